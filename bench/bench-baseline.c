@@ -0,0 +1,426 @@
+/*
+ * bench-baseline.c - the throughput workload over other transports.
+ *
+ * The same single producer / single consumer stream of fixed size records is
+ * sent over the ring buffer and over the usual alternatives: a pipe (with
+ * write or vmsplice), a UNIX socketpair, a GAsyncQueue of heap buffers, an
+ * eventfd handoff of fixed slots and a plain ring without the double mapping
+ * that has to split copies at the wrap. All results come out in one table.
+ */
+
+#include "ringbuf.h"
+#include "bench-common.h"
+#include "bench-perf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+static gchar *sizes_option = "64,4K,64K,1M";
+static gchar *capacity_option = "1M";
+static gchar *total_option = "256M";
+static gchar *transports_option = NULL;
+static gboolean json = FALSE;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] = {
+    { "records", 'r', 0, G_OPTION_ARG_STRING, &sizes_option, "Record sizes to run", "LIST" },
+    { "capacity", 'c', 0, G_OPTION_ARG_STRING, &capacity_option, "Buffering of every transport", "SIZE" },
+    { "total", 't', 0, G_OPTION_ARG_STRING, &total_option, "Bytes transferred per run", "SIZE" },
+    { "transports", 0, 0, G_OPTION_ARG_STRING, &transports_option, "Transports to run (default all)", "LIST" },
+    { "json", 0, 0, G_OPTION_ARG_NONE, &json, "Write JSON instead of CSV", NULL },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Output file (default stdout)", "FILE" },
+    { NULL }
+};
+
+typedef struct {
+    gsize record_size;
+    guint64 nb_records;
+    gsize capacity;
+    // Sent by the producer, generated before the timer starts
+    guint8 *payload;
+
+    ringbuf_t *rb;
+    gint fds[2];
+    GAsyncQueue *queue, *tokens;
+
+    // eventfd handoff and plain ring
+    guint8 *slots;
+    guint nb_slots;
+    guint64 head, tail;
+    GMutex mutex;
+    GCond readable, writeable;
+} run_t;
+
+typedef struct {
+    const gchar *name;
+    gboolean (*setup) (run_t *run);
+    void (*send) (run_t *run, const guint8 *record);
+    void (*receive) (run_t *run, guint8 *record);
+    void (*teardown) (run_t *run);
+} transport_t;
+
+static void write_full (gint fd, const guint8 *data, gsize len) {
+    while (len > 0) {
+        gssize n = write (fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        g_assert (n > 0);
+        data += n;
+        len -= n;
+    }
+}
+
+static void read_full (gint fd, guint8 *data, gsize len) {
+    while (len > 0) {
+        gssize n = read (fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        g_assert (n > 0);
+        data += n;
+        len -= n;
+    }
+}
+
+static void close_fds (run_t *run) {
+    close (run->fds[0]);
+    close (run->fds[1]);
+}
+
+/* ringbuf */
+
+static gboolean ring_setup (run_t *run) {
+    run->rb = ringbuf_new_named ("bench-baseline", run->capacity, TRUE);
+    return run->rb != NULL && ringbuf_buffer_size (run->rb) >= run->record_size;
+}
+
+static void ring_send (run_t *run, const guint8 *record) {
+    ringbuf_push (run->rb, record, run->record_size);
+}
+
+static void ring_receive (run_t *run, guint8 *record) {
+    ringbuf_pop (record, run->rb, run->record_size);
+}
+
+static void ring_teardown (run_t *run) {
+    ringbuf_free (run->rb);
+}
+
+/* pipe, with write or vmsplice */
+
+static gboolean pipe_setup (run_t *run) {
+    if (pipe2 (run->fds, O_CLOEXEC) != 0) {
+        return FALSE;
+    }
+    // May be capped by /proc/sys/fs/pipe-max-size, the pipe still works
+    fcntl (run->fds[1], F_SETPIPE_SZ, (gint) run->capacity);
+    return TRUE;
+}
+
+static void pipe_send (run_t *run, const guint8 *record) {
+    write_full (run->fds[1], record, run->record_size);
+}
+
+static void vmsplice_send (run_t *run, const guint8 *record) {
+    // The record buffer is never modified, so the pages can be referenced as is
+    struct iovec iov = { (gpointer) record, run->record_size };
+    while (iov.iov_len > 0) {
+        gssize n = vmsplice (run->fds[1], &iov, 1, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        g_assert (n > 0);
+        iov.iov_base = (guint8 *) iov.iov_base + n;
+        iov.iov_len -= n;
+    }
+}
+
+static void fd_receive (run_t *run, guint8 *record) {
+    read_full (run->fds[0], record, run->record_size);
+}
+
+/* socketpair */
+
+static gboolean socketpair_setup (run_t *run) {
+    if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, run->fds) != 0) {
+        return FALSE;
+    }
+    gint size = run->capacity;
+    setsockopt (run->fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt (run->fds[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    return TRUE;
+}
+
+/* GAsyncQueue of heap buffers, bounded by a queue of tokens */
+
+static gboolean queue_setup (run_t *run) {
+    run->queue = g_async_queue_new ();
+    run->tokens = g_async_queue_new ();
+    for (gsize i = 0; i < MAX(run->capacity / run->record_size, 1); i++) {
+        g_async_queue_push (run->tokens, GUINT_TO_POINTER (1));
+    }
+    return TRUE;
+}
+
+static void queue_send (run_t *run, const guint8 *record) {
+    g_async_queue_pop (run->tokens);
+    guint8 *buffer = g_malloc (run->record_size);
+    memcpy (buffer, record, run->record_size);
+    g_async_queue_push (run->queue, buffer);
+}
+
+static void queue_receive (run_t *run, guint8 *record) {
+    guint8 *buffer = g_async_queue_pop (run->queue);
+    memcpy (record, buffer, run->record_size);
+    g_free (buffer);
+    g_async_queue_push (run->tokens, GUINT_TO_POINTER (1));
+}
+
+static void queue_teardown (run_t *run) {
+    g_async_queue_unref (run->queue);
+    g_async_queue_unref (run->tokens);
+}
+
+/* eventfd handoff: fixed slots, one semaphore for filled ones, one for free ones */
+
+static gboolean eventfd_setup (run_t *run) {
+    run->nb_slots = MAX(run->capacity / run->record_size, 1);
+    run->slots = g_malloc0 (run->nb_slots * run->record_size);
+    run->head = run->tail = 0;
+    run->fds[0] = eventfd (0, EFD_SEMAPHORE | EFD_CLOEXEC);
+    run->fds[1] = eventfd (run->nb_slots, EFD_SEMAPHORE | EFD_CLOEXEC);
+    return run->fds[0] >= 0 && run->fds[1] >= 0;
+}
+
+static void eventfd_send (run_t *run, const guint8 *record) {
+    guint64 token = 1;
+    read_full (run->fds[1], (guint8 *) &token, sizeof(token));
+    memcpy (run->slots + (run->head++ % run->nb_slots) * run->record_size, record, run->record_size);
+    token = 1;
+    write_full (run->fds[0], (guint8 *) &token, sizeof(token));
+}
+
+static void eventfd_receive (run_t *run, guint8 *record) {
+    guint64 token = 1;
+    read_full (run->fds[0], (guint8 *) &token, sizeof(token));
+    memcpy (record, run->slots + (run->tail++ % run->nb_slots) * run->record_size, run->record_size);
+    token = 1;
+    write_full (run->fds[1], (guint8 *) &token, sizeof(token));
+}
+
+static void eventfd_teardown (run_t *run) {
+    close_fds (run);
+    g_free (run->slots);
+}
+
+/* Plain ring: same locking as ringbuf, but copies are split at the wrap */
+
+static gboolean plain_setup (run_t *run) {
+    if (run->capacity < run->record_size) {
+        return FALSE;
+    }
+    run->slots = g_malloc0 (run->capacity);
+    run->head = run->tail = 0;
+    g_mutex_init (&run->mutex);
+    g_cond_init (&run->readable);
+    g_cond_init (&run->writeable);
+    return TRUE;
+}
+
+static void plain_send (run_t *run, const guint8 *record) {
+    g_mutex_lock (&run->mutex);
+    while (run->capacity - (run->head - run->tail) < run->record_size) {
+        g_cond_wait (&run->writeable, &run->mutex);
+    }
+    gsize offset = run->head % run->capacity;
+    gsize first = MIN(run->record_size, run->capacity - offset);
+    memcpy (run->slots + offset, record, first);
+    memcpy (run->slots, record + first, run->record_size - first);
+    run->head += run->record_size;
+    g_cond_signal (&run->readable);
+    g_mutex_unlock (&run->mutex);
+}
+
+static void plain_receive (run_t *run, guint8 *record) {
+    g_mutex_lock (&run->mutex);
+    while (run->head - run->tail < run->record_size) {
+        g_cond_wait (&run->readable, &run->mutex);
+    }
+    gsize offset = run->tail % run->capacity;
+    gsize first = MIN(run->record_size, run->capacity - offset);
+    memcpy (record, run->slots + offset, first);
+    memcpy (record + first, run->slots, run->record_size - first);
+    run->tail += run->record_size;
+    g_cond_signal (&run->writeable);
+    g_mutex_unlock (&run->mutex);
+}
+
+static void plain_teardown (run_t *run) {
+    g_mutex_clear (&run->mutex);
+    g_cond_clear (&run->readable);
+    g_cond_clear (&run->writeable);
+    g_free (run->slots);
+}
+
+static const transport_t transports[] = {
+    { "ringbuf", ring_setup, ring_send, ring_receive, ring_teardown },
+    { "pipe", pipe_setup, pipe_send, fd_receive, close_fds },
+    { "pipe-vmsplice", pipe_setup, vmsplice_send, fd_receive, close_fds },
+    { "socketpair", socketpair_setup, pipe_send, fd_receive, close_fds },
+    { "gasyncqueue", queue_setup, queue_send, queue_receive, queue_teardown },
+    { "eventfd", eventfd_setup, eventfd_send, eventfd_receive, eventfd_teardown },
+    { "plain-ring", plain_setup, plain_send, plain_receive, plain_teardown },
+};
+
+typedef struct {
+    const transport_t *transport;
+    run_t *run;
+} thread_data_t;
+
+static gpointer producer (gpointer data) {
+    thread_data_t *td = data;
+
+    for (guint64 i = 0; i < td->run->nb_records; i++) {
+        td->transport->send (td->run, td->run->payload);
+    }
+    return NULL;
+}
+
+static gpointer consumer (gpointer data) {
+    thread_data_t *td = data;
+    guint8 *record = g_malloc (td->run->record_size);
+
+    for (guint64 i = 0; i < td->run->nb_records; i++) {
+        td->transport->receive (td->run, record);
+    }
+
+    g_free (record);
+    return NULL;
+}
+
+static gboolean is_selected (gchar **selected, const gchar *name) {
+    if (selected == NULL) {
+        return TRUE;
+    }
+    for (guint i = 0; selected[i] != NULL; i++) {
+        if (g_strcmp0 (selected[i], name) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void append_result (GString *out, const transport_t *transport, const run_t *run,
+                           gint64 elapsed, const bench_perf_t *perf) {
+    guint64 bytes = run->nb_records * run->record_size;
+
+    if (!json) {
+        g_string_append_printf (out, "%s,%" G_GSIZE_FORMAT ",%" G_GUINT64_FORMAT ",%.3f,%.1f,%.3f",
+                                transport->name, run->record_size, run->nb_records, elapsed / 1e6,
+                                (gdouble) bytes / elapsed, (gdouble) run->nb_records / elapsed);
+        bench_perf_append_csv (out, perf, run->nb_records, bytes);
+        g_string_append_c (out, '\n');
+        return;
+    }
+
+    g_string_append_printf (out, "%s  {\"transport\": \"%s\", \"record_bytes\": %" G_GSIZE_FORMAT
+                            ", \"records\": %" G_GUINT64_FORMAT ", \"seconds\": %.3f"
+                            ", \"mb_per_s\": %.1f, \"mops_per_s\": %.3f",
+                            out->len > 2 ? ",\n" : "", transport->name, run->record_size, run->nb_records,
+                            elapsed / 1e6, (gdouble) bytes / elapsed, (gdouble) run->nb_records / elapsed);
+    bench_perf_append_json (out, perf, run->nb_records, bytes);
+    g_string_append (out, "}");
+}
+
+static void run_once (GString *out, const transport_t *transport, gsize record_size, gsize capacity, gsize total) {
+    run_t run = {
+        .record_size = record_size,
+        .nb_records = MAX(total / record_size, 1),
+        .capacity = capacity,
+    };
+    thread_data_t td = { transport, &run };
+    bench_perf_t perf;
+
+    if (!transport->setup (&run)) {
+        g_warning ("Could not set up %s for %" G_GSIZE_FORMAT " byte records", transport->name, record_size);
+        return;
+    }
+
+    run.payload = bench_payload_new (record_size, 1);
+
+    bench_perf_open (&perf);
+    bench_perf_start (&perf);
+    gint64 start = g_get_monotonic_time ();
+
+    GThread *threads[2] = {
+        g_thread_new ("consumer", consumer, &td),
+        g_thread_new ("producer", producer, &td),
+    };
+    g_thread_join (threads[0]);
+    g_thread_join (threads[1]);
+
+    gint64 elapsed = MAX(g_get_monotonic_time () - start, 1);
+    bench_perf_stop (&perf);
+
+    append_result (out, transport, &run, elapsed, &perf);
+
+    bench_perf_close (&perf);
+    transport->teardown (&run);
+    g_free (run.payload);
+}
+
+int main (int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- compare the ring buffer with other transports");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    GArray *records = bench_parse_sizes (sizes_option);
+    GArray *capacity = bench_parse_sizes (capacity_option);
+    GArray *total = bench_parse_sizes (total_option);
+    if (records == NULL || capacity == NULL || total == NULL) {
+        return 1;
+    }
+    gchar **selected = transports_option != NULL ? g_strsplit (transports_option, ",", -1) : NULL;
+
+    GString *out = g_string_new (NULL);
+    if (json) {
+        g_string_append (out, "[\n");
+    }
+    else {
+        g_string_append (out, "transport,record_bytes,records,seconds,mb_per_s,mops_per_s");
+        bench_perf_append_csv_header (out);
+        g_string_append_c (out, '\n');
+    }
+
+    for (guint i = 0; i < records->len; i++) {
+        for (guint t = 0; t < G_N_ELEMENTS(transports); t++) {
+            if (!is_selected (selected, transports[t].name)) {
+                continue;
+            }
+            run_once (out, &transports[t], g_array_index (records, gsize, i),
+                      g_array_index (capacity, gsize, 0), g_array_index (total, gsize, 0));
+        }
+    }
+
+    if (json) {
+        g_string_append (out, "\n]\n");
+    }
+    gboolean ok = bench_write_output (output, out);
+
+    g_string_free (out, TRUE);
+    g_strfreev (selected);
+    g_array_free (records, TRUE);
+    g_array_free (capacity, TRUE);
+    g_array_free (total, TRUE);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+ * Helpers shared by the benchmark programs.
+ */
+
+#define _GNU_SOURCE
+#include "bench-common.h"
+#include "ringbuf-framegen.h"
+
+#include <errno.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+GArray *bench_parse_sizes (const gchar *list) {
+    gchar **items = g_strsplit (list, ",", -1);
+    GArray *sizes = g_array_new (FALSE, FALSE, sizeof(gsize));
+
+    for (guint i = 0; items[i] != NULL; i++) {
+        gchar *end = NULL;
+        gsize size = g_ascii_strtoull (items[i], &end, 10);
+
+        switch (*end) {
+        case 'G': case 'g': size <<= 10; /* fall through */
+        case 'M': case 'm': size <<= 10; /* fall through */
+        case 'K': case 'k': size <<= 10; end++; break;
+        default: break;
+        }
+        if (end == items[i] || *end != '\0' || size == 0) {
+            g_warning ("Invalid size '%s'", items[i]);
+            g_array_free (sizes, TRUE);
+            g_strfreev (items);
+            return NULL;
+        }
+        g_array_append_val (sizes, size);
+    }
+
+    g_strfreev (items);
+    return sizes;
+}
+
+guint8 *bench_payload_new (gsize size, guint32 seed) {
+    guint8 *payload = g_malloc (size);
+    // One row of bytes, like the frames of bench-loadgen
+    ringbuf_framegen_t *gen = ringbuf_framegen_new (RINGBUF_PATTERN_NOISE, size, 1, 1, seed);
+
+    ringbuf_framegen_fill (gen, payload);
+    ringbuf_framegen_free (gen);
+    return payload;
+}
+
+gboolean bench_write_output (const gchar *path, const GString *text) {
+    if (path == NULL || g_strcmp0 (path, "-") == 0) {
+        fputs (text->str, stdout);
+        return TRUE;
+    }
+
+    FILE *fp = fopen (path, "w");
+    if (fp == NULL) {
+        g_warning ("Could not open %s", path);
+        return FALSE;
+    }
+    gboolean ok = fwrite (text->str, 1, text->len, fp) == text->len;
+    if (fclose (fp) != 0 || !ok) {
+        g_warning ("Could not write %s", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+guint64 bench_now_ns (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (guint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+gboolean bench_pin_thread (gint cpu) {
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    if (cpu < 0) {
+        for (gint i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET (i, &set);
+        }
+    }
+    else {
+        CPU_SET (cpu, &set);
+    }
+    if (sched_setaffinity (0, sizeof(set), &set) != 0) {
+        g_warning ("Could not pin thread to CPU %d: %s", cpu, strerror (errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Values below 2^(HIST_SUB_BITS + 1) are stored exactly, larger values keep
+ * their HIST_SUB_BITS + 1 most significant bits, i.e. a relative error below
+ * 1 / 2^HIST_SUB_BITS.
+ */
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+struct _bench_hist_t {
+    guint64 count;
+    guint64 max;
+    gdouble sum;
+    guint64 buckets[HIST_BUCKETS];
+};
+
+static guint hist_index (guint64 value) {
+    guint bits = value == 0 ? 0 : 64 - __builtin_clzll (value);
+    guint shift = bits > HIST_SUB_BITS + 1 ? bits - (HIST_SUB_BITS + 1) : 0;
+    return shift * HIST_SUB_COUNT + (value >> shift);
+}
+
+static guint64 hist_highest_value (guint index) {
+    guint shift = index < 2 * HIST_SUB_COUNT ? 0 : index / HIST_SUB_COUNT - 1;
+    guint64 sub = index - shift * HIST_SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+bench_hist_t *bench_hist_new (void) {
+    return g_new0 (bench_hist_t, 1);
+}
+
+void bench_hist_free (bench_hist_t *hist) {
+    g_free (hist);
+}
+
+void bench_hist_reset (bench_hist_t *hist) {
+    memset (hist, 0, sizeof(*hist));
+}
+
+void bench_hist_record (bench_hist_t *hist, guint64 value) {
+    hist->buckets[hist_index (value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void bench_hist_merge (bench_hist_t *dst, const bench_hist_t *src) {
+    for (guint i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->max = MAX(dst->max, src->max);
+}
+
+guint64 bench_hist_count (const bench_hist_t *hist) {
+    return hist->count;
+}
+
+guint64 bench_hist_max (const bench_hist_t *hist) {
+    return hist->max;
+}
+
+gdouble bench_hist_mean (const bench_hist_t *hist) {
+    return hist->count > 0 ? hist->sum / hist->count : 0.0;
+}
+
+guint64 bench_hist_percentile (const bench_hist_t *hist, gdouble percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    guint64 rank = (guint64) (CLAMP(percentile, 0.0, 100.0) / 100.0 * hist->count + 0.5);
+    guint64 seen = 0;
+    rank = CLAMP(rank, 1, hist->count);
+    for (guint i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            return MIN(hist_highest_value (i), hist->max);
+        }
+    }
+    return hist->max;
+}
+
+static guint64 hist_count_at_or_below (const bench_hist_t *hist, guint64 value) {
+    guint64 seen = 0;
+    guint last = hist_index (value);
+    for (guint i = 0; i <= last; i++) {
+        seen += hist->buckets[i];
+    }
+    return seen;
+}
+
+void bench_hist_append_hgrm (GString *out, const bench_hist_t *hist, gdouble unit) {
+    gdouble mean = bench_hist_mean (hist);
+    gdouble variance = 0.0;
+    guint nb_buckets = 0;
+
+    g_string_append_printf (out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+    // Same iteration as HdrHistogram: 5 ticks per halving of the distance to 100%
+    for (gdouble p = 0.0; hist->count > 0 && p < 100.0;) {
+        guint64 value = bench_hist_percentile (hist, p);
+        g_string_append_printf (out, "%12.3f %2.12f %10" G_GUINT64_FORMAT " %14.2f\n",
+                                value / unit, p / 100.0, hist_count_at_or_below (hist, value),
+                                1.0 / (1.0 - p / 100.0));
+        if (hist_count_at_or_below (hist, value) == hist->count) {
+            break;
+        }
+        gdouble half_distance = exp2 (floor (log2 (100.0 / (100.0 - p))) + 1);
+        p += 100.0 / (5 * half_distance);
+    }
+    if (hist->count > 0) {
+        g_string_append_printf (out, "%12.3f %2.12f %10" G_GUINT64_FORMAT "\n",
+                                hist->max / unit, 1.0, hist->count);
+    }
+
+    for (guint i = 0; i < HIST_BUCKETS; i++) {
+        if (hist->buckets[i] > 0) {
+            gdouble delta = hist_highest_value (i) - mean;
+            variance += delta * delta * hist->buckets[i];
+            nb_buckets = i / HIST_SUB_COUNT + 1;
+        }
+    }
+    variance = hist->count > 0 ? variance / hist->count : 0.0;
+
+    g_string_append_printf (out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / unit, sqrt (variance) / unit);
+    g_string_append_printf (out, "#[Max     = %12.3f, Total count    = %12" G_GUINT64_FORMAT "]\n", hist->max / unit, hist->count);
+    g_string_append_printf (out, "#[Buckets = %12u, SubBuckets     = %12u]\n", nb_buckets, 2 * HIST_SUB_COUNT);
+}
@@ -0,0 +1,134 @@
+#ifndef INCLUDED_BENCH_COMMON_H
+#define INCLUDED_BENCH_COMMON_H
+
+#include <glib.h>
+
+typedef struct _bench_hist_t bench_hist_t;
+
+/**
+ * bench_now_ns:
+ *
+ * Returns the monotonic clock in nanoseconds.
+ */
+guint64 bench_now_ns (void);
+
+/**
+ * bench_pin_thread:
+ * @cpu: CPU to run on, or a negative value to allow every CPU again.
+ *
+ * Pins the calling thread to @cpu. Returns FALSE and warns on error.
+ */
+gboolean bench_pin_thread (gint cpu);
+
+/**
+ * bench_hist_new:
+ *
+ * Creates an HDR style log-linear histogram covering the whole #guint64 range
+ * with a relative precision better than 1%.
+ */
+bench_hist_t *bench_hist_new (void);
+
+/**
+ * bench_hist_free:
+ * @hist: A histogram.
+ */
+void bench_hist_free (bench_hist_t *hist);
+
+/**
+ * bench_hist_reset:
+ * @hist: A histogram.
+ *
+ * Forgets all recorded values.
+ */
+void bench_hist_reset (bench_hist_t *hist);
+
+/**
+ * bench_hist_record:
+ * @hist: A histogram.
+ * @value: Value to record.
+ *
+ * Records @value. Never allocates, cheap enough for measurement loops.
+ */
+void bench_hist_record (bench_hist_t *hist, guint64 value);
+
+/**
+ * bench_hist_merge:
+ * @dst: Histogram to add to.
+ * @src: Histogram to add.
+ */
+void bench_hist_merge (bench_hist_t *dst, const bench_hist_t *src);
+
+/**
+ * bench_hist_count:
+ * @hist: A histogram.
+ *
+ * Returns the number of recorded values.
+ */
+guint64 bench_hist_count (const bench_hist_t *hist);
+
+/**
+ * bench_hist_max:
+ * @hist: A histogram.
+ *
+ * Returns the largest recorded value, exactly.
+ */
+guint64 bench_hist_max (const bench_hist_t *hist);
+
+/**
+ * bench_hist_mean:
+ * @hist: A histogram.
+ *
+ * Returns the mean of the recorded values.
+ */
+gdouble bench_hist_mean (const bench_hist_t *hist);
+
+/**
+ * bench_hist_percentile:
+ * @hist: A histogram.
+ * @percentile: Percentile between 0 and 100.
+ *
+ * Returns the value at @percentile, within the histogram precision.
+ */
+guint64 bench_hist_percentile (const bench_hist_t *hist, gdouble percentile);
+
+/**
+ * bench_hist_append_hgrm:
+ * @out: String to append to.
+ * @hist: A histogram.
+ * @unit: Divider applied to values, e.g. 1000 to print nanoseconds as microseconds.
+ *
+ * Appends the percentile distribution in the HdrHistogram .hgrm text format,
+ * as understood by the HdrHistogram plotter.
+ */
+void bench_hist_append_hgrm (GString *out, const bench_hist_t *hist, gdouble unit);
+
+/**
+ * bench_parse_sizes:
+ * @list: Comma separated sizes, with optional K, M or G (binary) suffixes.
+ *
+ * Parses a list such as "64,4K,2M". Returns a #GArray of #gsize, or NULL if
+ * @list is malformed.
+ */
+GArray *bench_parse_sizes (const gchar *list);
+
+/**
+ * bench_payload_new:
+ * @size: Record size in bytes.
+ * @seed: Seed of the noise.
+ *
+ * Allocates a record of noise from the synthetic frame generator, the same
+ * data the tests and bench-loadgen send. Generated once before a run, so
+ * the timed loop measures the ring and not the generator. Free with g_free().
+ */
+guint8 *bench_payload_new (gsize size, guint32 seed);
+
+/**
+ * bench_write_output:
+ * @path: File to write, or NULL or "-" for stdout.
+ * @text: Contents.
+ *
+ * Writes benchmark results. Returns FALSE and warns on error.
+ */
+gboolean bench_write_output (const gchar *path, const GString *text);
+
+#endif /* INCLUDED_BENCH_COMMON_H */
@@ -0,0 +1,273 @@
+/*
+ * bench-loadgen.c - open-loop, rate-controlled load generator.
+ *
+ * Frames are sent on a fixed schedule, frame i being due at start + i * period,
+ * whatever happened to the previous ones. Latency is measured from that
+ * intended send time, so a stalled producer or a full ring shows up as latency
+ * instead of silently lowering the offered load (coordinated omission).
+ * Frame contents come from the synthetic frame generator, written in place in
+ * reserve mode or taken from a pool built before the run in push mode, so
+ * nothing is allocated while sending.
+ */
+
+#include "ringbuf.h"
+#include "ringbuf-framegen.h"
+#include "bench-common.h"
+
+#include <errno.h>
+#include <time.h>
+
+#define POOL_SIZE 16
+
+typedef enum {
+    MODE_PUSH,
+    MODE_RESERVE,
+    NB_MODES
+} loadgen_mode_t;
+
+static const gchar *mode_str[NB_MODES] = {
+    "push",
+    "reserve"
+};
+
+// Stamped at the start of every frame
+typedef struct {
+    guint64 sequence;
+    guint64 intended_ns;
+} frame_header_t;
+
+static gchar *frame_option = "2M";
+static gchar *ring_option = "64M";
+static gchar *rate_option = NULL;
+static gdouble fps = 1000.0;
+static gdouble duration = 5.0;
+static gchar *mode_option = "push";
+static gchar *pattern_option = "ramp";
+static gboolean nonblock = FALSE;
+static gchar *hgrm_path = NULL;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] = {
+    { "frame", 'f', 0, G_OPTION_ARG_STRING, &frame_option, "Frame size", "SIZE" },
+    { "ring", 's', 0, G_OPTION_ARG_STRING, &ring_option, "Ring buffer size", "SIZE" },
+    { "fps", 0, 0, G_OPTION_ARG_DOUBLE, &fps, "Frames per second", "N" },
+    { "rate", 0, 0, G_OPTION_ARG_STRING, &rate_option, "Bytes per second, overrides --fps", "SIZE" },
+    { "duration", 'd', 0, G_OPTION_ARG_DOUBLE, &duration, "Seconds to run", "S" },
+    { "mode", 'm', 0, G_OPTION_ARG_STRING, &mode_option, "push (copy in and out) or reserve (reserve/commit, zero-copy read)", "MODE" },
+    { "pattern", 0, 0, G_OPTION_ARG_STRING, &pattern_option, "Frame contents, ramp or noise", "PATTERN" },
+    { "nonblock", 0, 0, G_OPTION_ARG_NONE, &nonblock, "Use a non-blocking ring, frames that do not fit are dropped", NULL },
+    { "hgrm", 0, 0, G_OPTION_ARG_FILENAME, &hgrm_path, "Write the latency distribution in .hgrm format", "FILE" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "CSV output file (default stdout)", "FILE" },
+    { NULL }
+};
+
+typedef struct {
+    ringbuf_t *rb;
+    loadgen_mode_t mode;
+    gsize frame_size;
+    guint64 nb_frames;
+    guint64 period_ns;
+    ringbuf_framegen_t *gen;
+    guint8 *pool[POOL_SIZE];
+
+    gint done;
+    // The producer stopped early because it could not sleep
+    gboolean failed;
+    guint64 sent, dropped, received;
+    guint64 start_ns, end_ns;
+    bench_hist_t *latency;
+} loadgen_t;
+
+static void build_pool (loadgen_t *lg) {
+    for (guint p = 0; p < POOL_SIZE; p++) {
+        lg->pool[p] = g_malloc (lg->frame_size);
+        ringbuf_framegen_fill (lg->gen, lg->pool[p]);
+    }
+}
+
+// Returns FALSE if the clock cannot be slept on, retrying only on signals
+static gboolean sleep_until (guint64 deadline_ns) {
+    struct timespec ts = {
+        .tv_sec = deadline_ns / 1000000000,
+        .tv_nsec = deadline_ns % 1000000000,
+    };
+    gint error;
+    while ((error = clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR) {
+    }
+    if (error != 0) {
+        g_warning ("Could not sleep until the next frame is due: %s", g_strerror (error));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gpointer producer (gpointer data) {
+    loadgen_t *lg = data;
+
+    for (guint64 i = 0; i < lg->nb_frames; i++) {
+        frame_header_t header = {
+            .sequence = i,
+            .intended_ns = lg->start_ns + i * lg->period_ns,
+        };
+
+        // Never catch up by skipping frames, late frames go out immediately
+        if (bench_now_ns () < header.intended_ns && !sleep_until (header.intended_ns)) {
+            lg->failed = TRUE;
+            break;
+        }
+
+        if (lg->mode == MODE_RESERVE) {
+            guint8 *frame = ringbuf_reserve (lg->rb, lg->frame_size);
+            if (frame == NULL) {
+                lg->dropped++;
+                continue;
+            }
+            ringbuf_framegen_fill (lg->gen, frame);
+            memcpy (frame, &header, sizeof(header));
+            ringbuf_commit (lg->rb, lg->frame_size);
+        }
+        else {
+            // The header goes into the pool slot, which only this thread touches
+            memcpy (lg->pool[i % POOL_SIZE], &header, sizeof(header));
+            if (ringbuf_push (lg->rb, lg->pool[i % POOL_SIZE], lg->frame_size) == NULL) {
+                lg->dropped++;
+                continue;
+            }
+        }
+        lg->sent++;
+    }
+
+    g_atomic_int_set (&lg->done, TRUE);
+    return NULL;
+}
+
+static gpointer consumer (gpointer data) {
+    loadgen_t *lg = data;
+    guint8 *frame = g_malloc (lg->frame_size);
+    frame_header_t header;
+
+    while (TRUE) {
+        if (lg->mode == MODE_RESERVE) {
+            if (ringbuf_wait_for_data_timed (lg->rb, lg->frame_size, 100 * G_TIME_SPAN_MILLISECOND) == 0) {
+                if (g_atomic_int_get (&lg->done) && ringbuf_is_empty (lg->rb)) {
+                    break;
+                }
+                continue;
+            }
+            memcpy (&header, ringbuf_tail (lg->rb), sizeof(header));
+            ringbuf_move_tail (lg->rb, lg->frame_size);
+        }
+        else {
+            if (ringbuf_timed_pop (frame, lg->rb, lg->frame_size, 100 * G_TIME_SPAN_MILLISECOND) == NULL) {
+                if (g_atomic_int_get (&lg->done) && ringbuf_is_empty (lg->rb)) {
+                    break;
+                }
+                continue;
+            }
+            memcpy (&header, frame, sizeof(header));
+        }
+
+        guint64 now = bench_now_ns ();
+        bench_hist_record (lg->latency, now > header.intended_ns ? now - header.intended_ns : 0);
+        lg->received++;
+        lg->end_ns = now;
+    }
+
+    g_free (frame);
+    return NULL;
+}
+
+int main (int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- open-loop ring buffer load generator");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    loadgen_t lg = { .mode = NB_MODES };
+    GArray *frame = bench_parse_sizes (frame_option);
+    GArray *ring = bench_parse_sizes (ring_option);
+    GArray *rate = rate_option != NULL ? bench_parse_sizes (rate_option) : NULL;
+    if (frame == NULL || ring == NULL || (rate_option != NULL && rate == NULL)) {
+        return 1;
+    }
+    for (guint i = 0; i < NB_MODES; i++) {
+        if (g_strcmp0 (mode_option, mode_str[i]) == 0) {
+            lg.mode = i;
+        }
+    }
+    lg.frame_size = g_array_index (frame, gsize, 0);
+    if (rate != NULL) {
+        fps = (gdouble) g_array_index (rate, gsize, 0) / lg.frame_size;
+    }
+    if (lg.mode == NB_MODES || lg.frame_size < sizeof(frame_header_t) || fps <= 0.0 || duration <= 0.0) {
+        g_printerr ("Invalid mode, frame size (at least %" G_GSIZE_FORMAT " bytes), rate or duration\n",
+                    sizeof(frame_header_t));
+        return 1;
+    }
+    lg.period_ns = MAX(1e9 / fps, 1);
+    lg.nb_frames = MAX(duration * fps, 1);
+    lg.rb = ringbuf_new_named ("bench-loadgen", g_array_index (ring, gsize, 0), !nonblock);
+    lg.latency = bench_hist_new ();
+    if (lg.rb == NULL || lg.frame_size > ringbuf_buffer_size (lg.rb)) {
+        g_printerr ("Frames do not fit in the ring\n");
+        return 1;
+    }
+    // Frames are handled as single rows of bytes
+    if (g_strcmp0 (pattern_option, "ramp") != 0 && g_strcmp0 (pattern_option, "noise") != 0) {
+        g_printerr ("Unknown pattern '%s'\n", pattern_option);
+        return 1;
+    }
+    lg.gen = ringbuf_framegen_new (g_strcmp0 (pattern_option, "noise") == 0 ? RINGBUF_PATTERN_NOISE : RINGBUF_PATTERN_RAMP,
+                                   lg.frame_size, 1, 1, 0);
+    build_pool (&lg);
+
+    // Fault the ring in so the first frames do not pay for it
+    memset ((gpointer) ringbuf_head (lg.rb), 0, ringbuf_buffer_size (lg.rb));
+
+    lg.start_ns = bench_now_ns ();
+    GThread *threads[2] = {
+        g_thread_new ("consumer", consumer, &lg),
+        g_thread_new ("producer", producer, &lg),
+    };
+    g_thread_join (threads[1]);
+    g_thread_join (threads[0]);
+
+    gdouble elapsed = (lg.end_ns > lg.start_ns ? lg.end_ns - lg.start_ns : 1) / 1e9;
+    GString *csv = g_string_new ("mode,nonblock,frame_bytes,target_fps,achieved_fps,sent,dropped,received,"
+                                 "p50_us,p99_us,p999_us,max_us,mean_us\n");
+    g_string_append_printf (csv, "%s,%d,%" G_GSIZE_FORMAT ",%.1f,%.1f,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
+                            ",%" G_GUINT64_FORMAT ",%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                            mode_str[lg.mode], nonblock, lg.frame_size, fps, lg.received / elapsed,
+                            lg.sent, lg.dropped, lg.received,
+                            bench_hist_percentile (lg.latency, 50.0) / 1e3,
+                            bench_hist_percentile (lg.latency, 99.0) / 1e3,
+                            bench_hist_percentile (lg.latency, 99.9) / 1e3,
+                            bench_hist_max (lg.latency) / 1e3, bench_hist_mean (lg.latency) / 1e3);
+    gboolean ok = !lg.failed && bench_write_output (output, csv);
+
+    if (hgrm_path != NULL) {
+        GString *hgrm = g_string_new (NULL);
+        bench_hist_append_hgrm (hgrm, lg.latency, 1000.0);
+        ok = bench_write_output (hgrm_path, hgrm) && ok;
+        g_string_free (hgrm, TRUE);
+    }
+
+    for (guint p = 0; p < POOL_SIZE; p++) {
+        g_free (lg.pool[p]);
+    }
+    g_string_free (csv, TRUE);
+    ringbuf_framegen_free (lg.gen);
+    bench_hist_free (lg.latency);
+    ringbuf_free (lg.rb);
+    g_array_free (frame, TRUE);
+    g_array_free (ring, TRUE);
+    if (rate != NULL) {
+        g_array_free (rate, TRUE);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * Hardware and software performance counters around benchmark runs, through
+ * perf_event_open(2).
+ */
+
+#define _GNU_SOURCE
+#include "bench-perf.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define HW_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    const gchar *name;
+    guint32 type;
+    guint64 config;
+} counters[BENCH_PERF_NB_COUNTERS] = {
+    [BENCH_PERF_CYCLES] = { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [BENCH_PERF_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [BENCH_PERF_LLC_MISSES] = { "llc_misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+    [BENCH_PERF_DTLB_MISSES] = { "dtlb_misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+    [BENCH_PERF_CONTEXT_SWITCHES] = { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    [BENCH_PERF_PAGE_FAULTS] = { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+static gint perf_event_open (struct perf_event_attr *attr) {
+    return syscall (__NR_perf_event_open, attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+void bench_perf_open (bench_perf_t *perf) {
+    static gboolean warned = FALSE;
+
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset (&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counters[i].type;
+        attr.config = counters[i].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        // Context switches and page faults happen in the kernel by definition
+        attr.exclude_kernel = counters[i].type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        perf->value[i] = 0;
+        perf->fd[i] = perf_event_open (&attr);
+        if (perf->fd[i] < 0 && !warned) {
+            g_warning ("perf counter %s unavailable (%s), check /proc/sys/kernel/perf_event_paranoid",
+                       counters[i].name, strerror (errno));
+            warned = TRUE;
+        }
+    }
+}
+
+void bench_perf_start (bench_perf_t *perf) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        if (perf->fd[i] >= 0) {
+            ioctl (perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl (perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void bench_perf_stop (bench_perf_t *perf) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        guint64 data[3]; // value, time enabled, time running
+
+        if (perf->fd[i] < 0) {
+            continue;
+        }
+        ioctl (perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read (perf->fd[i], data, sizeof(data)) != sizeof(data)) {
+            perf->value[i] = 0;
+            continue;
+        }
+        // Scale up counters the kernel had to multiplex
+        if (data[2] > 0 && data[2] < data[1]) {
+            perf->value[i] = (guint64) ((gdouble) data[0] * data[1] / data[2]);
+        }
+        else {
+            perf->value[i] = data[0];
+        }
+    }
+}
+
+void bench_perf_close (bench_perf_t *perf) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        if (perf->fd[i] >= 0) {
+            close (perf->fd[i]);
+            perf->fd[i] = -1;
+        }
+    }
+}
+
+const gchar *bench_perf_name (bench_perf_counter_t counter) {
+    return counters[counter].name;
+}
+
+void bench_perf_append_csv_header (GString *out) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        g_string_append_printf (out, ",%s_per_op,%s_per_byte", counters[i].name, counters[i].name);
+    }
+}
+
+void bench_perf_append_csv (GString *out, const bench_perf_t *perf, guint64 ops, guint64 bytes) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        if (perf->fd[i] < 0 || ops == 0 || bytes == 0) {
+            g_string_append (out, ",,");
+            continue;
+        }
+        g_string_append_printf (out, ",%.4g,%.4g",
+                                (gdouble) perf->value[i] / ops, (gdouble) perf->value[i] / bytes);
+    }
+}
+
+void bench_perf_append_json (GString *out, const bench_perf_t *perf, guint64 ops, guint64 bytes) {
+    for (guint i = 0; i < BENCH_PERF_NB_COUNTERS; i++) {
+        const gchar *name = counters[i].name;
+        if (perf->fd[i] < 0 || ops == 0 || bytes == 0) {
+            g_string_append_printf (out, ", \"%s_per_op\": null, \"%s_per_byte\": null", name, name);
+            continue;
+        }
+        g_string_append_printf (out, ", \"%s_per_op\": %.4g, \"%s_per_byte\": %.4g",
+                                name, (gdouble) perf->value[i] / ops, name, (gdouble) perf->value[i] / bytes);
+    }
+}
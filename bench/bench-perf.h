@@ -0,0 +1,106 @@
+#ifndef INCLUDED_BENCH_PERF_H
+#define INCLUDED_BENCH_PERF_H
+
+#include <glib.h>
+
+typedef enum {
+    BENCH_PERF_CYCLES,
+    BENCH_PERF_INSTRUCTIONS,
+    BENCH_PERF_LLC_MISSES,
+    BENCH_PERF_DTLB_MISSES,
+    BENCH_PERF_CONTEXT_SWITCHES,
+    BENCH_PERF_PAGE_FAULTS,
+    BENCH_PERF_NB_COUNTERS
+} bench_perf_counter_t;
+
+/**
+ * bench_perf_t:
+ * @fd: perf_event file descriptors, -1 for counters that could not be opened.
+ * @value: Counter values read by bench_perf_stop(), scaled for multiplexing.
+ *
+ * Set of hardware and software counters measured around a benchmark run.
+ */
+typedef struct {
+    gint fd[BENCH_PERF_NB_COUNTERS];
+    guint64 value[BENCH_PERF_NB_COUNTERS];
+} bench_perf_t;
+
+/**
+ * bench_perf_open:
+ * @perf: Counter set to open.
+ *
+ * Opens the counters for the calling process. Threads created afterwards are
+ * counted as well, so open before spawning the benchmark threads. Counters
+ * the kernel refuses (perf_event_paranoid, containers, missing PMU) are left
+ * unavailable, a single warning is printed per process.
+ */
+void bench_perf_open (bench_perf_t *perf);
+
+/**
+ * bench_perf_start:
+ * @perf: An opened counter set.
+ *
+ * Resets and enables all available counters.
+ */
+void bench_perf_start (bench_perf_t *perf);
+
+/**
+ * bench_perf_stop:
+ * @perf: A started counter set.
+ *
+ * Disables the counters and reads their values. Counts of threads created
+ * after bench_perf_open() are only folded in once those threads have exited,
+ * so join them first.
+ */
+void bench_perf_stop (bench_perf_t *perf);
+
+/**
+ * bench_perf_close:
+ * @perf: An opened counter set.
+ *
+ * Closes all counters.
+ */
+void bench_perf_close (bench_perf_t *perf);
+
+/**
+ * bench_perf_name:
+ * @counter: A counter.
+ *
+ * Returns a short name for @counter, suitable as a column header.
+ */
+const gchar *bench_perf_name (bench_perf_counter_t counter);
+
+/**
+ * bench_perf_append_csv_header:
+ * @out: String to append to.
+ *
+ * Appends the per-op and per-byte column names of every counter, each
+ * preceded by a comma.
+ */
+void bench_perf_append_csv_header (GString *out);
+
+/**
+ * bench_perf_append_csv:
+ * @out: String to append to.
+ * @perf: A stopped counter set.
+ * @ops: Operations done during the run.
+ * @bytes: Bytes moved during the run.
+ *
+ * Appends the per-op and per-byte value of every counter, each preceded by a
+ * comma. Unavailable counters are left empty.
+ */
+void bench_perf_append_csv (GString *out, const bench_perf_t *perf, guint64 ops, guint64 bytes);
+
+/**
+ * bench_perf_append_json:
+ * @out: String to append to.
+ * @perf: A stopped counter set.
+ * @ops: Operations done during the run.
+ * @bytes: Bytes moved during the run.
+ *
+ * Appends the same values as bench_perf_append_csv() as JSON members named
+ * like its columns, each preceded by a comma. Unavailable counters are null.
+ */
+void bench_perf_append_json (GString *out, const bench_perf_t *perf, guint64 ops, guint64 bytes);
+
+#endif /* INCLUDED_BENCH_PERF_H */
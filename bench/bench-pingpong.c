@@ -0,0 +1,204 @@
+/*
+ * bench-pingpong.c - round-trip latency between two threads over two rings.
+ *
+ * The pinger pushes a message into the ping ring and waits for the echo
+ * thread to bounce it back through the pong ring. Every combination of message
+ * size, wait strategy and core placement is one run. A CSV summary goes to the
+ * output, the full distribution of each run can be written as .hgrm files.
+ */
+
+#include "ringbuf.h"
+#include "bench-common.h"
+
+typedef enum {
+    WAIT_BLOCK,
+    WAIT_SPIN,
+    WAIT_YIELD,
+    NB_WAIT_STRATEGIES
+} wait_strategy_t;
+
+static const gchar *wait_strategy_str[NB_WAIT_STRATEGIES] = {
+    "block",
+    "spin",
+    "yield"
+};
+
+static gchar *sizes_option = "8,64,512,4K";
+static gchar *strategies_option = "block,spin,yield";
+static gchar *placements_option = "none";
+static gint iterations = 100000;
+static gint warmup = 1000;
+static gchar *hgrm_dir = NULL;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] = {
+    { "sizes", 's', 0, G_OPTION_ARG_STRING, &sizes_option, "Message sizes", "LIST" },
+    { "wait", 'w', 0, G_OPTION_ARG_STRING, &strategies_option, "Wait strategies among block,spin,yield (spin needs one free core per thread)", "LIST" },
+    { "placements", 'p', 0, G_OPTION_ARG_STRING, &placements_option,
+      "Core placements, 'none' or PINGER_CPU:ECHO_CPU", "LIST" },
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Round trips per run", "N" },
+    { "warmup", 0, 0, G_OPTION_ARG_INT, &warmup, "Unmeasured round trips per run", "N" },
+    { "hgrm-dir", 0, 0, G_OPTION_ARG_FILENAME, &hgrm_dir, "Write one .hgrm file per run there", "DIR" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "CSV output file (default stdout)", "FILE" },
+    { NULL }
+};
+
+typedef struct {
+    ringbuf_t *ping, *pong;
+    gsize size;
+    wait_strategy_t strategy;
+    gint cpu;
+    guint total;
+    bench_hist_t *rtt;
+} run_t;
+
+// Polls without the ring lock, so spinning never contends with the sender's push
+static void receive (ringbuf_t *rb, gpointer dst, gsize size, wait_strategy_t strategy) {
+    switch (strategy) {
+    case WAIT_SPIN:
+        while (ringbuf_bytes_used_relaxed (rb) < size) {
+        }
+        break;
+    case WAIT_YIELD:
+        while (ringbuf_bytes_used_relaxed (rb) < size) {
+            g_thread_yield ();
+        }
+        break;
+    default:
+        break;
+    }
+    ringbuf_pop (dst, rb, size);
+}
+
+static gpointer echo (gpointer data) {
+    run_t *run = data;
+    guint8 *message = g_malloc0 (run->size);
+
+    bench_pin_thread (run->cpu);
+    for (guint i = 0; i < run->total; i++) {
+        receive (run->ping, message, run->size, run->strategy);
+        ringbuf_push (run->pong, message, run->size);
+    }
+
+    g_free (message);
+    return NULL;
+}
+
+static void pinger (run_t *run, gint cpu) {
+    guint8 *message = bench_payload_new (run->size, 1);
+
+    bench_pin_thread (cpu);
+    for (guint i = 0; i < run->total; i++) {
+        guint64 start = bench_now_ns ();
+        ringbuf_push (run->ping, message, run->size);
+        receive (run->pong, message, run->size, run->strategy);
+        if (i >= (guint) warmup) {
+            bench_hist_record (run->rtt, bench_now_ns () - start);
+        }
+    }
+
+    g_free (message);
+}
+
+static gboolean parse_placement (const gchar *placement, gint *pinger_cpu, gint *echo_cpu) {
+    if (g_strcmp0 (placement, "none") == 0) {
+        *pinger_cpu = *echo_cpu = -1;
+        return TRUE;
+    }
+    return sscanf (placement, "%d:%d", pinger_cpu, echo_cpu) == 2 && *pinger_cpu >= 0 && *echo_cpu >= 0;
+}
+
+static void write_hgrm (const run_t *run, const gchar *placement) {
+    GString *hgrm = g_string_new (NULL);
+    gchar *name = g_strdup_printf ("pingpong-%" G_GSIZE_FORMAT "-%s-%s.hgrm",
+                                   run->size, wait_strategy_str[run->strategy], placement);
+    g_strdelimit (name, ":", '_');
+    gchar *path = g_build_filename (hgrm_dir, name, NULL);
+
+    bench_hist_append_hgrm (hgrm, run->rtt, 1000.0);
+    bench_write_output (path, hgrm);
+
+    g_free (path);
+    g_free (name);
+    g_string_free (hgrm, TRUE);
+}
+
+int main (int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- ring buffer round-trip latency benchmark");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    GArray *sizes = bench_parse_sizes (sizes_option);
+    if (sizes == NULL || iterations <= 0 || warmup < 0) {
+        return 1;
+    }
+    gchar **strategies = g_strsplit (strategies_option, ",", -1);
+    gchar **placements = g_strsplit (placements_option, ",", -1);
+
+    GString *csv = g_string_new ("size,wait,placement,count,min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,mean_ns\n");
+
+    for (guint s = 0; s < sizes->len; s++) {
+        for (guint w = 0; strategies[w] != NULL; w++) {
+            for (guint p = 0; placements[p] != NULL; p++) {
+                gsize size = g_array_index (sizes, gsize, s);
+                gint pinger_cpu, echo_cpu;
+                run_t run = {
+                    .size = size,
+                    .strategy = NB_WAIT_STRATEGIES,
+                    .total = iterations + warmup,
+                };
+
+                for (guint i = 0; i < NB_WAIT_STRATEGIES; i++) {
+                    if (g_strcmp0 (strategies[w], wait_strategy_str[i]) == 0) {
+                        run.strategy = i;
+                    }
+                }
+                if (run.strategy == NB_WAIT_STRATEGIES || !parse_placement (placements[p], &pinger_cpu, &echo_cpu)) {
+                    g_warning ("Skipping unknown wait strategy '%s' or placement '%s'", strategies[w], placements[p]);
+                    continue;
+                }
+
+                run.ping = ringbuf_new_named ("bench-ping", MAX(size, 1 << 16), TRUE);
+                run.pong = ringbuf_new_named ("bench-pong", MAX(size, 1 << 16), TRUE);
+                run.cpu = echo_cpu;
+                run.rtt = bench_hist_new ();
+
+                GThread *thread = g_thread_new ("echo", echo, &run);
+                pinger (&run, pinger_cpu);
+                g_thread_join (thread);
+                bench_pin_thread (-1);
+
+                g_string_append_printf (csv, "%" G_GSIZE_FORMAT ",%s,%s,%" G_GUINT64_FORMAT,
+                                        size, wait_strategy_str[run.strategy], placements[p], bench_hist_count (run.rtt));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT, bench_hist_percentile (run.rtt, 0.0));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT, bench_hist_percentile (run.rtt, 50.0));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT, bench_hist_percentile (run.rtt, 90.0));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT, bench_hist_percentile (run.rtt, 99.0));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT, bench_hist_percentile (run.rtt, 99.9));
+                g_string_append_printf (csv, ",%" G_GUINT64_FORMAT ",%.1f\n",
+                                        bench_hist_max (run.rtt), bench_hist_mean (run.rtt));
+                if (hgrm_dir != NULL) {
+                    write_hgrm (&run, placements[p]);
+                }
+
+                bench_hist_free (run.rtt);
+                ringbuf_free (run.ping);
+                ringbuf_free (run.pong);
+            }
+        }
+    }
+
+    gboolean ok = bench_write_output (output, csv);
+
+    g_string_free (csv, TRUE);
+    g_strfreev (placements);
+    g_strfreev (strategies);
+    g_array_free (sizes, TRUE);
+
+    return ok ? 0 : 1;
+}
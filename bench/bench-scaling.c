@@ -0,0 +1,221 @@
+/*
+ * bench-scaling.c - throughput against the number of producers and consumers.
+ *
+ * For every mode and record size, runs 1..N producers by 1..M consumers over
+ * one ring and prints a throughput matrix, plus one plot-ready CSV row per
+ * run. The ring has a single lock, so the copy mode accepts any number of
+ * threads while the zero-copy mode (reserve/commit, in-place read) is only
+ * valid with one producer and one consumer.
+ */
+
+#include "ringbuf.h"
+#include "bench-common.h"
+
+typedef enum {
+    MODE_COPY,
+    MODE_ZEROCOPY,
+    NB_MODES
+} scaling_mode_t;
+
+static const gchar *mode_str[NB_MODES] = {
+    "copy",
+    "zerocopy"
+};
+
+static gchar *sizes_option = "64,512,4K,32K,256K,2M,8M";
+static gchar *ring_option = "64M";
+static gchar *total_option = "128M";
+static gchar *modes_option = "copy,zerocopy";
+static gint max_producers = 4;
+static gint max_consumers = 4;
+static gboolean quiet = FALSE;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] = {
+    { "records", 'r', 0, G_OPTION_ARG_STRING, &sizes_option, "Record sizes to run", "LIST" },
+    { "ring", 's', 0, G_OPTION_ARG_STRING, &ring_option, "Ring buffer size", "SIZE" },
+    { "total", 't', 0, G_OPTION_ARG_STRING, &total_option, "Bytes transferred per run", "SIZE" },
+    { "modes", 'm', 0, G_OPTION_ARG_STRING, &modes_option, "Modes among copy,zerocopy", "LIST" },
+    { "producers", 'p', 0, G_OPTION_ARG_INT, &max_producers, "Maximum number of producers", "N" },
+    { "consumers", 'c', 0, G_OPTION_ARG_INT, &max_consumers, "Maximum number of consumers", "N" },
+    { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, "Do not print the matrices on stderr", NULL },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "CSV output file (default stdout)", "FILE" },
+    { NULL }
+};
+
+typedef struct {
+    ringbuf_t *rb;
+    scaling_mode_t mode;
+    gsize record_size;
+    guint64 nb_records;
+    // Sent by every producer, generated before the timer starts
+    guint8 *payload;
+} run_t;
+
+typedef struct {
+    run_t *run;
+    guint64 nb_records;
+} worker_t;
+
+static gpointer producer (gpointer data) {
+    worker_t *worker = data;
+    run_t *run = worker->run;
+
+    for (guint64 i = 0; i < worker->nb_records; i++) {
+        if (run->mode == MODE_ZEROCOPY) {
+            guint8 *slot = ringbuf_reserve (run->rb, run->record_size);
+            memcpy (slot, run->payload, run->record_size);
+            ringbuf_commit (run->rb, run->record_size);
+        }
+        else {
+            ringbuf_push (run->rb, run->payload, run->record_size);
+        }
+    }
+    return NULL;
+}
+
+static gpointer consumer (gpointer data) {
+    worker_t *worker = data;
+    run_t *run = worker->run;
+    guint8 *record = g_malloc (run->record_size);
+    guint64 checksum = 0;
+
+    for (guint64 i = 0; i < worker->nb_records; i++) {
+        if (run->mode == MODE_ZEROCOPY) {
+            // Read the record in place, touching one byte per cache line
+            ringbuf_wait_for_data (run->rb, run->record_size);
+            const guint8 *slot = ringbuf_tail (run->rb);
+            for (gsize j = 0; j < run->record_size; j += 64) {
+                checksum += slot[j];
+            }
+            ringbuf_move_tail (run->rb, run->record_size);
+        }
+        else {
+            ringbuf_pop (record, run->rb, run->record_size);
+        }
+    }
+
+    g_free (record);
+    return GSIZE_TO_POINTER (checksum);
+}
+
+// Splits @total between @nb workers, the first ones take the remainder
+static guint64 share (guint64 total, guint nb, guint index) {
+    return total / nb + (index < total % nb ? 1 : 0);
+}
+
+static gdouble run_once (run_t *run, guint nb_producers, guint nb_consumers) {
+    GThread **threads = g_new0 (GThread *, nb_producers + nb_consumers);
+    worker_t *workers = g_new0 (worker_t, nb_producers + nb_consumers);
+
+    gint64 start = g_get_monotonic_time ();
+    for (guint i = 0; i < nb_consumers; i++) {
+        workers[i].run = run;
+        workers[i].nb_records = share (run->nb_records, nb_consumers, i);
+        threads[i] = g_thread_new ("consumer", consumer, &workers[i]);
+    }
+    for (guint i = 0; i < nb_producers; i++) {
+        worker_t *worker = &workers[nb_consumers + i];
+        worker->run = run;
+        worker->nb_records = share (run->nb_records, nb_producers, i);
+        threads[nb_consumers + i] = g_thread_new ("producer", producer, worker);
+    }
+    for (guint i = 0; i < nb_producers + nb_consumers; i++) {
+        g_thread_join (threads[i]);
+    }
+    gint64 elapsed = MAX(g_get_monotonic_time () - start, 1);
+
+    g_free (workers);
+    g_free (threads);
+
+    return (gdouble) run->nb_records * run->record_size / elapsed;
+}
+
+int main (int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- ring buffer scaling benchmark");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    GArray *records = bench_parse_sizes (sizes_option);
+    GArray *ring = bench_parse_sizes (ring_option);
+    GArray *total = bench_parse_sizes (total_option);
+    if (records == NULL || ring == NULL || total == NULL || max_producers < 1 || max_consumers < 1) {
+        return 1;
+    }
+    gchar **modes = g_strsplit (modes_option, ",", -1);
+
+    GString *csv = g_string_new ("mode,record_bytes,producers,consumers,mb_per_s,mops_per_s\n");
+
+    for (guint m = 0; modes[m] != NULL; m++) {
+        scaling_mode_t mode = NB_MODES;
+        for (guint i = 0; i < NB_MODES; i++) {
+            if (g_strcmp0 (modes[m], mode_str[i]) == 0) {
+                mode = i;
+            }
+        }
+        if (mode == NB_MODES) {
+            g_warning ("Skipping unknown mode '%s'", modes[m]);
+            continue;
+        }
+
+        for (guint r = 0; r < records->len; r++) {
+            run_t run = {
+                .rb = ringbuf_new_named ("bench-scaling", g_array_index (ring, gsize, 0), TRUE),
+                .mode = mode,
+                .record_size = g_array_index (records, gsize, r),
+            };
+            run.nb_records = MAX(g_array_index (total, gsize, 0) / run.record_size, 1);
+            if (run.record_size > ringbuf_buffer_size (run.rb)) {
+                g_warning ("Skipping %" G_GSIZE_FORMAT " byte records, larger than the ring", run.record_size);
+                ringbuf_free (run.rb);
+                continue;
+            }
+            run.payload = bench_payload_new (run.record_size, 1);
+
+            guint nb_producers = mode == MODE_ZEROCOPY ? 1 : max_producers;
+            guint nb_consumers = mode == MODE_ZEROCOPY ? 1 : max_consumers;
+            if (!quiet) {
+                g_printerr ("\n%s, %" G_GSIZE_FORMAT " byte records, MB/s (rows: producers, columns: consumers)\n   ",
+                            mode_str[mode], run.record_size);
+                for (guint c = 1; c <= nb_consumers; c++) {
+                    g_printerr (" %9u", c);
+                }
+            }
+
+            for (guint p = 1; p <= nb_producers; p++) {
+                if (!quiet) {
+                    g_printerr ("\n%3u", p);
+                }
+                for (guint c = 1; c <= nb_consumers; c++) {
+                    gdouble mb_per_s = run_once (&run, p, c);
+                    g_string_append_printf (csv, "%s,%" G_GSIZE_FORMAT ",%u,%u,%.1f,%.4g\n",
+                                            mode_str[mode], run.record_size, p, c,
+                                            mb_per_s, mb_per_s / run.record_size);
+                    if (!quiet) {
+                        g_printerr (" %9.1f", mb_per_s);
+                    }
+                }
+            }
+            if (!quiet) {
+                g_printerr ("\n");
+            }
+            ringbuf_free (run.rb);
+            g_free (run.payload);
+        }
+    }
+
+    gboolean ok = bench_write_output (output, csv);
+
+    g_string_free (csv, TRUE);
+    g_strfreev (modes);
+    g_array_free (records, TRUE);
+    g_array_free (ring, TRUE);
+    g_array_free (total, TRUE);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * bench-throughput.c - producer/consumer throughput through a ring buffer.
+ *
+ * One producer pushes fixed size records, one consumer pops them. Each record
+ * size is a separate run, reported as one CSV row with throughput and the
+ * hardware counters per operation and per byte.
+ */
+
+#include "ringbuf.h"
+#include "bench-common.h"
+#include "bench-perf.h"
+
+static gchar *sizes_option = "64,4K,64K,1M,2M";
+static gchar *ring_option = "64M";
+static gchar *total_option = "1G";
+static gchar *output = NULL;
+
+static GOptionEntry entries[] = {
+    { "records", 'r', 0, G_OPTION_ARG_STRING, &sizes_option, "Record sizes to run", "LIST" },
+    { "ring", 's', 0, G_OPTION_ARG_STRING, &ring_option, "Ring buffer size", "SIZE" },
+    { "total", 't', 0, G_OPTION_ARG_STRING, &total_option, "Bytes transferred per run", "SIZE" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "CSV output file (default stdout)", "FILE" },
+    { NULL }
+};
+
+typedef struct {
+    ringbuf_t *rb;
+    gsize record_size;
+    guint64 nb_records;
+    // Sent by the producer, generated before the timer starts
+    guint8 *payload;
+} run_t;
+
+static gpointer producer (gpointer data) {
+    run_t *run = data;
+
+    for (guint64 i = 0; i < run->nb_records; i++) {
+        ringbuf_push (run->rb, run->payload, run->record_size);
+    }
+    return NULL;
+}
+
+static gpointer consumer (gpointer data) {
+    run_t *run = data;
+    guint8 *record = g_malloc (run->record_size);
+
+    for (guint64 i = 0; i < run->nb_records; i++) {
+        ringbuf_pop (record, run->rb, run->record_size);
+    }
+
+    g_free (record);
+    return NULL;
+}
+
+static void run_once (GString *csv, gsize ring_size, gsize record_size, gsize total) {
+    run_t run = {
+        .rb = ringbuf_new_named ("bench-throughput", ring_size, TRUE),
+        .record_size = record_size,
+        .nb_records = MAX(total / record_size, 1),
+        .payload = bench_payload_new (record_size, 1),
+    };
+    guint64 bytes = run.nb_records * record_size;
+    bench_perf_t perf;
+
+    // Fault the ring in so the first run does not pay for it
+    memset ((gpointer) ringbuf_head (run.rb), 0, ringbuf_buffer_size (run.rb));
+
+    bench_perf_open (&perf);
+    bench_perf_start (&perf);
+    gint64 start = g_get_monotonic_time ();
+
+    GThread *threads[2] = {
+        g_thread_new ("consumer", consumer, &run),
+        g_thread_new ("producer", producer, &run),
+    };
+    g_thread_join (threads[0]);
+    g_thread_join (threads[1]);
+
+    gint64 elapsed = MAX(g_get_monotonic_time () - start, 1);
+    bench_perf_stop (&perf);
+
+    g_string_append_printf (csv, "%" G_GSIZE_FORMAT ",%" G_GUINT64_FORMAT ",%.3f,%.1f,%.3f",
+                            record_size, run.nb_records, elapsed / 1e6,
+                            (gdouble) bytes / elapsed, (gdouble) run.nb_records / elapsed);
+    bench_perf_append_csv (csv, &perf, run.nb_records, bytes);
+    g_string_append_c (csv, '\n');
+
+    bench_perf_close (&perf);
+    ringbuf_free (run.rb);
+    g_free (run.payload);
+}
+
+int main (int argc, char **argv) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- ring buffer throughput benchmark");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    GArray *records = bench_parse_sizes (sizes_option);
+    GArray *ring = bench_parse_sizes (ring_option);
+    GArray *total = bench_parse_sizes (total_option);
+    if (records == NULL || ring == NULL || total == NULL) {
+        return 1;
+    }
+    gsize ring_size = g_array_index (ring, gsize, 0);
+    gsize total_bytes = g_array_index (total, gsize, 0);
+
+    GString *csv = g_string_new ("record_bytes,records,seconds,mb_per_s,mops_per_s");
+    bench_perf_append_csv_header (csv);
+    g_string_append_c (csv, '\n');
+
+    for (guint i = 0; i < records->len; i++) {
+        gsize record_size = g_array_index (records, gsize, i);
+        if (record_size > ring_size) {
+            g_warning ("Skipping %" G_GSIZE_FORMAT " byte records, larger than the ring", record_size);
+            continue;
+        }
+        run_once (csv, ring_size, record_size, total_bytes);
+    }
+
+    gboolean ok = bench_write_output (output, csv);
+
+    g_string_free (csv, TRUE);
+    g_array_free (records, TRUE);
+    g_array_free (ring, TRUE);
+    g_array_free (total, TRUE);
+
+    return ok ? 0 : 1;
+}
@@ -14,6 +14,7 @@
  */
 
 #include "ringbuf.h"
+#include "ringbuf-framegen.h"
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -117,22 +118,6 @@ gpointer profiler (gpointer data) {
     return NULL;
 }
 
-gpointer general_increasing_data (gsize len, gsize size) {
-    guint8 *data = g_malloc0 (size * len);
-    if (data == NULL) {
-        g_debug ("Error allocating data\n");
-        return NULL;
-    }
-
-    // use pointer arithmetic to fill the buffer
-    guint8 *ptr = data;
-    for (gsize i = 0; i < len; i++) {
-        *(ptr + i * size) = i;
-    }
-
-    return data;
-}
-
 gpointer writer_thread (gpointer data) {
     g_debug ("Starting writer thread %d\n", getpid());
     srand(time(NULL));
@@ -150,25 +135,32 @@ gpointer writer_thread (gpointer data) {
 
         measure_t *mdata = g_new0 (measure_t, 1);
 
-        gsize image_size = request->x_res * request->y_res * request->byte_depth;
+        ringbuf_framegen_t *gen = ringbuf_framegen_new (RINGBUF_PATTERN_RAMP, request->x_res, request->y_res,
+                                                        request->byte_depth, 0);
+        gsize image_size = ringbuf_framegen_frame_size (gen);
+
+        // Generate the image straight into the ring
+        gpointer frame = ringbuf_reserve (rb, image_size);
+        if (frame == NULL) {
+            g_debug ("Not enough space available\n");
+            ringbuf_framegen_free (gen);
+            g_free (mdata);
+            g_free (request);
+            break;
+        }
 
         mdata->type = GENERATE_DATA;
         mdata->size = image_size;
         mdata->tic = g_get_monotonic_time ();
-        guint8 *data = general_increasing_data (image_size, request->byte_depth);
+        ringbuf_framegen_fill (gen, frame);
         mdata->toc = g_get_monotonic_time ();
         mdata->kill_pill = FALSE;
         g_async_queue_push (measure_queue, mdata);
-        
-        gpointer retval = ringbuf_push (rb, data, image_size);
-        if (retval == NULL) {
-            g_debug ("Not enough space available\n");
-            g_free (data);
-            break;
-        }
+
+        ringbuf_commit (rb, image_size);
         total_data_received += image_size;
 
-        g_free (data);
+        ringbuf_framegen_free (gen);
         g_free (request);
     }
 
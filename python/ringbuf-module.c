@@ -0,0 +1,826 @@
+/*
+ * Python bindings: rings and frame rings read and written in place through
+ * the buffer protocol.
+ *
+ * Acquiring or reserving returns a span over ring memory, which memoryview()
+ * and numpy.asarray() wrap without copying. A span gives its memory back when
+ * released, on leaving a with block, or when collected. It refuses to while
+ * views over it are alive, since the producer would then write under them.
+ * Waits drop the GIL and come back regularly for signals.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "ringbuf.h"
+#include "ringbuf-frame.h"
+
+// How often waits without a deadline check for signals such as Ctrl-C
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+#define FRAME_RING_CAPSULE "ringbuf.frame_ring"
+
+typedef struct {
+    PyObject_HEAD
+    ringbuf_t *rb;
+    gboolean owned;
+    // A span is acquired, or reserved, and not released yet
+    gboolean reading, writing;
+} RingObject;
+
+typedef struct {
+    PyObject_HEAD
+    ringbuf_frame_ring_t *fr;
+    gboolean owned;
+    gboolean reading, writing;
+} FrameRingObject;
+
+typedef struct {
+    PyObject_HEAD
+    // The Ring or FrameRing the memory belongs to, kept alive by the span
+    PyObject *ring;
+    gpointer data;
+    Py_ssize_t size;
+    // Reserved spans are committed on release instead of consumed
+    gboolean writable;
+    gboolean released;
+    Py_ssize_t exports;
+
+    // Frames are exported as 2-D arrays of pixels, other spans as bytes
+    gboolean frame;
+    ringbuf_frame_meta_t meta;
+    const gchar *format;
+    Py_ssize_t itemsize;
+    Py_ssize_t shape[2], strides[2];
+} SpanObject;
+
+static PyTypeObject RingType, FrameRingType, SpanType;
+
+typedef gboolean (*wait_func) (gpointer user_data, guint64 timeout);
+
+/* Calls @func with the GIL released until it succeeds, @timeout seconds pass
+ * (forever if negative) or a signal handler raises. Returns 1, 0 or -1.
+ */
+static int wait_interruptible (wait_func func, gpointer user_data, gdouble timeout) {
+    gint64 end = timeout < 0 ? -1 : g_get_monotonic_time () + (gint64) (timeout * G_USEC_PER_SEC);
+
+    for (;;) {
+        gint64 slice = POLL_TIMEOUT;
+        gboolean ready;
+        if (end >= 0) {
+            slice = MIN (slice, MAX (end - g_get_monotonic_time (), 0));
+        }
+        Py_BEGIN_ALLOW_THREADS
+        ready = func (user_data, slice);
+        Py_END_ALLOW_THREADS
+        if (ready) {
+            return 1;
+        }
+        if (PyErr_CheckSignals () < 0) {
+            return -1;
+        }
+        if (end >= 0 && g_get_monotonic_time () >= end) {
+            return 0;
+        }
+    }
+}
+
+// None waits forever
+static int parse_timeout (PyObject *arg, gdouble *timeout) {
+    if (arg == NULL || arg == Py_None) {
+        *timeout = -1;
+        return 0;
+    }
+    *timeout = PyFloat_AsDouble (arg);
+    if (*timeout == -1 && PyErr_Occurred ()) {
+        return -1;
+    }
+    if (*timeout < 0) {
+        PyErr_SetString (PyExc_ValueError, "timeout must be non-negative");
+        return -1;
+    }
+    return 0;
+}
+
+/* Span */
+
+static SpanObject *span_new (PyObject *ring, gpointer data, Py_ssize_t size, gboolean writable) {
+    SpanObject *span = PyObject_New (SpanObject, &SpanType);
+    if (span == NULL) {
+        return NULL;
+    }
+    Py_INCREF (ring);
+    span->ring = ring;
+    span->data = data;
+    span->size = size;
+    span->writable = writable;
+    span->released = FALSE;
+    span->exports = 0;
+    span->frame = FALSE;
+    memset (&span->meta, 0, sizeof(span->meta));
+    span->format = "B";
+    span->itemsize = 1;
+    span->shape[0] = size;
+    span->strides[0] = 1;
+    return span;
+}
+
+static void span_set_frame (SpanObject *span, const ringbuf_frame_geometry_t *geometry) {
+    span->frame = TRUE;
+    span->itemsize = geometry->bytes_per_pixel;
+    span->format = geometry->bytes_per_pixel == 1 ? "B" : geometry->bytes_per_pixel == 2 ? "H" : "I";
+    span->shape[0] = geometry->height;
+    span->shape[1] = geometry->width;
+    span->strides[0] = (Py_ssize_t) geometry->width * geometry->bytes_per_pixel;
+    span->strides[1] = geometry->bytes_per_pixel;
+}
+
+/* Gives the memory back to the ring: commits it if @commit is set and the
+ * span was reserved, drops it otherwise.
+ */
+static int span_finish (SpanObject *span, gboolean commit) {
+    if (span->released) {
+        return 0;
+    }
+    if (span->exports > 0) {
+        PyErr_Format (PyExc_BufferError, "cannot release a span with %zd views over it", span->exports);
+        return -1;
+    }
+    span->released = TRUE;
+
+    if (PyObject_TypeCheck (span->ring, &FrameRingType)) {
+        FrameRingObject *ring = (FrameRingObject *) span->ring;
+        if (span->writable) {
+            if (commit) {
+                ringbuf_frame_ring_commit (ring->fr);
+            }
+            ring->writing = FALSE;
+        }
+        else {
+            ringbuf_frame_ring_release (ring->fr);
+            ring->reading = FALSE;
+        }
+    }
+    else {
+        RingObject *ring = (RingObject *) span->ring;
+        if (span->writable) {
+            if (commit) {
+                ringbuf_commit (ring->rb, span->size);
+            }
+            ring->writing = FALSE;
+        }
+        else {
+            ringbuf_move_tail (ring->rb, span->size);
+            ring->reading = FALSE;
+        }
+    }
+    return 0;
+}
+
+static void span_dealloc (SpanObject *span) {
+    // Views hold a reference, so none is left. A reserved span nobody released is dropped.
+    span_finish (span, FALSE);
+    Py_DECREF (span->ring);
+    PyObject_Del (span);
+}
+
+static int span_getbuffer (SpanObject *span, Py_buffer *view, int flags) {
+    if (span->released) {
+        PyErr_SetString (PyExc_ValueError, "operation on a released span");
+        return -1;
+    }
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && !span->writable) {
+        PyErr_SetString (PyExc_BufferError, "acquired spans are read-only");
+        return -1;
+    }
+
+    Py_INCREF (span);
+    view->obj = (PyObject *) span;
+    view->buf = span->data;
+    view->len = span->size;
+    view->readonly = !span->writable;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) {
+        view->format = (gchar *) span->format;
+        view->itemsize = span->itemsize;
+        view->ndim = span->frame ? 2 : 1;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? span->shape : NULL;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? span->strides : NULL;
+    }
+    else {
+        // Without a format the consumer expects plain bytes
+        static Py_ssize_t byte_stride = 1;
+        view->format = NULL;
+        view->itemsize = 1;
+        view->ndim = 1;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &span->size : NULL;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &byte_stride : NULL;
+    }
+    span->exports++;
+    return 0;
+}
+
+static void span_releasebuffer (SpanObject *span, Py_buffer *view) {
+    (void) view;
+    span->exports--;
+}
+
+static PyObject *span_release (SpanObject *span, PyObject *unused) {
+    (void) unused;
+    if (span_finish (span, TRUE) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *span_enter (SpanObject *span, PyObject *unused) {
+    (void) unused;
+    if (span->released) {
+        PyErr_SetString (PyExc_ValueError, "operation on a released span");
+        return NULL;
+    }
+    Py_INCREF (span);
+    return (PyObject *) span;
+}
+
+static PyObject *span_exit (SpanObject *span, PyObject *args) {
+    PyObject *type = PyTuple_Size (args) > 0 ? PyTuple_GetItem (args, 0) : Py_None;
+    // A reserved span left by an exception is dropped rather than published
+    if (span_finish (span, type == Py_None) < 0) {
+        return NULL;
+    }
+    Py_RETURN_FALSE;
+}
+
+static PyObject *span_get_sequence (SpanObject *span, void *closure) {
+    (void) closure;
+    if (!span->frame || span->writable) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromUnsignedLongLong (span->meta.sequence);
+}
+
+static PyObject *span_get_timestamp (SpanObject *span, void *closure) {
+    (void) closure;
+    if (!span->frame || span->writable) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromLongLong (span->meta.timestamp);
+}
+
+static PyObject *span_get_released (SpanObject *span, void *closure) {
+    (void) closure;
+    return PyBool_FromLong (span->released);
+}
+
+static PyObject *span_get_readonly (SpanObject *span, void *closure) {
+    (void) closure;
+    return PyBool_FromLong (!span->writable);
+}
+
+static PyBufferProcs span_as_buffer = {
+    .bf_getbuffer = (getbufferproc) span_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) span_releasebuffer,
+};
+
+static PyMethodDef span_methods[] = {
+    { "release", (PyCFunction) span_release, METH_NOARGS,
+      "Gives the memory back to the ring, publishing it if it was reserved." },
+    { "__enter__", (PyCFunction) span_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction) span_exit, METH_VARARGS, NULL },
+    { NULL, NULL, 0, NULL },
+};
+
+static PyGetSetDef span_getset[] = {
+    { "sequence", (getter) span_get_sequence, NULL, "Sequence number of an acquired frame, None otherwise.", NULL },
+    { "timestamp", (getter) span_get_timestamp, NULL,
+      "Commit time of an acquired frame in monotonic microseconds, None otherwise.", NULL },
+    { "released", (getter) span_get_released, NULL, "Whether the memory went back to the ring.", NULL },
+    { "readonly", (getter) span_get_readonly, NULL, "Whether the span was acquired rather than reserved.", NULL },
+    { NULL, NULL, NULL, NULL, NULL },
+};
+
+static PyTypeObject SpanType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name = "ringbuf.Span",
+    .tp_basicsize = sizeof(SpanObject),
+    .tp_dealloc = (destructor) span_dealloc,
+    .tp_as_buffer = &span_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Ring memory acquired or reserved in place, exported through the buffer protocol.",
+    .tp_methods = span_methods,
+    .tp_getset = span_getset,
+};
+
+/* Ring */
+
+static PyObject *ring_new (PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "size", "block", "name", NULL };
+    Py_ssize_t size;
+    int block = TRUE;
+    const gchar *name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwargs, "n|pz", keywords, &size, &block, &name)) {
+        return NULL;
+    }
+    if (size <= 0) {
+        PyErr_SetString (PyExc_ValueError, "size must be positive");
+        return NULL;
+    }
+    RingObject *ring = (RingObject *) type->tp_alloc (type, 0);
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->rb = ringbuf_new_named (name, size, block);
+    if (ring->rb == NULL) {
+        Py_DECREF (ring);
+        return PyErr_NoMemory ();
+    }
+    ring->owned = TRUE;
+    return (PyObject *) ring;
+}
+
+static void ring_dealloc (RingObject *ring) {
+    if (ring->owned && ring->rb != NULL) {
+        ringbuf_free (ring->rb);
+    }
+    Py_TYPE (ring)->tp_free ((PyObject *) ring);
+}
+
+typedef struct {
+    const gchar *name;
+    ringbuf_t *found;
+} lookup_t;
+
+static void find_ring (ringbuf_t *rb, gpointer user_data) {
+    lookup_t *lookup = user_data;
+    if (lookup->found == NULL && g_strcmp0 (ringbuf_name (rb), lookup->name) == 0) {
+        lookup->found = rb;
+    }
+}
+
+static PyObject *ring_attach (PyTypeObject *type, PyObject *args) {
+    lookup_t lookup = { NULL, NULL };
+
+    if (!PyArg_ParseTuple (args, "s", &lookup.name)) {
+        return NULL;
+    }
+    ringbuf_foreach (find_ring, &lookup);
+    if (lookup.found == NULL) {
+        PyErr_Format (PyExc_KeyError, "no ring named %s", lookup.name);
+        return NULL;
+    }
+    RingObject *ring = (RingObject *) type->tp_alloc (type, 0);
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->rb = lookup.found;
+    ring->owned = FALSE;
+    return (PyObject *) ring;
+}
+
+typedef struct {
+    ringbuf_t *rb;
+    gsize size;
+} ring_wait_t;
+
+static gboolean ring_wait (gpointer user_data, guint64 timeout) {
+    ring_wait_t *wait = user_data;
+    return ringbuf_wait_for_data_timed (wait->rb, wait->size, timeout) != 0;
+}
+
+static gboolean ring_wait_space (gpointer user_data, guint64 timeout) {
+    ring_wait_t *wait = user_data;
+    return ringbuf_wait_for_space_timed (wait->rb, wait->size, timeout);
+}
+
+static PyObject *ring_push (RingObject *ring, PyObject *args) {
+    Py_buffer data;
+    gpointer head;
+
+    if (!PyArg_ParseTuple (args, "y*", &data)) {
+        return NULL;
+    }
+    ring_wait_t wait = { ring->rb, data.len };
+    if (wait_interruptible (ring_wait_space, &wait, -1) < 0) {
+        PyBuffer_Release (&data);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    head = ringbuf_push (ring->rb, data.buf, data.len);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release (&data);
+    return PyBool_FromLong (head != NULL);
+}
+
+
+/* Waits for @size bytes on behalf of the single reader. Returns 1, 0 on
+ * timeout or -1 with an exception set.
+ */
+static int ring_wait_readable (RingObject *ring, Py_ssize_t size, PyObject *timeout_arg) {
+    ring_wait_t wait = { ring->rb, size };
+    gdouble timeout;
+
+    if (parse_timeout (timeout_arg, &timeout) < 0) {
+        return -1;
+    }
+    if (size <= 0 || (gsize) size > ringbuf_buffer_size (ring->rb)) {
+        PyErr_SetString (PyExc_ValueError, "size must be positive and fit in the ring");
+        return -1;
+    }
+    if (ring->reading) {
+        PyErr_SetString (PyExc_RuntimeError, "the acquired span is not released");
+        return -1;
+    }
+    ring->reading = TRUE;
+    int ready = wait_interruptible (ring_wait, &wait, timeout);
+    if (ready <= 0) {
+        ring->reading = FALSE;
+    }
+    return ready;
+}
+
+static PyObject *ring_acquire (RingObject *ring, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "size", "timeout", NULL };
+    Py_ssize_t size;
+    PyObject *timeout = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwargs, "n|O", keywords, &size, &timeout)) {
+        return NULL;
+    }
+    int ready = ring_wait_readable (ring, size, timeout);
+    if (ready <= 0) {
+        if (ready < 0) {
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+    SpanObject *span = span_new ((PyObject *) ring, (gpointer) ringbuf_tail (ring->rb), size, FALSE);
+    if (span == NULL) {
+        ring->reading = FALSE;
+    }
+    return (PyObject *) span;
+}
+
+static PyObject *ring_pop (RingObject *ring, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "size", "timeout", NULL };
+    Py_ssize_t size;
+    PyObject *timeout = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwargs, "n|O", keywords, &size, &timeout)) {
+        return NULL;
+    }
+    int ready = ring_wait_readable (ring, size, timeout);
+    if (ready <= 0) {
+        if (ready < 0) {
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+    PyObject *bytes = PyBytes_FromStringAndSize (ringbuf_tail (ring->rb), size);
+    if (bytes != NULL) {
+        ringbuf_move_tail (ring->rb, size);
+    }
+    ring->reading = FALSE;
+    return bytes;
+}
+
+static PyObject *ring_reserve (RingObject *ring, PyObject *args) {
+    Py_ssize_t size;
+    gpointer head;
+
+    if (!PyArg_ParseTuple (args, "n", &size)) {
+        return NULL;
+    }
+    if (size <= 0 || (gsize) size > ringbuf_buffer_size (ring->rb)) {
+        PyErr_SetString (PyExc_ValueError, "size must be positive and fit in the ring");
+        return NULL;
+    }
+    if (ring->writing) {
+        PyErr_SetString (PyExc_RuntimeError, "the reserved span is not released");
+        return NULL;
+    }
+    ring_wait_t wait = { ring->rb, size };
+    if (wait_interruptible (ring_wait_space, &wait, -1) < 0) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    head = ringbuf_reserve (ring->rb, size);
+    Py_END_ALLOW_THREADS
+    if (head == NULL) {
+        Py_RETURN_NONE;
+    }
+    SpanObject *span = span_new ((PyObject *) ring, head, size, TRUE);
+    if (span != NULL) {
+        ring->writing = TRUE;
+    }
+    return (PyObject *) span;
+}
+
+static PyObject *ring_get_name (RingObject *ring, void *closure) {
+    (void) closure;
+    return PyUnicode_FromString (ringbuf_name (ring->rb));
+}
+
+static PyObject *ring_get_size (RingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromSize_t (ringbuf_buffer_size (ring->rb));
+}
+
+static PyObject *ring_get_used (RingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromSize_t (ringbuf_bytes_used (ring->rb));
+}
+
+static PyMethodDef ring_methods[] = {
+    { "attach", (PyCFunction) ring_attach, METH_VARARGS | METH_CLASS,
+      "attach(name)\n\nWraps the live ring of this process with the given name, which must outlive the wrapper." },
+    { "push", (PyCFunction) ring_push, METH_VARARGS,
+      "push(data)\n\nCopies a bytes-like object into the ring. Returns False if a non-blocking ring was full." },
+    { "pop", (PyCFunction) (void (*) (void)) ring_pop, METH_VARARGS | METH_KEYWORDS,
+      "pop(size, timeout=None)\n\nWaits for size bytes and returns a copy, or None after timeout seconds." },
+    { "acquire", (PyCFunction) (void (*) (void)) ring_acquire, METH_VARARGS | METH_KEYWORDS,
+      "acquire(size, timeout=None)\n\nWaits for size bytes and returns a read-only Span over them, consumed when "
+      "released, or None after timeout seconds." },
+    { "reserve", (PyCFunction) ring_reserve, METH_VARARGS,
+      "reserve(size)\n\nReturns a writable Span over the next size bytes, pushed when released, or None if a "
+      "non-blocking ring is full." },
+    { NULL, NULL, 0, NULL },
+};
+
+static PyGetSetDef ring_getset[] = {
+    { "name", (getter) ring_get_name, NULL, "Name of the ring.", NULL },
+    { "size", (getter) ring_get_size, NULL, "Capacity in bytes, rounded up to pages, or to 64 bytes for rings under a page.", NULL },
+    { "used", (getter) ring_get_used, NULL, "Bytes waiting to be read.", NULL },
+    { NULL, NULL, NULL, NULL, NULL },
+};
+
+static PyTypeObject RingType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name = "ringbuf.Ring",
+    .tp_basicsize = sizeof(RingObject),
+    .tp_dealloc = (destructor) ring_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Ring(size, block=True, name=None)\n\nA byte ring, blocking producers when full unless block is False.",
+    .tp_methods = ring_methods,
+    .tp_getset = ring_getset,
+    .tp_new = ring_new,
+};
+
+/* FrameRing */
+
+static PyObject *frame_ring_new (PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "width", "height", "bytes_per_pixel", "nb_frames", "block", "name", NULL };
+    ringbuf_frame_geometry_t geometry;
+    guint nb_frames;
+    int block = TRUE;
+    const gchar *name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwargs, "IIII|pz", keywords, &geometry.width, &geometry.height,
+                                      &geometry.bytes_per_pixel, &nb_frames, &block, &name)) {
+        return NULL;
+    }
+    if (geometry.width == 0 || geometry.height == 0 || nb_frames == 0 ||
+        (geometry.bytes_per_pixel != 1 && geometry.bytes_per_pixel != 2 && geometry.bytes_per_pixel != 4)) {
+        PyErr_SetString (PyExc_ValueError, "invalid frame geometry");
+        return NULL;
+    }
+    FrameRingObject *ring = (FrameRingObject *) type->tp_alloc (type, 0);
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->fr = ringbuf_frame_ring_new (name, &geometry, nb_frames, block);
+    if (ring->fr == NULL) {
+        Py_DECREF (ring);
+        return PyErr_NoMemory ();
+    }
+    ring->owned = TRUE;
+    return (PyObject *) ring;
+}
+
+static void frame_ring_dealloc (FrameRingObject *ring) {
+    if (ring->owned && ring->fr != NULL) {
+        ringbuf_frame_ring_free (ring->fr);
+    }
+    Py_TYPE (ring)->tp_free ((PyObject *) ring);
+}
+
+static PyObject *frame_ring_from_capsule (PyTypeObject *type, PyObject *args) {
+    PyObject *capsule;
+
+    if (!PyArg_ParseTuple (args, "O", &capsule)) {
+        return NULL;
+    }
+    ringbuf_frame_ring_t *fr = PyCapsule_GetPointer (capsule, FRAME_RING_CAPSULE);
+    if (fr == NULL) {
+        return NULL;
+    }
+    FrameRingObject *ring = (FrameRingObject *) type->tp_alloc (type, 0);
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->fr = fr;
+    ring->owned = FALSE;
+    return (PyObject *) ring;
+}
+
+static PyObject *frame_ring_capsule (FrameRingObject *ring, PyObject *unused) {
+    (void) unused;
+    return PyCapsule_New (ring->fr, FRAME_RING_CAPSULE, NULL);
+}
+
+static PyObject *frame_ring_push (FrameRingObject *ring, PyObject *args) {
+    Py_buffer data;
+    gboolean pushed;
+
+    if (!PyArg_ParseTuple (args, "y*", &data)) {
+        return NULL;
+    }
+    if ((gsize) data.len != ringbuf_frame_ring_frame_size (ring->fr)) {
+        PyErr_Format (PyExc_ValueError, "frames are %zu bytes, not %zd", ringbuf_frame_ring_frame_size (ring->fr),
+                      data.len);
+        PyBuffer_Release (&data);
+        return NULL;
+    }
+    ring_wait_t wait = { ringbuf_frame_ring_pixels (ring->fr), data.len };
+    if (wait_interruptible (ring_wait_space, &wait, -1) < 0) {
+        PyBuffer_Release (&data);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    pushed = ringbuf_frame_ring_push (ring->fr, data.buf);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release (&data);
+    return PyBool_FromLong (pushed);
+}
+
+typedef struct {
+    ringbuf_frame_ring_t *fr;
+    gconstpointer pixels;
+    ringbuf_frame_meta_t meta;
+} frame_wait_t;
+
+static gboolean frame_wait (gpointer user_data, guint64 timeout) {
+    frame_wait_t *wait = user_data;
+    wait->pixels = ringbuf_frame_ring_acquire_timed (wait->fr, &wait->meta, timeout);
+    return wait->pixels != NULL;
+}
+
+static PyObject *frame_ring_acquire (FrameRingObject *ring, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "timeout", NULL };
+    frame_wait_t wait = { ring->fr, NULL, {0} };
+    PyObject *timeout_arg = NULL;
+    gdouble timeout;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwargs, "|O", keywords, &timeout_arg) ||
+        parse_timeout (timeout_arg, &timeout) < 0) {
+        return NULL;
+    }
+    if (ring->reading) {
+        PyErr_SetString (PyExc_RuntimeError, "the acquired frame is not released");
+        return NULL;
+    }
+    ring->reading = TRUE;
+    int ready = wait_interruptible (frame_wait, &wait, timeout);
+    if (ready <= 0) {
+        ring->reading = FALSE;
+        if (ready < 0) {
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+
+    SpanObject *span = span_new ((PyObject *) ring, (gpointer) wait.pixels, ringbuf_frame_ring_frame_size (ring->fr),
+                                 FALSE);
+    if (span == NULL) {
+        ringbuf_frame_ring_release (ring->fr);
+        ring->reading = FALSE;
+        return NULL;
+    }
+    span_set_frame (span, ringbuf_frame_ring_geometry (ring->fr));
+    span->meta = wait.meta;
+    return (PyObject *) span;
+}
+
+static PyObject *frame_ring_reserve (FrameRingObject *ring, PyObject *unused) {
+    gpointer pixels;
+    (void) unused;
+
+    if (ring->writing) {
+        PyErr_SetString (PyExc_RuntimeError, "the reserved frame is not released");
+        return NULL;
+    }
+    ring_wait_t wait = { ringbuf_frame_ring_pixels (ring->fr), ringbuf_frame_ring_frame_size (ring->fr) };
+    if (wait_interruptible (ring_wait_space, &wait, -1) < 0) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    pixels = ringbuf_frame_ring_reserve (ring->fr);
+    Py_END_ALLOW_THREADS
+    if (pixels == NULL) {
+        Py_RETURN_NONE;
+    }
+    SpanObject *span = span_new ((PyObject *) ring, pixels, ringbuf_frame_ring_frame_size (ring->fr), TRUE);
+    if (span == NULL) {
+        return NULL;
+    }
+    span_set_frame (span, ringbuf_frame_ring_geometry (ring->fr));
+    ring->writing = TRUE;
+    return (PyObject *) span;
+}
+
+static PyObject *frame_ring_get_name (FrameRingObject *ring, void *closure) {
+    (void) closure;
+    return PyUnicode_FromString (ringbuf_name (ringbuf_frame_ring_pixels (ring->fr)));
+}
+
+static PyObject *frame_ring_get_width (FrameRingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromUnsignedLong (ringbuf_frame_ring_geometry (ring->fr)->width);
+}
+
+static PyObject *frame_ring_get_height (FrameRingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromUnsignedLong (ringbuf_frame_ring_geometry (ring->fr)->height);
+}
+
+static PyObject *frame_ring_get_bytes_per_pixel (FrameRingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromUnsignedLong (ringbuf_frame_ring_geometry (ring->fr)->bytes_per_pixel);
+}
+
+static PyObject *frame_ring_get_frame_size (FrameRingObject *ring, void *closure) {
+    (void) closure;
+    return PyLong_FromSize_t (ringbuf_frame_ring_frame_size (ring->fr));
+}
+
+static PyMethodDef frame_ring_methods[] = {
+    { "from_capsule", (PyCFunction) frame_ring_from_capsule, METH_VARARGS | METH_CLASS,
+      "from_capsule(capsule)\n\nWraps a ringbuf_frame_ring_t * handed over by C code in a \"" FRAME_RING_CAPSULE
+      "\" capsule. The ring must outlive the wrapper." },
+    { "capsule", (PyCFunction) frame_ring_capsule, METH_NOARGS,
+      "capsule()\n\nReturns the ringbuf_frame_ring_t * in a \"" FRAME_RING_CAPSULE "\" capsule for C code." },
+    { "push", (PyCFunction) frame_ring_push, METH_VARARGS,
+      "push(frame)\n\nCopies a bytes-like frame into the ring. Returns False if a non-blocking ring was full." },
+    { "acquire", (PyCFunction) (void (*) (void)) frame_ring_acquire, METH_VARARGS | METH_KEYWORDS,
+      "acquire(timeout=None)\n\nWaits for the oldest frame and returns a read-only Span of height x width pixels "
+      "over it, given back to the producer when released, or None after timeout seconds." },
+    { "reserve", (PyCFunction) frame_ring_reserve, METH_NOARGS,
+      "reserve()\n\nReturns a writable Span over the next frame, committed when released, or None if a "
+      "non-blocking ring is full." },
+    { NULL, NULL, 0, NULL },
+};
+
+static PyGetSetDef frame_ring_getset[] = {
+    { "name", (getter) frame_ring_get_name, NULL, "Name of the pixel ring.", NULL },
+    { "width", (getter) frame_ring_get_width, NULL, "Pixels per row.", NULL },
+    { "height", (getter) frame_ring_get_height, NULL, "Number of rows.", NULL },
+    { "bytes_per_pixel", (getter) frame_ring_get_bytes_per_pixel, NULL, "1, 2 or 4.", NULL },
+    { "frame_size", (getter) frame_ring_get_frame_size, NULL, "Bytes per frame.", NULL },
+    { NULL, NULL, NULL, NULL, NULL },
+};
+
+static PyTypeObject FrameRingType = {
+    PyVarObject_HEAD_INIT (NULL, 0)
+    .tp_name = "ringbuf.FrameRing",
+    .tp_basicsize = sizeof(FrameRingObject),
+    .tp_dealloc = (destructor) frame_ring_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "FrameRing(width, height, bytes_per_pixel, nb_frames, block=True, name=None)\n\n"
+              "A ring of fixed-size frames of unsigned pixels.",
+    .tp_methods = frame_ring_methods,
+    .tp_getset = frame_ring_getset,
+    .tp_new = frame_ring_new,
+};
+
+static struct PyModuleDef ringbuf_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "ringbuf",
+    .m_doc = "Rings and frame rings shared with C code, read and written in place.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_ringbuf (void) {
+    PyTypeObject *types[] = { &RingType, &FrameRingType, &SpanType };
+    PyObject *module;
+
+    for (guint i = 0; i < G_N_ELEMENTS(types); i++) {
+        if (PyType_Ready (types[i]) < 0) {
+            return NULL;
+        }
+    }
+    module = PyModule_Create (&ringbuf_module);
+    if (module == NULL) {
+        return NULL;
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(types); i++) {
+        Py_INCREF (types[i]);
+        if (PyModule_AddObject (module, strrchr (types[i]->tp_name, '.') + 1, (PyObject *) types[i]) < 0) {
+            Py_DECREF (types[i]);
+            Py_DECREF (module);
+            return NULL;
+        }
+    }
+    return module;
+}
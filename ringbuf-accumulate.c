@@ -0,0 +1,203 @@
+/*
+ * Accumulation stage: sums of N consecutive frames.
+ *
+ * The sum lives in the output ring from the start: space for it is reserved
+ * when a batch begins, the first frame is converted into it and the next ones
+ * are added, and the frame is committed once the batch is complete. No
+ * separate accumulator buffer, no final copy.
+ */
+
+#include "ringbuf-accumulate.h"
+#include "ringbuf-simd.h"
+#include "ringbuf-tiles.h"
+
+// Frames smaller than this stay on the calling thread
+#define TILE_MIN_PIXELS (256 * 1024)
+
+// How often the consumer thread checks for ringbuf_accumulator_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+struct _ringbuf_accumulator_t {
+    ringbuf_frame_geometry_t geometry;
+    ringbuf_accumulate_type_t type;
+    guint nb_frames;
+    ringbuf_tiles_t *tiles;
+    ringbuf_frame_ring_t *output;
+
+    // Current batch
+    guint count;
+    gpointer sum;
+    gconstpointer pixels;
+
+    GThread *thread;
+    ringbuf_frame_ring_t *input;
+    gint stop;
+};
+
+// Widens eight pixels at a time, stores them for the first frame of a batch
+#define DEFINE_ACCUMULATE(name, in_type, in_vec, acc_type, acc_vec)                     \
+RINGBUF_SIMD_CLONES                                                                       \
+static void name (const in_type *src, acc_type *acc, gsize n, gboolean first) {          \
+    gsize i = 0;                                                                         \
+    if (first) {                                                                         \
+        for (; i + 8 <= n; i += 8) {                                                     \
+            *(acc_vec *) (acc + i) = __builtin_convertvector (*(const in_vec *) (src + i), acc_vec); \
+        }                                                                                \
+        for (; i < n; i++) {                                                             \
+            acc[i] = src[i];                                                             \
+        }                                                                                \
+        return;                                                                          \
+    }                                                                                    \
+    for (; i + 8 <= n; i += 8) {                                                         \
+        *(acc_vec *) (acc + i) += __builtin_convertvector (*(const in_vec *) (src + i), acc_vec); \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        acc[i] += src[i];                                                                \
+    }                                                                                    \
+}
+
+DEFINE_ACCUMULATE(accumulate_u8_u32, guint8, ringbuf_vu8x8, guint32, ringbuf_vu32)
+DEFINE_ACCUMULATE(accumulate_u16_u32, guint16, ringbuf_vu16x8, guint32, ringbuf_vu32)
+DEFINE_ACCUMULATE(accumulate_u32_u32, guint32, ringbuf_vu32, guint32, ringbuf_vu32)
+DEFINE_ACCUMULATE(accumulate_u8_f32, guint8, ringbuf_vu8x8, gfloat, ringbuf_vf32)
+DEFINE_ACCUMULATE(accumulate_u16_f32, guint16, ringbuf_vu16x8, gfloat, ringbuf_vf32)
+DEFINE_ACCUMULATE(accumulate_u32_f32, guint32, ringbuf_vu32, gfloat, ringbuf_vf32)
+
+static void accumulate_tile (guint tile, guint first_row, guint nb_rows, gpointer user_data) {
+    ringbuf_accumulator_t *acc = user_data;
+    gsize first = (gsize) first_row * acc->geometry.width;
+    gsize n = (gsize) nb_rows * acc->geometry.width;
+    const guint8 *src = (const guint8 *) acc->pixels + first * acc->geometry.bytes_per_pixel;
+    gboolean store = acc->count == 0;
+    (void) tile;
+
+    if (acc->type == RINGBUF_ACCUMULATE_U32) {
+        guint32 *sum = (guint32 *) acc->sum + first;
+        switch (acc->geometry.bytes_per_pixel) {
+        case 1:
+            accumulate_u8_u32 (src, sum, n, store);
+            break;
+        case 2:
+            accumulate_u16_u32 ((const guint16 *) src, sum, n, store);
+            break;
+        default:
+            accumulate_u32_u32 ((const guint32 *) src, sum, n, store);
+            break;
+        }
+    }
+    else {
+        gfloat *sum = (gfloat *) acc->sum + first;
+        switch (acc->geometry.bytes_per_pixel) {
+        case 1:
+            accumulate_u8_f32 (src, sum, n, store);
+            break;
+        case 2:
+            accumulate_u16_f32 ((const guint16 *) src, sum, n, store);
+            break;
+        default:
+            accumulate_u32_f32 ((const guint32 *) src, sum, n, store);
+            break;
+        }
+    }
+}
+
+ringbuf_accumulator_t *ringbuf_accumulator_new (const ringbuf_frame_geometry_t *geometry,
+                                                ringbuf_accumulate_type_t type, guint nb_frames,
+                                                guint nb_threads, guint depth) {
+    guint bpp = geometry->bytes_per_pixel;
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || nb_frames == 0 || nb_threads == 0 || depth == 0 ||
+        (type != RINGBUF_ACCUMULATE_U32 && type != RINGBUF_ACCUMULATE_F32)) {
+        g_warning ("Invalid accumulator for %u byte pixels, %u frames, %u threads", bpp, nb_frames, nb_threads);
+        return NULL;
+    }
+
+    ringbuf_frame_geometry_t output = { geometry->width, geometry->height, 4 };
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new ("accumulated", &output, depth, TRUE);
+    if (fr == NULL) {
+        return NULL;
+    }
+
+    ringbuf_accumulator_t *acc = g_new0 (ringbuf_accumulator_t, 1);
+    acc->geometry = *geometry;
+    acc->type = type;
+    acc->nb_frames = nb_frames;
+    acc->tiles = ringbuf_tiles_new (nb_threads);
+    acc->output = fr;
+    return acc;
+}
+
+void ringbuf_accumulator_free (ringbuf_accumulator_t *acc) {
+    if (acc == NULL) {
+        return;
+    }
+    ringbuf_accumulator_stop (acc);
+    ringbuf_tiles_free (acc->tiles);
+    ringbuf_frame_ring_free (acc->output);
+    g_free (acc);
+}
+
+ringbuf_frame_ring_t *ringbuf_accumulator_output (ringbuf_accumulator_t *acc) {
+    return acc->output;
+}
+
+gboolean ringbuf_accumulator_add (ringbuf_accumulator_t *acc, gconstpointer pixels) {
+    const ringbuf_frame_geometry_t *geometry = &acc->geometry;
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    if (acc->count == 0) {
+        acc->sum = ringbuf_frame_ring_reserve (acc->output);
+    }
+    acc->pixels = pixels;
+    ringbuf_tiles_run (acc->tiles, geometry->height,
+                       nb_pixels < TILE_MIN_PIXELS ? 1 : ringbuf_tiles_nb_threads (acc->tiles),
+                       accumulate_tile, acc);
+    acc->pixels = NULL;
+
+    if (++acc->count < acc->nb_frames) {
+        return FALSE;
+    }
+    ringbuf_frame_ring_commit (acc->output);
+    acc->count = 0;
+    acc->sum = NULL;
+    return TRUE;
+}
+
+static gpointer accumulator_thread (gpointer data) {
+    ringbuf_accumulator_t *acc = data;
+
+    while (!g_atomic_int_get (&acc->stop)) {
+        gconstpointer pixels = ringbuf_frame_ring_acquire_timed (acc->input, NULL, POLL_TIMEOUT);
+        if (pixels == NULL) {
+            continue;
+        }
+        ringbuf_accumulator_add (acc, pixels);
+        ringbuf_frame_ring_release (acc->input);
+    }
+    return NULL;
+}
+
+void ringbuf_accumulator_start (ringbuf_accumulator_t *acc, ringbuf_frame_ring_t *input) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (input);
+
+    if (acc->thread != NULL) {
+        return;
+    }
+    if (geometry->width != acc->geometry.width || geometry->height != acc->geometry.height ||
+        geometry->bytes_per_pixel != acc->geometry.bytes_per_pixel) {
+        g_warning ("Accumulator and input ring geometries differ");
+        return;
+    }
+    acc->input = input;
+    g_atomic_int_set (&acc->stop, FALSE);
+    acc->thread = g_thread_new ("accumulator", accumulator_thread, acc);
+}
+
+void ringbuf_accumulator_stop (ringbuf_accumulator_t *acc) {
+    if (acc->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&acc->stop, TRUE);
+    g_thread_join (acc->thread);
+    acc->thread = NULL;
+    acc->input = NULL;
+}
@@ -0,0 +1,80 @@
+#ifndef INCLUDED_RINGBUF_ACCUMULATE_H
+#define INCLUDED_RINGBUF_ACCUMULATE_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_accumulator_t ringbuf_accumulator_t;
+
+/**
+ * ringbuf_accumulate_type_t:
+ * @RINGBUF_ACCUMULATE_U32: Sums kept as unsigned 32-bit integers. Exact, but
+ *   wraps around past 2^32, e.g. after 65537 saturated 16-bit frames.
+ * @RINGBUF_ACCUMULATE_F32: Sums kept as single precision floats.
+ */
+typedef enum {
+    RINGBUF_ACCUMULATE_U32,
+    RINGBUF_ACCUMULATE_F32,
+} ringbuf_accumulate_type_t;
+
+/**
+ * ringbuf_accumulator_new:
+ * @geometry: Layout of the input frames.
+ * @type: Type of the accumulated pixels.
+ * @nb_frames: Number of input frames summed into each output frame.
+ * @nb_threads: Threads sharing each frame by tiles of rows.
+ * @depth: Number of summed frames the output ring holds.
+ *
+ * Creates an accumulation stage summing every @nb_frames consecutive input
+ * frames. Sums are built directly in space reserved in the output ring, a
+ * frame ring of 4-byte pixels holding either integers or floats depending on
+ * @type. Returns NULL on invalid arguments.
+ */
+ringbuf_accumulator_t *ringbuf_accumulator_new (const ringbuf_frame_geometry_t *geometry,
+                                                ringbuf_accumulate_type_t type, guint nb_frames,
+                                                guint nb_threads, guint depth);
+
+/**
+ * ringbuf_accumulator_free:
+ * @acc: An accumulator, stopped first if running. A partial sum is lost.
+ */
+void ringbuf_accumulator_free (ringbuf_accumulator_t *acc);
+
+/**
+ * ringbuf_accumulator_output:
+ * @acc: An accumulator.
+ *
+ * Returns the frame ring receiving the sums. Owned by @acc.
+ */
+ringbuf_frame_ring_t *ringbuf_accumulator_output (ringbuf_accumulator_t *acc);
+
+/**
+ * ringbuf_accumulator_add:
+ * @acc: An accumulator.
+ * @pixels: One input frame.
+ *
+ * Adds a frame to the running sum, and publishes the sum to the output ring
+ * once it holds @nb_frames frames. May block on a full output ring. Returns
+ * TRUE when a sum was published.
+ */
+gboolean ringbuf_accumulator_add (ringbuf_accumulator_t *acc, gconstpointer pixels);
+
+/**
+ * ringbuf_accumulator_start:
+ * @acc: An accumulator.
+ * @input: Frame ring to consume, with the geometry given at creation.
+ *
+ * Starts a thread acquiring frames from @input in place, adding them and
+ * releasing them, until ringbuf_accumulator_stop().
+ */
+void ringbuf_accumulator_start (ringbuf_accumulator_t *acc, ringbuf_frame_ring_t *input);
+
+/**
+ * ringbuf_accumulator_stop:
+ * @acc: An accumulator.
+ *
+ * Stops the thread started by ringbuf_accumulator_start(). Frames still in
+ * the input ring are left there.
+ */
+void ringbuf_accumulator_stop (ringbuf_accumulator_t *acc);
+
+#endif /* INCLUDED_RINGBUF_ACCUMULATE_H */
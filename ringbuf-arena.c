@@ -0,0 +1,170 @@
+/*
+ * Arena: many rings of the same size carved out of one memfd.
+ *
+ * Slot i of the file is mapped at slots 2i and 2i + 1 of one reserved
+ * address range, which gives every ring its own double mapping. The second
+ * mapping of a slot and the first mapping of the next one are contiguous both
+ * in the file and in memory, so the kernel merges them: the arena costs one
+ * file descriptor and about one VMA per ring instead of a descriptor and two
+ * VMAs each, all set up once. Creating a ring then only pops a slot from a
+ * free stack.
+ */
+
+#include "ringbuf-arena.h"
+#include "ringbuf-private.h"
+#include <errno.h>
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+#if __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 27)
+static inline int memfd_create(const char *name, unsigned int flags) {
+    return syscall(__NR_memfd_create, name, flags);
+}
+#endif
+
+struct _ringbuf_arena_t {
+    gint fd;
+    // Reserved range, and where the first slot starts in it once aligned
+    guint8 *reserved;
+    gsize reserved_size;
+    guint8 *base;
+    gsize ring_size;
+
+    GMutex mutex;
+    guint *free_slots;
+    guint nb_free;
+
+    // One reference for the arena, one per live ring
+    gint ref;
+};
+
+static void arena_unref (ringbuf_arena_t *arena) {
+    if (!g_atomic_int_dec_and_test (&arena->ref)) {
+        return;
+    }
+    if (munmap (arena->reserved, arena->reserved_size) != 0) {
+        g_warning ("Could not unmap arena");
+    }
+    close (arena->fd);
+    g_mutex_clear (&arena->mutex);
+    g_free (arena->free_slots);
+    g_free (arena);
+}
+
+ringbuf_arena_t *ringbuf_arena_new (const gchar *name, gsize ring_size, guint nb_rings, gboolean huge_pages) {
+    gsize page_size = huge_pages ? RINGBUF_ARENA_HUGE_PAGE_SIZE : (gsize) getpagesize ();
+    gsize s = MAX ((ring_size + page_size - 1) / page_size, 1) * page_size;
+
+    if (ring_size == 0 || nb_rings == 0 || s > G_MAXSIZE / 4 / nb_rings) {
+        g_warning ("Invalid arena of %u rings of %" G_GSIZE_FORMAT " bytes", nb_rings, ring_size);
+        return NULL;
+    }
+
+    gint fd = memfd_create (name != NULL ? name : "ring_arena", huge_pages ? MFD_HUGETLB : 0);
+    if (fd == -1) {
+        g_warning ("Failed to create anonymous file for arena %s: %s", name != NULL ? name : "ring_arena",
+                   g_strerror (errno));
+        return NULL;
+    }
+    if (ftruncate (fd, s * nb_rings) != 0) {
+        g_warning ("Could not set size of arena file: %s", g_strerror (errno));
+        close (fd);
+        return NULL;
+    }
+
+    // With huge pages, mappings must start on one: reserve enough to align the range
+    gsize reserved_size = 2 * s * nb_rings + (huge_pages ? page_size : 0);
+    guint8 *reserved = mmap (NULL, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        g_warning ("Could not allocate virtual memory for arena");
+        close (fd);
+        return NULL;
+    }
+    guint8 *base = (guint8 *) (((guintptr) reserved + page_size - 1) / page_size * page_size);
+
+    for (guint i = 0; i < nb_rings; i++) {
+        for (guint half = 0; half < 2; half++) {
+            if (mmap (base + (2 * i + half) * s, s, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                      (off_t) i * s) == MAP_FAILED) {
+                g_warning ("Could not map arena slot into virtual memory: %s", g_strerror (errno));
+                munmap (reserved, reserved_size);
+                close (fd);
+                return NULL;
+            }
+        }
+    }
+
+    ringbuf_arena_t *arena = g_new0 (ringbuf_arena_t, 1);
+    arena->fd = fd;
+    arena->reserved = reserved;
+    arena->reserved_size = reserved_size;
+    arena->base = base;
+    arena->ring_size = s;
+    g_mutex_init (&arena->mutex);
+    // Popped from the end, so rings take the slots in order
+    arena->free_slots = g_new (guint, nb_rings);
+    for (guint i = 0; i < nb_rings; i++) {
+        arena->free_slots[i] = nb_rings - 1 - i;
+    }
+    arena->nb_free = nb_rings;
+    arena->ref = 1;
+    return arena;
+}
+
+void ringbuf_arena_free (ringbuf_arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    arena_unref (arena);
+}
+
+static void arena_release_slot (gpointer buffer, gsize size, gpointer user_data) {
+    ringbuf_arena_t *arena = user_data;
+    guint slot = ((guint8 *) buffer - arena->base) / (2 * size);
+
+    g_mutex_lock (&arena->mutex);
+    arena->free_slots[arena->nb_free++] = slot;
+    g_mutex_unlock (&arena->mutex);
+    arena_unref (arena);
+}
+
+ringbuf_t *ringbuf_arena_ring_new (ringbuf_arena_t *arena, const gchar *name, gboolean block) {
+    guint slot;
+
+    g_mutex_lock (&arena->mutex);
+    if (arena->nb_free == 0) {
+        g_mutex_unlock (&arena->mutex);
+        return NULL;
+    }
+    slot = arena->free_slots[--arena->nb_free];
+    g_mutex_unlock (&arena->mutex);
+
+    g_atomic_int_inc (&arena->ref);
+    return ringbuf_new_from_mapping (name, arena->base + 2 * (gsize) slot * arena->ring_size, arena->fd,
+                                     arena->ring_size, block, arena_release_slot, arena);
+}
+
+gsize ringbuf_arena_ring_size (const ringbuf_arena_t *arena) {
+    return arena->ring_size;
+}
+
+guint ringbuf_arena_nb_free (ringbuf_arena_t *arena) {
+    g_mutex_lock (&arena->mutex);
+    guint nb_free = arena->nb_free;
+    g_mutex_unlock (&arena->mutex);
+    return nb_free;
+}
+
+void ringbuf_arena_trim (ringbuf_arena_t *arena) {
+    g_mutex_lock (&arena->mutex);
+    for (guint i = 0; i < arena->nb_free; i++) {
+        off_t offset = (off_t) arena->free_slots[i] * arena->ring_size;
+        if (fallocate (arena->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, arena->ring_size) != 0) {
+            g_warning ("Could not release arena slot: %s", g_strerror (errno));
+            break;
+        }
+    }
+    g_mutex_unlock (&arena->mutex);
+}
@@ -0,0 +1,72 @@
+#ifndef INCLUDED_RINGBUF_ARENA_H
+#define INCLUDED_RINGBUF_ARENA_H
+
+#include "ringbuf.h"
+
+typedef struct _ringbuf_arena_t ringbuf_arena_t;
+
+/* Size of the huge pages arenas use, see ringbuf_arena_new(). */
+#define RINGBUF_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * ringbuf_arena_new:
+ * @name: Name of the backing memfd, may be NULL.
+ * @ring_size: Size of every ring, rounded up to pages.
+ * @nb_rings: Number of rings the arena holds.
+ * @huge_pages: Back the arena with huge pages, @ring_size is then rounded up
+ *   to RINGBUF_ARENA_HUGE_PAGE_SIZE. Needs pages reserved in
+ *   /proc/sys/vm/nr_hugepages.
+ *
+ * Maps one memfd holding @nb_rings rings, each mapped twice in a row in its
+ * own part of a single address range. Creating and freeing rings of the arena
+ * then makes no syscall. Returns NULL if the memory cannot be mapped.
+ */
+ringbuf_arena_t *ringbuf_arena_new (const gchar *name, gsize ring_size, guint nb_rings, gboolean huge_pages);
+
+/**
+ * ringbuf_arena_free:
+ * @arena: An arena.
+ *
+ * Releases @arena. Its memory stays mapped until the rings still alive are
+ * freed.
+ */
+void ringbuf_arena_free (ringbuf_arena_t *arena);
+
+/**
+ * ringbuf_arena_ring_new:
+ * @arena: An arena.
+ * @name: Name of the ring, may be NULL.
+ * @block: Whether producers block when the ring is full.
+ *
+ * Creates a ring in a free slot of @arena, or returns NULL if there is none.
+ * The ring works like any other and is freed with ringbuf_free(), which gives
+ * the slot back. Its ringbuf_info_t.fd is the arena's memfd.
+ */
+ringbuf_t *ringbuf_arena_ring_new (ringbuf_arena_t *arena, const gchar *name, gboolean block);
+
+/**
+ * ringbuf_arena_ring_size:
+ * @arena: An arena.
+ *
+ * Returns the size of every ring of @arena.
+ */
+gsize ringbuf_arena_ring_size (const ringbuf_arena_t *arena);
+
+/**
+ * ringbuf_arena_nb_free:
+ * @arena: An arena.
+ *
+ * Returns the number of rings that can still be created.
+ */
+guint ringbuf_arena_nb_free (ringbuf_arena_t *arena);
+
+/**
+ * ringbuf_arena_trim:
+ * @arena: An arena.
+ *
+ * Gives the memory of free slots back to the system. Slots keep their pages
+ * otherwise, so that creating a ring makes no syscall.
+ */
+void ringbuf_arena_trim (ringbuf_arena_t *arena);
+
+#endif /* INCLUDED_RINGBUF_ARENA_H */
@@ -0,0 +1,246 @@
+/*
+ * Background model stage: per-pixel running mean and variance.
+ *
+ * Both models update with the same recurrence, only the weight w of the new
+ * frame differs (alpha, or 1/n for the cumulative mean):
+ *
+ *   d = x - mean, mean += w * d, var = (1 - w) * (var + w * d * d)
+ *
+ * which for w = 1/n is Welford's update of the population variance. The
+ * output is computed from d in the same pass, so every pixel of the model is
+ * read and written once per frame, and written straight to the output ring.
+ */
+
+#include "ringbuf-background.h"
+#include "ringbuf-simd.h"
+#include "ringbuf-tiles.h"
+
+// Frames smaller than this stay on the calling thread
+#define TILE_MIN_PIXELS (256 * 1024)
+
+// How often the consumer thread checks for ringbuf_background_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+// Quantization noise of integer pixels, keeps z-scores of constant pixels finite
+#define VARIANCE_FLOOR (1.0f / 12)
+
+#define LANES 8
+
+struct _ringbuf_background_t {
+    ringbuf_frame_geometry_t geometry;
+    ringbuf_background_model_t model;
+    gfloat alpha;
+    gboolean zscore;
+    ringbuf_tiles_t *tiles;
+    ringbuf_frame_ring_t *output;
+
+    gfloat *mean;
+    gfloat *variance;
+    guint64 count;
+
+    // Current frame
+    gconstpointer pixels;
+    gfloat *out;
+    gfloat weight;
+
+    GThread *thread;
+    ringbuf_frame_ring_t *input;
+    gint stop;
+};
+
+/*
+ * 1 / sqrt(x) from the classic bit-level estimate and two Newton steps,
+ * within a few parts per million, as vectors have no square root.
+ */
+#define RSQRT(x, y)                                                                     \
+    do {                                                                                \
+        (y) = (ringbuf_vf32) (0x5f3759df - ((ringbuf_vi32) (x) >> 1));                  \
+        (y) = (y) * (1.5f - 0.5f * (x) * (y) * (y));                                    \
+        (y) = (y) * (1.5f - 0.5f * (x) * (y) * (y));                                    \
+    } while (0)
+
+// @n is a multiple of LANES
+#define DEFINE_UPDATE(type, vec)                                                        \
+RINGBUF_SIMD_CLONES                                                                      \
+static void update_##type (const type *src, gfloat *mean, gfloat *variance, gfloat *out, gsize n, \
+                           gfloat w, gboolean zscore) {                                  \
+    for (gsize i = 0; i < n; i += LANES) {                                               \
+        ringbuf_vf32 x = __builtin_convertvector (*(const vec *) (src + i), ringbuf_vf32); \
+        ringbuf_vf32 m = *(ringbuf_vf32 *) (mean + i), v = *(ringbuf_vf32 *) (variance + i); \
+        ringbuf_vf32 d = x - m;                                                          \
+        if (zscore) {                                                                    \
+            ringbuf_vf32 s = v + VARIANCE_FLOOR, r;                                      \
+            RSQRT(s, r);                                                                 \
+            *(ringbuf_vf32 *) (out + i) = d * r;                                         \
+        }                                                                                \
+        else {                                                                           \
+            *(ringbuf_vf32 *) (out + i) = d;                                             \
+        }                                                                                \
+        *(ringbuf_vf32 *) (mean + i) = m + w * d;                                        \
+        *(ringbuf_vf32 *) (variance + i) = (1.0f - w) * (v + w * d * d);                 \
+    }                                                                                    \
+}
+
+DEFINE_UPDATE(guint8, ringbuf_vu8x8)
+DEFINE_UPDATE(guint16, ringbuf_vu16x8)
+DEFINE_UPDATE(guint32, ringbuf_vu32)
+
+static void update_pixels (guint bytes_per_pixel, gconstpointer src, gfloat *mean, gfloat *variance,
+                           gfloat *out, gsize n, gfloat w, gboolean zscore) {
+    switch (bytes_per_pixel) {
+    case 1:
+        update_guint8 (src, mean, variance, out, n, w, zscore);
+        break;
+    case 2:
+        update_guint16 (src, mean, variance, out, n, w, zscore);
+        break;
+    default:
+        update_guint32 (src, mean, variance, out, n, w, zscore);
+        break;
+    }
+}
+
+static void background_tile (guint tile, guint first_row, guint nb_rows, gpointer user_data) {
+    ringbuf_background_t *bg = user_data;
+    guint bpp = bg->geometry.bytes_per_pixel;
+    gsize first = (gsize) first_row * bg->geometry.width;
+    gsize n = (gsize) nb_rows * bg->geometry.width;
+    gsize body = n - n % LANES;
+    const guint8 *src = (const guint8 *) bg->pixels + first * bpp;
+    (void) tile;
+
+    update_pixels (bpp, src, bg->mean + first, bg->variance + first, bg->out + first, body, bg->weight,
+                   bg->zscore);
+    if (body == n) {
+        return;
+    }
+
+    // The rest goes through a whole vector on the stack, output slots end with the frame
+    guint32 tail[LANES] = {0};
+    gfloat out[LANES], mean[LANES] = {0}, variance[LANES] = {0};
+    gsize rest = n - body;
+    memcpy (tail, src + body * bpp, rest * bpp);
+    memcpy (mean, bg->mean + first + body, rest * sizeof(gfloat));
+    memcpy (variance, bg->variance + first + body, rest * sizeof(gfloat));
+    update_pixels (bpp, tail, mean, variance, out, LANES, bg->weight, bg->zscore);
+    memcpy (bg->out + first + body, out, rest * sizeof(gfloat));
+    memcpy (bg->mean + first + body, mean, rest * sizeof(gfloat));
+    memcpy (bg->variance + first + body, variance, rest * sizeof(gfloat));
+}
+
+ringbuf_background_t *ringbuf_background_new (const ringbuf_frame_geometry_t *geometry,
+                                              ringbuf_background_model_t model, gfloat alpha,
+                                              ringbuf_background_output_t output, guint nb_threads, guint depth) {
+    guint bpp = geometry->bytes_per_pixel;
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || nb_threads == 0 || depth == 0 ||
+        (model == RINGBUF_BACKGROUND_EXPONENTIAL && !(alpha > 0.0f && alpha <= 1.0f))) {
+        g_warning ("Invalid background model for %u byte pixels, alpha %g", bpp, alpha);
+        return NULL;
+    }
+
+    ringbuf_frame_geometry_t floats = { geometry->width, geometry->height, 4 };
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new ("background", &floats, depth, TRUE);
+    if (fr == NULL) {
+        return NULL;
+    }
+
+    ringbuf_background_t *bg = g_new0 (ringbuf_background_t, 1);
+    bg->geometry = *geometry;
+    bg->model = model;
+    bg->alpha = alpha;
+    bg->zscore = output == RINGBUF_BACKGROUND_ZSCORE;
+    bg->tiles = ringbuf_tiles_new (nb_threads);
+    bg->output = fr;
+    bg->mean = g_new0 (gfloat, nb_pixels);
+    bg->variance = g_new0 (gfloat, nb_pixels);
+    return bg;
+}
+
+void ringbuf_background_free (ringbuf_background_t *bg) {
+    if (bg == NULL) {
+        return;
+    }
+    ringbuf_background_stop (bg);
+    ringbuf_tiles_free (bg->tiles);
+    ringbuf_frame_ring_free (bg->output);
+    g_free (bg->mean);
+    g_free (bg->variance);
+    g_free (bg);
+}
+
+ringbuf_frame_ring_t *ringbuf_background_output (ringbuf_background_t *bg) {
+    return bg->output;
+}
+
+const gfloat *ringbuf_background_mean (const ringbuf_background_t *bg) {
+    return bg->mean;
+}
+
+const gfloat *ringbuf_background_variance (const ringbuf_background_t *bg) {
+    return bg->variance;
+}
+
+void ringbuf_background_process (ringbuf_background_t *bg, gconstpointer pixels) {
+    const ringbuf_frame_geometry_t *geometry = &bg->geometry;
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    bg->count++;
+    bg->weight = 1.0f / bg->count;
+    if (bg->model == RINGBUF_BACKGROUND_EXPONENTIAL) {
+        bg->weight = MAX(bg->weight, bg->alpha);
+    }
+    bg->pixels = pixels;
+    bg->out = ringbuf_frame_ring_reserve (bg->output);
+    ringbuf_tiles_run (bg->tiles, geometry->height,
+                       nb_pixels < TILE_MIN_PIXELS ? 1 : ringbuf_tiles_nb_threads (bg->tiles),
+                       background_tile, bg);
+    if (bg->count == 1) {
+        // Nothing to compare the first frame with
+        memset (bg->out, 0, nb_pixels * sizeof(gfloat));
+    }
+    ringbuf_frame_ring_commit (bg->output);
+    bg->pixels = NULL;
+    bg->out = NULL;
+}
+
+static gpointer background_thread (gpointer data) {
+    ringbuf_background_t *bg = data;
+
+    while (!g_atomic_int_get (&bg->stop)) {
+        gconstpointer pixels = ringbuf_frame_ring_acquire_timed (bg->input, NULL, POLL_TIMEOUT);
+        if (pixels == NULL) {
+            continue;
+        }
+        ringbuf_background_process (bg, pixels);
+        ringbuf_frame_ring_release (bg->input);
+    }
+    return NULL;
+}
+
+void ringbuf_background_start (ringbuf_background_t *bg, ringbuf_frame_ring_t *input) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (input);
+
+    if (bg->thread != NULL) {
+        return;
+    }
+    if (geometry->width != bg->geometry.width || geometry->height != bg->geometry.height ||
+        geometry->bytes_per_pixel != bg->geometry.bytes_per_pixel) {
+        g_warning ("Background model and input ring geometries differ");
+        return;
+    }
+    bg->input = input;
+    g_atomic_int_set (&bg->stop, FALSE);
+    bg->thread = g_thread_new ("background", background_thread, bg);
+}
+
+void ringbuf_background_stop (ringbuf_background_t *bg) {
+    if (bg->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&bg->stop, TRUE);
+    g_thread_join (bg->thread);
+    bg->thread = NULL;
+    bg->input = NULL;
+}
@@ -0,0 +1,113 @@
+#ifndef INCLUDED_RINGBUF_BACKGROUND_H
+#define INCLUDED_RINGBUF_BACKGROUND_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_background_t ringbuf_background_t;
+
+/**
+ * ringbuf_background_model_t:
+ * @RINGBUF_BACKGROUND_EXPONENTIAL: Exponentially weighted mean and variance,
+ *   each frame weighing @alpha. The first 1 / @alpha frames are averaged
+ *   evenly so the model does not start from zero.
+ * @RINGBUF_BACKGROUND_CUMULATIVE: Mean and variance of every frame so far,
+ *   updated with Welford's recurrence.
+ */
+typedef enum {
+    RINGBUF_BACKGROUND_EXPONENTIAL,
+    RINGBUF_BACKGROUND_CUMULATIVE,
+} ringbuf_background_model_t;
+
+/**
+ * ringbuf_background_output_t:
+ * @RINGBUF_BACKGROUND_SUBTRACTED: Pixel minus its background mean.
+ * @RINGBUF_BACKGROUND_ZSCORE: Pixel minus its background mean, divided by
+ *   the background standard deviation.
+ *
+ * What the output ring receives for every frame, as floats. Both are taken
+ * against the background before the frame is added to it, and are zero for
+ * the first frame.
+ */
+typedef enum {
+    RINGBUF_BACKGROUND_SUBTRACTED,
+    RINGBUF_BACKGROUND_ZSCORE,
+} ringbuf_background_output_t;
+
+/**
+ * ringbuf_background_new:
+ * @geometry: Layout of the input frames.
+ * @model: How the background is updated.
+ * @alpha: Weight of each new frame for RINGBUF_BACKGROUND_EXPONENTIAL,
+ *   between 0 and 1. Ignored otherwise.
+ * @output: What is written to the output ring.
+ * @nb_threads: Threads sharing each frame by tiles of rows.
+ * @depth: Number of frames the output ring holds.
+ *
+ * Creates a background model stage keeping a float mean and variance for
+ * every pixel. Returns NULL on invalid arguments.
+ */
+ringbuf_background_t *ringbuf_background_new (const ringbuf_frame_geometry_t *geometry,
+                                              ringbuf_background_model_t model, gfloat alpha,
+                                              ringbuf_background_output_t output, guint nb_threads, guint depth);
+
+/**
+ * ringbuf_background_free:
+ * @bg: A background stage, stopped first if running.
+ */
+void ringbuf_background_free (ringbuf_background_t *bg);
+
+/**
+ * ringbuf_background_output:
+ * @bg: A background stage.
+ *
+ * Returns the frame ring receiving the subtracted frames or z-score maps, as
+ * 4-byte float pixels. Owned by @bg.
+ */
+ringbuf_frame_ring_t *ringbuf_background_output (ringbuf_background_t *bg);
+
+/**
+ * ringbuf_background_mean:
+ * @bg: A background stage.
+ *
+ * Returns the current mean of every pixel. Not synchronized with the thread
+ * started by ringbuf_background_start().
+ */
+const gfloat *ringbuf_background_mean (const ringbuf_background_t *bg);
+
+/**
+ * ringbuf_background_variance:
+ * @bg: A background stage.
+ *
+ * Same as ringbuf_background_mean() for the variance.
+ */
+const gfloat *ringbuf_background_variance (const ringbuf_background_t *bg);
+
+/**
+ * ringbuf_background_process:
+ * @bg: A background stage.
+ * @pixels: One input frame.
+ *
+ * Writes the frame's output straight into the output ring and adds the frame
+ * to the background, in the same pass. May block on a full output ring.
+ */
+void ringbuf_background_process (ringbuf_background_t *bg, gconstpointer pixels);
+
+/**
+ * ringbuf_background_start:
+ * @bg: A background stage.
+ * @input: Frame ring to consume, with the geometry given at creation.
+ *
+ * Starts a thread acquiring frames from @input in place, processing them and
+ * releasing them, until ringbuf_background_stop().
+ */
+void ringbuf_background_start (ringbuf_background_t *bg, ringbuf_frame_ring_t *input);
+
+/**
+ * ringbuf_background_stop:
+ * @bg: A background stage.
+ *
+ * Stops the thread started by ringbuf_background_start().
+ */
+void ringbuf_background_stop (ringbuf_background_t *bg);
+
+#endif /* INCLUDED_RINGBUF_BACKGROUND_H */
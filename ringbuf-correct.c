@@ -0,0 +1,299 @@
+/*
+ * Bad pixel correction, optionally fused with dark and flat field correction.
+ *
+ * Bad pixels are kept as a list sorted by index, each with the good
+ * neighbours it is interpolated from, so patching a frame touches only the
+ * cache lines around a few thousand pixels. Patches only ever read good
+ * pixels and only ever write bad ones, so they can run in any order.
+ *
+ * With dark and flat field correction every pixel is rewritten anyway. Tiles
+ * of rows are then corrected in bands of a few rows, and after each band the
+ * bad pixels whose neighbours are all corrected are patched while those rows
+ * are still in cache. Bad pixels on the first or last row of a tile need a
+ * row from the next tile and are patched once all tiles are done.
+ */
+
+#include "ringbuf-correct.h"
+#include "ringbuf-simd.h"
+#include "ringbuf-tiles.h"
+#include <stdlib.h>
+
+// Frames smaller than this stay on the calling thread
+#define TILE_MIN_PIXELS (256 * 1024)
+
+// Rows corrected before patching the bad pixels among them
+#define BAND_ROWS 8
+
+typedef struct {
+    guint32 index;
+    guint32 row;
+    guint32 neighbours[4];
+    guint nb_neighbours;
+} patch_t;
+
+typedef struct {
+    guint first_row, end_row;
+} tile_rows_t;
+
+struct _ringbuf_correction_t {
+    ringbuf_frame_geometry_t geometry;
+    patch_t *patches;
+    gsize nb_patches;
+
+    gpointer dark;
+    gfloat *gain;
+    gfloat max;
+
+    ringbuf_tiles_t *tiles;
+    tile_rows_t *tile_rows;
+    gpointer pixels;
+};
+
+#define DEFINE_PATCH(type)                                                               \
+static void patch_##type (type *pixels, const patch_t *patches, gsize n) {               \
+    for (gsize p = 0; p < n; p++) {                                                      \
+        const patch_t *patch = &patches[p];                                              \
+        guint64 sum = 0;                                                                 \
+        for (guint k = 0; k < patch->nb_neighbours; k++) {                               \
+            sum += pixels[patch->neighbours[k]];                                         \
+        }                                                                                \
+        pixels[patch->index] = patch->nb_neighbours == 0 ? 0                             \
+            : (sum + patch->nb_neighbours / 2) / patch->nb_neighbours;                   \
+    }                                                                                    \
+}
+
+DEFINE_PATCH(guint8)
+DEFINE_PATCH(guint16)
+DEFINE_PATCH(guint32)
+
+static void patch_pixels (guint bytes_per_pixel, gpointer pixels, const patch_t *patches, gsize n) {
+    switch (bytes_per_pixel) {
+    case 1:
+        patch_guint8 (pixels, patches, n);
+        break;
+    case 2:
+        patch_guint16 (pixels, patches, n);
+        break;
+    default:
+        patch_guint32 (pixels, patches, n);
+        break;
+    }
+}
+
+// (pixel - dark) * gain, rounded and clamped, eight pixels at a time
+#define DEFINE_DARK_FLAT(type, vec)                                                      \
+RINGBUF_SIMD_CLONES                                                                      \
+static void dark_flat_##type (type *pixels, const type *dark, const gfloat *gain, gsize n, gfloat max) { \
+    const ringbuf_vf32 zero = {0};                                                       \
+    const ringbuf_vf32 top = zero + max, half = zero + 0.5f;                             \
+    gsize i = 0;                                                                         \
+    for (; i + 8 <= n; i += 8) {                                                         \
+        ringbuf_vf32 v = __builtin_convertvector (*(const vec *) (pixels + i), ringbuf_vf32) - \
+                         __builtin_convertvector (*(const vec *) (dark + i), ringbuf_vf32);   \
+        v = v * *(const ringbuf_vf32 *) (gain + i) + half;                               \
+        ringbuf_vi32 low = v < zero, high = v > top;                                     \
+        v = (ringbuf_vf32) (((ringbuf_vi32) v & ~(low | high)) | ((ringbuf_vi32) top & high)); \
+        *(vec *) (pixels + i) = __builtin_convertvector (v, vec);                        \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        gfloat v = ((gfloat) pixels[i] - (gfloat) dark[i]) * gain[i] + 0.5f;             \
+        pixels[i] = v < 0.0f ? 0 : v > max ? max : v;                                    \
+    }                                                                                    \
+}
+
+DEFINE_DARK_FLAT(guint8, ringbuf_vu8x8)
+DEFINE_DARK_FLAT(guint16, ringbuf_vu16x8)
+DEFINE_DARK_FLAT(guint32, ringbuf_vu32)
+
+static void dark_flat_rows (ringbuf_correction_t *corr, guint first_row, guint nb_rows) {
+    const ringbuf_frame_geometry_t *geometry = &corr->geometry;
+    gsize first = (gsize) first_row * geometry->width;
+    gsize n = (gsize) nb_rows * geometry->width;
+
+    switch (geometry->bytes_per_pixel) {
+    case 1:
+        dark_flat_guint8 ((guint8 *) corr->pixels + first, (const guint8 *) corr->dark + first,
+                          corr->gain + first, n, corr->max);
+        break;
+    case 2:
+        dark_flat_guint16 ((guint16 *) corr->pixels + first, (const guint16 *) corr->dark + first,
+                           corr->gain + first, n, corr->max);
+        break;
+    default:
+        dark_flat_guint32 ((guint32 *) corr->pixels + first, (const guint32 *) corr->dark + first,
+                           corr->gain + first, n, corr->max);
+        break;
+    }
+}
+
+// First patch on @row or after
+static gsize find_row (const ringbuf_correction_t *corr, guint row) {
+    gsize lo = 0, hi = corr->nb_patches;
+    while (lo < hi) {
+        gsize mid = lo + (hi - lo) / 2;
+        if (corr->patches[mid].row < row) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void correct_tile (guint tile, guint first_row, guint nb_rows, gpointer user_data) {
+    ringbuf_correction_t *corr = user_data;
+    guint end_row = first_row + nb_rows;
+    gsize p = find_row (corr, first_row);
+
+    corr->tile_rows[tile] = (tile_rows_t) { first_row, end_row };
+
+    for (guint band = first_row; band < end_row; band += BAND_ROWS) {
+        guint band_end = MIN(band + BAND_ROWS, end_row);
+        dark_flat_rows (corr, band, band_end - band);
+
+        // Rows whose lower neighbours are corrected, the tile's edge rows are left for later
+        guint limit = band_end == end_row && end_row == corr->geometry.height ? end_row : band_end - 1;
+        gsize start = p;
+        while (p < corr->nb_patches && corr->patches[p].row < limit) {
+            p++;
+        }
+        if (start < p && first_row > 0 && corr->patches[start].row == first_row) {
+            start = find_row (corr, first_row + 1);
+        }
+        if (start < p) {
+            patch_pixels (corr->geometry.bytes_per_pixel, corr->pixels, corr->patches + start, p - start);
+        }
+    }
+}
+
+static int compare_indices (const void *a, const void *b) {
+    guint32 x = *(const guint32 *) a, y = *(const guint32 *) b;
+    return x < y ? -1 : x > y;
+}
+
+ringbuf_correction_t *ringbuf_correction_new (const ringbuf_frame_geometry_t *geometry, const guint32 *bad_pixels,
+                                              gsize nb_bad_pixels, guint nb_threads) {
+    guint bpp = geometry->bytes_per_pixel;
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || nb_pixels == 0 || nb_pixels > G_MAXUINT32 || nb_threads == 0) {
+        g_warning ("Invalid correction for %u byte pixels, %u threads", bpp, nb_threads);
+        return NULL;
+    }
+
+    // Sorted, unique and in the frame
+    guint32 *sorted = g_new (guint32, MAX(nb_bad_pixels, 1));
+    memcpy (sorted, bad_pixels, nb_bad_pixels * sizeof(guint32));
+    qsort (sorted, nb_bad_pixels, sizeof(guint32), compare_indices);
+    gsize n = 0;
+    for (gsize i = 0; i < nb_bad_pixels; i++) {
+        if (sorted[i] >= nb_pixels) {
+            g_warning ("Bad pixel %u is outside of a %ux%u frame", sorted[i], geometry->width, geometry->height);
+            break;
+        }
+        if (n == 0 || sorted[n - 1] != sorted[i]) {
+            sorted[n++] = sorted[i];
+        }
+    }
+
+    guint8 *mask = g_malloc0 (nb_pixels);
+    for (gsize i = 0; i < n; i++) {
+        mask[sorted[i]] = TRUE;
+    }
+
+    ringbuf_correction_t *corr = g_new0 (ringbuf_correction_t, 1);
+    corr->geometry = *geometry;
+    corr->patches = g_new0 (patch_t, MAX(n, 1));
+    corr->nb_patches = n;
+    for (gsize i = 0; i < n; i++) {
+        patch_t *patch = &corr->patches[i];
+        guint32 x = sorted[i] % geometry->width, y = sorted[i] / geometry->width;
+        guint32 candidates[4];
+        guint nb_candidates = 0;
+
+        if (x > 0) {
+            candidates[nb_candidates++] = sorted[i] - 1;
+        }
+        if (x + 1 < geometry->width) {
+            candidates[nb_candidates++] = sorted[i] + 1;
+        }
+        if (y > 0) {
+            candidates[nb_candidates++] = sorted[i] - geometry->width;
+        }
+        if (y + 1 < geometry->height) {
+            candidates[nb_candidates++] = sorted[i] + geometry->width;
+        }
+        patch->index = sorted[i];
+        patch->row = y;
+        for (guint k = 0; k < nb_candidates; k++) {
+            if (!mask[candidates[k]]) {
+                patch->neighbours[patch->nb_neighbours++] = candidates[k];
+            }
+        }
+    }
+    g_free (mask);
+    g_free (sorted);
+
+    corr->max = bpp == 4 ? 4294967040.0f : (gfloat) ((1u << (8 * bpp)) - 1);
+    corr->tiles = ringbuf_tiles_new (nb_threads);
+    corr->tile_rows = g_new0 (tile_rows_t, nb_threads);
+    return corr;
+}
+
+void ringbuf_correction_free (ringbuf_correction_t *corr) {
+    if (corr == NULL) {
+        return;
+    }
+    ringbuf_tiles_free (corr->tiles);
+    g_free (corr->tile_rows);
+    g_free (corr->patches);
+    g_free (corr->dark);
+    g_free (corr->gain);
+    g_free (corr);
+}
+
+gsize ringbuf_correction_nb_bad_pixels (const ringbuf_correction_t *corr) {
+    return corr->nb_patches;
+}
+
+void ringbuf_correction_set_dark_flat (ringbuf_correction_t *corr, gconstpointer dark, const gfloat *gain) {
+    gsize nb_pixels = (gsize) corr->geometry.width * corr->geometry.height;
+
+    if ((dark == NULL) != (gain == NULL)) {
+        g_warning ("Dark and flat field correction need both a dark frame and gains");
+        return;
+    }
+    g_free (corr->dark);
+    g_free (corr->gain);
+    corr->dark = NULL;
+    corr->gain = NULL;
+    if (dark != NULL) {
+        corr->dark = g_malloc (nb_pixels * corr->geometry.bytes_per_pixel);
+        memcpy (corr->dark, dark, nb_pixels * corr->geometry.bytes_per_pixel);
+        corr->gain = g_new (gfloat, nb_pixels);
+        memcpy (corr->gain, gain, nb_pixels * sizeof(gfloat));
+    }
+}
+
+void ringbuf_correction_apply (ringbuf_correction_t *corr, gpointer pixels) {
+    const ringbuf_frame_geometry_t *geometry = &corr->geometry;
+
+    if (corr->dark == NULL) {
+        patch_pixels (geometry->bytes_per_pixel, pixels, corr->patches, corr->nb_patches);
+        return;
+    }
+
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+    guint nb_tiles = nb_pixels < TILE_MIN_PIXELS ? 1 : ringbuf_tiles_nb_threads (corr->tiles);
+    corr->pixels = pixels;
+    nb_tiles = ringbuf_tiles_run (corr->tiles, geometry->height, nb_tiles, correct_tile, corr);
+
+    // Rows on both sides of each boundary between tiles
+    for (guint t = 1; t < nb_tiles; t++) {
+        guint row = corr->tile_rows[t].first_row;
+        gsize first = find_row (corr, row - 1), end = find_row (corr, row + 1);
+        patch_pixels (geometry->bytes_per_pixel, pixels, corr->patches + first, end - first);
+    }
+    corr->pixels = NULL;
+}
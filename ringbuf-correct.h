@@ -0,0 +1,60 @@
+#ifndef INCLUDED_RINGBUF_CORRECT_H
+#define INCLUDED_RINGBUF_CORRECT_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_correction_t ringbuf_correction_t;
+
+/**
+ * ringbuf_correction_new:
+ * @geometry: Layout of the frames.
+ * @bad_pixels: Indices (y * width + x) of dead or hot pixels, in any order.
+ * @nb_bad_pixels: Number of @bad_pixels.
+ * @nb_threads: Threads sharing large frames by tiles of rows, 1 to stay on
+ *   the caller's thread.
+ *
+ * Creates a correction stage replacing every bad pixel with the mean of its
+ * good horizontal and vertical neighbours, or zero if it has none. The list
+ * is sorted and each pixel's neighbours are worked out once here. Indices
+ * outside of the frame are ignored with a warning.
+ */
+ringbuf_correction_t *ringbuf_correction_new (const ringbuf_frame_geometry_t *geometry, const guint32 *bad_pixels,
+                                              gsize nb_bad_pixels, guint nb_threads);
+
+/**
+ * ringbuf_correction_free:
+ * @corr: A correction stage.
+ */
+void ringbuf_correction_free (ringbuf_correction_t *corr);
+
+/**
+ * ringbuf_correction_nb_bad_pixels:
+ * @corr: A correction stage.
+ *
+ * Returns the number of distinct bad pixels patched in every frame.
+ */
+gsize ringbuf_correction_nb_bad_pixels (const ringbuf_correction_t *corr);
+
+/**
+ * ringbuf_correction_set_dark_flat:
+ * @corr: A correction stage.
+ * @dark: Dark frame with the geometry of the frames, or NULL.
+ * @gain: Flat field gain of every pixel, or NULL.
+ *
+ * Enables dark and flat field correction, fused with bad pixel patching:
+ * pixels become (pixel - dark) * gain, rounded and clamped to the pixel
+ * range. Both are copied. Passing NULL for both disables it again.
+ */
+void ringbuf_correction_set_dark_flat (ringbuf_correction_t *corr, gconstpointer dark, const gfloat *gain);
+
+/**
+ * ringbuf_correction_apply:
+ * @corr: A correction stage.
+ * @pixels: One frame, corrected in place.
+ *
+ * Corrects one frame. Frames acquired from a frame ring live in writable
+ * memory and can be corrected before being released.
+ */
+void ringbuf_correction_apply (ringbuf_correction_t *corr, gpointer pixels);
+
+#endif /* INCLUDED_RINGBUF_CORRECT_H */
@@ -0,0 +1,278 @@
+/*
+ * Delta encoding stage: residuals of each frame against the previous one.
+ *
+ * Consecutive frames differ little, so their residuals are mostly zero or
+ * small and compress far better than the frames themselves. The encoder keeps
+ * the previous frame in a reference slot; one pass over a frame reads it and
+ * the reference, writes the residuals straight into the output record and
+ * writes the frame over the reference. The decoder does the same in reverse
+ * with its own reference, and only ever follows the chain of records from a
+ * keyframe.
+ */
+
+#include "ringbuf-delta.h"
+#include "ringbuf-simd.h"
+
+// How often the consumer thread checks for ringbuf_delta_encoder_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+struct _ringbuf_delta_encoder_t {
+    ringbuf_frame_geometry_t geometry;
+    ringbuf_delta_mode_t mode;
+    guint keyframe_interval;
+    gsize frame_size;
+
+    gpointer reference;
+    guint64 reference_sequence;
+    guint64 count;
+    gint keyframe_requested;
+
+    ringbuf_t *output;
+
+    GThread *thread;
+    ringbuf_frame_ring_t *input;
+    gint stop;
+};
+
+struct _ringbuf_delta_decoder_t {
+    ringbuf_frame_geometry_t geometry;
+    ringbuf_delta_mode_t mode;
+    gsize frame_size;
+
+    gpointer reference;
+    guint64 reference_sequence;
+    gboolean valid;
+};
+
+/*
+ * dst = src - reference or src ^ reference, then reference = src. Encoding
+ * and decoding differ by the operation only, @forward selects subtraction or
+ * addition.
+ */
+#define DEFINE_DELTA(type, vec)                                                         \
+RINGBUF_SIMD_CLONES                                                                      \
+static void delta_##type (const type *src, type *reference, type *dst, gsize n, gboolean xor, \
+                          gboolean forward) {                                            \
+    const gsize lanes = RINGBUF_SIMD_BYTES / sizeof(type);                              \
+    gsize i = 0;                                                                        \
+    for (; i + lanes <= n; i += lanes) {                                                \
+        vec x = *(const vec *) (src + i), r = *(vec *) (reference + i);                  \
+        vec y = xor ? x ^ r : forward ? x - r : x + r;                                   \
+        *(vec *) (dst + i) = y;                                                          \
+        *(vec *) (reference + i) = forward ? x : y;                                      \
+    }                                                                                   \
+    for (; i < n; i++) {                                                                \
+        type x = src[i], r = reference[i];                                              \
+        type y = xor ? x ^ r : forward ? (type) (x - r) : (type) (x + r);               \
+        dst[i] = y;                                                                     \
+        reference[i] = forward ? x : y;                                                 \
+    }                                                                                   \
+}
+
+DEFINE_DELTA(guint8, ringbuf_vu8)
+DEFINE_DELTA(guint16, ringbuf_vu16)
+DEFINE_DELTA(guint32, ringbuf_vu32)
+
+static gboolean check_geometry (const ringbuf_frame_geometry_t *geometry) {
+    guint bpp = geometry->bytes_per_pixel;
+    if (bpp != 1 && bpp != 2 && bpp != 4) {
+        g_warning ("Invalid delta frames of %u byte pixels", bpp);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void delta_pixels (const ringbuf_frame_geometry_t *geometry, ringbuf_delta_mode_t mode, gconstpointer src,
+                          gpointer reference, gpointer dst, gboolean forward) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+    gboolean xor = mode == RINGBUF_DELTA_XOR;
+
+    switch (geometry->bytes_per_pixel) {
+    case 1:
+        delta_guint8 (src, reference, dst, nb_pixels, xor, forward);
+        break;
+    case 2:
+        delta_guint16 (src, reference, dst, nb_pixels, xor, forward);
+        break;
+    case 4:
+        delta_guint32 (src, reference, dst, nb_pixels, xor, forward);
+        break;
+    default:
+        check_geometry (geometry);
+        break;
+    }
+}
+
+void ringbuf_delta_encode (const ringbuf_frame_geometry_t *geometry, ringbuf_delta_mode_t mode,
+                           gconstpointer pixels, gpointer reference, gpointer residuals) {
+    delta_pixels (geometry, mode, pixels, reference, residuals, TRUE);
+}
+
+void ringbuf_delta_decode (const ringbuf_frame_geometry_t *geometry, ringbuf_delta_mode_t mode,
+                           gconstpointer residuals, gpointer reference, gpointer pixels) {
+    delta_pixels (geometry, mode, residuals, reference, pixels, FALSE);
+}
+
+ringbuf_delta_encoder_t *ringbuf_delta_encoder_new (const ringbuf_frame_geometry_t *geometry,
+                                                    ringbuf_delta_mode_t mode, guint keyframe_interval,
+                                                    guint depth) {
+    gsize frame_size = (gsize) geometry->width * geometry->height * geometry->bytes_per_pixel;
+
+    if (!check_geometry (geometry) || frame_size == 0 || frame_size > G_MAXUINT32 || depth == 0) {
+        return NULL;
+    }
+
+    ringbuf_delta_encoder_t *enc = g_new0 (ringbuf_delta_encoder_t, 1);
+    enc->geometry = *geometry;
+    enc->mode = mode;
+    enc->keyframe_interval = keyframe_interval;
+    enc->frame_size = frame_size;
+    enc->output = ringbuf_new_named ("delta", depth * (sizeof(ringbuf_delta_header_t) + frame_size), TRUE);
+    if (enc->output == NULL) {
+        g_free (enc);
+        return NULL;
+    }
+    enc->reference = g_malloc (frame_size);
+    return enc;
+}
+
+void ringbuf_delta_encoder_free (ringbuf_delta_encoder_t *enc) {
+    if (enc == NULL) {
+        return;
+    }
+    ringbuf_delta_encoder_stop (enc);
+    ringbuf_free (enc->output);
+    g_free (enc->reference);
+    g_free (enc);
+}
+
+ringbuf_t *ringbuf_delta_encoder_output (ringbuf_delta_encoder_t *enc) {
+    return enc->output;
+}
+
+void ringbuf_delta_encoder_request_keyframe (ringbuf_delta_encoder_t *enc) {
+    g_atomic_int_set (&enc->keyframe_requested, TRUE);
+}
+
+void ringbuf_delta_encoder_process (ringbuf_delta_encoder_t *enc, gconstpointer pixels,
+                                    const ringbuf_frame_meta_t *meta) {
+    ringbuf_delta_header_t header = { meta->sequence, meta->timestamp, meta->sequence, 0, enc->frame_size };
+    gboolean keyframe = enc->count == 0 || g_atomic_int_compare_and_exchange (&enc->keyframe_requested, TRUE, FALSE) ||
+                        (enc->keyframe_interval > 0 && enc->count % enc->keyframe_interval == 0);
+
+    guint8 *record = ringbuf_reserve (enc->output, sizeof(header) + enc->frame_size);
+    if (keyframe) {
+        header.flags = RINGBUF_DELTA_KEYFRAME;
+        memcpy (record + sizeof(header), pixels, enc->frame_size);
+        memcpy (enc->reference, pixels, enc->frame_size);
+    }
+    else {
+        header.reference = enc->reference_sequence;
+        ringbuf_delta_encode (&enc->geometry, enc->mode, pixels, enc->reference, record + sizeof(header));
+    }
+    memcpy (record, &header, sizeof(header));
+    ringbuf_commit (enc->output, sizeof(header) + enc->frame_size);
+
+    enc->reference_sequence = meta->sequence;
+    enc->count++;
+}
+
+static gpointer delta_thread (gpointer data) {
+    ringbuf_delta_encoder_t *enc = data;
+    ringbuf_frame_meta_t meta;
+
+    while (!g_atomic_int_get (&enc->stop)) {
+        gconstpointer pixels = ringbuf_frame_ring_acquire_timed (enc->input, &meta, POLL_TIMEOUT);
+        if (pixels == NULL) {
+            continue;
+        }
+        ringbuf_delta_encoder_process (enc, pixels, &meta);
+        ringbuf_frame_ring_release (enc->input);
+    }
+    return NULL;
+}
+
+void ringbuf_delta_encoder_start (ringbuf_delta_encoder_t *enc, ringbuf_frame_ring_t *input) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (input);
+
+    if (enc->thread != NULL) {
+        return;
+    }
+    if (geometry->width != enc->geometry.width || geometry->height != enc->geometry.height ||
+        geometry->bytes_per_pixel != enc->geometry.bytes_per_pixel) {
+        g_warning ("Delta encoder and input ring geometries differ");
+        return;
+    }
+    enc->input = input;
+    g_atomic_int_set (&enc->stop, FALSE);
+    enc->thread = g_thread_new ("delta", delta_thread, enc);
+}
+
+void ringbuf_delta_encoder_stop (ringbuf_delta_encoder_t *enc) {
+    if (enc->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&enc->stop, TRUE);
+    g_thread_join (enc->thread);
+    enc->thread = NULL;
+    enc->input = NULL;
+}
+
+ringbuf_delta_decoder_t *ringbuf_delta_decoder_new (const ringbuf_frame_geometry_t *geometry,
+                                                    ringbuf_delta_mode_t mode) {
+    gsize frame_size = (gsize) geometry->width * geometry->height * geometry->bytes_per_pixel;
+
+    if (!check_geometry (geometry) || frame_size == 0 || frame_size > G_MAXUINT32) {
+        return NULL;
+    }
+
+    ringbuf_delta_decoder_t *dec = g_new0 (ringbuf_delta_decoder_t, 1);
+    dec->geometry = *geometry;
+    dec->mode = mode;
+    dec->frame_size = frame_size;
+    dec->reference = g_malloc (frame_size);
+    return dec;
+}
+
+void ringbuf_delta_decoder_free (ringbuf_delta_decoder_t *dec) {
+    if (dec == NULL) {
+        return;
+    }
+    g_free (dec->reference);
+    g_free (dec);
+}
+
+gboolean ringbuf_delta_decoder_decode (ringbuf_delta_decoder_t *dec, const ringbuf_delta_header_t *header,
+                                       gconstpointer payload, gpointer pixels) {
+    if (header->size != dec->frame_size) {
+        return FALSE;
+    }
+    if (header->flags & RINGBUF_DELTA_KEYFRAME) {
+        memcpy (dec->reference, payload, dec->frame_size);
+        memcpy (pixels, payload, dec->frame_size);
+    }
+    else if (dec->valid && header->reference == dec->reference_sequence) {
+        ringbuf_delta_decode (&dec->geometry, dec->mode, payload, dec->reference, pixels);
+    }
+    else {
+        // The chain is broken until the next keyframe
+        dec->valid = FALSE;
+        return FALSE;
+    }
+    dec->reference_sequence = header->sequence;
+    dec->valid = TRUE;
+    return TRUE;
+}
+
+gboolean ringbuf_delta_decoder_pop (ringbuf_delta_decoder_t *dec, ringbuf_t *rb, ringbuf_delta_header_t *header,
+                                    gpointer pixels, guint64 timeout) {
+    if (ringbuf_wait_for_data_timed (rb, sizeof(*header), timeout) == 0) {
+        return FALSE;
+    }
+    // Header and payload are committed together
+    const guint8 *record = ringbuf_tail (rb);
+    memcpy (header, record, sizeof(*header));
+    gboolean decoded = ringbuf_delta_decoder_decode (dec, header, record + sizeof(*header), pixels);
+    ringbuf_move_tail (rb, sizeof(*header) + header->size);
+    return decoded;
+}
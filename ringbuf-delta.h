@@ -0,0 +1,187 @@
+#ifndef INCLUDED_RINGBUF_DELTA_H
+#define INCLUDED_RINGBUF_DELTA_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_delta_encoder_t ringbuf_delta_encoder_t;
+typedef struct _ringbuf_delta_decoder_t ringbuf_delta_decoder_t;
+
+/**
+ * ringbuf_delta_mode_t:
+ * @RINGBUF_DELTA_SUBTRACT: Pixel minus the previous pixel, wrapping around
+ *   like unsigned integers. Small changes give small residuals.
+ * @RINGBUF_DELTA_XOR: Pixel XOR the previous pixel. Unchanged high bits give
+ *   zero bits.
+ *
+ * How residuals are computed against the previous frame. Both are lossless.
+ */
+typedef enum {
+    RINGBUF_DELTA_SUBTRACT,
+    RINGBUF_DELTA_XOR,
+} ringbuf_delta_mode_t;
+
+/* Set in ringbuf_delta_header_t.flags when the payload is the frame itself. */
+#define RINGBUF_DELTA_KEYFRAME (1 << 0)
+
+/**
+ * ringbuf_delta_header_t:
+ * @sequence: Sequence number of the source frame.
+ * @timestamp: Commit timestamp of the source frame.
+ * @reference: Sequence number of the frame the residuals are taken against,
+ *   equal to @sequence for keyframes.
+ * @flags: RINGBUF_DELTA_KEYFRAME or 0.
+ * @size: Number of payload bytes following the header.
+ *
+ * Heads every record in the output ring of a delta encoder.
+ */
+typedef struct {
+    guint64 sequence;
+    gint64 timestamp;
+    guint64 reference;
+    guint32 flags;
+    guint32 size;
+} ringbuf_delta_header_t;
+
+/**
+ * ringbuf_delta_encode:
+ * @geometry: Layout of the frames.
+ * @mode: How residuals are computed.
+ * @pixels: One frame.
+ * @reference: The previous frame, replaced by @pixels.
+ * @residuals: Receives the residuals, may be @pixels.
+ *
+ * Computes the residuals of a frame against the previous one, and moves the
+ * reference on to this frame, in a single pass.
+ */
+void ringbuf_delta_encode (const ringbuf_frame_geometry_t *geometry, ringbuf_delta_mode_t mode,
+                           gconstpointer pixels, gpointer reference, gpointer residuals);
+
+/**
+ * ringbuf_delta_decode:
+ * @geometry: Layout of the frames.
+ * @mode: How residuals were computed.
+ * @residuals: Output of ringbuf_delta_encode().
+ * @reference: The previous frame, replaced by the decoded one.
+ * @pixels: Receives the decoded frame, may be @residuals.
+ *
+ * Inverse of ringbuf_delta_encode().
+ */
+void ringbuf_delta_decode (const ringbuf_frame_geometry_t *geometry, ringbuf_delta_mode_t mode,
+                           gconstpointer residuals, gpointer reference, gpointer pixels);
+
+/**
+ * ringbuf_delta_encoder_new:
+ * @geometry: Layout of the input frames.
+ * @mode: How residuals are computed.
+ * @keyframe_interval: A keyframe every so many frames, or 0 for the first
+ *   frame only.
+ * @depth: Number of records the output ring holds.
+ *
+ * Creates a stage writing one ringbuf_delta_header_t and a frame of residuals,
+ * or a keyframe, per input frame into a blocking output ring. Returns NULL on
+ * invalid arguments.
+ */
+ringbuf_delta_encoder_t *ringbuf_delta_encoder_new (const ringbuf_frame_geometry_t *geometry,
+                                                    ringbuf_delta_mode_t mode, guint keyframe_interval,
+                                                    guint depth);
+
+/**
+ * ringbuf_delta_encoder_free:
+ * @enc: A delta encoder, stopped first if running.
+ */
+void ringbuf_delta_encoder_free (ringbuf_delta_encoder_t *enc);
+
+/**
+ * ringbuf_delta_encoder_output:
+ * @enc: A delta encoder.
+ *
+ * Returns the ring receiving the records. Owned by @enc.
+ */
+ringbuf_t *ringbuf_delta_encoder_output (ringbuf_delta_encoder_t *enc);
+
+/**
+ * ringbuf_delta_encoder_request_keyframe:
+ * @enc: A delta encoder.
+ *
+ * Makes the next frame a keyframe, for a recorder opening a new file for
+ * instance. Can be called from any thread.
+ */
+void ringbuf_delta_encoder_request_keyframe (ringbuf_delta_encoder_t *enc);
+
+/**
+ * ringbuf_delta_encoder_process:
+ * @enc: A delta encoder.
+ * @pixels: One input frame.
+ * @meta: The frame's metadata, copied to the header.
+ *
+ * Encodes one frame straight into the output ring. May block on a full
+ * output ring.
+ */
+void ringbuf_delta_encoder_process (ringbuf_delta_encoder_t *enc, gconstpointer pixels,
+                                    const ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_delta_encoder_start:
+ * @enc: A delta encoder.
+ * @input: Frame ring to consume, with the geometry given at creation.
+ *
+ * Starts a thread acquiring frames from @input in place, encoding them and
+ * releasing them, until ringbuf_delta_encoder_stop().
+ */
+void ringbuf_delta_encoder_start (ringbuf_delta_encoder_t *enc, ringbuf_frame_ring_t *input);
+
+/**
+ * ringbuf_delta_encoder_stop:
+ * @enc: A delta encoder.
+ *
+ * Stops the thread started by ringbuf_delta_encoder_start().
+ */
+void ringbuf_delta_encoder_stop (ringbuf_delta_encoder_t *enc);
+
+/**
+ * ringbuf_delta_decoder_new:
+ * @geometry: Layout of the frames.
+ * @mode: How residuals were computed.
+ *
+ * Creates a decoder keeping its own reference frame. Returns NULL on invalid
+ * arguments.
+ */
+ringbuf_delta_decoder_t *ringbuf_delta_decoder_new (const ringbuf_frame_geometry_t *geometry,
+                                                    ringbuf_delta_mode_t mode);
+
+/**
+ * ringbuf_delta_decoder_free:
+ * @dec: A delta decoder.
+ */
+void ringbuf_delta_decoder_free (ringbuf_delta_decoder_t *dec);
+
+/**
+ * ringbuf_delta_decoder_decode:
+ * @dec: A delta decoder.
+ * @header: Header of one record.
+ * @payload: The @header->size bytes following it.
+ * @pixels: Receives the decoded frame.
+ *
+ * Decodes one record. Returns FALSE, leaving @pixels untouched, if the
+ * record does not fit the geometry or is not taken against the last decoded
+ * frame, after a lost record for instance. Decoding resumes at the next
+ * keyframe.
+ */
+gboolean ringbuf_delta_decoder_decode (ringbuf_delta_decoder_t *dec, const ringbuf_delta_header_t *header,
+                                       gconstpointer payload, gpointer pixels);
+
+/**
+ * ringbuf_delta_decoder_pop:
+ * @dec: A delta decoder.
+ * @rb: Output ring of a delta encoder.
+ * @header: Set to the header of the record read.
+ * @pixels: Receives the decoded frame.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Reads and decodes the oldest record of @rb. Returns FALSE on timeout, or
+ * if the record read could not be decoded, see ringbuf_delta_decoder_decode().
+ */
+gboolean ringbuf_delta_decoder_pop (ringbuf_delta_decoder_t *dec, ringbuf_t *rb, ringbuf_delta_header_t *header,
+                                    gpointer pixels, guint64 timeout);
+
+#endif /* INCLUDED_RINGBUF_DELTA_H */
@@ -0,0 +1,327 @@
+/*
+ * Stats exporter for ring buffers, in the Prometheus text exposition format.
+ *
+ * Snapshots are taken with ringbuf_get_stats() which never takes the data
+ * path locks, so scraping does not disturb producers and consumers.
+ */
+
+#include "ringbuf-exporter.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define REQUEST_TIMEOUT_MS 100
+#define REQUEST_MAX_BYTES 4096
+
+struct _ringbuf_exporter_t {
+    gint listen_fd;
+    gint wakeup[2];
+    gchar *unix_path;
+    GThread *thread;
+};
+
+typedef struct {
+    const gchar *name;
+    const gchar *type;
+    const gchar *help;
+    gsize offset;
+    gboolean is_size;
+} metric_t;
+
+static const metric_t metrics[] = {
+    { "ringbuf_capacity_bytes", "gauge", "Size of the ring buffer in bytes.",
+      offsetof(ringbuf_stats_t, capacity), TRUE },
+    { "ringbuf_used_bytes", "gauge", "Bytes currently stored in the ring buffer.",
+      offsetof(ringbuf_stats_t, used), TRUE },
+    { "ringbuf_high_watermark_bytes", "gauge", "Highest number of bytes ever stored.",
+      offsetof(ringbuf_stats_t, high_watermark), TRUE },
+    { "ringbuf_push_ops_total", "counter", "Completed write operations.",
+      offsetof(ringbuf_stats_t, push_ops), FALSE },
+    { "ringbuf_pop_ops_total", "counter", "Completed read operations.",
+      offsetof(ringbuf_stats_t, pop_ops), FALSE },
+    { "ringbuf_pushed_bytes_total", "counter", "Bytes written.",
+      offsetof(ringbuf_stats_t, bytes_pushed), FALSE },
+    { "ringbuf_popped_bytes_total", "counter", "Bytes read.",
+      offsetof(ringbuf_stats_t, bytes_popped), FALSE },
+    { "ringbuf_producer_waits_total", "counter", "Writes that blocked on a full ring.",
+      offsetof(ringbuf_stats_t, producer_waits), FALSE },
+    { "ringbuf_consumer_waits_total", "counter", "Reads that blocked on an empty ring.",
+      offsetof(ringbuf_stats_t, consumer_waits), FALSE },
+    { "ringbuf_drops_total", "counter", "Writes refused by a full non-blocking ring.",
+      offsetof(ringbuf_stats_t, drops), FALSE },
+    { "ringbuf_timeouts_total", "counter", "Timed waits for data or space that expired.",
+      offsetof(ringbuf_stats_t, timeouts), FALSE },
+};
+
+static const gdouble quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+// Label values must escape backslashes, double quotes and newlines
+static void append_labels (GString *out, const ringbuf_info_t *info) {
+    g_string_append_printf (out, "ring=\"%u\",name=\"", info->id);
+    for (const gchar *c = info->name; *c != '\0'; c++) {
+        if (*c == '\\' || *c == '"') {
+            g_string_append_c (out, '\\');
+            g_string_append_c (out, *c);
+        }
+        else if (*c == '\n') {
+            g_string_append (out, "\\n");
+        }
+        else {
+            g_string_append_c (out, *c);
+        }
+    }
+    g_string_append_c (out, '"');
+}
+
+static guint64 metric_value (const metric_t *metric, const ringbuf_stats_t *stats) {
+    const guint8 *field = (const guint8 *) stats + metric->offset;
+    return metric->is_size ? *(const gsize *) field : *(const guint64 *) field;
+}
+
+static void render_latency (GString *out, GArray *rings, const gchar *side) {
+    gboolean push = g_strcmp0 (side, "push") == 0;
+
+    for (guint i = 0; i < rings->len; i++) {
+        const ringbuf_info_t *info = &g_array_index (rings, ringbuf_info_t, i);
+        const guint64 *histogram = push ? info->stats.push_latency : info->stats.pop_latency;
+        guint64 count = 0;
+
+        for (guint q = 0; q < G_N_ELEMENTS(quantiles); q++) {
+            g_string_append (out, "ringbuf_wait_seconds{");
+            append_labels (out, info);
+            g_string_append_printf (out, ",side=\"%s\",quantile=\"%g\"} %g\n", side, quantiles[q],
+                ringbuf_latency_percentile (histogram, quantiles[q]) / (gdouble) G_USEC_PER_SEC);
+        }
+        for (guint b = 0; b < RINGBUF_LATENCY_BUCKETS; b++) {
+            count += histogram[b];
+        }
+        g_string_append (out, "ringbuf_wait_seconds_sum{");
+        append_labels (out, info);
+        g_string_append_printf (out, ",side=\"%s\"} %g\n", side,
+            (push ? info->stats.push_wait_usec : info->stats.pop_wait_usec) / (gdouble) G_USEC_PER_SEC);
+        g_string_append (out, "ringbuf_wait_seconds_count{");
+        append_labels (out, info);
+        g_string_append_printf (out, ",side=\"%s\"} %" G_GUINT64_FORMAT "\n", side, count);
+    }
+}
+
+gchar *ringbuf_exporter_render (void) {
+    GArray *rings = ringbuf_list ();
+    GString *out = g_string_new (NULL);
+
+    for (guint m = 0; m < G_N_ELEMENTS(metrics); m++) {
+        g_string_append_printf (out, "# HELP %s %s\n# TYPE %s %s\n",
+            metrics[m].name, metrics[m].help, metrics[m].name, metrics[m].type);
+        for (guint i = 0; i < rings->len; i++) {
+            const ringbuf_info_t *info = &g_array_index (rings, ringbuf_info_t, i);
+            g_string_append_printf (out, "%s{", metrics[m].name);
+            append_labels (out, info);
+            g_string_append_printf (out, "} %" G_GUINT64_FORMAT "\n", metric_value (&metrics[m], &info->stats));
+        }
+    }
+
+    g_string_append (out, "# HELP ringbuf_wait_seconds Time spent blocked per operation.\n"
+                          "# TYPE ringbuf_wait_seconds summary\n");
+    render_latency (out, rings, "push");
+    render_latency (out, rings, "pop");
+
+    g_array_unref (rings);
+    return g_string_free (out, FALSE);
+}
+
+static gboolean write_all (gint fd, const gchar *data, gsize len) {
+    while (len > 0) {
+        gssize n = send (fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        data += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static void serve_client (gint fd) {
+    gchar request[REQUEST_MAX_BYTES + 1];
+    gsize len = 0;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    // Read whatever the client sends, but do not wait for raw clients forever
+    while (len < REQUEST_MAX_BYTES && poll (&pfd, 1, REQUEST_TIMEOUT_MS) > 0) {
+        gssize n = recv (fd, request + len, REQUEST_MAX_BYTES - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+        request[len] = '\0';
+        if (strstr (request, "\r\n\r\n") != NULL || strstr (request, "\n\n") != NULL) {
+            break;
+        }
+    }
+    request[len] = '\0';
+
+    gchar *body = ringbuf_exporter_render ();
+    if (g_str_has_prefix (request, "GET ") || g_str_has_prefix (request, "HEAD ")) {
+        gchar *header = g_strdup_printf ("HTTP/1.0 200 OK\r\n"
+                                         "Content-Type: text/plain; version=0.0.4\r\n"
+                                         "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                                         "Connection: close\r\n\r\n", strlen (body));
+        if (write_all (fd, header, strlen (header)) && g_str_has_prefix (request, "GET ")) {
+            write_all (fd, body, strlen (body));
+        }
+        g_free (header);
+    }
+    else {
+        write_all (fd, body, strlen (body));
+    }
+    g_free (body);
+}
+
+static gpointer exporter_thread (gpointer data) {
+    ringbuf_exporter_t *exporter = data;
+    struct pollfd fds[2] = {
+        { exporter->listen_fd, POLLIN, 0 },
+        { exporter->wakeup[0], POLLIN, 0 },
+    };
+
+    while (TRUE) {
+        if (poll (fds, G_N_ELEMENTS(fds), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            g_warning ("Exporter poll failed: %s", strerror (errno));
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            gint client = accept (exporter->listen_fd, NULL, NULL);
+            if (client < 0) {
+                continue;
+            }
+            serve_client (client);
+            close (client);
+        }
+    }
+
+    return NULL;
+}
+
+static gint listen_unix (const gchar *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen (path) >= sizeof(addr.sun_path)) {
+        g_warning ("Exporter socket path too long: %s", path);
+        return -1;
+    }
+    g_strlcpy (addr.sun_path, path, sizeof(addr.sun_path));
+
+    gint fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_warning ("Could not create exporter socket: %s", strerror (errno));
+        return -1;
+    }
+    unlink (path);
+    if (bind (fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        g_warning ("Could not bind exporter socket %s: %s", path, strerror (errno));
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+static gint listen_tcp (guint16 port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    addr.sin_port = htons (port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+    gint fd = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_warning ("Could not create exporter socket: %s", strerror (errno));
+        return -1;
+    }
+    gint one = 1;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind (fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        g_warning ("Could not bind exporter to port %u: %s", port, strerror (errno));
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+ringbuf_exporter_t *ringbuf_exporter_new (const gchar *address) {
+    g_return_val_if_fail (address != NULL, NULL);
+
+    gint fd = -1;
+    gchar *unix_path = NULL;
+
+    if (g_str_has_prefix (address, "unix:")) {
+        unix_path = g_strdup (address + strlen ("unix:"));
+        fd = listen_unix (unix_path);
+    }
+    else if (g_str_has_prefix (address, "tcp:")) {
+        gchar *end = NULL;
+        guint64 port = g_ascii_strtoull (address + strlen ("tcp:"), &end, 10);
+        if (end == NULL || *end != '\0' || port == 0 || port > G_MAXUINT16) {
+            g_warning ("Invalid exporter port in %s", address);
+            return NULL;
+        }
+        fd = listen_tcp (port);
+    }
+    else {
+        g_warning ("Unknown exporter address %s", address);
+        return NULL;
+    }
+
+    if (fd < 0) {
+        g_free (unix_path);
+        return NULL;
+    }
+    if (listen (fd, 8) != 0) {
+        g_warning ("Exporter could not listen: %s", strerror (errno));
+        close (fd);
+        g_free (unix_path);
+        return NULL;
+    }
+
+    ringbuf_exporter_t *exporter = g_new0 (ringbuf_exporter_t, 1);
+    exporter->listen_fd = fd;
+    exporter->unix_path = unix_path;
+    if (pipe2 (exporter->wakeup, O_CLOEXEC) != 0) {
+        g_warning ("Could not create exporter wakeup pipe");
+        close (fd);
+        g_free (unix_path);
+        g_free (exporter);
+        return NULL;
+    }
+    exporter->thread = g_thread_new ("ringbuf-exporter", exporter_thread, exporter);
+
+    return exporter;
+}
+
+void ringbuf_exporter_free (ringbuf_exporter_t *exporter) {
+    g_assert(exporter);
+
+    if (write (exporter->wakeup[1], "", 1) != 1) {
+        g_warning ("Could not wake exporter thread");
+    }
+    g_thread_join (exporter->thread);
+
+    close (exporter->listen_fd);
+    close (exporter->wakeup[0]);
+    close (exporter->wakeup[1]);
+    if (exporter->unix_path != NULL) {
+        unlink (exporter->unix_path);
+        g_free (exporter->unix_path);
+    }
+    g_free (exporter);
+}
@@ -0,0 +1,36 @@
+#ifndef INCLUDED_RINGBUF_EXPORTER_H
+#define INCLUDED_RINGBUF_EXPORTER_H
+
+#include "ringbuf.h"
+
+typedef struct _ringbuf_exporter_t ringbuf_exporter_t;
+
+/**
+ * ringbuf_exporter_render:
+ *
+ * Formats the stats of every live ring buffer in the Prometheus text
+ * exposition format. Returns a newly allocated string, free with g_free().
+ */
+gchar *ringbuf_exporter_render (void);
+
+/**
+ * ringbuf_exporter_new:
+ * @address: Where to listen, either "unix:/path/to/socket" or "tcp:PORT".
+ *
+ * Starts a background thread serving ringbuf_exporter_render() to every
+ * client that connects. TCP listeners are bound to the loopback interface
+ * only. Clients sending an HTTP request get an HTTP response, anything else
+ * gets the plain text. Returns NULL on error.
+ */
+ringbuf_exporter_t *ringbuf_exporter_new (const gchar *address);
+
+/**
+ * ringbuf_exporter_free:
+ * @exporter: A running exporter.
+ *
+ * Stops the exporter thread, closes the socket and removes the UNIX socket
+ * file if any.
+ */
+void ringbuf_exporter_free (ringbuf_exporter_t *exporter);
+
+#endif /* INCLUDED_RINGBUF_EXPORTER_H */
@@ -0,0 +1,346 @@
+/*
+ * Frame rings: fixed-size frames in one ring, their metadata in a sidecar.
+ *
+ * The producer commits the pixels first and then pushes the metadata, so a
+ * consumer holding a metadata entry knows its frame is there. The sidecar is
+ * sized to hold at least as many entries as the pixel ring holds frames, which
+ * means it never fills up before the pixel ring does and pushing metadata
+ * never blocks or drops on its own.
+ */
+
+#include "ringbuf-frame.h"
+#include "ringbuf-simd.h"
+
+// Blocks copied and summarized together by the fused push, sized to stay in L1
+#define FUSED_BLOCK_BYTES (16 * 1024)
+
+typedef struct {
+    ringbuf_frame_stage_func func;
+    gpointer user_data;
+} frame_stage_t;
+
+struct _ringbuf_frame_ring_t {
+    ringbuf_frame_geometry_t geometry;
+    gsize frame_size;
+    ringbuf_t *pixels;
+    ringbuf_t *meta;
+
+    gboolean stats_enabled;
+    guint32 saturation;
+    GArray *stages;
+
+    // Producer side only
+    guint64 sequence;
+    // Frames produced, dropped ones included
+    guint64 frame_id;
+    gpointer reserved;
+};
+
+static void stats_init (ringbuf_frame_stats_t *stats) {
+    memset (stats, 0, sizeof(*stats));
+    stats->min = G_MAXUINT32;
+}
+
+// Folds @n pixels into @stats, eight lanes at a time widened to 32 bits. Sums
+// are split in 16-bit halves so 32-bit lanes do not overflow within a block.
+#define STATS_BLOCK_PIXELS (8 * 65536)
+
+#define DEFINE_STATS(type, ntype)                                                        \
+RINGBUF_SIMD_CLONES                                                                       \
+static void stats_##type (const type *src, gsize n, guint32 saturation,                  \
+                          ringbuf_frame_stats_t *stats) {                                \
+    const ringbuf_vu32 zero = {0};                                                       \
+    ringbuf_vu32 vmin = zero + stats->min, vmax = zero + stats->max, vsat = zero;        \
+    gsize i = 0;                                                                         \
+    while (i + 8 <= n) {                                                                 \
+        gsize end = MIN(n - n % 8, i + STATS_BLOCK_PIXELS);                              \
+        ringbuf_vu32 lo = zero, hi = zero;                                               \
+        for (; i < end; i += 8) {                                                        \
+            ringbuf_vu32 v = __builtin_convertvector (*(const ntype *) (src + i), ringbuf_vu32); \
+            ringbuf_vu32 lt = (ringbuf_vu32) (v < vmin);                                 \
+            ringbuf_vu32 gt = (ringbuf_vu32) (v > vmax);                                 \
+            vmin = (v & lt) | (vmin & ~lt);                                              \
+            vmax = (v & gt) | (vmax & ~gt);                                              \
+            vsat -= (ringbuf_vu32) (v >= saturation);                                    \
+            lo += v & 0xffff;                                                            \
+            hi += v >> 16;                                                               \
+        }                                                                                \
+        for (guint l = 0; l < 8; l++) {                                                  \
+            stats->sum += lo[l] + ((guint64) hi[l] << 16);                               \
+        }                                                                                \
+    }                                                                                    \
+    for (guint l = 0; l < 8; l++) {                                                      \
+        stats->min = MIN(stats->min, vmin[l]);                                           \
+        stats->max = MAX(stats->max, vmax[l]);                                           \
+        stats->saturated += vsat[l];                                                     \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        stats->min = MIN(stats->min, src[i]);                                            \
+        stats->max = MAX(stats->max, src[i]);                                            \
+        stats->saturated += src[i] >= saturation;                                        \
+        stats->sum += src[i];                                                            \
+    }                                                                                    \
+}
+
+DEFINE_STATS(guint8, ringbuf_vu8x8)
+DEFINE_STATS(guint16, ringbuf_vu16x8)
+DEFINE_STATS(guint32, ringbuf_vu32)
+
+static void stats_update (guint bytes_per_pixel, gconstpointer pixels, gsize size, guint32 saturation,
+                          ringbuf_frame_stats_t *stats) {
+    switch (bytes_per_pixel) {
+    case 1:
+        stats_guint8 (pixels, size, saturation, stats);
+        break;
+    case 2:
+        stats_guint16 (pixels, size / 2, saturation, stats);
+        break;
+    default:
+        stats_guint32 (pixels, size / 4, saturation, stats);
+        break;
+    }
+}
+
+static void stats_finish (ringbuf_frame_stats_t *stats, gsize nb_pixels) {
+    stats->mean = (gdouble) stats->sum / nb_pixels;
+}
+
+void ringbuf_frame_compute_stats (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                  guint32 saturation, ringbuf_frame_stats_t *stats) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    stats_init (stats);
+    stats_update (geometry->bytes_per_pixel, pixels, nb_pixels * geometry->bytes_per_pixel, saturation, stats);
+    stats_finish (stats, nb_pixels);
+}
+
+ringbuf_frame_ring_t *ringbuf_frame_ring_new (const gchar *name, const ringbuf_frame_geometry_t *geometry,
+                                              guint nb_frames, gboolean block) {
+    guint bpp = geometry->bytes_per_pixel;
+    if (geometry->width == 0 || geometry->height == 0 || nb_frames == 0 || (bpp != 1 && bpp != 2 && bpp != 4)) {
+        g_warning ("Invalid frame ring geometry %ux%u, %u bytes per pixel, %u frames",
+                   geometry->width, geometry->height, bpp, nb_frames);
+        return NULL;
+    }
+
+    ringbuf_frame_ring_t *fr = g_new0 (ringbuf_frame_ring_t, 1);
+    fr->geometry = *geometry;
+    fr->frame_size = (gsize) geometry->width * geometry->height * bpp;
+    fr->saturation = G_MAXUINT32 >> (32 - 8 * bpp);
+    fr->stages = g_array_new (FALSE, FALSE, sizeof(frame_stage_t));
+
+    fr->pixels = ringbuf_new_named (name, fr->frame_size * nb_frames, block);
+    if (fr->pixels == NULL) {
+        g_array_free (fr->stages, TRUE);
+        g_free (fr);
+        return NULL;
+    }
+
+    // The pixel ring was rounded up to pages and may hold more frames than asked
+    gsize capacity = ringbuf_buffer_size (fr->pixels) / fr->frame_size;
+    gchar *meta_name = g_strdup_printf ("%s-meta", name != NULL ? name : "frames");
+    fr->meta = ringbuf_new_named (meta_name, capacity * sizeof(ringbuf_frame_meta_t), TRUE);
+    g_free (meta_name);
+    if (fr->meta == NULL) {
+        ringbuf_free (fr->pixels);
+        g_array_free (fr->stages, TRUE);
+        g_free (fr);
+        return NULL;
+    }
+
+    return fr;
+}
+
+void ringbuf_frame_ring_free (ringbuf_frame_ring_t *fr) {
+    if (fr == NULL) {
+        return;
+    }
+    ringbuf_free (fr->meta);
+    ringbuf_free (fr->pixels);
+    g_array_free (fr->stages, TRUE);
+    g_free (fr);
+}
+
+const ringbuf_frame_geometry_t *ringbuf_frame_ring_geometry (const ringbuf_frame_ring_t *fr) {
+    return &fr->geometry;
+}
+
+gsize ringbuf_frame_ring_frame_size (const ringbuf_frame_ring_t *fr) {
+    return fr->frame_size;
+}
+
+ringbuf_t *ringbuf_frame_ring_pixels (ringbuf_frame_ring_t *fr) {
+    return fr->pixels;
+}
+
+void ringbuf_frame_ring_set_stats (ringbuf_frame_ring_t *fr, gboolean enable, guint32 saturation) {
+    fr->stats_enabled = enable;
+    fr->saturation = saturation;
+}
+
+void ringbuf_frame_ring_add_stage (ringbuf_frame_ring_t *fr, ringbuf_frame_stage_func func, gpointer user_data) {
+    frame_stage_t stage = { func, user_data };
+    g_array_append_val (fr->stages, stage);
+}
+
+gpointer ringbuf_frame_ring_reserve (ringbuf_frame_ring_t *fr) {
+    fr->reserved = ringbuf_reserve (fr->pixels, fr->frame_size);
+    if (fr->reserved == NULL) {
+        fr->frame_id++;
+    }
+    return fr->reserved;
+}
+
+static void frame_ring_publish (ringbuf_frame_ring_t *fr, gconstpointer pixels, ringbuf_frame_meta_t *meta) {
+    meta->sequence = fr->sequence++;
+    meta->frame_id = fr->frame_id++;
+    for (guint i = 0; i < fr->stages->len; i++) {
+        frame_stage_t *stage = &g_array_index (fr->stages, frame_stage_t, i);
+        stage->func (&fr->geometry, pixels, meta, stage->user_data);
+    }
+    meta->timestamp = g_get_monotonic_time ();
+    ringbuf_commit (fr->pixels, fr->frame_size);
+    ringbuf_push (fr->meta, meta, sizeof(*meta));
+}
+
+void ringbuf_frame_ring_commit (ringbuf_frame_ring_t *fr) {
+    ringbuf_frame_meta_t meta = {0};
+
+    if (fr->reserved == NULL) {
+        g_warning ("Committing a frame that was not reserved");
+        return;
+    }
+    if (fr->stats_enabled) {
+        ringbuf_frame_compute_stats (&fr->geometry, fr->reserved, fr->saturation, &meta.stats);
+        meta.flags |= RINGBUF_FRAME_META_STATS;
+    }
+    frame_ring_publish (fr, fr->reserved, &meta);
+    fr->reserved = NULL;
+}
+
+gboolean ringbuf_frame_ring_push (ringbuf_frame_ring_t *fr, gconstpointer src) {
+    ringbuf_frame_meta_t meta = {0};
+    guint8 *frame = ringbuf_reserve (fr->pixels, fr->frame_size);
+
+    if (frame == NULL) {
+        fr->frame_id++;
+        return FALSE;
+    }
+    if (fr->stats_enabled) {
+        // Summarize each block while it is still in cache from the copy
+        stats_init (&meta.stats);
+        for (gsize offset = 0; offset < fr->frame_size; offset += FUSED_BLOCK_BYTES) {
+            gsize size = MIN(FUSED_BLOCK_BYTES, fr->frame_size - offset);
+            memcpy (frame + offset, (const guint8 *) src + offset, size);
+            stats_update (fr->geometry.bytes_per_pixel, frame + offset, size, fr->saturation, &meta.stats);
+        }
+        stats_finish (&meta.stats, fr->frame_size / fr->geometry.bytes_per_pixel);
+        meta.flags |= RINGBUF_FRAME_META_STATS;
+    }
+    else {
+        memcpy (frame, src, fr->frame_size);
+    }
+    frame_ring_publish (fr, frame, &meta);
+    return TRUE;
+}
+
+gconstpointer ringbuf_frame_ring_acquire (ringbuf_frame_ring_t *fr, ringbuf_frame_meta_t *meta) {
+    ringbuf_frame_meta_t entry;
+
+    ringbuf_pop (&entry, fr->meta, sizeof(entry));
+    if (meta != NULL) {
+        *meta = entry;
+    }
+    return ringbuf_tail (fr->pixels);
+}
+
+gconstpointer ringbuf_frame_ring_acquire_timed (ringbuf_frame_ring_t *fr, ringbuf_frame_meta_t *meta,
+                                                guint64 timeout) {
+    ringbuf_frame_meta_t entry;
+
+    if (ringbuf_timed_pop (&entry, fr->meta, sizeof(entry), timeout) == NULL) {
+        return NULL;
+    }
+    if (meta != NULL) {
+        *meta = entry;
+    }
+    return ringbuf_tail (fr->pixels);
+}
+
+void ringbuf_frame_ring_release (ringbuf_frame_ring_t *fr) {
+    ringbuf_move_tail (fr->pixels, fr->frame_size);
+}
+
+void ringbuf_frame_ring_pop (ringbuf_frame_ring_t *fr, gpointer dst, ringbuf_frame_meta_t *meta) {
+    memcpy (dst, ringbuf_frame_ring_acquire (fr, meta), fr->frame_size);
+    ringbuf_frame_ring_release (fr);
+}
+
+gsize ringbuf_frame_rois_size (const ringbuf_frame_geometry_t *geometry, const ringbuf_frame_roi_t *rois,
+                               guint nb_rois) {
+    gsize size = 0;
+
+    for (guint r = 0; r < nb_rois; r++) {
+        const ringbuf_frame_roi_t *roi = &rois[r];
+        if (roi->width == 0 || roi->height == 0 || roi->x >= geometry->width || roi->y >= geometry->height ||
+            roi->width > geometry->width - roi->x || roi->height > geometry->height - roi->y) {
+            g_warning ("Region %u of %ux%u at (%u, %u) does not fit in a %ux%u frame", r, roi->width,
+                       roi->height, roi->x, roi->y, geometry->width, geometry->height);
+            return 0;
+        }
+        size += (gsize) roi->width * roi->height * geometry->bytes_per_pixel;
+    }
+    return size;
+}
+
+gconstpointer ringbuf_frame_roi_view (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                      const ringbuf_frame_roi_t *roi, gsize *stride) {
+    *stride = (gsize) geometry->width * geometry->bytes_per_pixel;
+    return (const guint8 *) pixels + roi->y * *stride + (gsize) roi->x * geometry->bytes_per_pixel;
+}
+
+/*
+ * Rows of at least one vector are copied with vector moves, the last one
+ * overlapping the previous ones, so no row goes through a memcpy() call.
+ */
+RINGBUF_SIMD_CLONES
+static void copy_rows (const guint8 *src, gsize stride, guint8 *dst, gsize row_bytes, guint nb_rows) {
+    if (row_bytes < RINGBUF_SIMD_BYTES) {
+        for (guint y = 0; y < nb_rows; y++, src += stride, dst += row_bytes) {
+            memcpy (dst, src, row_bytes);
+        }
+        return;
+    }
+    for (guint y = 0; y < nb_rows; y++, src += stride, dst += row_bytes) {
+        gsize i = 0;
+        for (; i + RINGBUF_SIMD_BYTES < row_bytes; i += RINGBUF_SIMD_BYTES) {
+            *(ringbuf_vu8 *) (dst + i) = *(const ringbuf_vu8 *) (src + i);
+        }
+        i = row_bytes - RINGBUF_SIMD_BYTES;
+        *(ringbuf_vu8 *) (dst + i) = *(const ringbuf_vu8 *) (src + i);
+    }
+}
+
+gsize ringbuf_frame_copy_rois (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                               const ringbuf_frame_roi_t *rois, guint nb_rois, gpointer dst) {
+    gsize size = ringbuf_frame_rois_size (geometry, rois, nb_rois);
+    guint8 *out = dst;
+
+    for (guint r = 0; size > 0 && r < nb_rois; r++) {
+        gsize stride, row_bytes = (gsize) rois[r].width * geometry->bytes_per_pixel;
+        const guint8 *src = ringbuf_frame_roi_view (geometry, pixels, &rois[r], &stride);
+        copy_rows (src, stride, out, row_bytes, rois[r].height);
+        out += row_bytes * rois[r].height;
+    }
+    return size;
+}
+
+gboolean ringbuf_frame_ring_pop_rois (ringbuf_frame_ring_t *fr, const ringbuf_frame_roi_t *rois, guint nb_rois,
+                                      gpointer dst, ringbuf_frame_meta_t *meta) {
+    if (ringbuf_frame_rois_size (&fr->geometry, rois, nb_rois) == 0) {
+        return FALSE;
+    }
+    ringbuf_frame_copy_rois (&fr->geometry, ringbuf_frame_ring_acquire (fr, meta), rois, nb_rois, dst);
+    ringbuf_frame_ring_release (fr);
+    return TRUE;
+}
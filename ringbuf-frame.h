@@ -0,0 +1,297 @@
+#ifndef INCLUDED_RINGBUF_FRAME_H
+#define INCLUDED_RINGBUF_FRAME_H
+
+#include "ringbuf.h"
+
+typedef struct _ringbuf_frame_ring_t ringbuf_frame_ring_t;
+
+/**
+ * ringbuf_frame_geometry_t:
+ * @width: Pixels per row.
+ * @height: Number of rows.
+ * @bytes_per_pixel: 1, 2 or 4, pixels are unsigned integers.
+ *
+ * Layout of the frames carried by a frame ring. Rows are packed.
+ */
+typedef struct {
+    guint width;
+    guint height;
+    guint bytes_per_pixel;
+} ringbuf_frame_geometry_t;
+
+/**
+ * ringbuf_frame_roi_t:
+ * @x: First column.
+ * @y: First row.
+ * @width: Number of columns.
+ * @height: Number of rows.
+ *
+ * Rectangular region of interest within a frame, in pixels.
+ */
+typedef struct {
+    guint x;
+    guint y;
+    guint width;
+    guint height;
+} ringbuf_frame_roi_t;
+
+/**
+ * ringbuf_frame_stats_t:
+ * @min: Smallest pixel value.
+ * @max: Largest pixel value.
+ * @sum: Sum of all pixel values.
+ * @mean: @sum divided by the number of pixels.
+ * @saturated: Number of pixels at or above the saturation level.
+ *
+ * Summary of the pixels of one frame.
+ */
+typedef struct {
+    guint32 min;
+    guint32 max;
+    guint64 sum;
+    gdouble mean;
+    guint64 saturated;
+} ringbuf_frame_stats_t;
+
+/* Set in ringbuf_frame_meta_t.flags when the stats stage filled @stats. */
+#define RINGBUF_FRAME_META_STATS (1 << 0)
+/* Set when a histogram stage published this frame's histogram. */
+#define RINGBUF_FRAME_META_HISTOGRAM (1 << 1)
+
+/**
+ * ringbuf_frame_meta_t:
+ * @sequence: Commit order of the frame, starting at 0.
+ * @frame_id: Production order of the frame, starting at 0. Unlike @sequence
+ *   it also counts the frames a full non-blocking ring dropped, so drops
+ *   leave gaps.
+ * @timestamp: Monotonic time of the commit, in microseconds.
+ * @flags: Which optional fields are valid, see RINGBUF_FRAME_META_STATS.
+ * @stats: Pixel statistics, when the stats stage is enabled.
+ *
+ * Metadata travelling next to each frame in the sidecar ring.
+ */
+typedef struct {
+    guint64 sequence;
+    guint64 frame_id;
+    gint64 timestamp;
+    guint32 flags;
+    ringbuf_frame_stats_t stats;
+} ringbuf_frame_meta_t;
+
+/**
+ * ringbuf_frame_stage_func:
+ * @geometry: Layout of @pixels.
+ * @pixels: The frame being committed.
+ * @meta: Its metadata, @sequence is already set. Stages may fill in fields
+ *   and flags.
+ * @user_data: Data given to ringbuf_frame_ring_add_stage().
+ *
+ * Processing run by the producer on every frame before it is published.
+ */
+typedef void (*ringbuf_frame_stage_func) (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                          ringbuf_frame_meta_t *meta, gpointer user_data);
+
+/**
+ * ringbuf_frame_compute_stats:
+ * @geometry: Layout of @pixels.
+ * @pixels: One frame.
+ * @saturation: Pixels at or above this value are counted as saturated.
+ * @stats: Filled with the result.
+ *
+ * Computes the statistics of one frame with vector instructions.
+ */
+void ringbuf_frame_compute_stats (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                  guint32 saturation, ringbuf_frame_stats_t *stats);
+
+/**
+ * ringbuf_frame_ring_new:
+ * @name: Name of the ring, may be NULL. The metadata ring is named "@name-meta".
+ * @geometry: Layout of every frame.
+ * @nb_frames: Minimum number of frames the ring can hold.
+ * @block: Whether producers block when the ring is full, or drop the frame.
+ *
+ * Creates a ring of fixed-size frames, made of a pixel ring and a sidecar
+ * ring of #ringbuf_frame_meta_t. Meant for one producer and one consumer.
+ * Returns NULL on error.
+ */
+ringbuf_frame_ring_t *ringbuf_frame_ring_new (const gchar *name, const ringbuf_frame_geometry_t *geometry,
+                                              guint nb_frames, gboolean block);
+
+/**
+ * ringbuf_frame_ring_free:
+ * @fr: A frame ring.
+ */
+void ringbuf_frame_ring_free (ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_geometry:
+ * @fr: A frame ring.
+ *
+ * Returns the frame layout. Owned by @fr.
+ */
+const ringbuf_frame_geometry_t *ringbuf_frame_ring_geometry (const ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_frame_size:
+ * @fr: A frame ring.
+ *
+ * Returns the size of one frame in bytes.
+ */
+gsize ringbuf_frame_ring_frame_size (const ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_pixels:
+ * @fr: A frame ring.
+ *
+ * Returns the ring holding the pixels, for stats and monitoring.
+ */
+ringbuf_t *ringbuf_frame_ring_pixels (ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_set_stats:
+ * @fr: A frame ring.
+ * @enable: Whether to compute stats on commit.
+ * @saturation: Pixels at or above this value are counted as saturated.
+ *
+ * Enables the stats stage: every committed or pushed frame gets its
+ * #ringbuf_frame_stats_t computed while still hot in the producer's cache,
+ * so consumers that only need the stats never read the pixels. Call before
+ * producing frames.
+ */
+void ringbuf_frame_ring_set_stats (ringbuf_frame_ring_t *fr, gboolean enable, guint32 saturation);
+
+/**
+ * ringbuf_frame_ring_add_stage:
+ * @fr: A frame ring.
+ * @func: Called on every committed or pushed frame, after the stats stage.
+ * @user_data: Passed to @func.
+ *
+ * Attaches a producer-side stage. Stages run in the order they were added,
+ * while the frame is hot in the producer's cache. Call before producing frames.
+ */
+void ringbuf_frame_ring_add_stage (ringbuf_frame_ring_t *fr, ringbuf_frame_stage_func func, gpointer user_data);
+
+/**
+ * ringbuf_frame_ring_reserve:
+ * @fr: A frame ring.
+ *
+ * Reserves the next frame for in-place writing. Returns NULL if a
+ * non-blocking ring is full, the frame is then dropped.
+ */
+gpointer ringbuf_frame_ring_reserve (ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_commit:
+ * @fr: A frame ring.
+ *
+ * Publishes the reserved frame together with its metadata, running the
+ * stats stage first if enabled.
+ */
+void ringbuf_frame_ring_commit (ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_push:
+ * @fr: A frame ring.
+ * @src: One frame.
+ *
+ * Copies @src into the ring. With the stats stage enabled, stats are computed
+ * block by block right behind the copy. Returns FALSE if a non-blocking ring
+ * was full.
+ */
+gboolean ringbuf_frame_ring_push (ringbuf_frame_ring_t *fr, gconstpointer src);
+
+/**
+ * ringbuf_frame_ring_acquire:
+ * @fr: A frame ring.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ *
+ * Blocks until a frame is available and returns it in place. The frame stays
+ * valid until ringbuf_frame_ring_release().
+ */
+gconstpointer ringbuf_frame_ring_acquire (ringbuf_frame_ring_t *fr, ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_frame_ring_acquire_timed:
+ * @fr: A frame ring.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Same as ringbuf_frame_ring_acquire() but returns NULL after @timeout.
+ */
+gconstpointer ringbuf_frame_ring_acquire_timed (ringbuf_frame_ring_t *fr, ringbuf_frame_meta_t *meta,
+                                                guint64 timeout);
+
+/**
+ * ringbuf_frame_ring_release:
+ * @fr: A frame ring.
+ *
+ * Gives the acquired frame back to the producer.
+ */
+void ringbuf_frame_ring_release (ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_frame_ring_pop:
+ * @fr: A frame ring.
+ * @dst: Room for one frame.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ *
+ * Blocks until a frame is available and copies it to @dst.
+ */
+void ringbuf_frame_ring_pop (ringbuf_frame_ring_t *fr, gpointer dst, ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_frame_rois_size:
+ * @geometry: Layout of the frames.
+ * @rois: Regions of interest.
+ * @nb_rois: Number of @rois.
+ *
+ * Returns the number of bytes needed to hold @rois packed one after the
+ * other, or 0 if one of them is empty or does not fit in the frame.
+ */
+gsize ringbuf_frame_rois_size (const ringbuf_frame_geometry_t *geometry, const ringbuf_frame_roi_t *rois,
+                               guint nb_rois);
+
+/**
+ * ringbuf_frame_roi_view:
+ * @geometry: Layout of @pixels.
+ * @pixels: One frame, e.g. from ringbuf_frame_ring_acquire().
+ * @roi: A region of interest within the frame.
+ * @stride: Set to the distance in bytes between two rows of the region.
+ *
+ * Returns the first pixel of @roi in place, its rows follow every @stride
+ * bytes and are ringbuf_frame_roi_t.width pixels long.
+ */
+gconstpointer ringbuf_frame_roi_view (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                      const ringbuf_frame_roi_t *roi, gsize *stride);
+
+/**
+ * ringbuf_frame_copy_rois:
+ * @geometry: Layout of @pixels.
+ * @pixels: One frame.
+ * @rois: Regions of interest.
+ * @nb_rois: Number of @rois.
+ * @dst: Room for ringbuf_frame_rois_size() bytes.
+ *
+ * Copies the regions to @dst one after the other, each with packed rows.
+ * Only the rows and columns of the regions are read. Returns the number of
+ * bytes written, 0 if the regions are invalid.
+ */
+gsize ringbuf_frame_copy_rois (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                               const ringbuf_frame_roi_t *rois, guint nb_rois, gpointer dst);
+
+/**
+ * ringbuf_frame_ring_pop_rois:
+ * @fr: A frame ring.
+ * @rois: Regions of interest.
+ * @nb_rois: Number of @rois.
+ * @dst: Room for ringbuf_frame_rois_size() bytes.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ *
+ * Same as ringbuf_frame_ring_pop() but only copies the given regions, see
+ * ringbuf_frame_copy_rois(). Returns FALSE without consuming a frame if the
+ * regions are invalid.
+ */
+gboolean ringbuf_frame_ring_pop_rois (ringbuf_frame_ring_t *fr, const ringbuf_frame_roi_t *rois, guint nb_rois,
+                                      gpointer dst, ringbuf_frame_meta_t *meta);
+
+#endif /* INCLUDED_RINGBUF_FRAME_H */
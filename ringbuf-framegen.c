@@ -0,0 +1,194 @@
+/*
+ * Synthetic frame generator for tests and benchmarks.
+ *
+ * Patterns are written straight into their destination, usually space
+ * reserved in a ring, with vector stores, so producers cost about as much as
+ * a memset and benchmarks measure the ring rather than the generator.
+ */
+
+#include "ringbuf-framegen.h"
+#include "ringbuf-simd.h"
+
+// Independent xorshift streams kept in flight to hide the dependency chain
+#define NOISE_STREAMS 4
+
+struct _ringbuf_framegen_t {
+    ringbuf_pattern_t pattern;
+    guint width, height;
+    guint bytes_per_pixel;
+    gsize frame_size;
+    guint64 frame;
+
+    guint32 noise[NOISE_STREAMS][RINGBUF_SIMD_BYTES / sizeof(guint32)];
+
+    guint8 *replay;
+    guint nb_replay_frames;
+};
+
+#define DEFINE_RAMP(type, vtype)                                                        \
+RINGBUF_SIMD_CLONES                                                                      \
+static void ramp_##type (type *dst, guint width, guint height, guint64 frame) {          \
+    const guint lanes = RINGBUF_SIMD_BYTES / sizeof(type);                              \
+    vtype step;                                                                          \
+    for (guint i = 0; i < lanes; i++) {                                                  \
+        step[i] = i;                                                                     \
+    }                                                                                    \
+    for (guint y = 0; y < height; y++, dst += width) {                                   \
+        type start = (type) (y + frame);                                                 \
+        vtype v = step + start;                                                          \
+        guint x = 0;                                                                     \
+        for (; x + lanes <= width; x += lanes) {                                         \
+            *(vtype *) (dst + x) = v;                                                    \
+            v += (type) lanes;                                                           \
+        }                                                                                \
+        for (; x < width; x++) {                                                         \
+            dst[x] = (type) (start + x);                                                 \
+        }                                                                                \
+    }                                                                                    \
+}
+
+DEFINE_RAMP(guint8, ringbuf_vu8)
+DEFINE_RAMP(guint16, ringbuf_vu16)
+DEFINE_RAMP(guint32, ringbuf_vu32)
+
+RINGBUF_SIMD_CLONES
+static void noise (guint32 state[NOISE_STREAMS][RINGBUF_SIMD_BYTES / sizeof(guint32)], guint8 *dst, gsize size) {
+    ringbuf_vu32 s[NOISE_STREAMS];
+    const gsize block = NOISE_STREAMS * RINGBUF_SIMD_BYTES;
+    gsize offset = 0;
+
+    for (guint i = 0; i < NOISE_STREAMS; i++) {
+        s[i] = *(ringbuf_vu32 *) state[i];
+    }
+    for (; offset < size; offset += block) {
+        for (guint i = 0; i < NOISE_STREAMS; i++) {
+            s[i] ^= s[i] << 13;
+            s[i] ^= s[i] >> 17;
+            s[i] ^= s[i] << 5;
+        }
+        if (offset + block <= size) {
+            for (guint i = 0; i < NOISE_STREAMS; i++) {
+                *(ringbuf_vu32 *) (dst + offset + i * RINGBUF_SIMD_BYTES) = s[i];
+            }
+        }
+        else {
+            memcpy (dst + offset, s, size - offset);
+        }
+    }
+    for (guint i = 0; i < NOISE_STREAMS; i++) {
+        *(ringbuf_vu32 *) state[i] = s[i];
+    }
+}
+
+static ringbuf_framegen_t *framegen_new (ringbuf_pattern_t pattern, guint width, guint height, guint bytes_per_pixel) {
+    if (width == 0 || height == 0 || (bytes_per_pixel != 1 && bytes_per_pixel != 2 && bytes_per_pixel != 4)) {
+        g_warning ("Invalid frame geometry %ux%u, %u bytes per pixel", width, height, bytes_per_pixel);
+        return NULL;
+    }
+
+    ringbuf_framegen_t *gen = g_new0 (ringbuf_framegen_t, 1);
+    gen->pattern = pattern;
+    gen->width = width;
+    gen->height = height;
+    gen->bytes_per_pixel = bytes_per_pixel;
+    gen->frame_size = (gsize) width * height * bytes_per_pixel;
+    return gen;
+}
+
+ringbuf_framegen_t *ringbuf_framegen_new (ringbuf_pattern_t pattern, guint width, guint height,
+                                          guint bytes_per_pixel, guint32 seed) {
+    if (pattern != RINGBUF_PATTERN_RAMP && pattern != RINGBUF_PATTERN_NOISE) {
+        g_warning ("Use ringbuf_framegen_new_replay() to replay frames");
+        return NULL;
+    }
+    ringbuf_framegen_t *gen = framegen_new (pattern, width, height, bytes_per_pixel);
+    if (gen == NULL) {
+        return NULL;
+    }
+
+    // Seed every lane through splitmix64, xorshift must not start from zero
+    guint64 x = seed;
+    for (guint i = 0; i < NOISE_STREAMS; i++) {
+        for (guint j = 0; j < RINGBUF_SIMD_BYTES / sizeof(guint32); j++) {
+            guint64 z = (x += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+            gen->noise[i][j] = (guint32) z != 0 ? (guint32) z : 1;
+        }
+    }
+    return gen;
+}
+
+ringbuf_framegen_t *ringbuf_framegen_new_replay (const gchar *path, guint width, guint height,
+                                                 guint bytes_per_pixel) {
+    ringbuf_framegen_t *gen = framegen_new (RINGBUF_PATTERN_REPLAY, width, height, bytes_per_pixel);
+    GError *error = NULL;
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    if (gen == NULL) {
+        return NULL;
+    }
+    if (!g_file_get_contents (path, &contents, &length, &error)) {
+        g_warning ("Could not read frames to replay: %s", error->message);
+        g_error_free (error);
+        g_free (gen);
+        return NULL;
+    }
+    if (length < gen->frame_size) {
+        g_warning ("%s holds less than one %" G_GSIZE_FORMAT " byte frame", path, gen->frame_size);
+        g_free (contents);
+        g_free (gen);
+        return NULL;
+    }
+
+    gen->replay = (guint8 *) contents;
+    gen->nb_replay_frames = length / gen->frame_size;
+    return gen;
+}
+
+void ringbuf_framegen_free (ringbuf_framegen_t *gen) {
+    if (gen == NULL) {
+        return;
+    }
+    g_free (gen->replay);
+    g_free (gen);
+}
+
+gsize ringbuf_framegen_frame_size (const ringbuf_framegen_t *gen) {
+    return gen->frame_size;
+}
+
+void ringbuf_framegen_fill (ringbuf_framegen_t *gen, gpointer dst) {
+    switch (gen->pattern) {
+    case RINGBUF_PATTERN_RAMP:
+        if (gen->bytes_per_pixel == 1) {
+            ramp_guint8 (dst, gen->width, gen->height, gen->frame);
+        }
+        else if (gen->bytes_per_pixel == 2) {
+            ramp_guint16 (dst, gen->width, gen->height, gen->frame);
+        }
+        else {
+            ramp_guint32 (dst, gen->width, gen->height, gen->frame);
+        }
+        break;
+    case RINGBUF_PATTERN_NOISE:
+        noise (gen->noise, dst, gen->frame_size);
+        break;
+    case RINGBUF_PATTERN_REPLAY:
+        memcpy (dst, gen->replay + (gen->frame % gen->nb_replay_frames) * gen->frame_size, gen->frame_size);
+        break;
+    }
+    gen->frame++;
+}
+
+gpointer ringbuf_framegen_push (ringbuf_framegen_t *gen, ringbuf_t *rb) {
+    gpointer frame = ringbuf_reserve (rb, gen->frame_size);
+    if (frame == NULL) {
+        return NULL;
+    }
+    ringbuf_framegen_fill (gen, frame);
+    ringbuf_commit (rb, gen->frame_size);
+    return frame;
+}
@@ -0,0 +1,86 @@
+#ifndef INCLUDED_RINGBUF_FRAMEGEN_H
+#define INCLUDED_RINGBUF_FRAMEGEN_H
+
+#include "ringbuf.h"
+
+typedef struct _ringbuf_framegen_t ringbuf_framegen_t;
+
+/**
+ * ringbuf_pattern_t:
+ * @RINGBUF_PATTERN_RAMP: Pixel (x, y) of frame f is x + y + f, wrapped to the
+ *   pixel width.
+ * @RINGBUF_PATTERN_NOISE: Uniform random bytes from a vectorized xorshift
+ *   generator. The sequence only depends on the seed.
+ * @RINGBUF_PATTERN_REPLAY: Frames loaded from a raw file, replayed in a loop.
+ */
+typedef enum {
+    RINGBUF_PATTERN_RAMP,
+    RINGBUF_PATTERN_NOISE,
+    RINGBUF_PATTERN_REPLAY,
+} ringbuf_pattern_t;
+
+/**
+ * ringbuf_framegen_new:
+ * @pattern: RINGBUF_PATTERN_RAMP or RINGBUF_PATTERN_NOISE.
+ * @width: Pixels per row.
+ * @height: Number of rows.
+ * @bytes_per_pixel: 1, 2 or 4.
+ * @seed: Seed of the noise generator, ignored by the ramp.
+ *
+ * Creates a synthetic frame generator. Frames are written directly to their
+ * destination, nothing is allocated per frame. Returns NULL on invalid
+ * arguments.
+ */
+ringbuf_framegen_t *ringbuf_framegen_new (ringbuf_pattern_t pattern, guint width, guint height,
+                                          guint bytes_per_pixel, guint32 seed);
+
+/**
+ * ringbuf_framegen_new_replay:
+ * @path: Raw file holding one or more frames back to back, as written by
+ *   example/image_to_bin.py from the images in example/data.
+ * @width: Pixels per row.
+ * @height: Number of rows.
+ * @bytes_per_pixel: 1, 2 or 4.
+ *
+ * Creates a generator replaying the frames of @path in a loop. A trailing
+ * partial frame is ignored. Returns NULL if the file cannot be read or holds
+ * less than one frame.
+ */
+ringbuf_framegen_t *ringbuf_framegen_new_replay (const gchar *path, guint width, guint height,
+                                                 guint bytes_per_pixel);
+
+/**
+ * ringbuf_framegen_free:
+ * @gen: A frame generator.
+ */
+void ringbuf_framegen_free (ringbuf_framegen_t *gen);
+
+/**
+ * ringbuf_framegen_frame_size:
+ * @gen: A frame generator.
+ *
+ * Returns the size of one frame in bytes.
+ */
+gsize ringbuf_framegen_frame_size (const ringbuf_framegen_t *gen);
+
+/**
+ * ringbuf_framegen_fill:
+ * @gen: A frame generator.
+ * @dst: At least ringbuf_framegen_frame_size() writable bytes.
+ *
+ * Writes the next frame to @dst and advances the frame counter.
+ */
+void ringbuf_framegen_fill (ringbuf_framegen_t *gen, gpointer dst);
+
+/**
+ * ringbuf_framegen_push:
+ * @gen: A frame generator.
+ * @rb: The ring buffer to write to.
+ *
+ * Reserves one frame in @rb, generates it in place and commits it. Only one
+ * thread may write to @rb this way. Returns the frame in the ring, or NULL if
+ * a non-blocking ring had no room.
+ */
+gpointer ringbuf_framegen_push (ringbuf_framegen_t *gen, ringbuf_t *rb);
+
+#endif /* INCLUDED_RINGBUF_FRAMEGEN_H */
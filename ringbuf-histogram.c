@@ -0,0 +1,226 @@
+/*
+ * Intensity histogram stage for frame rings.
+ *
+ * Binning keeps four replicated sub-histograms and spreads consecutive pixels
+ * over them, so runs of equal pixels do not serialize on a store-to-load
+ * dependency through the same counter. Large frames are split in tiles of
+ * rows handled by a thread pool, each tile with its own sub-histograms. The
+ * copies are summed and cleared with vector adds at the end.
+ */
+
+#include "ringbuf-histogram.h"
+#include "ringbuf-simd.h"
+#include "ringbuf-tiles.h"
+
+#define SUB_HISTOGRAMS 4
+
+// Frames smaller than this stay on the calling thread
+#define TILE_MIN_PIXELS (256 * 1024)
+
+struct _ringbuf_histogram_stage_t {
+    ringbuf_frame_geometry_t geometry;
+    guint bits, shift, nb_bins;
+
+    // SUB_HISTOGRAMS copies per thread, kept zeroed between frames
+    guint32 *sub;
+    ringbuf_tiles_t *tiles;
+    gconstpointer pixels;
+
+    ringbuf_t *side;
+    gsize record_size;
+};
+
+// Stamped in front of every histogram in the side ring
+typedef struct {
+    guint64 sequence;
+} record_header_t;
+
+#define DEFINE_HISTOGRAM(type)                                                           \
+static void histogram_##type (const type *src, gsize n, guint shift, guint nb_bins,      \
+                              guint32 *sub) {                                            \
+    guint32 *h0 = sub, *h1 = sub + nb_bins, *h2 = sub + 2 * nb_bins, *h3 = sub + 3 * nb_bins; \
+    gsize i = 0;                                                                         \
+    for (; i + 4 <= n; i += 4) {                                                         \
+        h0[src[i] >> shift]++;                                                           \
+        h1[src[i + 1] >> shift]++;                                                       \
+        h2[src[i + 2] >> shift]++;                                                       \
+        h3[src[i + 3] >> shift]++;                                                       \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        h0[src[i] >> shift]++;                                                           \
+    }                                                                                    \
+}
+
+DEFINE_HISTOGRAM(guint8)
+DEFINE_HISTOGRAM(guint16)
+DEFINE_HISTOGRAM(guint32)
+
+static void histogram_pixels (guint bytes_per_pixel, gconstpointer pixels, gsize n, guint shift, guint nb_bins,
+                              guint32 *sub) {
+    switch (bytes_per_pixel) {
+    case 1:
+        histogram_guint8 (pixels, n, shift, nb_bins, sub);
+        break;
+    case 2:
+        histogram_guint16 (pixels, n, shift, nb_bins, sub);
+        break;
+    default:
+        histogram_guint32 (pixels, n, shift, nb_bins, sub);
+        break;
+    }
+}
+
+// Sums @nb_copies histograms into @bins and zeroes them for the next frame
+RINGBUF_SIMD_CLONES
+static void merge_and_clear (guint32 *sub, guint nb_copies, guint nb_bins, guint32 *bins) {
+    const guint lanes = RINGBUF_SIMD_BYTES / sizeof(guint32);
+    const ringbuf_vu32 zero = {0};
+    guint b = 0;
+
+    for (; b + lanes <= nb_bins; b += lanes) {
+        ringbuf_vu32 sum = zero;
+        for (guint c = 0; c < nb_copies; c++) {
+            ringbuf_vu32 *copy = (ringbuf_vu32 *) (sub + (gsize) c * nb_bins + b);
+            sum += *copy;
+            *copy = zero;
+        }
+        *(ringbuf_vu32 *) (bins + b) = sum;
+    }
+    for (; b < nb_bins; b++) {
+        guint32 sum = 0;
+        for (guint c = 0; c < nb_copies; c++) {
+            sum += sub[(gsize) c * nb_bins + b];
+            sub[(gsize) c * nb_bins + b] = 0;
+        }
+        bins[b] = sum;
+    }
+}
+
+static gboolean check_bits (const ringbuf_frame_geometry_t *geometry, guint bits) {
+    guint bpp = geometry->bytes_per_pixel;
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || bits == 0 || bits > RINGBUF_HISTOGRAM_MAX_BITS || bits > 8 * bpp) {
+        g_warning ("Invalid histogram of %u bits for %u byte pixels", bits, bpp);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void ringbuf_histogram_compute (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                guint bits, guint32 *bins) {
+    if (!check_bits (geometry, bits)) {
+        return;
+    }
+    guint nb_bins = 1 << bits;
+    guint32 *sub = g_new0 (guint32, (gsize) SUB_HISTOGRAMS * nb_bins);
+
+    histogram_pixels (geometry->bytes_per_pixel, pixels, (gsize) geometry->width * geometry->height,
+                      8 * geometry->bytes_per_pixel - bits, nb_bins, sub);
+    merge_and_clear (sub, SUB_HISTOGRAMS, nb_bins, bins);
+    g_free (sub);
+}
+
+static void histogram_tile (guint tile, guint first_row, guint nb_rows, gpointer user_data) {
+    ringbuf_histogram_stage_t *stage = user_data;
+    const ringbuf_frame_geometry_t *geometry = &stage->geometry;
+
+    histogram_pixels (geometry->bytes_per_pixel,
+                      (const guint8 *) stage->pixels + (gsize) first_row * geometry->width * geometry->bytes_per_pixel,
+                      (gsize) nb_rows * geometry->width, stage->shift, stage->nb_bins,
+                      stage->sub + (gsize) tile * SUB_HISTOGRAMS * stage->nb_bins);
+}
+
+ringbuf_histogram_stage_t *ringbuf_histogram_stage_new (const ringbuf_frame_geometry_t *geometry, guint bits,
+                                                        guint nb_threads, guint depth) {
+    if (!check_bits (geometry, bits) || nb_threads == 0 || depth == 0) {
+        return NULL;
+    }
+
+    ringbuf_histogram_stage_t *stage = g_new0 (ringbuf_histogram_stage_t, 1);
+    stage->geometry = *geometry;
+    stage->bits = bits;
+    stage->shift = 8 * geometry->bytes_per_pixel - bits;
+    stage->nb_bins = 1 << bits;
+    stage->sub = g_new0 (guint32, (gsize) nb_threads * SUB_HISTOGRAMS * stage->nb_bins);
+    stage->tiles = ringbuf_tiles_new (nb_threads);
+
+    stage->record_size = sizeof(record_header_t) + stage->nb_bins * sizeof(guint32);
+    stage->side = ringbuf_new_named ("histograms", depth * stage->record_size, FALSE);
+    if (stage->side == NULL) {
+        ringbuf_histogram_stage_free (stage);
+        return NULL;
+    }
+    return stage;
+}
+
+void ringbuf_histogram_stage_free (ringbuf_histogram_stage_t *stage) {
+    if (stage == NULL) {
+        return;
+    }
+    if (stage->side != NULL) {
+        ringbuf_free (stage->side);
+    }
+    ringbuf_tiles_free (stage->tiles);
+    g_free (stage->sub);
+    g_free (stage);
+}
+
+guint ringbuf_histogram_stage_nb_bins (const ringbuf_histogram_stage_t *stage) {
+    return stage->nb_bins;
+}
+
+gboolean ringbuf_histogram_stage_process (ringbuf_histogram_stage_t *stage, gconstpointer pixels,
+                                          ringbuf_frame_meta_t *meta) {
+    const ringbuf_frame_geometry_t *geometry = &stage->geometry;
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+    guint nb_tiles = nb_pixels < TILE_MIN_PIXELS ? 1 : ringbuf_tiles_nb_threads (stage->tiles);
+
+    stage->pixels = pixels;
+    nb_tiles = ringbuf_tiles_run (stage->tiles, geometry->height, nb_tiles, histogram_tile, stage);
+
+    // Merge straight into the side ring, or just clear if there is no room
+    guint8 *record = ringbuf_reserve (stage->side, stage->record_size);
+    if (record == NULL) {
+        memset (stage->sub, 0, (gsize) nb_tiles * SUB_HISTOGRAMS * stage->nb_bins * sizeof(guint32));
+        return FALSE;
+    }
+    record_header_t header = { meta->sequence };
+    memcpy (record, &header, sizeof(header));
+    merge_and_clear (stage->sub, nb_tiles * SUB_HISTOGRAMS, stage->nb_bins,
+                     (guint32 *) (record + sizeof(header)));
+    ringbuf_commit (stage->side, stage->record_size);
+
+    meta->flags |= RINGBUF_FRAME_META_HISTOGRAM;
+    return TRUE;
+}
+
+static void histogram_stage_run (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                 ringbuf_frame_meta_t *meta, gpointer user_data) {
+    (void) geometry;
+    ringbuf_histogram_stage_process (user_data, pixels, meta);
+}
+
+void ringbuf_histogram_stage_attach (ringbuf_histogram_stage_t *stage, ringbuf_frame_ring_t *fr) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (fr);
+    if (geometry->width != stage->geometry.width || geometry->height != stage->geometry.height ||
+        geometry->bytes_per_pixel != stage->geometry.bytes_per_pixel) {
+        g_warning ("Histogram stage and frame ring geometries differ");
+        return;
+    }
+    ringbuf_frame_ring_add_stage (fr, histogram_stage_run, stage);
+}
+
+gboolean ringbuf_histogram_stage_pop (ringbuf_histogram_stage_t *stage, guint64 *sequence, guint32 *bins,
+                                      guint64 timeout) {
+    record_header_t header;
+
+    if (ringbuf_wait_for_data_timed (stage->side, stage->record_size, timeout) == 0) {
+        return FALSE;
+    }
+    const guint8 *record = ringbuf_tail (stage->side);
+    memcpy (&header, record, sizeof(header));
+    memcpy (bins, record + sizeof(header), stage->nb_bins * sizeof(guint32));
+    ringbuf_move_tail (stage->side, stage->record_size);
+
+    *sequence = header.sequence;
+    return TRUE;
+}
@@ -0,0 +1,87 @@
+#ifndef INCLUDED_RINGBUF_HISTOGRAM_H
+#define INCLUDED_RINGBUF_HISTOGRAM_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_histogram_stage_t ringbuf_histogram_stage_t;
+
+/* Largest supported histogram, one bin per 16-bit intensity. */
+#define RINGBUF_HISTOGRAM_MAX_BITS 16
+
+/**
+ * ringbuf_histogram_compute:
+ * @geometry: Layout of @pixels.
+ * @pixels: One frame.
+ * @bits: log2 of the number of bins, at most RINGBUF_HISTOGRAM_MAX_BITS and
+ *   the pixel width. Pixels wider than @bits keep their top @bits bits.
+ * @bins: 2^@bits counters, overwritten.
+ *
+ * Computes the intensity histogram of one frame on the calling thread.
+ */
+void ringbuf_histogram_compute (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                guint bits, guint32 *bins);
+
+/**
+ * ringbuf_histogram_stage_new:
+ * @geometry: Layout of the frames.
+ * @bits: log2 of the number of bins, see ringbuf_histogram_compute().
+ * @nb_threads: Threads sharing large frames by tiles of rows, 1 to stay on
+ *   the caller's thread.
+ * @depth: Number of histograms the side ring holds before dropping.
+ *
+ * Creates a histogram stage. Histograms are published to a non-blocking side
+ * ring, so a slow reader loses histograms instead of stalling the frames.
+ * Returns NULL on invalid arguments.
+ */
+ringbuf_histogram_stage_t *ringbuf_histogram_stage_new (const ringbuf_frame_geometry_t *geometry, guint bits,
+                                                        guint nb_threads, guint depth);
+
+/**
+ * ringbuf_histogram_stage_free:
+ * @stage: A histogram stage, detached from any frame ring.
+ */
+void ringbuf_histogram_stage_free (ringbuf_histogram_stage_t *stage);
+
+/**
+ * ringbuf_histogram_stage_nb_bins:
+ * @stage: A histogram stage.
+ *
+ * Returns the number of bins of each histogram.
+ */
+guint ringbuf_histogram_stage_nb_bins (const ringbuf_histogram_stage_t *stage);
+
+/**
+ * ringbuf_histogram_stage_attach:
+ * @stage: A histogram stage.
+ * @fr: A frame ring with the same geometry.
+ *
+ * Runs the stage on every frame produced into @fr. Frames whose histogram
+ * was published get RINGBUF_FRAME_META_HISTOGRAM in their metadata.
+ */
+void ringbuf_histogram_stage_attach (ringbuf_histogram_stage_t *stage, ringbuf_frame_ring_t *fr);
+
+/**
+ * ringbuf_histogram_stage_process:
+ * @stage: A histogram stage.
+ * @pixels: One frame.
+ * @meta: The frame's metadata, its @sequence tags the histogram.
+ *
+ * Computes and publishes the histogram of one frame, for use outside of a
+ * frame ring. Returns FALSE if the side ring was full and it was dropped.
+ */
+gboolean ringbuf_histogram_stage_process (ringbuf_histogram_stage_t *stage, gconstpointer pixels,
+                                          ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_histogram_stage_pop:
+ * @stage: A histogram stage.
+ * @sequence: Set to the sequence number of the frame.
+ * @bins: Room for ringbuf_histogram_stage_nb_bins() counters.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Reads the oldest published histogram. Returns FALSE on timeout.
+ */
+gboolean ringbuf_histogram_stage_pop (ringbuf_histogram_stage_t *stage, guint64 *sequence, guint32 *bins,
+                                      guint64 timeout);
+
+#endif /* INCLUDED_RINGBUF_HISTOGRAM_H */
@@ -0,0 +1,648 @@
+/*
+ * Asynchronous logging through per-thread rings.
+ *
+ * A log call parses nothing and formats nothing: the format of each call site
+ * is split into conversions once, then every call copies its raw arguments
+ * next to the address of the site and pushes the record into a ring owned by
+ * the calling thread. Rings do not block, so a thread logging faster than the
+ * logger drains loses messages instead of stalling, and the loss is reported.
+ * The logger's thread wakes up periodically rather than being signalled,
+ * which would cost the caller a syscall, and formats each conversion with
+ * the value read in place from the ring.
+ */
+
+#include "ringbuf-log.h"
+#include <errno.h>
+#include <sys/prctl.h>
+#include <time.h>
+
+// How often the logger's thread drains the rings, they must hold this much logging
+#define DRAIN_INTERVAL (10 * G_TIME_SPAN_MILLISECOND)
+
+// Conversions, stars included, one call can carry. Formats with more are formatted by the caller.
+#define MAX_VALUES 16
+
+// Longest string argument copied, in bytes
+#define STRING_MAX 256
+
+typedef enum {
+    ARG_NONE,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+} arg_type_t;
+
+// Literal text followed by at most one conversion
+typedef struct {
+    gchar *format;
+    arg_type_t type;
+    guint nb_stars;
+} segment_t;
+
+typedef struct {
+    // The caller formats the message and sends it as a single string
+    gboolean preformatted;
+    guint nb_values;
+    // Room for the stars of a conversion found to be one too many
+    arg_type_t types[MAX_VALUES + 2];
+    guint nb_segments;
+    segment_t *segments;
+} log_format_t;
+
+// One argument. Strings take a value holding their length, then their bytes and NUL in the next ones.
+typedef union {
+    gint64 i;
+    long l;
+    long long ll;
+    intmax_t j;
+    gsize z;
+    ptrdiff_t t;
+    gdouble d;
+    gpointer p;
+} log_value_t;
+
+typedef struct {
+    gsize size;
+    gint64 timestamp;
+    const ringbuf_log_site_t *site;
+} record_t;
+
+G_STATIC_ASSERT (sizeof(log_value_t) == 8);
+G_STATIC_ASSERT (sizeof(record_t) % sizeof(log_value_t) == 0);
+
+#define RECORD_MAX (sizeof(record_t) + MAX_VALUES * (sizeof(log_value_t) + STRING_MAX + sizeof(log_value_t)))
+
+typedef struct {
+    // Only compared once @closed is set
+    ringbuf_logger_t *logger;
+    ringbuf_t *rb;
+    gchar *thread;
+    // Drops already reported
+    guint64 dropped;
+    gint ref;
+    // The thread exited, or the logger was freed
+    gint orphaned, closed;
+} log_ring_t;
+
+typedef struct {
+    GPtrArray *rings;
+    log_ring_t *last;
+} thread_rings_t;
+
+struct _ringbuf_logger_t {
+    gsize ring_size;
+    FILE *file;
+
+    // Protects @rings, @stop and @wake
+    GMutex lock;
+    GPtrArray *rings;
+    gboolean stop;
+    GCond wake;
+    GThread *thread;
+
+    // One drain at a time, by the thread or ringbuf_logger_flush()
+    GMutex drain_lock;
+    GString *message;
+    guint64 nb_dropped;
+};
+
+static void thread_rings_free (gpointer data);
+
+static GPrivate thread_rings = G_PRIVATE_INIT (thread_rings_free);
+
+static arg_type_t integer_type (const gchar *length) {
+    if (length[0] == 'l' && length[1] == 'l') {
+        return ARG_LLONG;
+    }
+    switch (length[0]) {
+    case 'l':
+        return ARG_LONG;
+    case 'q':
+        return ARG_LLONG;
+    case 'j':
+        return ARG_INTMAX;
+    case 'z':
+        return ARG_SIZE;
+    case 't':
+        return ARG_PTRDIFF;
+    default:
+        return ARG_INT;
+    }
+}
+
+/* Type of the conversion @c with length modifier @length, ARG_NONE if
+ * records cannot carry it.
+ */
+static arg_type_t conversion_type (gchar c, const gchar *length) {
+    switch (c) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        return integer_type (length);
+    case 'c':
+        return length[0] == '\0' ? ARG_INT : ARG_NONE;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        return length[0] == '\0' || (length[0] == 'l' && length[1] == '\0') ? ARG_DOUBLE : ARG_NONE;
+    case 's':
+        return length[0] == '\0' ? ARG_STRING : ARG_NONE;
+    case 'p':
+        return length[0] == '\0' ? ARG_POINTER : ARG_NONE;
+    default:
+        // %n, %m, positional arguments, wide characters
+        return ARG_NONE;
+    }
+}
+
+static void add_segment (GArray *segments, const gchar *start, gsize length, arg_type_t type, guint nb_stars) {
+    segment_t segment = { g_strndup (start, length), type, nb_stars };
+    g_array_append_val (segments, segment);
+}
+
+/* Splits @format into segments, or returns FALSE if one of its conversions
+ * cannot be recorded.
+ */
+static gboolean parse_format (log_format_t *parsed, const gchar *format) {
+    GArray *segments = g_array_new (FALSE, FALSE, sizeof(segment_t));
+    const gchar *start = format, *p = format;
+
+    while (*p != '\0') {
+        if (*p != '%') {
+            p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+
+        guint nb_stars = 0;
+        gchar length[3] = "";
+        const gchar *q = p + 1;
+        while (*q != '\0' && strchr ("-+ #0'", *q) != NULL) {
+            q++;
+        }
+        if (*q == '*') {
+            parsed->types[parsed->nb_values + nb_stars++] = ARG_INT;
+            q++;
+        }
+        while (g_ascii_isdigit (*q)) {
+            q++;
+        }
+        if (*q == '.') {
+            q++;
+            if (*q == '*') {
+                parsed->types[parsed->nb_values + nb_stars++] = ARG_INT;
+                q++;
+            }
+            while (g_ascii_isdigit (*q)) {
+                q++;
+            }
+        }
+        for (guint i = 0; i < 2 && *q != '\0' && strchr ("hlLqjzt", *q) != NULL; i++) {
+            length[i] = *q++;
+        }
+
+        arg_type_t type = conversion_type (*q, length);
+        if (type == ARG_NONE || parsed->nb_values + nb_stars + 1 > MAX_VALUES || length[0] == 'L') {
+            for (guint i = 0; i < segments->len; i++) {
+                g_free (g_array_index (segments, segment_t, i).format);
+            }
+            g_array_free (segments, TRUE);
+            return FALSE;
+        }
+        parsed->nb_values += nb_stars;
+        parsed->types[parsed->nb_values++] = type;
+        p = q + 1;
+        add_segment (segments, start, p - start, type, nb_stars);
+        start = p;
+    }
+
+    // Trailing text is appended as is, so its %% are unescaped here
+    if (*start != '\0') {
+        GString *text = g_string_new (NULL);
+        for (p = start; *p != '\0'; p++) {
+            g_string_append_c (text, *p);
+            if (p[0] == '%' && p[1] == '%') {
+                p++;
+            }
+        }
+        add_segment (segments, text->str, text->len, ARG_NONE, 0);
+        g_string_free (text, TRUE);
+    }
+
+    parsed->nb_segments = segments->len;
+    parsed->segments = (segment_t *) g_array_free (segments, FALSE);
+    return TRUE;
+}
+
+// Parsed once per call site and kept for the life of the program, like the site itself
+static const log_format_t *site_format (ringbuf_log_site_t *site) {
+    if (g_once_init_enter (&site->parsed)) {
+        log_format_t *parsed = g_new0 (log_format_t, 1);
+        if (!parse_format (parsed, site->format)) {
+            memset (parsed, 0, sizeof(*parsed));
+            parsed->preformatted = TRUE;
+            parsed->nb_values = 1;
+            parsed->types[0] = ARG_STRING;
+            parsed->nb_segments = 1;
+            parsed->segments = g_new (segment_t, 1);
+            parsed->segments[0] = (segment_t) { g_strdup ("%s"), ARG_STRING, 0 };
+        }
+        g_once_init_leave (&site->parsed, (gsize) parsed);
+    }
+    return (const log_format_t *) site->parsed;
+}
+
+static void log_ring_unref (log_ring_t *lr) {
+    if (g_atomic_int_dec_and_test (&lr->ref)) {
+        ringbuf_free (lr->rb);
+        g_free (lr->thread);
+        g_free (lr);
+    }
+}
+
+static void thread_rings_free (gpointer data) {
+    thread_rings_t *tr = data;
+    for (guint i = 0; i < tr->rings->len; i++) {
+        log_ring_t *lr = g_ptr_array_index (tr->rings, i);
+        g_atomic_int_set (&lr->orphaned, TRUE);
+        log_ring_unref (lr);
+    }
+    g_ptr_array_free (tr->rings, TRUE);
+    g_free (tr);
+}
+
+static log_ring_t *thread_ring_slow (ringbuf_logger_t *logger) {
+    thread_rings_t *tr = g_private_get (&thread_rings);
+    log_ring_t *lr;
+
+    if (tr == NULL) {
+        tr = g_new0 (thread_rings_t, 1);
+        tr->rings = g_ptr_array_new ();
+        g_private_set (&thread_rings, tr);
+    }
+    tr->last = NULL;
+
+    // Forget the rings of freed loggers, whose address may have been reused
+    for (guint i = 0; i < tr->rings->len;) {
+        lr = g_ptr_array_index (tr->rings, i);
+        if (g_atomic_int_get (&lr->closed)) {
+            g_ptr_array_remove_index_fast (tr->rings, i);
+            log_ring_unref (lr);
+            continue;
+        }
+        if (lr->logger == logger) {
+            tr->last = lr;
+            return lr;
+        }
+        i++;
+    }
+
+    gchar name[16] = "";
+    if (prctl (PR_GET_NAME, name) != 0 || name[0] == '\0') {
+        g_snprintf (name, sizeof(name), "%lu", (gulong) syscall (SYS_gettid));
+    }
+    gchar *ring_name = g_strdup_printf ("log-%s", name);
+    ringbuf_t *rb = ringbuf_new_named (ring_name, logger->ring_size, FALSE);
+    g_free (ring_name);
+    if (rb == NULL) {
+        return NULL;
+    }
+
+    // One reference for the thread, one for the logger
+    lr = g_new0 (log_ring_t, 1);
+    lr->logger = logger;
+    lr->rb = rb;
+    lr->thread = g_strdup (name);
+    lr->ref = 2;
+    g_ptr_array_add (tr->rings, lr);
+    g_mutex_lock (&logger->lock);
+    g_ptr_array_add (logger->rings, lr);
+    g_mutex_unlock (&logger->lock);
+
+    tr->last = lr;
+    return lr;
+}
+
+static inline log_ring_t *thread_ring (ringbuf_logger_t *logger) {
+    thread_rings_t *tr = g_private_get (&thread_rings);
+    if (G_LIKELY (tr != NULL && tr->last != NULL && tr->last->logger == logger &&
+                  !g_atomic_int_get (&tr->last->closed))) {
+        return tr->last;
+    }
+    return thread_ring_slow (logger);
+}
+
+void ringbuf_log_write (ringbuf_logger_t *logger, ringbuf_log_site_t *site, const gchar *format, ...) {
+    const log_format_t *parsed = site_format (site);
+    log_ring_t *lr = thread_ring (logger);
+    log_value_t buffer[RECORD_MAX / sizeof(log_value_t)];
+    record_t *record = (record_t *) buffer;
+    log_value_t *v = (log_value_t *) (record + 1);
+    va_list args;
+
+    if (lr == NULL) {
+        return;
+    }
+
+    va_start (args, format);
+    if (parsed->preformatted) {
+        gchar *text = (gchar *) (v + 1);
+        gsize room = sizeof(buffer) - ((guint8 *) text - (guint8 *) buffer);
+        gint length = g_vsnprintf (text, room, format, args);
+        v->z = MIN ((gsize) MAX (length, 0), room - 1);
+        v += 1 + (v->z + sizeof(log_value_t)) / sizeof(log_value_t);
+    }
+    else {
+        for (guint i = 0; i < parsed->nb_values; i++) {
+            switch (parsed->types[i]) {
+            case ARG_INT:
+                v->i = va_arg (args, gint);
+                break;
+            case ARG_LONG:
+                v->l = va_arg (args, long);
+                break;
+            case ARG_LLONG:
+                v->ll = va_arg (args, long long);
+                break;
+            case ARG_INTMAX:
+                v->j = va_arg (args, intmax_t);
+                break;
+            case ARG_SIZE:
+                v->z = va_arg (args, gsize);
+                break;
+            case ARG_PTRDIFF:
+                v->t = va_arg (args, ptrdiff_t);
+                break;
+            case ARG_DOUBLE:
+                v->d = va_arg (args, gdouble);
+                break;
+            case ARG_POINTER:
+                v->p = va_arg (args, gpointer);
+                break;
+            case ARG_STRING: {
+                const gchar *s = va_arg (args, const gchar *);
+                if (s == NULL) {
+                    s = "(null)";
+                }
+                v->z = strnlen (s, STRING_MAX);
+                memcpy (v + 1, s, v->z);
+                ((gchar *) (v + 1))[v->z] = '\0';
+                v += (v->z + sizeof(log_value_t)) / sizeof(log_value_t);
+                break;
+            }
+            default:
+                break;
+            }
+            v++;
+        }
+    }
+    va_end (args);
+
+    record->size = (guint8 *) v - (guint8 *) buffer;
+    record->timestamp = g_get_real_time ();
+    record->site = site;
+    ringbuf_push (lr->rb, buffer, record->size);
+}
+
+#define APPEND(out, segment, stars, value)                                               \
+    G_STMT_START {                                                                       \
+        if ((segment)->nb_stars == 0) {                                                  \
+            g_string_append_printf (out, (segment)->format, value);                      \
+        }                                                                                \
+        else if ((segment)->nb_stars == 1) {                                             \
+            g_string_append_printf (out, (segment)->format, (stars)[0], value);          \
+        }                                                                                \
+        else {                                                                           \
+            g_string_append_printf (out, (segment)->format, (stars)[0], (stars)[1], value); \
+        }                                                                                \
+    } G_STMT_END
+
+static void format_record (GString *out, const record_t *record) {
+    const log_format_t *parsed = (const log_format_t *) record->site->parsed;
+    const log_value_t *v = (const log_value_t *) (record + 1);
+
+    for (guint s = 0; s < parsed->nb_segments; s++) {
+        const segment_t *segment = &parsed->segments[s];
+        gint stars[2] = {0, 0};
+
+        for (guint i = 0; i < segment->nb_stars; i++) {
+            stars[i] = (gint) (v++)->i;
+        }
+        switch (segment->type) {
+        case ARG_NONE:
+            g_string_append (out, segment->format);
+            continue;
+        case ARG_INT:
+            APPEND (out, segment, stars, (gint) v->i);
+            break;
+        case ARG_LONG:
+            APPEND (out, segment, stars, v->l);
+            break;
+        case ARG_LLONG:
+            APPEND (out, segment, stars, v->ll);
+            break;
+        case ARG_INTMAX:
+            APPEND (out, segment, stars, v->j);
+            break;
+        case ARG_SIZE:
+            APPEND (out, segment, stars, v->z);
+            break;
+        case ARG_PTRDIFF:
+            APPEND (out, segment, stars, v->t);
+            break;
+        case ARG_DOUBLE:
+            APPEND (out, segment, stars, v->d);
+            break;
+        case ARG_POINTER:
+            APPEND (out, segment, stars, v->p);
+            break;
+        case ARG_STRING:
+            APPEND (out, segment, stars, (const gchar *) (v + 1));
+            v += (v->z + sizeof(log_value_t)) / sizeof(log_value_t);
+            break;
+        }
+        v++;
+    }
+}
+
+static const gchar *level_name (GLogLevelFlags level) {
+    switch (level & G_LOG_LEVEL_MASK) {
+    case G_LOG_LEVEL_ERROR:
+        return "ERROR";
+    case G_LOG_LEVEL_CRITICAL:
+        return "CRITICAL";
+    case G_LOG_LEVEL_WARNING:
+        return "WARNING";
+    case G_LOG_LEVEL_MESSAGE:
+        return "Message";
+    case G_LOG_LEVEL_INFO:
+        return "INFO";
+    default:
+        return "DEBUG";
+    }
+}
+
+static void emit (ringbuf_logger_t *logger, const gchar *domain, GLogLevelFlags level, const gchar *file, gint line,
+                  gint64 timestamp, const gchar *thread, const gchar *message) {
+    // The message is long gone by now, aborting the logger's thread would not help
+    if (level & G_LOG_LEVEL_ERROR) {
+        level = G_LOG_LEVEL_CRITICAL;
+    }
+    level &= G_LOG_LEVEL_MASK;
+
+    if (logger->file != NULL) {
+        time_t seconds = timestamp / G_USEC_PER_SEC;
+        struct tm tm;
+        gchar date[32];
+        localtime_r (&seconds, &tm);
+        strftime (date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+        fprintf (logger->file, "%s.%06d [%s] %s%s%s: %s\n", date, (gint) (timestamp % G_USEC_PER_SEC), thread,
+                 domain != NULL ? domain : "", domain != NULL ? "-" : "", level_name (level), message);
+        return;
+    }
+
+#if GLIB_CHECK_VERSION(2, 50, 0)
+    gchar code_line[16], time_text[24];
+    g_snprintf (code_line, sizeof(code_line), "%d", line);
+    g_snprintf (time_text, sizeof(time_text), "%" G_GINT64_FORMAT, timestamp);
+    GLogField fields[] = {
+        { "MESSAGE", message, -1 },
+        { "CODE_FILE", file, -1 },
+        { "CODE_LINE", code_line, -1 },
+        { "RINGBUF_THREAD", thread, -1 },
+        { "RINGBUF_TIMESTAMP", time_text, -1 },
+        { "GLIB_DOMAIN", domain, -1 },
+    };
+    g_log_structured_array (level, fields, G_N_ELEMENTS(fields) - (domain == NULL));
+#else
+    (void) file, (void) line;
+    g_log (domain, level, "[%s] %s", thread, message);
+#endif
+}
+
+static void drain_ring (ringbuf_logger_t *logger, log_ring_t *lr) {
+    ringbuf_stats_t stats;
+
+    while (ringbuf_bytes_used (lr->rb) >= sizeof(record_t)) {
+        const record_t *record = ringbuf_tail (lr->rb);
+        const ringbuf_log_site_t *site = record->site;
+        g_string_truncate (logger->message, 0);
+        format_record (logger->message, record);
+        emit (logger, site->domain, site->level, site->file, site->line, record->timestamp, lr->thread,
+              logger->message->str);
+        ringbuf_move_tail (lr->rb, record->size);
+    }
+
+    ringbuf_get_stats (lr->rb, &stats);
+    if (stats.drops > lr->dropped) {
+        guint64 n = stats.drops - lr->dropped;
+        gchar *message = g_strdup_printf ("%" G_GUINT64_FORMAT " messages dropped, the ring is too small", n);
+        emit (logger, G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, __FILE__, __LINE__, g_get_real_time (), lr->thread,
+              message);
+        g_free (message);
+        lr->dropped = stats.drops;
+        __atomic_store_n (&logger->nb_dropped, logger->nb_dropped + n, __ATOMIC_RELAXED);
+    }
+}
+
+void ringbuf_logger_flush (ringbuf_logger_t *logger) {
+    g_mutex_lock (&logger->drain_lock);
+
+    g_mutex_lock (&logger->lock);
+    guint nb_rings = logger->rings->len;
+    log_ring_t **rings = g_new (log_ring_t *, nb_rings);
+    memcpy (rings, logger->rings->pdata, nb_rings * sizeof(*rings));
+    g_mutex_unlock (&logger->lock);
+
+    // Only this function removes rings, so the snapshot stays valid
+    for (guint i = 0; i < nb_rings; i++) {
+        log_ring_t *lr = rings[i];
+        // Read before draining: a thread logs nothing after it exits
+        gboolean orphaned = g_atomic_int_get (&lr->orphaned);
+        drain_ring (logger, lr);
+        if (orphaned) {
+            g_mutex_lock (&logger->lock);
+            g_ptr_array_remove_fast (logger->rings, lr);
+            g_mutex_unlock (&logger->lock);
+            log_ring_unref (lr);
+        }
+    }
+    g_free (rings);
+
+    if (logger->file != NULL) {
+        fflush (logger->file);
+    }
+    g_mutex_unlock (&logger->drain_lock);
+}
+
+static gpointer logger_thread (gpointer data) {
+    ringbuf_logger_t *logger = data;
+
+    g_mutex_lock (&logger->lock);
+    while (!logger->stop) {
+        g_mutex_unlock (&logger->lock);
+        ringbuf_logger_flush (logger);
+        g_mutex_lock (&logger->lock);
+        if (!logger->stop) {
+            g_cond_wait_until (&logger->wake, &logger->lock, g_get_monotonic_time () + DRAIN_INTERVAL);
+        }
+    }
+    g_mutex_unlock (&logger->lock);
+    return NULL;
+}
+
+ringbuf_logger_t *ringbuf_logger_new (gsize ring_size, const gchar *path) {
+    FILE *file = NULL;
+
+    if (path != NULL && (file = fopen (path, "a")) == NULL) {
+        g_warning ("Cannot open log file %s: %s", path, g_strerror (errno));
+        return NULL;
+    }
+
+    ringbuf_logger_t *logger = g_new0 (ringbuf_logger_t, 1);
+    logger->ring_size = ring_size;
+    logger->file = file;
+    logger->rings = g_ptr_array_new ();
+    logger->message = g_string_new (NULL);
+    g_mutex_init (&logger->lock);
+    g_mutex_init (&logger->drain_lock);
+    g_cond_init (&logger->wake);
+    logger->thread = g_thread_new ("logger", logger_thread, logger);
+    return logger;
+}
+
+void ringbuf_logger_free (ringbuf_logger_t *logger) {
+    if (logger == NULL) {
+        return;
+    }
+    g_mutex_lock (&logger->lock);
+    logger->stop = TRUE;
+    g_cond_signal (&logger->wake);
+    g_mutex_unlock (&logger->lock);
+    g_thread_join (logger->thread);
+    ringbuf_logger_flush (logger);
+
+    for (guint i = 0; i < logger->rings->len; i++) {
+        log_ring_t *lr = g_ptr_array_index (logger->rings, i);
+        g_atomic_int_set (&lr->closed, TRUE);
+        log_ring_unref (lr);
+    }
+    g_ptr_array_free (logger->rings, TRUE);
+    if (logger->file != NULL) {
+        fclose (logger->file);
+    }
+    g_string_free (logger->message, TRUE);
+    g_cond_clear (&logger->wake);
+    g_mutex_clear (&logger->drain_lock);
+    g_mutex_clear (&logger->lock);
+    g_free (logger);
+}
+
+guint64 ringbuf_logger_nb_dropped (ringbuf_logger_t *logger) {
+    return __atomic_load_n (&logger->nb_dropped, __ATOMIC_RELAXED);
+}
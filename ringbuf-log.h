@@ -0,0 +1,99 @@
+#ifndef INCLUDED_RINGBUF_LOG_H
+#define INCLUDED_RINGBUF_LOG_H
+
+#include "ringbuf.h"
+
+typedef struct _ringbuf_logger_t ringbuf_logger_t;
+
+/**
+ * ringbuf_log_site_t:
+ * @domain: Log domain of the calling code.
+ * @level: Level of the messages.
+ * @format: printf() format of the messages.
+ * @file: Source file of the call.
+ * @line: Source line of the call.
+ * @parsed: Private, set on first use.
+ *
+ * One call site of ringbuf_log(), kept in static storage. Records refer to it
+ * by address instead of carrying the format.
+ */
+typedef struct {
+    const gchar *domain;
+    GLogLevelFlags level;
+    const gchar *format;
+    const gchar *file;
+    gint line;
+    gsize parsed;
+} ringbuf_log_site_t;
+
+#define RINGBUF_LOG_FORMAT_(format, ...) format
+
+/**
+ * ringbuf_log:
+ * @logger: A logger.
+ * @level: A constant #GLogLevelFlags.
+ * @...: A literal printf() format and its arguments.
+ *
+ * Queues a message from the calling thread without formatting it. Arguments
+ * are copied as they are, strings up to 256 bytes, so they can be freed as
+ * soon as this returns. Never blocks: messages that do not fit in the
+ * thread's ring are dropped and counted.
+ */
+#define ringbuf_log(logger, level, ...)                                                       \
+    G_STMT_START {                                                                            \
+        static ringbuf_log_site_t ringbuf_log_site_ = {                                       \
+            G_LOG_DOMAIN, (level), RINGBUF_LOG_FORMAT_(__VA_ARGS__, ""), __FILE__, __LINE__, 0 \
+        };                                                                                    \
+        ringbuf_log_write ((logger), &ringbuf_log_site_, __VA_ARGS__);                        \
+    } G_STMT_END
+
+/**
+ * ringbuf_logger_new:
+ * @ring_size: Size of the ring given to each logging thread.
+ * @path: File the messages are appended to, or NULL to hand them to the GLib
+ *   log writer.
+ *
+ * Creates a logger and starts the thread formatting and writing its
+ * messages. Returns NULL if @path cannot be opened.
+ */
+ringbuf_logger_t *ringbuf_logger_new (gsize ring_size, const gchar *path);
+
+/**
+ * ringbuf_logger_free:
+ * @logger: A logger.
+ *
+ * Writes the messages still queued, stops the thread and frees @logger.
+ * Threads must not log to it any more.
+ */
+void ringbuf_logger_free (ringbuf_logger_t *logger);
+
+/**
+ * ringbuf_logger_flush:
+ * @logger: A logger.
+ *
+ * Writes every message queued so far from the calling thread, without waiting
+ * for the logger's thread.
+ */
+void ringbuf_logger_flush (ringbuf_logger_t *logger);
+
+/**
+ * ringbuf_logger_nb_dropped:
+ * @logger: A logger.
+ *
+ * Returns the number of messages dropped on full rings and reported so far.
+ */
+guint64 ringbuf_logger_nb_dropped (ringbuf_logger_t *logger);
+
+/**
+ * ringbuf_log_write:
+ * @logger: A logger.
+ * @site: The call site, in static storage.
+ * @format: Same as @site->format.
+ * @...: Arguments for @format.
+ *
+ * Backend of ringbuf_log(), which should be used instead.
+ */
+void ringbuf_log_write (ringbuf_logger_t *logger, ringbuf_log_site_t *site, const gchar *format, ...)
+    G_GNUC_PRINTF(3, 4);
+
+#endif /* INCLUDED_RINGBUF_LOG_H */
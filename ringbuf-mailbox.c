@@ -0,0 +1,158 @@
+/*
+ * Latest-frame mailbox: a triple buffer in one memfd.
+ *
+ * At any time one slot belongs to the producer, one to the consumer, and the
+ * third holds the latest published frame. Publishing swaps the producer's slot
+ * with the published one, acquiring swaps the consumer's slot with it when it
+ * is fresh. Both swaps are a single atomic exchange of a word holding the
+ * published slot and whether it is fresh, so neither side ever waits and the
+ * slot a side owns is never touched by the other.
+ */
+
+#include "ringbuf-mailbox.h"
+#include <errno.h>
+
+#if __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 27)
+static inline int memfd_create(const char *name, unsigned int flags) {
+    return syscall(__NR_memfd_create, name, flags);
+}
+#endif
+
+#define NB_SLOTS 3
+#define SLOT_MASK 0x3
+// Set in the shared word when its slot was published after the consumer's last swap
+#define SLOT_FRESH 0x4
+
+// Keeps the shared word and each side's fields on their own cache line
+#define CACHE_LINE 64
+
+struct _ringbuf_mailbox_t {
+    ringbuf_frame_geometry_t geometry;
+    gsize frame_size, slot_size;
+    gint fd;
+    guint8 *slots;
+    ringbuf_frame_meta_t meta[NB_SLOTS];
+
+    guint8 pad0[CACHE_LINE];
+    gint shared;
+    guint8 pad1[CACHE_LINE];
+
+    // Producer side only
+    gint back;
+    guint64 sequence;
+    guint8 pad2[CACHE_LINE];
+
+    // Consumer side only
+    gint front;
+    gboolean acquired;
+};
+
+ringbuf_mailbox_t *ringbuf_mailbox_new (const gchar *name, const ringbuf_frame_geometry_t *geometry) {
+    guint bpp = geometry->bytes_per_pixel;
+    if (geometry->width == 0 || geometry->height == 0 || (bpp != 1 && bpp != 2 && bpp != 4)) {
+        g_warning ("Invalid mailbox geometry %ux%u, %u bytes per pixel", geometry->width, geometry->height, bpp);
+        return NULL;
+    }
+
+    gsize page_size = getpagesize ();
+    gsize frame_size = (gsize) geometry->width * geometry->height * bpp;
+    // Page-aligned slots, so a frame never shares a page with its neighbours
+    gsize slot_size = (frame_size + page_size - 1) / page_size * page_size;
+
+    gint fd = memfd_create (name != NULL ? name : "mailbox", 0);
+    if (fd == -1) {
+        g_warning ("Failed to create anonymous file for mailbox %s: %s", name != NULL ? name : "mailbox",
+                   g_strerror (errno));
+        return NULL;
+    }
+    if (ftruncate (fd, NB_SLOTS * slot_size) != 0) {
+        g_warning ("Could not set size of mailbox file: %s", g_strerror (errno));
+        close (fd);
+        return NULL;
+    }
+    guint8 *slots = mmap (NULL, NB_SLOTS * slot_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (slots == MAP_FAILED) {
+        g_warning ("Could not map mailbox into virtual memory: %s", g_strerror (errno));
+        close (fd);
+        return NULL;
+    }
+
+    ringbuf_mailbox_t *mb = g_new0 (ringbuf_mailbox_t, 1);
+    mb->geometry = *geometry;
+    mb->frame_size = frame_size;
+    mb->slot_size = slot_size;
+    mb->fd = fd;
+    mb->slots = slots;
+    mb->back = 0;
+    mb->shared = 1;
+    mb->front = 2;
+    return mb;
+}
+
+void ringbuf_mailbox_free (ringbuf_mailbox_t *mb) {
+    if (mb == NULL) {
+        return;
+    }
+    if (munmap (mb->slots, NB_SLOTS * mb->slot_size) != 0) {
+        g_warning ("Could not unmap mailbox");
+    }
+    close (mb->fd);
+    g_free (mb);
+}
+
+const ringbuf_frame_geometry_t *ringbuf_mailbox_geometry (const ringbuf_mailbox_t *mb) {
+    return &mb->geometry;
+}
+
+gpointer ringbuf_mailbox_reserve (ringbuf_mailbox_t *mb) {
+    return mb->slots + mb->back * mb->slot_size;
+}
+
+void ringbuf_mailbox_commit (ringbuf_mailbox_t *mb, const ringbuf_frame_meta_t *meta) {
+    ringbuf_frame_meta_t *slot_meta = &mb->meta[mb->back];
+
+    if (meta != NULL) {
+        *slot_meta = *meta;
+    }
+    else {
+        memset (slot_meta, 0, sizeof(*slot_meta));
+        slot_meta->sequence = mb->sequence;
+    }
+    mb->sequence++;
+    slot_meta->timestamp = g_get_monotonic_time ();
+
+    // Releases the frame and its metadata, takes back whichever slot was published before
+    mb->back = __atomic_exchange_n (&mb->shared, mb->back | SLOT_FRESH, __ATOMIC_ACQ_REL) & SLOT_MASK;
+}
+
+gconstpointer ringbuf_mailbox_acquire (ringbuf_mailbox_t *mb, ringbuf_frame_meta_t *meta) {
+    if (__atomic_load_n (&mb->shared, __ATOMIC_RELAXED) & SLOT_FRESH) {
+        mb->front = __atomic_exchange_n (&mb->shared, mb->front, __ATOMIC_ACQ_REL) & SLOT_MASK;
+        mb->acquired = TRUE;
+    }
+    if (!mb->acquired) {
+        return NULL;
+    }
+    if (meta != NULL) {
+        *meta = mb->meta[mb->front];
+    }
+    return mb->slots + mb->front * mb->slot_size;
+}
+
+static void mailbox_stage_run (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                               ringbuf_frame_meta_t *meta, gpointer user_data) {
+    ringbuf_mailbox_t *mb = user_data;
+    (void) geometry;
+    memcpy (ringbuf_mailbox_reserve (mb), pixels, mb->frame_size);
+    ringbuf_mailbox_commit (mb, meta);
+}
+
+void ringbuf_mailbox_attach (ringbuf_mailbox_t *mb, ringbuf_frame_ring_t *fr) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (fr);
+    if (geometry->width != mb->geometry.width || geometry->height != mb->geometry.height ||
+        geometry->bytes_per_pixel != mb->geometry.bytes_per_pixel) {
+        g_warning ("Mailbox and frame ring geometries differ");
+        return;
+    }
+    ringbuf_frame_ring_add_stage (fr, mailbox_stage_run, mb);
+}
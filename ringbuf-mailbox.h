@@ -0,0 +1,78 @@
+#ifndef INCLUDED_RINGBUF_MAILBOX_H
+#define INCLUDED_RINGBUF_MAILBOX_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_mailbox_t ringbuf_mailbox_t;
+
+/**
+ * ringbuf_mailbox_new:
+ * @name: Name of the backing memfd, or NULL for "mailbox".
+ * @geometry: Layout of every frame.
+ *
+ * Creates a latest-frame mailbox: three frame slots in one memfd, handed
+ * around between one producer and one consumer. The producer never waits and
+ * overwrites frames the consumer did not get to, the consumer always gets the
+ * newest complete frame. Neither side locks or copies. Returns NULL on error.
+ */
+ringbuf_mailbox_t *ringbuf_mailbox_new (const gchar *name, const ringbuf_frame_geometry_t *geometry);
+
+/**
+ * ringbuf_mailbox_free:
+ * @mb: A mailbox, detached from any frame ring.
+ */
+void ringbuf_mailbox_free (ringbuf_mailbox_t *mb);
+
+/**
+ * ringbuf_mailbox_geometry:
+ * @mb: A mailbox.
+ *
+ * Returns the frame layout. Owned by @mb.
+ */
+const ringbuf_frame_geometry_t *ringbuf_mailbox_geometry (const ringbuf_mailbox_t *mb);
+
+/**
+ * ringbuf_mailbox_reserve:
+ * @mb: A mailbox.
+ *
+ * Returns the slot the producer writes the next frame into. It is never read
+ * by the consumer before ringbuf_mailbox_commit(), and stays the same until
+ * then.
+ */
+gpointer ringbuf_mailbox_reserve (ringbuf_mailbox_t *mb);
+
+/**
+ * ringbuf_mailbox_commit:
+ * @mb: A mailbox.
+ * @meta: Metadata of the frame, or NULL to number frames in commit order.
+ *
+ * Publishes the reserved frame, replacing the previous one if the consumer
+ * did not acquire it yet. @meta's timestamp is set to the time of the commit.
+ */
+void ringbuf_mailbox_commit (ringbuf_mailbox_t *mb, const ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_mailbox_acquire:
+ * @mb: A mailbox.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ *
+ * Returns the newest published frame in place, valid until the next call.
+ * Returns the same frame again when nothing was published since, which
+ * @meta's sequence tells, and NULL before the first commit.
+ */
+gconstpointer ringbuf_mailbox_acquire (ringbuf_mailbox_t *mb, ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_mailbox_attach:
+ * @mb: A mailbox.
+ * @fr: A frame ring with the same geometry.
+ *
+ * Publishes every frame produced into @fr to @mb as well, with the same
+ * metadata, so one commit feeds both. The frame is copied into the mailbox
+ * while it is hot in the producer's cache. Attach it after the other stages
+ * so their fields are set. Frames dropped by a full non-blocking ring are not
+ * published.
+ */
+void ringbuf_mailbox_attach (ringbuf_mailbox_t *mb, ringbuf_frame_ring_t *fr);
+
+#endif /* INCLUDED_RINGBUF_MAILBOX_H */
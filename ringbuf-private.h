@@ -0,0 +1,21 @@
+#ifndef INCLUDED_RINGBUF_PRIVATE_H
+#define INCLUDED_RINGBUF_PRIVATE_H
+
+/*
+ * Private constructor for rings whose memory is mapped by someone else, such
+ * as the slots of an arena.
+ */
+
+#include "ringbuf.h"
+
+typedef void (*ringbuf_unmap_func) (gpointer buffer, gsize size, gpointer user_data);
+
+/*
+ * Creates a ring over @buffer, where @size bytes of @fd are mapped twice in a
+ * row. ringbuf_free() calls @unmap instead of unmapping @buffer and closing
+ * @fd. Makes no syscall.
+ */
+ringbuf_t *ringbuf_new_from_mapping (const gchar *name, gpointer buffer, gint fd, gsize size, gboolean block,
+                                     ringbuf_unmap_func unmap, gpointer user_data);
+
+#endif /* INCLUDED_RINGBUF_PRIVATE_H */
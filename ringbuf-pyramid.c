@@ -0,0 +1,246 @@
+/*
+ * Pyramid stage: 2x2 binned levels of every frame for zoomable viewers.
+ *
+ * Each level is built from the one above it, already in the record and
+ * mostly still in cache, so the full-resolution frame is read only once.
+ * Binning loads two vectors from each of two rows, splits even and odd
+ * columns with shuffles, and takes the rounded mean of the four values as
+ * the sum of their quarters plus the rounded sum of their remainders, which
+ * cannot overflow the pixel type.
+ */
+
+#include "ringbuf-pyramid.h"
+#include "ringbuf-simd.h"
+#include "ringbuf-tiles.h"
+
+// Levels smaller than this stay on the calling thread
+#define TILE_MIN_PIXELS (256 * 1024)
+
+// How often the consumer thread checks for ringbuf_pyramid_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+// Records and levels start on cache lines
+#define ALIGNMENT 64
+
+#define EVEN_8 0, 2, 4, 6, 8, 10, 12, 14
+#define ODD_8 1, 3, 5, 7, 9, 11, 13, 15
+#define EVEN_16 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30
+#define ODD_16 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31
+#define EVEN_32 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30, \
+                32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62
+#define ODD_32 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31, \
+               33, 35, 37, 39, 41, 43, 45, 47, 49, 51, 53, 55, 57, 59, 61, 63
+
+struct _ringbuf_pyramid_t {
+    ringbuf_frame_geometry_t geometry;
+    guint nb_levels;
+    ringbuf_pyramid_level_t levels[RINGBUF_PYRAMID_MAX_LEVELS];
+    gsize record_size;
+    ringbuf_tiles_t *tiles;
+    ringbuf_t *output;
+
+    // Level being built
+    const guint8 *src;
+    guint src_width;
+    guint8 *dst;
+    guint dst_width;
+
+    GThread *thread;
+    ringbuf_frame_ring_t *input;
+    gint stop;
+};
+
+// One binned row of @n pixels from rows @top and @bottom of 2 * @n pixels or more
+#define DEFINE_BIN_ROW(type, vec, even, odd)                                             \
+RINGBUF_SIMD_CLONES                                                                      \
+static void bin_row_##type (const type *top, const type *bottom, type *dst, gsize n) {  \
+    const gsize lanes = RINGBUF_SIMD_BYTES / sizeof(type);                              \
+    const vec two = (vec) {0} + 2, three = (vec) {0} + 3;                                \
+    gsize i = 0;                                                                         \
+    for (; i + lanes <= n; i += lanes) {                                                 \
+        vec t0 = *(const vec *) (top + 2 * i), t1 = *(const vec *) (top + 2 * i + lanes); \
+        vec b0 = *(const vec *) (bottom + 2 * i), b1 = *(const vec *) (bottom + 2 * i + lanes); \
+        vec a = RINGBUF_SIMD_SHUFFLE2 (t0, t1, vec, even);                               \
+        vec b = RINGBUF_SIMD_SHUFFLE2 (t0, t1, vec, odd);                                \
+        vec c = RINGBUF_SIMD_SHUFFLE2 (b0, b1, vec, even);                               \
+        vec d = RINGBUF_SIMD_SHUFFLE2 (b0, b1, vec, odd);                                \
+        *(vec *) (dst + i) = (a >> 2) + (b >> 2) + (c >> 2) + (d >> 2) +                 \
+                             (((a & three) + (b & three) + (c & three) + (d & three) + two) >> 2); \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        type a = top[2 * i], b = top[2 * i + 1], c = bottom[2 * i], d = bottom[2 * i + 1]; \
+        dst[i] = (a >> 2) + (b >> 2) + (c >> 2) + (d >> 2) + (((a & 3) + (b & 3) + (c & 3) + (d & 3) + 2) >> 2); \
+    }                                                                                    \
+}
+
+DEFINE_BIN_ROW(guint8, ringbuf_vu8, EVEN_32, ODD_32)
+DEFINE_BIN_ROW(guint16, ringbuf_vu16, EVEN_16, ODD_16)
+DEFINE_BIN_ROW(guint32, ringbuf_vu32, EVEN_8, ODD_8)
+
+static void bin_tile (guint tile, guint first_row, guint nb_rows, gpointer user_data) {
+    ringbuf_pyramid_t *pyr = user_data;
+    guint bpp = pyr->geometry.bytes_per_pixel;
+    gsize src_row = (gsize) pyr->src_width * bpp, dst_row = (gsize) pyr->dst_width * bpp;
+    (void) tile;
+
+    for (guint y = first_row; y < first_row + nb_rows; y++) {
+        const guint8 *top = pyr->src + 2 * y * src_row;
+        guint8 *dst = pyr->dst + y * dst_row;
+        switch (bpp) {
+        case 1:
+            bin_row_guint8 (top, top + src_row, dst, pyr->dst_width);
+            break;
+        case 2:
+            bin_row_guint16 ((const guint16 *) top, (const guint16 *) (top + src_row), (guint16 *) dst,
+                             pyr->dst_width);
+            break;
+        default:
+            bin_row_guint32 ((const guint32 *) top, (const guint32 *) (top + src_row), (guint32 *) dst,
+                             pyr->dst_width);
+            break;
+        }
+    }
+}
+
+ringbuf_pyramid_t *ringbuf_pyramid_new (const ringbuf_frame_geometry_t *geometry, guint nb_levels, guint nb_threads,
+                                        guint depth) {
+    guint bpp = geometry->bytes_per_pixel;
+
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || nb_levels == 0 || nb_levels > RINGBUF_PYRAMID_MAX_LEVELS ||
+        nb_threads == 0 || depth == 0 || geometry->width >> nb_levels == 0 || geometry->height >> nb_levels == 0) {
+        g_warning ("Invalid pyramid of %u levels over %ux%u frames", nb_levels, geometry->width, geometry->height);
+        return NULL;
+    }
+
+    ringbuf_pyramid_t *pyr = g_new0 (ringbuf_pyramid_t, 1);
+    pyr->geometry = *geometry;
+    pyr->nb_levels = nb_levels;
+
+    gsize offset = (sizeof(ringbuf_pyramid_header_t) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    for (guint l = 0; l < nb_levels; l++) {
+        ringbuf_pyramid_level_t *level = &pyr->levels[l];
+        level->width = geometry->width >> (l + 1);
+        level->height = geometry->height >> (l + 1);
+        level->offset = offset;
+        offset += ((gsize) level->width * level->height * bpp + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+    pyr->record_size = offset;
+
+    pyr->output = ringbuf_new_named ("pyramid", depth * pyr->record_size, TRUE);
+    if (pyr->output == NULL) {
+        g_free (pyr);
+        return NULL;
+    }
+    pyr->tiles = ringbuf_tiles_new (nb_threads);
+    return pyr;
+}
+
+void ringbuf_pyramid_free (ringbuf_pyramid_t *pyr) {
+    if (pyr == NULL) {
+        return;
+    }
+    ringbuf_pyramid_stop (pyr);
+    ringbuf_tiles_free (pyr->tiles);
+    ringbuf_free (pyr->output);
+    g_free (pyr);
+}
+
+ringbuf_t *ringbuf_pyramid_output (ringbuf_pyramid_t *pyr) {
+    return pyr->output;
+}
+
+gsize ringbuf_pyramid_record_size (const ringbuf_pyramid_t *pyr) {
+    return pyr->record_size;
+}
+
+void ringbuf_pyramid_process (ringbuf_pyramid_t *pyr, gconstpointer pixels, const ringbuf_frame_meta_t *meta) {
+    ringbuf_pyramid_header_t header = { meta->sequence, meta->timestamp, pyr->nb_levels,
+                                        pyr->geometry.bytes_per_pixel, {{0}} };
+    guint8 *record = ringbuf_reserve (pyr->output, pyr->record_size);
+
+    memcpy (header.levels, pyr->levels, sizeof(pyr->levels));
+    memcpy (record, &header, sizeof(header));
+
+    pyr->src = pixels;
+    pyr->src_width = pyr->geometry.width;
+    gsize src_pixels = (gsize) pyr->geometry.width * pyr->geometry.height;
+    for (guint l = 0; l < pyr->nb_levels; l++) {
+        const ringbuf_pyramid_level_t *level = &pyr->levels[l];
+        pyr->dst = record + level->offset;
+        pyr->dst_width = level->width;
+        ringbuf_tiles_run (pyr->tiles, level->height,
+                           src_pixels < TILE_MIN_PIXELS ? 1 : ringbuf_tiles_nb_threads (pyr->tiles), bin_tile, pyr);
+        pyr->src = pyr->dst;
+        pyr->src_width = level->width;
+        src_pixels = (gsize) level->width * level->height;
+    }
+    pyr->src = NULL;
+    pyr->dst = NULL;
+
+    ringbuf_commit (pyr->output, pyr->record_size);
+}
+
+static gpointer pyramid_thread (gpointer data) {
+    ringbuf_pyramid_t *pyr = data;
+    ringbuf_frame_meta_t meta;
+
+    while (!g_atomic_int_get (&pyr->stop)) {
+        gconstpointer pixels = ringbuf_frame_ring_acquire_timed (pyr->input, &meta, POLL_TIMEOUT);
+        if (pixels == NULL) {
+            continue;
+        }
+        ringbuf_pyramid_process (pyr, pixels, &meta);
+        ringbuf_frame_ring_release (pyr->input);
+    }
+    return NULL;
+}
+
+void ringbuf_pyramid_start (ringbuf_pyramid_t *pyr, ringbuf_frame_ring_t *input) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (input);
+
+    if (pyr->thread != NULL) {
+        return;
+    }
+    if (geometry->width != pyr->geometry.width || geometry->height != pyr->geometry.height ||
+        geometry->bytes_per_pixel != pyr->geometry.bytes_per_pixel) {
+        g_warning ("Pyramid stage and input ring geometries differ");
+        return;
+    }
+    pyr->input = input;
+    g_atomic_int_set (&pyr->stop, FALSE);
+    pyr->thread = g_thread_new ("pyramid", pyramid_thread, pyr);
+}
+
+void ringbuf_pyramid_stop (ringbuf_pyramid_t *pyr) {
+    if (pyr->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&pyr->stop, TRUE);
+    g_thread_join (pyr->thread);
+    pyr->thread = NULL;
+    pyr->input = NULL;
+}
+
+const ringbuf_pyramid_header_t *ringbuf_pyramid_acquire (ringbuf_pyramid_t *pyr, guint64 timeout) {
+    if (ringbuf_wait_for_data_timed (pyr->output, pyr->record_size, timeout) == 0) {
+        return NULL;
+    }
+    // Records are multiples of the alignment in a page-aligned ring, so the header is aligned
+    return ringbuf_tail (pyr->output);
+}
+
+gconstpointer ringbuf_pyramid_level (const ringbuf_pyramid_header_t *header, guint level,
+                                     ringbuf_frame_geometry_t *geometry) {
+    if (level == 0 || level > header->nb_levels) {
+        return NULL;
+    }
+    const ringbuf_pyramid_level_t *l = &header->levels[level - 1];
+    if (geometry != NULL) {
+        *geometry = (ringbuf_frame_geometry_t) { l->width, l->height, header->bytes_per_pixel };
+    }
+    return (const guint8 *) header + l->offset;
+}
+
+void ringbuf_pyramid_release (ringbuf_pyramid_t *pyr) {
+    ringbuf_move_tail (pyr->output, pyr->record_size);
+}
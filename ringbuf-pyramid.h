@@ -0,0 +1,141 @@
+#ifndef INCLUDED_RINGBUF_PYRAMID_H
+#define INCLUDED_RINGBUF_PYRAMID_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_pyramid_t ringbuf_pyramid_t;
+
+/* Most levels a pyramid can have. */
+#define RINGBUF_PYRAMID_MAX_LEVELS 16
+
+/**
+ * ringbuf_pyramid_level_t:
+ * @width: Pixels per row.
+ * @height: Number of rows.
+ * @offset: Byte offset of the level's first pixel from the start of the
+ *   record.
+ *
+ * Where one level of a pyramid is in its record. Rows are packed.
+ */
+typedef struct {
+    guint32 width;
+    guint32 height;
+    guint64 offset;
+} ringbuf_pyramid_level_t;
+
+/**
+ * ringbuf_pyramid_header_t:
+ * @sequence: Sequence number of the source frame.
+ * @timestamp: Commit timestamp of the source frame.
+ * @nb_levels: Number of valid entries in @levels.
+ * @bytes_per_pixel: Same as the source frame.
+ * @levels: Offset table, level 1 (half the source's width and height) first.
+ *
+ * Heads every record in the output ring of a pyramid stage. The levels
+ * follow in the same record, one after the other.
+ */
+typedef struct {
+    guint64 sequence;
+    gint64 timestamp;
+    guint32 nb_levels;
+    guint32 bytes_per_pixel;
+    ringbuf_pyramid_level_t levels[RINGBUF_PYRAMID_MAX_LEVELS];
+} ringbuf_pyramid_header_t;
+
+/**
+ * ringbuf_pyramid_new:
+ * @geometry: Layout of the input frames.
+ * @nb_levels: Number of binned levels, each half the width and height of
+ *   the one above it, odd rows and columns being dropped.
+ * @nb_threads: Threads sharing each level by tiles of rows.
+ * @depth: Number of records the output ring holds.
+ *
+ * Creates a stage binning every frame 2x2 into a pyramid of @nb_levels
+ * levels, written as one record per frame into a blocking output ring.
+ * Returns NULL on invalid arguments, or if the last level would be empty.
+ */
+ringbuf_pyramid_t *ringbuf_pyramid_new (const ringbuf_frame_geometry_t *geometry, guint nb_levels, guint nb_threads,
+                                        guint depth);
+
+/**
+ * ringbuf_pyramid_free:
+ * @pyr: A pyramid stage, stopped first if running.
+ */
+void ringbuf_pyramid_free (ringbuf_pyramid_t *pyr);
+
+/**
+ * ringbuf_pyramid_output:
+ * @pyr: A pyramid stage.
+ *
+ * Returns the ring receiving the records. Owned by @pyr.
+ */
+ringbuf_t *ringbuf_pyramid_output (ringbuf_pyramid_t *pyr);
+
+/**
+ * ringbuf_pyramid_record_size:
+ * @pyr: A pyramid stage.
+ *
+ * Returns the size of every record, header included, a multiple of 64 bytes.
+ */
+gsize ringbuf_pyramid_record_size (const ringbuf_pyramid_t *pyr);
+
+/**
+ * ringbuf_pyramid_process:
+ * @pyr: A pyramid stage.
+ * @pixels: One input frame.
+ * @meta: The frame's metadata, copied to the header.
+ *
+ * Builds the pyramid of one frame straight into the output ring, each level
+ * from the one above it. May block on a full output ring.
+ */
+void ringbuf_pyramid_process (ringbuf_pyramid_t *pyr, gconstpointer pixels, const ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_pyramid_start:
+ * @pyr: A pyramid stage.
+ * @input: Frame ring to consume, with the geometry given at creation.
+ *
+ * Starts a thread acquiring frames from @input in place, processing them and
+ * releasing them, until ringbuf_pyramid_stop().
+ */
+void ringbuf_pyramid_start (ringbuf_pyramid_t *pyr, ringbuf_frame_ring_t *input);
+
+/**
+ * ringbuf_pyramid_stop:
+ * @pyr: A pyramid stage.
+ *
+ * Stops the thread started by ringbuf_pyramid_start().
+ */
+void ringbuf_pyramid_stop (ringbuf_pyramid_t *pyr);
+
+/**
+ * ringbuf_pyramid_acquire:
+ * @pyr: A pyramid stage.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Waits for the oldest record and returns its header, in place in the output
+ * ring, or NULL on timeout. Give it back with ringbuf_pyramid_release().
+ */
+const ringbuf_pyramid_header_t *ringbuf_pyramid_acquire (ringbuf_pyramid_t *pyr, guint64 timeout);
+
+/**
+ * ringbuf_pyramid_level:
+ * @header: An acquired record.
+ * @level: From 1 to @header->nb_levels.
+ * @geometry: Set to the level's layout, may be NULL.
+ *
+ * Returns the pixels of one level of an acquired record, or NULL if there is
+ * no such level.
+ */
+gconstpointer ringbuf_pyramid_level (const ringbuf_pyramid_header_t *header, guint level,
+                                     ringbuf_frame_geometry_t *geometry);
+
+/**
+ * ringbuf_pyramid_release:
+ * @pyr: A pyramid stage.
+ *
+ * Gives the acquired record back to the stage.
+ */
+void ringbuf_pyramid_release (ringbuf_pyramid_t *pyr);
+
+#endif /* INCLUDED_RINGBUF_PYRAMID_H */
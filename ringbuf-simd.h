@@ -0,0 +1,72 @@
+#ifndef INCLUDED_RINGBUF_SIMD_H
+#define INCLUDED_RINGBUF_SIMD_H
+
+/*
+ * Private helpers for the vectorized frame kernels.
+ *
+ * Kernels are written with GCC vector extensions so they build on any target.
+ * On x86-64 Linux, functions tagged RINGBUF_SIMD_CLONES are compiled twice,
+ * for the baseline ISA and for AVX2, and the dynamic loader picks the best one
+ * at startup.
+ */
+
+#include <glib.h>
+
+/* Width of the vector types below, in bytes. */
+#define RINGBUF_SIMD_BYTES 32
+
+/* Unaligned, aliasing-safe vectors: dereference them to load or store. */
+typedef guint8 ringbuf_vu8 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+typedef guint16 ringbuf_vu16 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+typedef guint32 ringbuf_vu32 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+typedef guint64 ringbuf_vu64 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+typedef gint32 ringbuf_vi32 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+typedef gfloat ringbuf_vf32 __attribute__((vector_size(RINGBUF_SIMD_BYTES), aligned(1), may_alias));
+
+/* Eight-lane vectors, for widening narrow pixels with __builtin_convertvector(). */
+typedef guint8 ringbuf_vu8x8 __attribute__((vector_size(8), aligned(1), may_alias));
+typedef guint16 ringbuf_vu16x8 __attribute__((vector_size(16), aligned(1), may_alias));
+typedef guint64 ringbuf_vu64x8 __attribute__((vector_size(64), aligned(1), may_alias));
+
+/* Sixteen-lane bytes, for transposing bytes by 16 x 16 tiles. */
+typedef guint8 ringbuf_vu8x16 __attribute__((vector_size(16), aligned(1), may_alias));
+
+/* Sixteen-lane floats, for converting a whole ringbuf_vu16. */
+typedef gfloat ringbuf_vf32x16 __attribute__((vector_size(64), aligned(1), may_alias));
+
+/* Byte shuffle of a ringbuf_vu8 with constant indices, one per output lane. */
+#ifdef __clang__
+#define RINGBUF_SIMD_SHUFFLE_U8(v, ...) __builtin_shufflevector (v, v, __VA_ARGS__)
+#else
+#define RINGBUF_SIMD_SHUFFLE_U8(v, ...) __builtin_shuffle (v, (ringbuf_vu8) {__VA_ARGS__})
+#endif
+
+/* Lanes picked from two vectors of type @vec, indices past the first one's lanes select the second. */
+#ifdef __clang__
+#define RINGBUF_SIMD_SHUFFLE2(a, b, vec, ...) __builtin_shufflevector (a, b, __VA_ARGS__)
+#else
+#define RINGBUF_SIMD_SHUFFLE2(a, b, vec, ...) __builtin_shuffle (a, b, (vec) {__VA_ARGS__})
+#endif
+
+/* Full unrolling of short constant loops over arrays of vectors, so they stay in registers. */
+#if defined(__clang__)
+#define RINGBUF_SIMD_UNROLL _Pragma ("unroll")
+#elif __GNUC__ >= 8
+#define RINGBUF_SIMD_UNROLL _Pragma ("GCC unroll 16")
+#else
+#define RINGBUF_SIMD_UNROLL
+#endif
+
+#if defined(__x86_64__) && defined(__linux__) && \
+    ((defined(__clang__) && __clang_major__ >= 14) || (!defined(__clang__) && __GNUC__ >= 6))
+#define RINGBUF_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define RINGBUF_SIMD_CLONES
+#endif
+
+/* For kernels only worth running with AVX2, guarded by __builtin_cpu_supports(). */
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define RINGBUF_SIMD_AVX2 __attribute__((target("avx2")))
+#endif
+
+#endif /* INCLUDED_RINGBUF_SIMD_H */
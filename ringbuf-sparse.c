@@ -0,0 +1,240 @@
+/*
+ * Zero-suppression stage: lists of the pixels above a threshold.
+ *
+ * Frames are scanned one vector at a time. Blocks with no pixel above the
+ * threshold, the vast majority on sparse data, cost a compare and a test.
+ * The others are compressed without branches: every pixel of the block is
+ * written as a candidate event and the output position only advances for the
+ * ones above the threshold.
+ */
+
+#include "ringbuf-sparse.h"
+#include "ringbuf-simd.h"
+
+// How often the consumer thread checks for ringbuf_sparse_stage_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+struct _ringbuf_sparse_stage_t {
+    ringbuf_frame_geometry_t geometry;
+    guint32 threshold;
+    gsize max_events;
+
+    ringbuf_t *output;
+    gsize record_size;
+
+    GThread *thread;
+    ringbuf_frame_ring_t *input;
+    gint stop;
+};
+
+#define DEFINE_EXTRACT(type, vec)                                                       \
+RINGBUF_SIMD_CLONES                                                                      \
+static gsize extract_##type (const type *src, gsize n, type threshold, ringbuf_sparse_event_t *events, \
+                             gsize max_events, gboolean *truncated) {                    \
+    const gsize lanes = RINGBUF_SIMD_BYTES / sizeof(type);                              \
+    const vec limit = (vec) {0} + threshold;                                            \
+    gsize count = 0, i = 0;                                                             \
+    for (; i + lanes <= n; i += lanes) {                                                \
+        ringbuf_vu64 above = (ringbuf_vu64) (*(const vec *) (src + i) > limit);          \
+        if ((above[0] | above[1] | above[2] | above[3]) == 0) {                          \
+            continue;                                                                   \
+        }                                                                               \
+        if (count + lanes > max_events) {                                               \
+            break;                                                                      \
+        }                                                                               \
+        for (gsize j = i; j < i + lanes; j++) {                                         \
+            events[count].index = j;                                                    \
+            events[count].value = src[j];                                               \
+            count += src[j] > threshold;                                                \
+        }                                                                               \
+    }                                                                                   \
+    for (; i < n; i++) {                                                                \
+        if (src[i] <= threshold) {                                                      \
+            continue;                                                                   \
+        }                                                                               \
+        if (count == max_events) {                                                      \
+            *truncated = TRUE;                                                          \
+            break;                                                                      \
+        }                                                                               \
+        events[count].index = i;                                                        \
+        events[count].value = src[i];                                                   \
+        count++;                                                                        \
+    }                                                                                   \
+    return count;                                                                       \
+}
+
+DEFINE_EXTRACT(guint8, ringbuf_vu8)
+DEFINE_EXTRACT(guint16, ringbuf_vu16)
+DEFINE_EXTRACT(guint32, ringbuf_vu32)
+
+static gboolean check_geometry (const ringbuf_frame_geometry_t *geometry) {
+    guint bpp = geometry->bytes_per_pixel;
+    if (bpp != 1 && bpp != 2 && bpp != 4) {
+        g_warning ("Invalid sparse frames of %u byte pixels", bpp);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gsize ringbuf_sparse_extract (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels, guint32 threshold,
+                              ringbuf_sparse_event_t *events, gsize max_events, gboolean *truncated) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+    gboolean cut = FALSE;
+    gsize count = 0;
+
+    switch (geometry->bytes_per_pixel) {
+    case 1:
+        if (threshold < G_MAXUINT8) {
+            count = extract_guint8 (pixels, nb_pixels, threshold, events, max_events, &cut);
+        }
+        break;
+    case 2:
+        if (threshold < G_MAXUINT16) {
+            count = extract_guint16 (pixels, nb_pixels, threshold, events, max_events, &cut);
+        }
+        break;
+    case 4:
+        count = extract_guint32 (pixels, nb_pixels, threshold, events, max_events, &cut);
+        break;
+    default:
+        check_geometry (geometry);
+        break;
+    }
+
+    if (truncated != NULL) {
+        *truncated = cut;
+    }
+    return count;
+}
+
+void ringbuf_sparse_reconstruct (const ringbuf_frame_geometry_t *geometry, const ringbuf_sparse_event_t *events,
+                                 gsize nb_events, gpointer pixels) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    if (!check_geometry (geometry)) {
+        return;
+    }
+    memset (pixels, 0, nb_pixels * geometry->bytes_per_pixel);
+    for (gsize e = 0; e < nb_events; e++) {
+        guint32 i = events[e].index;
+        if (i >= nb_pixels) {
+            continue;
+        }
+        switch (geometry->bytes_per_pixel) {
+        case 1:
+            ((guint8 *) pixels)[i] = events[e].value;
+            break;
+        case 2:
+            ((guint16 *) pixels)[i] = events[e].value;
+            break;
+        default:
+            ((guint32 *) pixels)[i] = events[e].value;
+            break;
+        }
+    }
+}
+
+ringbuf_sparse_stage_t *ringbuf_sparse_stage_new (const ringbuf_frame_geometry_t *geometry, guint32 threshold,
+                                                  gsize max_events, guint depth) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    if (!check_geometry (geometry) || nb_pixels > G_MAXUINT32 || max_events == 0 || depth == 0) {
+        return NULL;
+    }
+
+    ringbuf_sparse_stage_t *stage = g_new0 (ringbuf_sparse_stage_t, 1);
+    stage->geometry = *geometry;
+    stage->threshold = threshold;
+    stage->max_events = MIN(max_events, nb_pixels);
+    stage->record_size = sizeof(ringbuf_sparse_header_t) + stage->max_events * sizeof(ringbuf_sparse_event_t);
+    stage->output = ringbuf_new_named ("events", depth * stage->record_size, TRUE);
+    if (stage->output == NULL) {
+        g_free (stage);
+        return NULL;
+    }
+    return stage;
+}
+
+void ringbuf_sparse_stage_free (ringbuf_sparse_stage_t *stage) {
+    if (stage == NULL) {
+        return;
+    }
+    ringbuf_sparse_stage_stop (stage);
+    ringbuf_free (stage->output);
+    g_free (stage);
+}
+
+ringbuf_t *ringbuf_sparse_stage_output (ringbuf_sparse_stage_t *stage) {
+    return stage->output;
+}
+
+gboolean ringbuf_sparse_stage_process (ringbuf_sparse_stage_t *stage, gconstpointer pixels,
+                                       const ringbuf_frame_meta_t *meta) {
+    ringbuf_sparse_header_t header = { meta->sequence, meta->timestamp, 0, 0 };
+    gboolean truncated;
+
+    // Room for the longest list, only what was written is committed
+    guint8 *record = ringbuf_reserve (stage->output, stage->record_size);
+    gsize count = ringbuf_sparse_extract (&stage->geometry, pixels, stage->threshold,
+                                          (ringbuf_sparse_event_t *) (record + sizeof(header)),
+                                          stage->max_events, &truncated);
+    header.nb_events = count;
+    header.flags = truncated ? RINGBUF_SPARSE_TRUNCATED : 0;
+    memcpy (record, &header, sizeof(header));
+    ringbuf_commit (stage->output, sizeof(header) + count * sizeof(ringbuf_sparse_event_t));
+    return !truncated;
+}
+
+static gpointer sparse_thread (gpointer data) {
+    ringbuf_sparse_stage_t *stage = data;
+    ringbuf_frame_meta_t meta;
+
+    while (!g_atomic_int_get (&stage->stop)) {
+        gconstpointer pixels = ringbuf_frame_ring_acquire_timed (stage->input, &meta, POLL_TIMEOUT);
+        if (pixels == NULL) {
+            continue;
+        }
+        ringbuf_sparse_stage_process (stage, pixels, &meta);
+        ringbuf_frame_ring_release (stage->input);
+    }
+    return NULL;
+}
+
+void ringbuf_sparse_stage_start (ringbuf_sparse_stage_t *stage, ringbuf_frame_ring_t *input) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (input);
+
+    if (stage->thread != NULL) {
+        return;
+    }
+    if (geometry->width != stage->geometry.width || geometry->height != stage->geometry.height ||
+        geometry->bytes_per_pixel != stage->geometry.bytes_per_pixel) {
+        g_warning ("Sparse stage and input ring geometries differ");
+        return;
+    }
+    stage->input = input;
+    g_atomic_int_set (&stage->stop, FALSE);
+    stage->thread = g_thread_new ("sparse", sparse_thread, stage);
+}
+
+void ringbuf_sparse_stage_stop (ringbuf_sparse_stage_t *stage) {
+    if (stage->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&stage->stop, TRUE);
+    g_thread_join (stage->thread);
+    stage->thread = NULL;
+    stage->input = NULL;
+}
+
+gboolean ringbuf_sparse_stage_pop (ringbuf_sparse_stage_t *stage, ringbuf_sparse_header_t *header,
+                                   ringbuf_sparse_event_t *events, guint64 timeout) {
+    if (ringbuf_wait_for_data_timed (stage->output, sizeof(*header), timeout) == 0) {
+        return FALSE;
+    }
+    // Header and events are committed together
+    const guint8 *record = ringbuf_tail (stage->output);
+    memcpy (header, record, sizeof(*header));
+    memcpy (events, record + sizeof(*header), header->nb_events * sizeof(ringbuf_sparse_event_t));
+    ringbuf_move_tail (stage->output, sizeof(*header) + header->nb_events * sizeof(ringbuf_sparse_event_t));
+    return TRUE;
+}
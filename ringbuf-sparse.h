@@ -0,0 +1,135 @@
+#ifndef INCLUDED_RINGBUF_SPARSE_H
+#define INCLUDED_RINGBUF_SPARSE_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_sparse_stage_t ringbuf_sparse_stage_t;
+
+/**
+ * ringbuf_sparse_event_t:
+ * @index: Pixel index in the frame, y * width + x.
+ * @value: Pixel value.
+ */
+typedef struct {
+    guint32 index;
+    guint32 value;
+} ringbuf_sparse_event_t;
+
+/* Set in ringbuf_sparse_header_t.flags when events were cut at the maximum. */
+#define RINGBUF_SPARSE_TRUNCATED (1 << 0)
+
+/**
+ * ringbuf_sparse_header_t:
+ * @sequence: Sequence number of the source frame.
+ * @timestamp: Commit timestamp of the source frame.
+ * @nb_events: Number of ringbuf_sparse_event_t following the header.
+ * @flags: RINGBUF_SPARSE_TRUNCATED or 0.
+ *
+ * Heads every event list in the output ring of a sparse stage.
+ */
+typedef struct {
+    guint64 sequence;
+    gint64 timestamp;
+    guint32 nb_events;
+    guint32 flags;
+} ringbuf_sparse_header_t;
+
+/**
+ * ringbuf_sparse_extract:
+ * @geometry: Layout of @pixels.
+ * @pixels: One frame.
+ * @threshold: Pixels strictly above this value become events.
+ * @events: Room for @max_events events.
+ * @max_events: Maximum number of events written.
+ * @truncated: Set to TRUE if more pixels were above @threshold, or NULL.
+ *
+ * Lists the pixels of one frame above @threshold, in index order. Returns the
+ * number of events written.
+ */
+gsize ringbuf_sparse_extract (const ringbuf_frame_geometry_t *geometry, gconstpointer pixels, guint32 threshold,
+                              ringbuf_sparse_event_t *events, gsize max_events, gboolean *truncated);
+
+/**
+ * ringbuf_sparse_reconstruct:
+ * @geometry: Layout of @pixels.
+ * @events: Events of one frame.
+ * @nb_events: Number of @events.
+ * @pixels: One frame, overwritten.
+ *
+ * Rebuilds a dense frame from an event list, every other pixel being zero.
+ * Events with an index outside of the frame are ignored.
+ */
+void ringbuf_sparse_reconstruct (const ringbuf_frame_geometry_t *geometry, const ringbuf_sparse_event_t *events,
+                                 gsize nb_events, gpointer pixels);
+
+/**
+ * ringbuf_sparse_stage_new:
+ * @geometry: Layout of the input frames.
+ * @threshold: Pixels strictly above this value become events.
+ * @max_events: Maximum number of events kept per frame.
+ * @depth: Number of full event lists the output ring holds.
+ *
+ * Creates a zero-suppression stage writing one ringbuf_sparse_header_t and
+ * its events per input frame into a blocking output ring. Returns NULL on
+ * invalid arguments.
+ */
+ringbuf_sparse_stage_t *ringbuf_sparse_stage_new (const ringbuf_frame_geometry_t *geometry, guint32 threshold,
+                                                  gsize max_events, guint depth);
+
+/**
+ * ringbuf_sparse_stage_free:
+ * @stage: A sparse stage, stopped first if running.
+ */
+void ringbuf_sparse_stage_free (ringbuf_sparse_stage_t *stage);
+
+/**
+ * ringbuf_sparse_stage_output:
+ * @stage: A sparse stage.
+ *
+ * Returns the ring receiving the event lists. Owned by @stage.
+ */
+ringbuf_t *ringbuf_sparse_stage_output (ringbuf_sparse_stage_t *stage);
+
+/**
+ * ringbuf_sparse_stage_process:
+ * @stage: A sparse stage.
+ * @pixels: One input frame.
+ * @meta: The frame's metadata, copied to the header.
+ *
+ * Extracts the events of one frame straight into the output ring. May block
+ * on a full output ring. Returns FALSE if the event list was truncated.
+ */
+gboolean ringbuf_sparse_stage_process (ringbuf_sparse_stage_t *stage, gconstpointer pixels,
+                                       const ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_sparse_stage_start:
+ * @stage: A sparse stage.
+ * @input: Frame ring to consume, with the geometry given at creation.
+ *
+ * Starts a thread acquiring frames from @input in place, processing them and
+ * releasing them, until ringbuf_sparse_stage_stop().
+ */
+void ringbuf_sparse_stage_start (ringbuf_sparse_stage_t *stage, ringbuf_frame_ring_t *input);
+
+/**
+ * ringbuf_sparse_stage_stop:
+ * @stage: A sparse stage.
+ *
+ * Stops the thread started by ringbuf_sparse_stage_start().
+ */
+void ringbuf_sparse_stage_stop (ringbuf_sparse_stage_t *stage);
+
+/**
+ * ringbuf_sparse_stage_pop:
+ * @stage: A sparse stage.
+ * @header: Set to the header of the event list.
+ * @events: Room for @max_events events.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Reads the oldest event list. Returns FALSE on timeout.
+ */
+gboolean ringbuf_sparse_stage_pop (ringbuf_sparse_stage_t *stage, ringbuf_sparse_header_t *header,
+                                   ringbuf_sparse_event_t *events, guint64 timeout);
+
+#endif /* INCLUDED_RINGBUF_SPARSE_H */
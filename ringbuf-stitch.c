@@ -0,0 +1,334 @@
+/*
+ * Stitching stage: modules' sub-frames assembled into full frames.
+ *
+ * The placement of every module is reduced at creation to where its top left
+ * corner lands in the full frame and how it is turned, and sub-frames are
+ * copied there with ringbuf_transform_copy(), whose destination stride is the
+ * full frame's width. Pixels covered by no module are listed as spans at
+ * creation too, and only those are cleared in every new output slot.
+ */
+
+#include "ringbuf-stitch.h"
+#include "ringbuf-transform.h"
+
+// How often the stitching thread checks for ringbuf_stitcher_stop()
+#define POLL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+    gsize origin;
+    ringbuf_transform_t transform;
+} placement_t;
+
+typedef struct {
+    gsize offset, length;
+} span_t;
+
+struct _ringbuf_stitcher_t {
+    ringbuf_frame_geometry_t module;
+    guint width;
+    guint nb_modules;
+    placement_t *placements;
+    GArray *gaps;
+    ringbuf_frame_ring_t *output;
+
+    // Frame being assembled
+    guint8 *slot;
+    guint64 frame;
+    gboolean *placed;
+    guint nb_placed;
+    guint64 nb_incomplete;
+
+    GThread *thread;
+    ringbuf_frame_ring_t **inputs;
+    guint nb_inputs;
+    gint stop;
+};
+
+// Where the module's top left corner lands in the full frame, and how it is turned
+static void compute_placement (const ringbuf_stitch_module_t *m, guint width, placement_t *p) {
+    p->origin = (gsize) m->y * width + m->x;
+    switch (m->orientation) {
+    case RINGBUF_STITCH_FLIP_X:
+        p->transform = RINGBUF_TRANSFORM_FLIP_X;
+        break;
+    case RINGBUF_STITCH_FLIP_Y:
+        p->transform = RINGBUF_TRANSFORM_FLIP_Y;
+        break;
+    case RINGBUF_STITCH_ROTATE_90:
+        p->transform = RINGBUF_TRANSFORM_ROTATE_90;
+        break;
+    case RINGBUF_STITCH_ROTATE_180:
+        p->transform = RINGBUF_TRANSFORM_ROTATE_180;
+        break;
+    case RINGBUF_STITCH_ROTATE_270:
+        p->transform = RINGBUF_TRANSFORM_ROTATE_270;
+        break;
+    default:
+        p->transform = RINGBUF_TRANSFORM_IDENTITY;
+        break;
+    }
+}
+
+// Marks the pixels of every module, fails on overflow or overlap
+static gboolean compute_coverage (const ringbuf_frame_geometry_t *module, const ringbuf_stitch_module_t *modules,
+                                  guint nb_modules, guint width, guint height, guint8 *covered) {
+    for (guint i = 0; i < nb_modules; i++) {
+        const ringbuf_stitch_module_t *m = &modules[i];
+        gboolean turned = m->orientation == RINGBUF_STITCH_ROTATE_90 || m->orientation == RINGBUF_STITCH_ROTATE_270;
+        guint w = turned ? module->height : module->width;
+        guint h = turned ? module->width : module->height;
+
+        if (m->x > width || w > width - m->x || m->y > height || h > height - m->y) {
+            g_warning ("Module %u of %ux%u at (%u, %u) does not fit in a %ux%u frame", i, w, h, m->x, m->y,
+                       width, height);
+            return FALSE;
+        }
+        for (guint y = m->y; y < m->y + h; y++) {
+            for (guint x = m->x; x < m->x + w; x++) {
+                if (covered[(gsize) y * width + x]) {
+                    g_warning ("Module %u overlaps another one at (%u, %u)", i, x, y);
+                    return FALSE;
+                }
+                covered[(gsize) y * width + x] = TRUE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+ringbuf_stitcher_t *ringbuf_stitcher_new (const ringbuf_frame_geometry_t *module,
+                                          const ringbuf_stitch_module_t *modules, guint nb_modules,
+                                          guint width, guint height, guint depth) {
+    guint bpp = module->bytes_per_pixel;
+    gsize nb_pixels = (gsize) width * height;
+
+    if ((bpp != 1 && bpp != 2 && bpp != 4) || nb_modules == 0 || module->width == 0 || module->height == 0 ||
+        nb_pixels == 0 || depth == 0) {
+        g_warning ("Invalid stitcher of %u modules of %u byte pixels", nb_modules, bpp);
+        return NULL;
+    }
+
+    guint8 *covered = g_malloc0 (nb_pixels);
+    if (!compute_coverage (module, modules, nb_modules, width, height, covered)) {
+        g_free (covered);
+        return NULL;
+    }
+
+    ringbuf_frame_geometry_t full = { width, height, bpp };
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new ("stitched", &full, depth, TRUE);
+    if (fr == NULL) {
+        g_free (covered);
+        return NULL;
+    }
+
+    ringbuf_stitcher_t *st = g_new0 (ringbuf_stitcher_t, 1);
+    st->module = *module;
+    st->width = width;
+    st->nb_modules = nb_modules;
+    st->placements = g_new (placement_t, nb_modules);
+    for (guint i = 0; i < nb_modules; i++) {
+        compute_placement (&modules[i], width, &st->placements[i]);
+    }
+    st->gaps = g_array_new (FALSE, FALSE, sizeof(span_t));
+    for (gsize i = 0; i < nb_pixels;) {
+        gsize start = i;
+        while (i < nb_pixels && !covered[i]) {
+            i++;
+        }
+        if (i > start) {
+            span_t gap = { start * bpp, (i - start) * bpp };
+            g_array_append_val (st->gaps, gap);
+        }
+        while (i < nb_pixels && covered[i]) {
+            i++;
+        }
+    }
+    g_free (covered);
+
+    st->output = fr;
+    st->placed = g_new0 (gboolean, nb_modules);
+    return st;
+}
+
+void ringbuf_stitcher_free (ringbuf_stitcher_t *st) {
+    if (st == NULL) {
+        return;
+    }
+    ringbuf_stitcher_stop (st);
+    ringbuf_frame_ring_free (st->output);
+    g_array_unref (st->gaps);
+    g_free (st->placements);
+    g_free (st->placed);
+    g_free (st);
+}
+
+ringbuf_frame_ring_t *ringbuf_stitcher_output (ringbuf_stitcher_t *st) {
+    return st->output;
+}
+
+guint64 ringbuf_stitcher_nb_incomplete (const ringbuf_stitcher_t *st) {
+    return st->nb_incomplete;
+}
+
+static void stitcher_clear (ringbuf_stitcher_t *st) {
+    memset (st->placed, 0, st->nb_modules * sizeof(gboolean));
+    st->nb_placed = 0;
+}
+
+gboolean ringbuf_stitcher_place (ringbuf_stitcher_t *st, guint module, guint64 frame, gconstpointer pixels) {
+    if (module >= st->nb_modules) {
+        g_warning ("No module %u in a stitcher of %u", module, st->nb_modules);
+        return FALSE;
+    }
+    if (frame < st->frame) {
+        return FALSE;
+    }
+    if (frame > st->frame && st->nb_placed > 0) {
+        // The slot is still reserved, the next frame reuses it
+        st->nb_incomplete++;
+        stitcher_clear (st);
+    }
+    st->frame = frame;
+
+    if (st->slot == NULL) {
+        st->slot = ringbuf_frame_ring_reserve (st->output);
+        for (guint i = 0; i < st->gaps->len; i++) {
+            const span_t *gap = &g_array_index (st->gaps, span_t, i);
+            memset (st->slot + gap->offset, 0, gap->length);
+        }
+    }
+    const placement_t *p = &st->placements[module];
+    ringbuf_transform_copy (&st->module, p->transform, pixels, st->slot + p->origin * st->module.bytes_per_pixel,
+                            st->width);
+    if (!st->placed[module]) {
+        st->placed[module] = TRUE;
+        st->nb_placed++;
+    }
+    if (st->nb_placed < st->nb_modules) {
+        return FALSE;
+    }
+
+    ringbuf_frame_ring_commit (st->output);
+    st->slot = NULL;
+    st->frame = frame + 1;
+    stitcher_clear (st);
+    return TRUE;
+}
+
+/* Next sub-frame of an input, acquired but not placed yet. */
+typedef struct {
+    gconstpointer pixels;
+    guint module;
+    guint64 frame;
+} pending_t;
+
+// Acquires the next sub-frame of input @i, if one comes within @timeout
+static void stitcher_take (ringbuf_stitcher_t *st, pending_t *pending, guint i, guint64 timeout) {
+    ringbuf_frame_meta_t meta;
+    guint per_input = st->nb_modules / st->nb_inputs;
+
+    pending[i].pixels = ringbuf_frame_ring_acquire_timed (st->inputs[i], &meta, timeout);
+    if (pending[i].pixels != NULL) {
+        pending[i].module = i + st->nb_inputs * (meta.frame_id % per_input);
+        pending[i].frame = meta.frame_id / per_input;
+    }
+}
+
+// The input to wait on: one carrying a module still missing from the current frame, else any empty one
+static gint stitcher_wait_input (ringbuf_stitcher_t *st, const pending_t *pending) {
+    gint empty = -1;
+    for (guint m = 0; m < st->nb_modules; m++) {
+        guint i = m % st->nb_inputs;
+        if (pending[i].pixels == NULL) {
+            if (!st->placed[m]) {
+                return i;
+            }
+            if (empty < 0) {
+                empty = i;
+            }
+        }
+    }
+    return empty;
+}
+
+/*
+ * Sub-frames are placed by production order: input i's frame id n is module
+ * i + nb_inputs * (n % per_input) of frame n / per_input. The thread holds the
+ * next sub-frame of each input and places the one of the earliest frame. It
+ * only moves past the frame being assembled once every input has shown a
+ * later one, so a sub-frame dropped by one input abandons that frame alone
+ * instead of shifting the input against the others.
+ */
+static gpointer stitcher_thread (gpointer data) {
+    ringbuf_stitcher_t *st = data;
+    pending_t *pending = g_new0 (pending_t, st->nb_inputs);
+
+    while (!g_atomic_int_get (&st->stop)) {
+        gboolean all_pending = TRUE;
+        gint next = -1;
+
+        for (guint i = 0; i < st->nb_inputs; i++) {
+            if (pending[i].pixels == NULL) {
+                stitcher_take (st, pending, i, 0);
+            }
+            if (pending[i].pixels == NULL) {
+                all_pending = FALSE;
+            }
+            else if (next < 0 || pending[i].frame < pending[next].frame) {
+                next = i;
+            }
+        }
+
+        if (next >= 0 && (pending[next].frame <= st->frame || all_pending)) {
+            ringbuf_stitcher_place (st, pending[next].module, pending[next].frame, pending[next].pixels);
+            ringbuf_frame_ring_release (st->inputs[next]);
+            pending[next].pixels = NULL;
+            continue;
+        }
+
+        stitcher_take (st, pending, stitcher_wait_input (st, pending), POLL_TIMEOUT);
+    }
+
+    for (guint i = 0; i < st->nb_inputs; i++) {
+        if (pending[i].pixels != NULL) {
+            ringbuf_frame_ring_release (st->inputs[i]);
+        }
+    }
+    g_free (pending);
+    return NULL;
+}
+
+void ringbuf_stitcher_start (ringbuf_stitcher_t *st, ringbuf_frame_ring_t **inputs, guint nb_inputs) {
+    if (st->thread != NULL) {
+        return;
+    }
+    if (nb_inputs == 0 || st->nb_modules % nb_inputs != 0) {
+        g_warning ("%u modules cannot be spread over %u inputs", st->nb_modules, nb_inputs);
+        return;
+    }
+    for (guint i = 0; i < nb_inputs; i++) {
+        const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (inputs[i]);
+        if (geometry->width != st->module.width || geometry->height != st->module.height ||
+            geometry->bytes_per_pixel != st->module.bytes_per_pixel) {
+            g_warning ("Input ring %u and module geometries differ", i);
+            return;
+        }
+    }
+    st->inputs = g_new (ringbuf_frame_ring_t *, nb_inputs);
+    memcpy (st->inputs, inputs, nb_inputs * sizeof(ringbuf_frame_ring_t *));
+    st->nb_inputs = nb_inputs;
+    g_atomic_int_set (&st->stop, FALSE);
+    st->thread = g_thread_new ("stitcher", stitcher_thread, st);
+}
+
+void ringbuf_stitcher_stop (ringbuf_stitcher_t *st) {
+    if (st->thread == NULL) {
+        return;
+    }
+    g_atomic_int_set (&st->stop, TRUE);
+    g_thread_join (st->thread);
+    st->thread = NULL;
+    g_free (st->inputs);
+    st->inputs = NULL;
+    st->nb_inputs = 0;
+}
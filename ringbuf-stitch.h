@@ -0,0 +1,121 @@
+#ifndef INCLUDED_RINGBUF_STITCH_H
+#define INCLUDED_RINGBUF_STITCH_H
+
+#include "ringbuf-frame.h"
+
+typedef struct _ringbuf_stitcher_t ringbuf_stitcher_t;
+
+/**
+ * ringbuf_stitch_orientation_t:
+ * @RINGBUF_STITCH_IDENTITY: Placed as is.
+ * @RINGBUF_STITCH_FLIP_X: Columns mirrored.
+ * @RINGBUF_STITCH_FLIP_Y: Rows mirrored.
+ * @RINGBUF_STITCH_ROTATE_90: Rotated a quarter turn clockwise.
+ * @RINGBUF_STITCH_ROTATE_180: Rotated a half turn.
+ * @RINGBUF_STITCH_ROTATE_270: Rotated a quarter turn counterclockwise.
+ *
+ * How a module's sub-frame is turned when placed in the full frame. Quarter
+ * turns swap its width and height.
+ */
+typedef enum {
+    RINGBUF_STITCH_IDENTITY,
+    RINGBUF_STITCH_FLIP_X,
+    RINGBUF_STITCH_FLIP_Y,
+    RINGBUF_STITCH_ROTATE_90,
+    RINGBUF_STITCH_ROTATE_180,
+    RINGBUF_STITCH_ROTATE_270,
+} ringbuf_stitch_orientation_t;
+
+/**
+ * ringbuf_stitch_module_t:
+ * @x: First column of the module in the full frame, after orientation.
+ * @y: First row of the module in the full frame, after orientation.
+ * @orientation: How the sub-frame is turned.
+ *
+ * Placement of one module.
+ */
+typedef struct {
+    guint x;
+    guint y;
+    ringbuf_stitch_orientation_t orientation;
+} ringbuf_stitch_module_t;
+
+/**
+ * ringbuf_stitcher_new:
+ * @module: Layout of every module's sub-frames.
+ * @modules: Placement of each module.
+ * @nb_modules: Number of @modules.
+ * @width: Width of the full frame.
+ * @height: Height of the full frame.
+ * @depth: Number of full frames the output ring holds.
+ *
+ * Creates a stitching stage assembling sub-frames into full frames reserved
+ * in an output frame ring. Pixels covered by no module are zero. Returns
+ * NULL if a module does not fit in the full frame or overlaps another one.
+ */
+ringbuf_stitcher_t *ringbuf_stitcher_new (const ringbuf_frame_geometry_t *module,
+                                          const ringbuf_stitch_module_t *modules, guint nb_modules,
+                                          guint width, guint height, guint depth);
+
+/**
+ * ringbuf_stitcher_free:
+ * @st: A stitcher, stopped first if running. A partial frame is lost.
+ */
+void ringbuf_stitcher_free (ringbuf_stitcher_t *st);
+
+/**
+ * ringbuf_stitcher_output:
+ * @st: A stitcher.
+ *
+ * Returns the frame ring receiving the full frames. Owned by @st. Its
+ * sequence numbers count completed frames.
+ */
+ringbuf_frame_ring_t *ringbuf_stitcher_output (ringbuf_stitcher_t *st);
+
+/**
+ * ringbuf_stitcher_place:
+ * @st: A stitcher.
+ * @module: Index of the module in the placement table.
+ * @frame: Frame number the sub-frame belongs to.
+ * @pixels: The module's sub-frame.
+ *
+ * Places a sub-frame in the full frame being assembled. The full frame is
+ * committed once every module of @frame has been placed. A sub-frame of a
+ * later frame abandons the one being assembled, a sub-frame of an earlier
+ * frame is ignored. May block on a full output ring. Returns TRUE when a
+ * full frame was committed.
+ */
+gboolean ringbuf_stitcher_place (ringbuf_stitcher_t *st, guint module, guint64 frame, gconstpointer pixels);
+
+/**
+ * ringbuf_stitcher_nb_incomplete:
+ * @st: A stitcher.
+ *
+ * Returns the number of frames abandoned with missing modules.
+ */
+guint64 ringbuf_stitcher_nb_incomplete (const ringbuf_stitcher_t *st);
+
+/**
+ * ringbuf_stitcher_start:
+ * @st: A stitcher.
+ * @inputs: Frame rings of sub-frames.
+ * @nb_inputs: Number of @inputs, dividing the number of modules.
+ *
+ * Starts a thread taking sub-frames from @inputs in place until
+ * ringbuf_stitcher_stop(). Input i carries modules i, i + @nb_inputs,
+ * i + 2 * @nb_inputs... one after the other for every frame, so with one
+ * input per module its frame ids are the frame numbers. Sub-frames dropped by
+ * a full non-blocking input keep their frame id, so the frame they belong to
+ * is abandoned instead of stitched from sub-frames of other frames.
+ */
+void ringbuf_stitcher_start (ringbuf_stitcher_t *st, ringbuf_frame_ring_t **inputs, guint nb_inputs);
+
+/**
+ * ringbuf_stitcher_stop:
+ * @st: A stitcher.
+ *
+ * Stops the thread started by ringbuf_stitcher_start().
+ */
+void ringbuf_stitcher_stop (ringbuf_stitcher_t *st);
+
+#endif /* INCLUDED_RINGBUF_STITCH_H */
@@ -0,0 +1,97 @@
+/*
+ * Tiles of rows processed by a thread pool, see ringbuf-tiles.h.
+ */
+
+#include "ringbuf-tiles.h"
+
+typedef struct {
+    ringbuf_tiles_t *tiles;
+    guint index, first_row, nb_rows;
+} job_t;
+
+struct _ringbuf_tiles_t {
+    guint nb_threads;
+    GThreadPool *pool;
+    job_t *jobs;
+
+    ringbuf_tile_func func;
+    gpointer user_data;
+
+    GMutex mutex;
+    GCond done;
+    guint pending;
+};
+
+static void tiles_worker (gpointer data, gpointer user_data) {
+    job_t *job = data;
+    ringbuf_tiles_t *tiles = user_data;
+
+    tiles->func (job->index, job->first_row, job->nb_rows, tiles->user_data);
+
+    g_mutex_lock (&tiles->mutex);
+    if (--tiles->pending == 0) {
+        g_cond_signal (&tiles->done);
+    }
+    g_mutex_unlock (&tiles->mutex);
+}
+
+ringbuf_tiles_t *ringbuf_tiles_new (guint nb_threads) {
+    ringbuf_tiles_t *tiles = g_new0 (ringbuf_tiles_t, 1);
+
+    tiles->nb_threads = MAX(nb_threads, 1);
+    tiles->jobs = g_new0 (job_t, tiles->nb_threads);
+    g_mutex_init (&tiles->mutex);
+    g_cond_init (&tiles->done);
+    if (tiles->nb_threads > 1) {
+        tiles->pool = g_thread_pool_new (tiles_worker, tiles, tiles->nb_threads - 1, TRUE, NULL);
+    }
+    return tiles;
+}
+
+void ringbuf_tiles_free (ringbuf_tiles_t *tiles) {
+    if (tiles == NULL) {
+        return;
+    }
+    if (tiles->pool != NULL) {
+        g_thread_pool_free (tiles->pool, FALSE, TRUE);
+    }
+    g_mutex_clear (&tiles->mutex);
+    g_cond_clear (&tiles->done);
+    g_free (tiles->jobs);
+    g_free (tiles);
+}
+
+guint ringbuf_tiles_nb_threads (const ringbuf_tiles_t *tiles) {
+    return tiles->nb_threads;
+}
+
+guint ringbuf_tiles_run (ringbuf_tiles_t *tiles, guint nb_rows, guint nb_tiles, ringbuf_tile_func func,
+                         gpointer user_data) {
+    nb_tiles = MAX(MIN(MIN(nb_tiles, tiles->nb_threads), nb_rows), 1);
+    tiles->func = func;
+    tiles->user_data = user_data;
+
+    // The first tiles take the remainder rows
+    guint row = 0;
+    for (guint t = 0; t < nb_tiles; t++) {
+        tiles->jobs[t].tiles = tiles;
+        tiles->jobs[t].index = t;
+        tiles->jobs[t].first_row = row;
+        tiles->jobs[t].nb_rows = nb_rows / nb_tiles + (t < nb_rows % nb_tiles ? 1 : 0);
+        row += tiles->jobs[t].nb_rows;
+    }
+
+    tiles->pending = nb_tiles - 1;
+    for (guint t = 1; t < nb_tiles; t++) {
+        g_thread_pool_push (tiles->pool, &tiles->jobs[t], NULL);
+    }
+    func (0, tiles->jobs[0].first_row, tiles->jobs[0].nb_rows, user_data);
+
+    g_mutex_lock (&tiles->mutex);
+    while (tiles->pending > 0) {
+        g_cond_wait (&tiles->done, &tiles->mutex);
+    }
+    g_mutex_unlock (&tiles->mutex);
+
+    return nb_tiles;
+}
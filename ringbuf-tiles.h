@@ -0,0 +1,27 @@
+#ifndef INCLUDED_RINGBUF_TILES_H
+#define INCLUDED_RINGBUF_TILES_H
+
+/*
+ * Private helper splitting frame processing in tiles of rows over a small
+ * thread pool. The calling thread always handles the first tile.
+ */
+
+#include <glib.h>
+
+typedef struct _ringbuf_tiles_t ringbuf_tiles_t;
+
+typedef void (*ringbuf_tile_func) (guint tile, guint first_row, guint nb_rows, gpointer user_data);
+
+ringbuf_tiles_t *ringbuf_tiles_new (guint nb_threads);
+void ringbuf_tiles_free (ringbuf_tiles_t *tiles);
+guint ringbuf_tiles_nb_threads (const ringbuf_tiles_t *tiles);
+
+/*
+ * Runs @func on @nb_tiles tiles of @nb_rows rows and waits for all of them.
+ * @nb_tiles is clamped to the number of threads and rows. Returns the number
+ * of tiles actually used, tile indices go from 0 to that number minus one.
+ */
+guint ringbuf_tiles_run (ringbuf_tiles_t *tiles, guint nb_rows, guint nb_tiles, ringbuf_tile_func func,
+                         gpointer user_data);
+
+#endif /* INCLUDED_RINGBUF_TILES_H */
@@ -0,0 +1,228 @@
+/*
+ * Orientation changes on copy.
+ *
+ * Flips and the half turn keep rows together and copy them forwards or
+ * backwards with vector moves. Transposes and quarter turns read rows and
+ * write columns, which touches a new cache line for every pixel when done
+ * naively. They go instead through blocks of BLOCK x BLOCK pixels, small
+ * enough for the source and destination lines of a block to stay in the L1
+ * cache, and within a block through square tiles of one vector per row,
+ * transposed in registers by log2(lanes) rounds of two-vector shuffles.
+ * Quarter turns differ from the transpose by the order rows are loaded in or
+ * the order columns are stored in, never by an extra shuffle.
+ */
+
+#include "ringbuf-transform.h"
+#include "ringbuf-simd.h"
+
+// Side of the cache blocks, in pixels
+#define BLOCK 64
+
+#define REVERSE_U8 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, \
+                   15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+#define REVERSE_U16 30, 31, 28, 29, 26, 27, 24, 25, 22, 23, 20, 21, 18, 19, 16, 17, \
+                    14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+#define REVERSE_U32 28, 29, 30, 31, 24, 25, 26, 27, 20, 21, 22, 23, 16, 17, 18, 19, \
+                    12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+
+/*
+ * Round g of a transpose swaps the g x g blocks off the diagonal of every
+ * 2g x 2g block: row i keeps its lanes without bit g and takes those of row
+ * i + g, shifted down by g, and the other way around.
+ */
+#define LO8_4 0, 1, 2, 3, 8, 9, 10, 11
+#define HI8_4 4, 5, 6, 7, 12, 13, 14, 15
+#define LO8_2 0, 1, 8, 9, 4, 5, 12, 13
+#define HI8_2 2, 3, 10, 11, 6, 7, 14, 15
+#define LO8_1 0, 8, 2, 10, 4, 12, 6, 14
+#define HI8_1 1, 9, 3, 11, 5, 13, 7, 15
+
+#define LO16_8 0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23
+#define HI16_8 8, 9, 10, 11, 12, 13, 14, 15, 24, 25, 26, 27, 28, 29, 30, 31
+#define LO16_4 0, 1, 2, 3, 16, 17, 18, 19, 8, 9, 10, 11, 24, 25, 26, 27
+#define HI16_4 4, 5, 6, 7, 20, 21, 22, 23, 12, 13, 14, 15, 28, 29, 30, 31
+#define LO16_2 0, 1, 16, 17, 4, 5, 20, 21, 8, 9, 24, 25, 12, 13, 28, 29
+#define HI16_2 2, 3, 18, 19, 6, 7, 22, 23, 10, 11, 26, 27, 14, 15, 30, 31
+#define LO16_1 0, 16, 2, 18, 4, 20, 6, 22, 8, 24, 10, 26, 12, 28, 14, 30
+#define HI16_1 1, 17, 3, 19, 5, 21, 7, 23, 9, 25, 11, 27, 13, 29, 15, 31
+
+#define TRANSPOSE_ROUND(v, vec, lanes, g, lo, hi)                                        \
+    RINGBUF_SIMD_UNROLL                                                                  \
+    for (guint i = 0; i < (lanes); i++) {                                                \
+        if (!(i & (g))) {                                                                \
+            vec a = v[i], b = v[i + (g)];                                                \
+            v[i] = RINGBUF_SIMD_SHUFFLE2 (a, b, vec, lo);                                \
+            v[i + (g)] = RINGBUF_SIMD_SHUFFLE2 (a, b, vec, hi);                          \
+        }                                                                                \
+    }
+
+#define TRANSPOSE_8(v, vec)                                                              \
+    TRANSPOSE_ROUND(v, vec, 8, 4, LO8_4, HI8_4)                                          \
+    TRANSPOSE_ROUND(v, vec, 8, 2, LO8_2, HI8_2)                                          \
+    TRANSPOSE_ROUND(v, vec, 8, 1, LO8_1, HI8_1)
+
+#define TRANSPOSE_16(v, vec)                                                             \
+    TRANSPOSE_ROUND(v, vec, 16, 8, LO16_8, HI16_8)                                       \
+    TRANSPOSE_ROUND(v, vec, 16, 4, LO16_4, HI16_4)                                       \
+    TRANSPOSE_ROUND(v, vec, 16, 2, LO16_2, HI16_2)                                       \
+    TRANSPOSE_ROUND(v, vec, 16, 1, LO16_1, HI16_1)
+
+// One row to @dst onwards, or to @dst backwards if @reverse
+#define DEFINE_COPY_ROW(type, reverse_bytes)                                             \
+RINGBUF_SIMD_CLONES                                                                      \
+static void copy_row_##type (const type *src, type *dst, gsize n, gboolean reverse) {    \
+    const gsize lanes = RINGBUF_SIMD_BYTES / sizeof(type);                              \
+    gsize i = 0;                                                                         \
+    if (!reverse) {                                                                      \
+        memcpy (dst, src, n * sizeof(type));                                             \
+        return;                                                                          \
+    }                                                                                    \
+    for (; i + lanes <= n; i += lanes) {                                                 \
+        ringbuf_vu8 v = *(const ringbuf_vu8 *) (src + i);                                \
+        *(ringbuf_vu8 *) (dst - i - (lanes - 1)) = RINGBUF_SIMD_SHUFFLE_U8 (v, reverse_bytes); \
+    }                                                                                    \
+    for (; i < n; i++) {                                                                 \
+        *(dst - i) = src[i];                                                             \
+    }                                                                                    \
+}
+
+DEFINE_COPY_ROW(guint8, REVERSE_U8)
+DEFINE_COPY_ROW(guint16, REVERSE_U16)
+DEFINE_COPY_ROW(guint32, REVERSE_U32)
+
+/*
+ * Transpose or quarter turn of a w x h frame. Source column x lands on
+ * destination row x (transpose, clockwise turn) or w - 1 - x (counter-clockwise
+ * turn), source row y on destination column y, or h - 1 - y for the clockwise
+ * turn.
+ */
+#define DEFINE_TURN(type, vec, lanes, TRANSPOSE)                                         \
+RINGBUF_SIMD_CLONES                                                                      \
+static void turn_##type (const type *src, guint w, guint h, type *dst, gsize stride,     \
+                         ringbuf_transform_t transform) {                                \
+    const gboolean clockwise = transform == RINGBUF_TRANSFORM_ROTATE_90;                 \
+    const gboolean counter = transform == RINGBUF_TRANSFORM_ROTATE_270;                  \
+    const guint bw = w - w % (lanes), bh = h - h % (lanes);                              \
+    for (guint y0 = 0; y0 < bh; y0 += BLOCK) {                                           \
+        for (guint x0 = 0; x0 < bw; x0 += BLOCK) {                                       \
+            for (guint x = x0; x < MIN(x0 + BLOCK, bw); x += (lanes)) {                  \
+                for (guint y = y0; y < MIN(y0 + BLOCK, bh); y += (lanes)) {              \
+                    vec v[lanes];                                                        \
+                    /* Bottom up for the clockwise turn, columns come out reversed */    \
+                    RINGBUF_SIMD_UNROLL                                                  \
+                    for (guint r = 0; r < (lanes); r++) {                                \
+                        guint row = clockwise ? y + (lanes) - 1 - r : y + r;             \
+                        v[r] = *(const vec *) (src + (gsize) row * w + x);               \
+                    }                                                                    \
+                    TRANSPOSE(v, vec)                                                    \
+                    gsize column = clockwise ? h - (lanes) - y : y;                      \
+                    RINGBUF_SIMD_UNROLL                                                  \
+                    for (guint c = 0; c < (lanes); c++) {                                \
+                        gsize row = counter ? w - 1 - x - c : x + c;                     \
+                        *(vec *) (dst + row * stride + column) = v[c];                   \
+                    }                                                                    \
+                }                                                                        \
+            }                                                                            \
+        }                                                                                \
+    }                                                                                    \
+    /* Right and bottom edges, less than a tile wide */                                  \
+    for (guint y = 0; y < h; y++) {                                                      \
+        for (guint x = y < bh ? bw : 0; x < w; x++) {                                    \
+            gsize row = counter ? w - 1 - x : x, column = clockwise ? h - 1 - y : y;     \
+            dst[row * stride + column] = src[(gsize) y * w + x];                         \
+        }                                                                                \
+    }                                                                                    \
+}
+
+// Tiles of at most 16 bytes per row for narrow pixels, whose rows then all fit in registers
+DEFINE_TURN(guint8, ringbuf_vu8x16, 16, TRANSPOSE_16)
+DEFINE_TURN(guint16, ringbuf_vu16x8, 8, TRANSPOSE_8)
+DEFINE_TURN(guint32, ringbuf_vu32, 8, TRANSPOSE_8)
+
+static gboolean is_turn (ringbuf_transform_t transform) {
+    return transform == RINGBUF_TRANSFORM_TRANSPOSE || transform == RINGBUF_TRANSFORM_ROTATE_90 ||
+           transform == RINGBUF_TRANSFORM_ROTATE_270;
+}
+
+void ringbuf_transform_geometry (const ringbuf_frame_geometry_t *geometry, ringbuf_transform_t transform,
+                                 ringbuf_frame_geometry_t *result) {
+    *result = *geometry;
+    if (is_turn (transform)) {
+        result->width = geometry->height;
+        result->height = geometry->width;
+    }
+}
+
+void ringbuf_transform_copy (const ringbuf_frame_geometry_t *geometry, ringbuf_transform_t transform,
+                             gconstpointer src, gpointer dst, gsize dst_stride) {
+    guint w = geometry->width, h = geometry->height, bpp = geometry->bytes_per_pixel;
+
+    if (is_turn (transform)) {
+        switch (bpp) {
+        case 1:
+            turn_guint8 (src, w, h, dst, dst_stride, transform);
+            break;
+        case 2:
+            turn_guint16 (src, w, h, dst, dst_stride, transform);
+            break;
+        default:
+            turn_guint32 (src, w, h, dst, dst_stride, transform);
+            break;
+        }
+        return;
+    }
+
+    gboolean flip_y = transform == RINGBUF_TRANSFORM_FLIP_Y || transform == RINGBUF_TRANSFORM_ROTATE_180;
+    gboolean reverse = transform == RINGBUF_TRANSFORM_FLIP_X || transform == RINGBUF_TRANSFORM_ROTATE_180;
+    for (guint y = 0; y < h; y++) {
+        const guint8 *row = (const guint8 *) src + (gsize) y * w * bpp;
+        guint8 *out = (guint8 *) dst + ((flip_y ? h - 1 - y : y) * dst_stride + (reverse ? w - 1 : 0)) * bpp;
+        switch (bpp) {
+        case 1:
+            copy_row_guint8 (row, out, w, reverse);
+            break;
+        case 2:
+            copy_row_guint16 ((const guint16 *) row, (guint16 *) out, w, reverse);
+            break;
+        default:
+            copy_row_guint32 ((const guint32 *) row, (guint32 *) out, w, reverse);
+            break;
+        }
+    }
+}
+
+void ringbuf_transform_pop (ringbuf_frame_ring_t *fr, ringbuf_transform_t transform, gpointer dst,
+                            ringbuf_frame_meta_t *meta) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (fr);
+    ringbuf_frame_geometry_t result;
+
+    ringbuf_transform_geometry (geometry, transform, &result);
+    ringbuf_transform_copy (geometry, transform, ringbuf_frame_ring_acquire (fr, meta), dst, result.width);
+    ringbuf_frame_ring_release (fr);
+}
+
+gboolean ringbuf_transform_pop_to_ring (ringbuf_frame_ring_t *fr, ringbuf_transform_t transform,
+                                        ringbuf_frame_ring_t *dst, ringbuf_frame_meta_t *meta) {
+    const ringbuf_frame_geometry_t *geometry = ringbuf_frame_ring_geometry (fr);
+    const ringbuf_frame_geometry_t *target = ringbuf_frame_ring_geometry (dst);
+    ringbuf_frame_geometry_t result;
+
+    ringbuf_transform_geometry (geometry, transform, &result);
+    if (result.width != target->width || result.height != target->height ||
+        result.bytes_per_pixel != target->bytes_per_pixel) {
+        g_warning ("Transformed frames do not match the destination ring geometry");
+        return FALSE;
+    }
+    // Reserve first, so a full non-blocking dst never gets written through
+    gpointer slot = ringbuf_frame_ring_reserve (dst);
+    gconstpointer pixels = ringbuf_frame_ring_acquire (fr, meta);
+    if (slot == NULL) {
+        // Dropped and counted by dst, like a push to a full ring
+        ringbuf_frame_ring_release (fr);
+        return FALSE;
+    }
+    ringbuf_transform_copy (geometry, transform, pixels, slot, result.width);
+    ringbuf_frame_ring_commit (dst);
+    ringbuf_frame_ring_release (fr);
+    return TRUE;
+}
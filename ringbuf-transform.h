@@ -0,0 +1,85 @@
+#ifndef INCLUDED_RINGBUF_TRANSFORM_H
+#define INCLUDED_RINGBUF_TRANSFORM_H
+
+#include "ringbuf-frame.h"
+
+/**
+ * ringbuf_transform_t:
+ * @RINGBUF_TRANSFORM_IDENTITY: Plain copy.
+ * @RINGBUF_TRANSFORM_FLIP_X: Mirrored left to right.
+ * @RINGBUF_TRANSFORM_FLIP_Y: Mirrored top to bottom.
+ * @RINGBUF_TRANSFORM_TRANSPOSE: Rows become columns, pixel (x, y) moves to
+ *   (y, x).
+ * @RINGBUF_TRANSFORM_ROTATE_90: Quarter turn clockwise.
+ * @RINGBUF_TRANSFORM_ROTATE_180: Half turn.
+ * @RINGBUF_TRANSFORM_ROTATE_270: Quarter turn counter-clockwise.
+ *
+ * Orientation changes applied while copying a frame. Transposes and quarter
+ * turns swap the width and height.
+ */
+typedef enum {
+    RINGBUF_TRANSFORM_IDENTITY,
+    RINGBUF_TRANSFORM_FLIP_X,
+    RINGBUF_TRANSFORM_FLIP_Y,
+    RINGBUF_TRANSFORM_TRANSPOSE,
+    RINGBUF_TRANSFORM_ROTATE_90,
+    RINGBUF_TRANSFORM_ROTATE_180,
+    RINGBUF_TRANSFORM_ROTATE_270,
+} ringbuf_transform_t;
+
+/**
+ * ringbuf_transform_geometry:
+ * @geometry: Layout of the source frames.
+ * @transform: A transform.
+ * @result: Set to the layout of the transformed frames.
+ */
+void ringbuf_transform_geometry (const ringbuf_frame_geometry_t *geometry, ringbuf_transform_t transform,
+                                 ringbuf_frame_geometry_t *result);
+
+/**
+ * ringbuf_transform_copy:
+ * @geometry: Layout of @src.
+ * @transform: A transform.
+ * @src: One frame.
+ * @dst: Receives the transformed frame, must not overlap @src.
+ * @dst_stride: Pixels from one row of @dst to the next, at least the width
+ *   of the transformed frame, to write into a larger frame.
+ *
+ * Copies a frame with a change of orientation. Transposes and quarter turns
+ * go through blocks that fit in the L1 cache, each made of tiles transposed
+ * in vector registers.
+ */
+void ringbuf_transform_copy (const ringbuf_frame_geometry_t *geometry, ringbuf_transform_t transform,
+                             gconstpointer src, gpointer dst, gsize dst_stride);
+
+/**
+ * ringbuf_transform_pop:
+ * @fr: A frame ring.
+ * @transform: A transform.
+ * @dst: Room for one frame.
+ * @meta: Filled with the frame's metadata, may be NULL.
+ *
+ * Same as ringbuf_frame_ring_pop() but transforms the frame on the way, see
+ * ringbuf_transform_copy().
+ */
+void ringbuf_transform_pop (ringbuf_frame_ring_t *fr, ringbuf_transform_t transform, gpointer dst,
+                            ringbuf_frame_meta_t *meta);
+
+/**
+ * ringbuf_transform_pop_to_ring:
+ * @fr: A frame ring.
+ * @transform: A transform.
+ * @dst: A frame ring with the transformed geometry.
+ * @meta: Filled with the source frame's metadata, may be NULL.
+ *
+ * Same as ringbuf_transform_pop() but writes straight into a reserved slot
+ * of @dst, and commits it. The slot is reserved before the source frame is
+ * acquired. A full blocking @dst blocks. With a full non-blocking @dst, the
+ * source frame is consumed and dropped, counted in @dst's drops, and FALSE is
+ * returned. Returns FALSE without consuming a frame if the geometry of @dst
+ * does not match.
+ */
+gboolean ringbuf_transform_pop_to_ring (ringbuf_frame_ring_t *fr, ringbuf_transform_t transform,
+                                        ringbuf_frame_ring_t *dst, ringbuf_frame_meta_t *meta);
+
+#endif /* INCLUDED_RINGBUF_TRANSFORM_H */
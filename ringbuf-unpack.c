@@ -0,0 +1,136 @@
+/*
+ * Unpacking of bit-packed 10 and 12-bit pixels.
+ *
+ * Each vector step loads 32 bytes and unpacks the first 16 pixels in them: a
+ * byte shuffle puts the two bytes holding every pixel in its 16-bit lane,
+ * then per-lane shifts and masks, selected by the pixel's position in its
+ * packing group, drop the neighbours' bits. The scalar loop handles the end
+ * of the input, where a full load would read past it, and is the reference
+ * the vector path is tested against.
+ *
+ * Without a byte shuffle instruction the compiler emulates it one lane at a
+ * time, which is slower than the scalar loop. On x86-64 the vector path is
+ * therefore built for AVX2 and only taken when the CPU has it.
+ */
+
+#include "ringbuf-unpack.h"
+#include "ringbuf-simd.h"
+
+#define BLOCK_PIXELS 16
+
+#if defined(RINGBUF_SIMD_AVX2)
+#define UNPACK_TARGET RINGBUF_SIMD_AVX2
+#define UNPACK_VECTORS __builtin_cpu_supports ("avx2")
+#elif defined(__aarch64__)
+#define UNPACK_TARGET
+#define UNPACK_VECTORS TRUE
+#else
+#define UNPACK_TARGET
+#define UNPACK_VECTORS FALSE
+#endif
+
+static guint packing_bits (ringbuf_packing_t packing) {
+    return packing == RINGBUF_PACKING_MONO10P ? 10 : 12;
+}
+
+gsize ringbuf_unpack_packed_size (ringbuf_packing_t packing, gsize nb_pixels) {
+    return (nb_pixels * packing_bits (packing) + 7) / 8;
+}
+
+// 16 pixels from 20 bytes, shifted by 0, 2, 4 or 6 bits in their lane
+static inline void block_mono10p (const guint8 *src, ringbuf_vu16 *out) {
+    const ringbuf_vu16 m0 = {0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0};
+    const ringbuf_vu16 m1 = {0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0};
+    const ringbuf_vu16 m2 = {0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0};
+    const ringbuf_vu16 m3 = {0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff, 0, 0, 0, 0x3ff};
+    ringbuf_vu8 bytes = *(const ringbuf_vu8 *) src;
+    ringbuf_vu16 w = (ringbuf_vu16) RINGBUF_SIMD_SHUFFLE_U8 (bytes,
+        0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9,
+        10, 11, 11, 12, 12, 13, 13, 14, 15, 16, 16, 17, 17, 18, 18, 19);
+    *out = (w & m0) | ((w >> 2) & m1) | ((w >> 4) & m2) | ((w >> 6) & m3);
+}
+
+// 16 pixels from 24 bytes, odd ones shifted by 4 bits in their lane
+static inline void block_mono12p (const guint8 *src, ringbuf_vu16 *out) {
+    const ringbuf_vu16 even = {0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0};
+    const ringbuf_vu16 odd = {0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff};
+    ringbuf_vu8 bytes = *(const ringbuf_vu8 *) src;
+    ringbuf_vu16 w = (ringbuf_vu16) RINGBUF_SIMD_SHUFFLE_U8 (bytes,
+        0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+        12, 13, 13, 14, 15, 16, 16, 17, 18, 19, 19, 20, 21, 22, 22, 23);
+    *out = (w & even) | ((w >> 4) & odd);
+}
+
+#define STORE_U16(dst, v) (*(ringbuf_vu16 *) (dst) = (v))
+#define STORE_F32(dst, v) (*(ringbuf_vf32x16 *) (dst) = __builtin_convertvector ((v), ringbuf_vf32x16))
+
+// Returns the number of pixels unpacked, a multiple of BLOCK_PIXELS
+#define DEFINE_UNPACK(name, block, block_bytes, out_type, store)                        \
+UNPACK_TARGET                                                                            \
+static gsize name (const guint8 *src, gsize packed_size, gsize nb_pixels, out_type *dst) { \
+    gsize i = 0, in = 0;                                                                 \
+    for (; i + BLOCK_PIXELS <= nb_pixels && in + RINGBUF_SIMD_BYTES <= packed_size;      \
+         i += BLOCK_PIXELS, in += block_bytes) {                                         \
+        ringbuf_vu16 pixels;                                                             \
+        block (src + in, &pixels);                                                       \
+        store (dst + i, pixels);                                                         \
+    }                                                                                    \
+    return i;                                                                            \
+}
+
+DEFINE_UNPACK(unpack_mono10p_u16, block_mono10p, 20, guint16, STORE_U16)
+DEFINE_UNPACK(unpack_mono12p_u16, block_mono12p, 24, guint16, STORE_U16)
+DEFINE_UNPACK(unpack_mono10p_f32, block_mono10p, 20, gfloat, STORE_F32)
+DEFINE_UNPACK(unpack_mono12p_f32, block_mono12p, 24, gfloat, STORE_F32)
+
+// Pixels from @first on, each read from the two bytes it overlaps
+#define DEFINE_UNPACK_SCALAR(name, out_type)                                             \
+static void name (guint bits, const guint8 *src, gsize first, gsize nb_pixels, out_type *dst) { \
+    const guint mask = (1 << bits) - 1;                                                  \
+    for (gsize i = first; i < nb_pixels; i++) {                                          \
+        gsize bit = i * bits;                                                            \
+        guint w = src[bit / 8] | (guint) src[bit / 8 + 1] << 8;                          \
+        dst[i] = (w >> (bit % 8)) & mask;                                                \
+    }                                                                                    \
+}
+
+DEFINE_UNPACK_SCALAR(unpack_scalar_u16, guint16)
+DEFINE_UNPACK_SCALAR(unpack_scalar_f32, gfloat)
+
+void ringbuf_unpack_u16 (ringbuf_packing_t packing, gconstpointer src, gsize nb_pixels, guint16 *dst) {
+    gsize size = ringbuf_unpack_packed_size (packing, nb_pixels);
+    gsize done = 0;
+
+    if (UNPACK_VECTORS) {
+        done = packing == RINGBUF_PACKING_MONO10P ? unpack_mono10p_u16 (src, size, nb_pixels, dst)
+                                                  : unpack_mono12p_u16 (src, size, nb_pixels, dst);
+    }
+    unpack_scalar_u16 (packing_bits (packing), src, done, nb_pixels, dst);
+}
+
+void ringbuf_unpack_f32 (ringbuf_packing_t packing, gconstpointer src, gsize nb_pixels, gfloat *dst) {
+    gsize size = ringbuf_unpack_packed_size (packing, nb_pixels);
+    gsize done = 0;
+
+    if (UNPACK_VECTORS) {
+        done = packing == RINGBUF_PACKING_MONO10P ? unpack_mono10p_f32 (src, size, nb_pixels, dst)
+                                                  : unpack_mono12p_f32 (src, size, nb_pixels, dst);
+    }
+    unpack_scalar_f32 (packing_bits (packing), src, done, nb_pixels, dst);
+}
+
+void ringbuf_unpack_pop_u16 (ringbuf_t *rb, ringbuf_packing_t packing, gsize nb_pixels, guint16 *dst) {
+    gsize size = ringbuf_unpack_packed_size (packing, nb_pixels);
+
+    ringbuf_wait_for_data (rb, size);
+    ringbuf_unpack_u16 (packing, ringbuf_tail (rb), nb_pixels, dst);
+    ringbuf_move_tail (rb, size);
+}
+
+void ringbuf_unpack_pop_f32 (ringbuf_t *rb, ringbuf_packing_t packing, gsize nb_pixels, gfloat *dst) {
+    gsize size = ringbuf_unpack_packed_size (packing, nb_pixels);
+
+    ringbuf_wait_for_data (rb, size);
+    ringbuf_unpack_f32 (packing, ringbuf_tail (rb), nb_pixels, dst);
+    ringbuf_move_tail (rb, size);
+}
@@ -0,0 +1,73 @@
+#ifndef INCLUDED_RINGBUF_UNPACK_H
+#define INCLUDED_RINGBUF_UNPACK_H
+
+#include "ringbuf.h"
+
+/**
+ * ringbuf_packing_t:
+ * @RINGBUF_PACKING_MONO10P: 10-bit pixels, 4 in 5 bytes, least significant
+ *   bits first as in the GenICam Mono10p format.
+ * @RINGBUF_PACKING_MONO12P: 12-bit pixels, 2 in 3 bytes, least significant
+ *   bits first as in the GenICam Mono12p format.
+ */
+typedef enum {
+    RINGBUF_PACKING_MONO10P,
+    RINGBUF_PACKING_MONO12P,
+} ringbuf_packing_t;
+
+/**
+ * ringbuf_unpack_packed_size:
+ * @packing: Packing of the pixels.
+ * @nb_pixels: Number of pixels.
+ *
+ * Returns the number of bytes taken by @nb_pixels packed pixels, the last
+ * byte being padded with zero bits.
+ */
+gsize ringbuf_unpack_packed_size (ringbuf_packing_t packing, gsize nb_pixels);
+
+/**
+ * ringbuf_unpack_u16:
+ * @packing: Packing of @src.
+ * @src: ringbuf_unpack_packed_size() bytes of packed pixels.
+ * @nb_pixels: Number of pixels.
+ * @dst: Room for @nb_pixels pixels.
+ *
+ * Unpacks pixels to 16-bit integers, e.g. on a span of an acquired frame.
+ */
+void ringbuf_unpack_u16 (ringbuf_packing_t packing, gconstpointer src, gsize nb_pixels, guint16 *dst);
+
+/**
+ * ringbuf_unpack_f32:
+ * @packing: Packing of @src.
+ * @src: ringbuf_unpack_packed_size() bytes of packed pixels.
+ * @nb_pixels: Number of pixels.
+ * @dst: Room for @nb_pixels pixels.
+ *
+ * Same as ringbuf_unpack_u16() with single precision float pixels.
+ */
+void ringbuf_unpack_f32 (ringbuf_packing_t packing, gconstpointer src, gsize nb_pixels, gfloat *dst);
+
+/**
+ * ringbuf_unpack_pop_u16:
+ * @rb: A ring buffer holding packed pixels.
+ * @packing: Packing of the pixels.
+ * @nb_pixels: Number of pixels to read.
+ * @dst: Room for @nb_pixels pixels.
+ *
+ * Blocks until ringbuf_unpack_packed_size() bytes are available, unpacks them
+ * straight from the ring to @dst and moves the tail. For a single consumer.
+ */
+void ringbuf_unpack_pop_u16 (ringbuf_t *rb, ringbuf_packing_t packing, gsize nb_pixels, guint16 *dst);
+
+/**
+ * ringbuf_unpack_pop_f32:
+ * @rb: A ring buffer holding packed pixels.
+ * @packing: Packing of the pixels.
+ * @nb_pixels: Number of pixels to read.
+ * @dst: Room for @nb_pixels pixels.
+ *
+ * Same as ringbuf_unpack_pop_u16() with single precision float pixels.
+ */
+void ringbuf_unpack_pop_f32 (ringbuf_t *rb, ringbuf_packing_t packing, gsize nb_pixels, gfloat *dst);
+
+#endif /* INCLUDED_RINGBUF_UNPACK_H */
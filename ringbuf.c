@@ -8,6 +8,7 @@
  */
 
 #include "ringbuf.h"
+#include "ringbuf-private.h"
 
 #ifndef likely
 #define likely(x)    __builtin_expect(!!(x), 1)
@@ -25,10 +26,35 @@ struct _ringbuf_t {
     gsize head, tail, buffer_size, reserved_size;
     GMutex mutex;
     GCond readable, writeable;
+    // Threads blocked on each condition, so commits and pops only signal when someone waits
+    guint readers_waiting, writers_waiting;
     gboolean block_on_full, full;
     GAsyncQueue *message_queue;
+    guint id;
+    gchar *name;
+    ringbuf_stats_t stats;
+    // Gives the memory back instead of unmapping it, for rings carved out of an arena
+    ringbuf_unmap_func unmap;
+    gpointer unmap_data;
+    /* Small rings live in a plain array followed by as many bounce bytes, in
+     * place of the page-granular mirror mapping. Copies split at the wrap, and
+     * in-place spans that straddle it are stitched through the bounce bytes.
+     */
+    gboolean compact;
 };
 
+/* Stats are only written with the ring mutex held, so a relaxed load/store is
+ * enough to let ringbuf_get_stats() read them without taking the lock.
+ */
+#define STATS_GET(field)    __atomic_load_n (&(field), __ATOMIC_RELAXED)
+#define STATS_SET(field, v) __atomic_store_n (&(field), (v), __ATOMIC_RELAXED)
+#define STATS_ADD(field, n) STATS_SET (field, (field) + (n))
+
+// Registry of live rings, used for introspection and by the stats exporter
+static GMutex registry_mutex;
+static GList *registry = NULL;
+static guint registry_next_id = 1;
+
 /** Convenience wrapper around memfd_create syscall, because apparently this is
   * so scary that glibc doesn't provide it...
   */
@@ -38,10 +64,72 @@ static inline int memfd_create(const char *name, unsigned int flags) {
 }
 #endif
 
+/* Sets up a ring over @buffer, @s bytes mapped twice in a row, and adds it
+ * to the registry. Takes @ring_name.
+ */
+static ringbuf_t *ringbuf_init (gchar *ring_name, guint8 *buffer, gint fd, gsize s, gboolean block) {
+    ringbuf_t *rb = g_new0(ringbuf_t, 1);
+    if (rb == NULL) {
+        g_warning ("Failed to allocate memory for ring buffer");
+        return NULL;
+    }
+
+    // Init the condition variables
+    g_cond_init(&rb->readable);
+    g_cond_init(&rb->writeable);
+
+    // Init the mutex
+    g_mutex_init(&rb->mutex);
+    
+    /* One byte is used for detecting the full condition. */
+    rb->buffer_size = s;
+    rb->buf = buffer;
+    rb->fd = fd;
+    rb->head = rb->tail = 0;
+    rb->block_on_full = block;
+    rb->name = ring_name;
+    rb->stats.capacity = s;
+
+    g_mutex_lock(&registry_mutex);
+    rb->id = registry_next_id++;
+    registry = g_list_append(registry, rb);
+    g_mutex_unlock(&registry_mutex);
+    
+    return rb;
+}
+
+static void ringbuf_compact_free (gpointer buffer, gsize size, gpointer user_data) {
+    (void) size, (void) user_data;
+    free (buffer);
+}
+
+/* Rings smaller than a page would still cost two pages of memfd and four of
+ * address space. They get an array of @size rounded to a cache line instead.
+ */
+static ringbuf_t *ringbuf_new_compact (const gchar *name, gsize size, gboolean block) {
+    gsize s = (size + RINGBUF_COMPACT_ALIGN - 1) / RINGBUF_COMPACT_ALIGN * RINGBUF_COMPACT_ALIGN;
+    gpointer buffer = NULL;
+
+    if (posix_memalign (&buffer, RINGBUF_COMPACT_ALIGN, 2 * s) != 0) {
+        g_warning ("Failed to allocate memory for ring buffer");
+        return NULL;
+    }
+    ringbuf_t *rb = ringbuf_new_from_mapping (name, buffer, -1, s, block, ringbuf_compact_free, NULL);
+    rb->compact = TRUE;
+    return rb;
+}
+
 ringbuf_t *ringbuf_new (gsize size, gboolean block) {
+    return ringbuf_new_named (NULL, size, block);
+}
+
+ringbuf_t *ringbuf_new_named (const gchar *name, gsize size, gboolean block) {
     // Check that the requested size is a multiple of a page. If it isn't, we're in trouble.
     gsize s = size;
     gsize page_size = getpagesize();
+    if (s > 0 && s < page_size) {
+        return ringbuf_new_compact (name, size, block);
+    }
     if (s % page_size != 0) {
         if (s < page_size) {
             s = 2*page_size;
@@ -54,9 +142,13 @@ ringbuf_t *ringbuf_new (gsize size, gboolean block) {
     gint fd = -1;
     gpointer buffer = NULL;
 
+    // Names longer than the registry can hold are truncated, memfd takes at most 249 bytes anyway
+    gchar *ring_name = g_strndup(name != NULL ? name : "queue_region", RINGBUF_NAME_MAX - 1);
+
     // Create an anonymous file backed by memory
-    if((fd = memfd_create("queue_region", 0)) == -1){
-        g_warning ("Failed to create anonymous file");
+    if((fd = memfd_create(ring_name, 0)) == -1){
+        g_warning ("Failed to create anonymous file for ring %s", ring_name);
+        g_free(ring_name);
         return NULL;
     }
 
@@ -80,26 +172,15 @@ ringbuf_t *ringbuf_new (gsize size, gboolean block) {
         g_warning ("Could not map buffer into virtual memory");
     }
 
-    ringbuf_t *rb = g_new0(ringbuf_t, 1);
-    if (rb == NULL) {
-        g_warning ("Failed to allocate memory for ring buffer");
-        return NULL;
-    }
-
-    // Init the condition variables
-    g_cond_init(&rb->readable);
-    g_cond_init(&rb->writeable);
+    return ringbuf_init (ring_name, buffer, fd, s, block);
+}
 
-    // Init the mutex
-    g_mutex_init(&rb->mutex);
-    
-    /* One byte is used for detecting the full condition. */
-    rb->buffer_size = s;
-    rb->buf = buffer;
-    rb->fd = fd;
-    rb->head = rb->tail = 0;
-    rb->block_on_full = block;
-    
+ringbuf_t *ringbuf_new_from_mapping (const gchar *name, gpointer buffer, gint fd, gsize size, gboolean block,
+                                     ringbuf_unmap_func unmap, gpointer user_data) {
+    gchar *ring_name = g_strndup(name != NULL ? name : "queue_region", RINGBUF_NAME_MAX - 1);
+    ringbuf_t *rb = ringbuf_init (ring_name, buffer, fd, size, block);
+    rb->unmap = unmap;
+    rb->unmap_data = user_data;
     return rb;
 }
 
@@ -107,27 +188,47 @@ gsize ringbuf_buffer_size (const ringbuf_t *rb) {
     return rb->buffer_size;
 }
 
+guint ringbuf_id (const ringbuf_t *rb) {
+    return rb->id;
+}
+
+const gchar *ringbuf_name (const ringbuf_t *rb) {
+    return rb->name;
+}
+
 void ringbuf_reset (ringbuf_t *rb) {
     g_mutex_lock(&rb->mutex);
     rb->head = rb->tail = 0;
+    rb->full = FALSE;
+    STATS_SET(rb->stats.used, 0);
+    g_cond_broadcast(&rb->writeable);
     g_mutex_unlock(&rb->mutex);
 }
 
 void ringbuf_free (ringbuf_t *rb) {
     g_assert(rb);
 
+    g_mutex_lock(&registry_mutex);
+    registry = g_list_remove(registry, rb);
+    g_mutex_unlock(&registry_mutex);
+
     GString *error_msg = NULL;
 
-    if(munmap(rb->buf + rb->buffer_size, rb->buffer_size) != 0){
-        g_string_append(error_msg, "Could not unmap second buffer. ");
-    }
-    
-    if(munmap(rb->buf, rb->buffer_size) != 0){
-        g_string_append(error_msg, "Could not unmap buffer. ");
+    if (rb->unmap != NULL) {
+        rb->unmap (rb->buf, rb->buffer_size, rb->unmap_data);
     }
-    
-    if(close(rb->fd) != 0){
-        g_string_append(error_msg, "Could not close file descriptor. ");
+    else {
+        if(munmap(rb->buf + rb->buffer_size, rb->buffer_size) != 0){
+            g_string_append(error_msg, "Could not unmap second buffer. ");
+        }
+
+        if(munmap(rb->buf, rb->buffer_size) != 0){
+            g_string_append(error_msg, "Could not unmap buffer. ");
+        }
+
+        if(close(rb->fd) != 0){
+            g_string_append(error_msg, "Could not close file descriptor. ");
+        }
     }
 
     if (error_msg != NULL) {
@@ -139,12 +240,16 @@ void ringbuf_free (ringbuf_t *rb) {
     g_cond_clear(&rb->readable);
     g_cond_clear(&rb->writeable);
 
+    g_free(rb->name);
     g_free(rb);
 }
 
 static gsize ringbuf_bytes_free_unlocked (ringbuf_t *rb) {
     gsize free = 0;
-    if (rb->tail <= rb->head) {
+    if (rb->full) {
+        free = 0;
+    }
+    else if (rb->tail <= rb->head) {
         gsize used = rb->head - rb->tail;
         gsize total = rb->buffer_size;
         free = total - used;
@@ -159,6 +264,173 @@ static gsize ringbuf_bytes_used_unlocked (ringbuf_t *rb) {
     return rb->buffer_size - ringbuf_bytes_free_unlocked(rb);
 }
 
+static void ringbuf_record_latency (guint64 *histogram, guint64 *total, gint64 start) {
+    gint64 waited = start > 0 ? g_get_monotonic_time () - start : 0;
+    guint bucket = waited <= 0 ? 0 : MIN(g_bit_storage (waited), RINGBUF_LATENCY_BUCKETS - 1);
+    STATS_ADD(histogram[bucket], 1);
+    if (waited > 0) {
+        STATS_ADD(*total, waited);
+    }
+}
+
+/* Waits until @size bytes can be read. A negative @end_time waits forever.
+ * Returns FALSE if @end_time expired first.
+ */
+static gboolean ringbuf_wait_readable_unlocked (ringbuf_t *rb, gsize size, gint64 end_time) {
+    gint64 start = 0;
+    while (ringbuf_bytes_used_unlocked(rb) < size) {
+        if (start == 0) {
+            start = g_get_monotonic_time ();
+            STATS_ADD(rb->stats.consumer_waits, 1);
+        }
+        rb->readers_waiting++;
+        gboolean signalled = TRUE;
+        if (end_time < 0) {
+            g_cond_wait (&rb->readable, &rb->mutex);
+        }
+        else {
+            signalled = g_cond_wait_until (&rb->readable, &rb->mutex, end_time);
+        }
+        rb->readers_waiting--;
+        if (!signalled) {
+            STATS_ADD(rb->stats.timeouts, 1);
+            ringbuf_record_latency (rb->stats.pop_latency, &rb->stats.pop_wait_usec, start);
+            return FALSE;
+        }
+    }
+    ringbuf_record_latency (rb->stats.pop_latency, &rb->stats.pop_wait_usec, start);
+    return TRUE;
+}
+
+/* Waits until @size bytes can be written. Non-blocking rings never wait and
+ * count a drop instead. A negative @end_time waits forever. Returns FALSE if
+ * there is not enough space, or @end_time expired first.
+ */
+static gboolean ringbuf_wait_writeable_unlocked (ringbuf_t *rb, gsize size, gint64 end_time) {
+    gint64 start = 0;
+    if (!rb->block_on_full) {
+        if (ringbuf_bytes_free_unlocked(rb) < size) {
+            STATS_ADD(rb->stats.drops, 1);
+            return FALSE;
+        }
+        return TRUE;
+    }
+    while (ringbuf_bytes_free_unlocked(rb) < size) {
+        if (start == 0) {
+            start = g_get_monotonic_time ();
+            STATS_ADD(rb->stats.producer_waits, 1);
+        }
+        rb->writers_waiting++;
+        gboolean signalled = TRUE;
+        if (end_time < 0) {
+            g_cond_wait(&rb->writeable, &rb->mutex);
+        }
+        else {
+            signalled = g_cond_wait_until (&rb->writeable, &rb->mutex, end_time);
+        }
+        rb->writers_waiting--;
+        if (!signalled) {
+            STATS_ADD(rb->stats.timeouts, 1);
+            ringbuf_record_latency (rb->stats.push_latency, &rb->stats.push_wait_usec, start);
+            return FALSE;
+        }
+    }
+    ringbuf_record_latency (rb->stats.push_latency, &rb->stats.push_wait_usec, start);
+    return TRUE;
+}
+
+/* Copies @size bytes from @src to the head. Compact rings split the copy at
+ * the end of the array.
+ */
+static void ringbuf_copy_in_unlocked (ringbuf_t *rb, gconstpointer src, gsize size) {
+    gsize first = rb->buffer_size - rb->head;
+    if (likely(!rb->compact || size <= first)) {
+        memcpy (rb->buf + rb->head, src, size);
+        return;
+    }
+    memcpy (rb->buf + rb->head, src, first);
+    memcpy (rb->buf, (const guint8 *) src + first, size - first);
+}
+
+/* Copies @size bytes from the tail to @dst, split like ringbuf_copy_in_unlocked(). */
+static void ringbuf_copy_out_unlocked (ringbuf_t *rb, gpointer dst, gsize size) {
+    gsize first = rb->buffer_size - rb->tail;
+    if (likely(!rb->compact || size <= first)) {
+        memcpy (dst, rb->buf + rb->tail, size);
+        return;
+    }
+    memcpy (dst, rb->buf + rb->tail, first);
+    memcpy ((guint8 *) dst + first, rb->buf, size - first);
+}
+
+/* Returns the tail with all readable bytes following it. On compact rings,
+ * bytes that wrapped to the start of the array are first copied to the bounce
+ * bytes after its end. A writer cannot straddle the end meanwhile: while the
+ * data wraps, the free space does not.
+ */
+static gconstpointer ringbuf_tail_unlocked (ringbuf_t *rb) {
+    if (unlikely(rb->compact && ringbuf_bytes_used_unlocked(rb) > rb->buffer_size - rb->tail)) {
+        memcpy (rb->buf + rb->buffer_size, rb->buf, rb->head);
+    }
+    return rb->buf + rb->tail;
+}
+
+/* Before committing @size bytes written in place at the head of a compact
+ * ring, moves those written past the end of the array to its start.
+ */
+static void ringbuf_fold_head_unlocked (ringbuf_t *rb, gsize size) {
+    if (unlikely(rb->compact && rb->head + size > rb->buffer_size)) {
+        memcpy (rb->buf, rb->buf + rb->buffer_size, rb->head + size - rb->buffer_size);
+    }
+}
+
+static void ringbuf_update_used_unlocked (ringbuf_t *rb) {
+    gsize used = ringbuf_bytes_used_unlocked(rb);
+    STATS_SET(rb->stats.used, used);
+    if (used > rb->stats.high_watermark) {
+        STATS_SET(rb->stats.high_watermark, used);
+    }
+}
+
+static gpointer ringbuf_advance_head_unlocked (ringbuf_t *rb, gsize size) {
+    rb->head += size;
+    if(rb->head >= rb->buffer_size) {
+        rb->head -= rb->buffer_size;
+    }
+    if (size > 0 && rb->head == rb->tail) {
+        rb->full = TRUE;
+    }
+
+    STATS_ADD(rb->stats.push_ops, 1);
+    STATS_ADD(rb->stats.bytes_pushed, size);
+    ringbuf_update_used_unlocked (rb);
+
+    // Signalling costs a syscall even with nobody waiting, which small pushes would feel
+    if (rb->readers_waiting > 0) {
+        g_cond_signal(&rb->readable);
+    }
+    return rb->buf + rb->head;
+}
+
+static gpointer ringbuf_advance_tail_unlocked (ringbuf_t *rb, gsize size) {
+    rb->tail += size;
+    if(rb->tail >= rb->buffer_size) {
+        rb->tail -= rb->buffer_size;
+    }
+    if (size > 0) {
+        rb->full = FALSE;
+    }
+
+    STATS_ADD(rb->stats.pop_ops, 1);
+    STATS_ADD(rb->stats.bytes_popped, size);
+    STATS_SET(rb->stats.used, ringbuf_bytes_used_unlocked(rb));
+
+    if (rb->writers_waiting > 0) {
+        g_cond_signal(&rb->writeable);
+    }
+    return rb->buf + rb->tail;
+}
+
 gsize ringbuf_bytes_free (ringbuf_t *rb) {
     gsize free = 0;
     g_mutex_lock(&rb->mutex);
@@ -171,18 +443,22 @@ gsize ringbuf_bytes_used (ringbuf_t *rb) {
     return rb->buffer_size - ringbuf_bytes_free(rb);
 }
 
+gsize ringbuf_bytes_used_relaxed (ringbuf_t *rb) {
+    return STATS_GET(rb->stats.used);
+}
+
 gboolean ringbuf_is_full (ringbuf_t *rb) {
-    return (ringbuf_bytes_free(rb) == rb->buffer_size) && rb->full;
+    return ringbuf_bytes_free(rb) == 0;
 }
 
 gboolean ringbuf_is_empty (ringbuf_t *rb) {
-    return (ringbuf_bytes_free (rb) == rb->buffer_size) && (rb->tail == rb->head);
+    return ringbuf_bytes_free (rb) == rb->buffer_size;
 }
 
 gconstpointer ringbuf_tail (ringbuf_t *rb) {
     gpointer retval = NULL;
     g_mutex_lock(&rb->mutex);
-    retval = rb->tail + rb->buf;
+    retval = (gpointer) ringbuf_tail_unlocked (rb);
     g_mutex_unlock(&rb->mutex);
     return retval;
 }
@@ -203,19 +479,8 @@ gconstpointer ringbuf_move_tail (ringbuf_t *rb, gsize size) {
     
     // Wait for data to become available
     g_mutex_lock(&rb->mutex);
-    while (ringbuf_bytes_used_unlocked(rb) < size) {
-        g_cond_wait (&rb->readable, &rb->mutex);
-    }
-
-    rb->tail += size;
-    tail = rb->buf + rb->tail;
-
-    if(rb->tail >= rb->buffer_size) {
-        rb->head -= rb->buffer_size;
-        rb->tail -= rb->buffer_size;
-    }
-
-    g_cond_signal (&rb->writeable);
+    ringbuf_wait_readable_unlocked (rb, size, -1);
+    tail = ringbuf_advance_tail_unlocked (rb, size);
     g_mutex_unlock (&rb->mutex);
 
     return tail;
@@ -227,10 +492,9 @@ gconstpointer ringbuf_move_head (ringbuf_t *rb, gsize size) {
     }
     gpointer head = NULL;
     
-    // Wait for space to become available
     g_mutex_lock(&rb->mutex);
-    rb->head += size;
-    head = rb->buf + rb->head;
+    ringbuf_fold_head_unlocked (rb, size);
+    head = ringbuf_advance_head_unlocked (rb, size);
     g_mutex_unlock(&rb->mutex);
 
     return head;
@@ -244,25 +508,13 @@ gpointer ringbuf_push(ringbuf_t *dst, gconstpointer src, gsize size) {
   
     // Wait for space to become available
     g_mutex_lock(&dst->mutex);
-    if (dst->block_on_full) {
-        while (ringbuf_bytes_free_unlocked(dst) < size) {
-            g_cond_wait(&dst->writeable, &dst->mutex);
-        }
-    }
-
-    if (size > dst->buffer_size) {
+    if (!ringbuf_wait_writeable_unlocked (dst, size, -1)) {
+        g_mutex_unlock(&dst->mutex);
         return NULL;
     }
 
-    memcpy(dst->buf + dst->head, src, size);
-    dst->head += size;
-    head = dst->buf + dst->head;
-
-    if(dst->head >= dst->buffer_size) {
-        dst->head -= dst->buffer_size;
-        dst->full = TRUE;
-    }
-    g_cond_signal(&dst->readable);
+    ringbuf_copy_in_unlocked (dst, src, size);
+    head = ringbuf_advance_head_unlocked (dst, size);
     g_mutex_unlock(&dst->mutex);
 
     return head;
@@ -275,22 +527,11 @@ gpointer ringbuf_pop (gpointer dst, ringbuf_t *src, gsize size) {
     gpointer tail = NULL;
     // Wait for data to become available
     g_mutex_lock(&src->mutex);
-    while (ringbuf_bytes_used_unlocked(src) < size) {
-        g_cond_wait (&src->readable, &src->mutex);
-    }
+    ringbuf_wait_readable_unlocked (src, size, -1);
     
-    memcpy (dst, src->buf + src->tail, size);
-    src->tail += size;
-    tail = src->buf + src->tail;
-
-    if(src->tail >= src->buffer_size) {
-        src->tail -= src->buffer_size;
-        src->full = FALSE;
-    }
-
-    g_cond_signal (&src->writeable);
+    ringbuf_copy_out_unlocked (src, dst, size);
+    tail = ringbuf_advance_tail_unlocked (src, size);
     g_mutex_unlock (&src->mutex);
-    
 
     return tail;
 }
@@ -300,28 +541,16 @@ gpointer ringbuf_timed_pop (gpointer dst, ringbuf_t *src, gsize size, guint64 ti
         return NULL;
     }
     gpointer tail = NULL;
-    guint64 end_time = 0;
     
     // Wait for data to become available
     g_mutex_lock(&src->mutex);
-    end_time = g_get_monotonic_time () + timeout;
-    while (ringbuf_bytes_used_unlocked(src) < size) {
-        if (!g_cond_wait_until (&src->readable, &src->mutex, end_time)) {
-            g_mutex_unlock (&src->mutex);
-            return NULL;
-        }
-    }
-
-    memcpy (dst, src->buf + src->tail, size);
-    src->tail += size;
-    tail = src->buf + src->tail;
-
-    if(src->tail >= src->buffer_size) {
-        src->tail -= src->buffer_size;
-        src->full = FALSE;
+    if (!ringbuf_wait_readable_unlocked (src, size, g_get_monotonic_time () + timeout)) {
+        g_mutex_unlock (&src->mutex);
+        return NULL;
     }
 
-    g_cond_signal (&src->writeable);
+    ringbuf_copy_out_unlocked (src, dst, size);
+    tail = ringbuf_advance_tail_unlocked (src, size);
     g_mutex_unlock (&src->mutex);
     
     return tail;
@@ -332,31 +561,22 @@ gboolean ringbuf_direct_copy (ringbuf_t *src, ringbuf_t *dst, gsize size) {
         return FALSE;
     }
     g_mutex_lock(&src->mutex);
-    g_mutex_lock(&dst->mutex);
 
     // Wait for data to become available in src
-    while (src->tail == src->head) {
-        g_cond_wait (&src->readable, &src->mutex);
-    }
+    ringbuf_wait_readable_unlocked (src, size, -1);
 
     // Wait for space to become available in dst
-    if (dst->block_on_full) {
-        while (ringbuf_bytes_free(dst) < size) {
-            g_cond_wait(&dst->writeable, &dst->mutex);
-        }
+    g_mutex_lock(&dst->mutex);
+    if (!ringbuf_wait_writeable_unlocked (dst, size, -1)) {
+        g_mutex_unlock(&dst->mutex);
+        g_mutex_unlock(&src->mutex);
+        return FALSE;
     }
 
-    memcpy (dst->buf + dst->head, src->buf + src->tail, size);
-    dst->head += size;
-    src->tail += size;
-
-    if(src->tail >= src->buffer_size) {
-        src->head -= src->buffer_size;
-        src->tail -= src->buffer_size;
-    }
+    ringbuf_copy_in_unlocked (dst, ringbuf_tail_unlocked (src), size);
+    ringbuf_advance_head_unlocked (dst, size);
+    ringbuf_advance_tail_unlocked (src, size);
 
-    g_cond_signal (&dst->readable);
-    g_cond_signal (&src->writeable);
     g_mutex_unlock(&dst->mutex);
     g_mutex_unlock(&src->mutex);
 
@@ -371,13 +591,9 @@ gpointer ringbuf_reserve (ringbuf_t *rb, gsize size) {
     
     // Wait for space to become available
     g_mutex_lock(&rb->mutex);
-    if (rb->block_on_full) {
-        while (ringbuf_bytes_free_unlocked(rb) < size) {
-            g_cond_wait(&rb->writeable, &rb->mutex);
-        }
+    if (ringbuf_wait_writeable_unlocked (rb, size, -1)) {
+        head = rb->buf + rb->head;
     }
-
-    head = rb->buf + rb->head;
     g_mutex_unlock(&rb->mutex);
 
     return head;
@@ -388,11 +604,8 @@ void ringbuf_commit (ringbuf_t *rb, gsize size) {
         return;
     }
     g_mutex_lock(&rb->mutex);
-    rb->head += size;
-    if(rb->head >= rb->buffer_size) {
-        rb->head -= rb->buffer_size;
-    }
-    g_cond_signal(&rb->readable);
+    ringbuf_fold_head_unlocked (rb, size);
+    ringbuf_advance_head_unlocked (rb, size);
     g_mutex_unlock(&rb->mutex);
 }
 
@@ -401,19 +614,12 @@ gsize ringbuf_wait_for_data_timed (ringbuf_t *rb, gsize size, guint64 timeout) {
         return 0;
     }
     gsize bytes_used = 0;
-    guint64 end_time = 0;
     
     // Wait for data to become available
     g_mutex_lock(&rb->mutex);
-    end_time = g_get_monotonic_time () + timeout;
-    while (ringbuf_bytes_used_unlocked(rb) < size) {
-        if (!g_cond_wait_until (&rb->readable, &rb->mutex, end_time)) {
-            g_mutex_unlock (&rb->mutex);
-            return 0;
-        }
+    if (ringbuf_wait_readable_unlocked (rb, size, g_get_monotonic_time () + timeout)) {
+        bytes_used = ringbuf_bytes_used_unlocked(rb);
     }
-
-    bytes_used = ringbuf_bytes_used_unlocked(rb);
     g_mutex_unlock (&rb->mutex);
     
     return bytes_used;
@@ -427,12 +633,113 @@ gsize ringbuf_wait_for_data (ringbuf_t *rb, gsize size) {
     
     // Wait for data to become available
     g_mutex_lock(&rb->mutex);
-    while (ringbuf_bytes_used_unlocked(rb) < size) {
-        g_cond_wait (&rb->readable, &rb->mutex);
-    }
-
+    ringbuf_wait_readable_unlocked (rb, size, -1);
     bytes_used = ringbuf_bytes_used_unlocked(rb);
     g_mutex_unlock (&rb->mutex);
     
     return bytes_used;
-}
\ No newline at end of file
+}
+
+gboolean ringbuf_wait_for_space_timed (ringbuf_t *rb, gsize size, guint64 timeout) {
+    if (unlikely(!rb || size > rb->buffer_size)) {
+        return TRUE;
+    }
+    gboolean ready = TRUE;
+
+    g_mutex_lock(&rb->mutex);
+    if (rb->block_on_full) {
+        ready = ringbuf_wait_writeable_unlocked (rb, size, g_get_monotonic_time () + timeout);
+    }
+    g_mutex_unlock (&rb->mutex);
+
+    return ready;
+}
+
+void ringbuf_get_stats (ringbuf_t *rb, ringbuf_stats_t *stats) {
+    g_assert(rb && stats);
+
+    stats->capacity = rb->buffer_size;
+    stats->used = STATS_GET(rb->stats.used);
+    stats->high_watermark = STATS_GET(rb->stats.high_watermark);
+    stats->push_ops = STATS_GET(rb->stats.push_ops);
+    stats->pop_ops = STATS_GET(rb->stats.pop_ops);
+    stats->bytes_pushed = STATS_GET(rb->stats.bytes_pushed);
+    stats->bytes_popped = STATS_GET(rb->stats.bytes_popped);
+    stats->producer_waits = STATS_GET(rb->stats.producer_waits);
+    stats->consumer_waits = STATS_GET(rb->stats.consumer_waits);
+    stats->drops = STATS_GET(rb->stats.drops);
+    stats->timeouts = STATS_GET(rb->stats.timeouts);
+    stats->push_wait_usec = STATS_GET(rb->stats.push_wait_usec);
+    stats->pop_wait_usec = STATS_GET(rb->stats.pop_wait_usec);
+    for (guint i = 0; i < RINGBUF_LATENCY_BUCKETS; i++) {
+        stats->push_latency[i] = STATS_GET(rb->stats.push_latency[i]);
+        stats->pop_latency[i] = STATS_GET(rb->stats.pop_latency[i]);
+    }
+}
+
+guint64 ringbuf_latency_percentile (const guint64 *histogram, gdouble quantile) {
+    guint64 total = 0, seen = 0;
+    for (guint i = 0; i < RINGBUF_LATENCY_BUCKETS; i++) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    guint64 rank = (guint64) (CLAMP(quantile, 0.0, 1.0) * total);
+    for (guint i = 0; i < RINGBUF_LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > rank || seen == total) {
+            return i == 0 ? 0 : G_GUINT64_CONSTANT(1) << i;
+        }
+    }
+    return G_GUINT64_CONSTANT(1) << (RINGBUF_LATENCY_BUCKETS - 1);
+}
+
+void ringbuf_foreach (ringbuf_foreach_func func, gpointer user_data) {
+    g_mutex_lock(&registry_mutex);
+    for (GList *l = registry; l != NULL; l = l->next) {
+        func (l->data, user_data);
+    }
+    g_mutex_unlock(&registry_mutex);
+}
+
+void ringbuf_get_info (ringbuf_t *rb, ringbuf_info_t *info) {
+    g_assert(rb && info);
+
+    info->id = rb->id;
+    g_strlcpy(info->name, rb->name, sizeof(info->name));
+    info->address = rb->buf;
+    info->fd = rb->fd;
+    ringbuf_get_stats(rb, &info->stats);
+}
+
+static void ringbuf_list_append (ringbuf_t *rb, gpointer user_data) {
+    GArray *infos = user_data;
+    ringbuf_info_t info;
+    ringbuf_get_info(rb, &info);
+    g_array_append_val(infos, info);
+}
+
+GArray *ringbuf_list (void) {
+    GArray *infos = g_array_new(FALSE, FALSE, sizeof(ringbuf_info_t));
+    ringbuf_foreach(ringbuf_list_append, infos);
+    return infos;
+}
+
+gboolean ringbuf_lookup (const gchar *name, ringbuf_info_t *info) {
+    gboolean found = FALSE;
+
+    g_mutex_lock(&registry_mutex);
+    for (GList *l = registry; l != NULL; l = l->next) {
+        ringbuf_t *rb = l->data;
+        if (g_strcmp0(rb->name, name) == 0) {
+            ringbuf_get_info(rb, info);
+            found = TRUE;
+            break;
+        }
+    }
+    g_mutex_unlock(&registry_mutex);
+
+    return found;
+}
@@ -18,15 +18,103 @@
 
 typedef struct _ringbuf_t ringbuf_t;
 
+/* Number of log2 microsecond buckets kept for each latency histogram. */
+#define RINGBUF_LATENCY_BUCKETS 32
+
+/**
+ * ringbuf_stats_t:
+ * @capacity: Size of the ring in bytes.
+ * @used: Bytes currently stored in the ring.
+ * @high_watermark: Largest value @used has reached since creation.
+ * @push_ops: Number of completed writes (push, commit, move_head, direct_copy).
+ * @pop_ops: Number of completed reads (pop, move_tail, direct_copy).
+ * @bytes_pushed: Total bytes written.
+ * @bytes_popped: Total bytes read.
+ * @producer_waits: Writes that had to block for free space.
+ * @consumer_waits: Reads that had to block for data.
+ * @drops: Writes refused because a non-blocking ring was full.
+ * @timeouts: Timed waits for data or space that gave up.
+ * @push_wait_usec: Total time producers spent blocked, in microseconds.
+ * @pop_wait_usec: Total time consumers spent blocked, in microseconds.
+ * @push_latency: Histogram of producer wait times. Bucket 0 counts calls that
+ *   did not wait, bucket n counts waits in [2^(n-1), 2^n) microseconds.
+ * @pop_latency: Same as @push_latency for consumers.
+ *
+ * Snapshot of the per-ring counters. The counters are maintained on the data
+ * path and can be read with ringbuf_get_stats() without taking the ring lock.
+ */
+typedef struct {
+    gsize capacity;
+    gsize used;
+    gsize high_watermark;
+    guint64 push_ops, pop_ops;
+    guint64 bytes_pushed, bytes_popped;
+    guint64 producer_waits, consumer_waits;
+    guint64 drops, timeouts;
+    guint64 push_wait_usec, pop_wait_usec;
+    guint64 push_latency[RINGBUF_LATENCY_BUCKETS];
+    guint64 pop_latency[RINGBUF_LATENCY_BUCKETS];
+} ringbuf_stats_t;
+
+/* Compact rings, those smaller than a page, are sized in multiples of this. */
+#define RINGBUF_COMPACT_ALIGN 64
+
+/* Longest ring name kept in a #ringbuf_info_t, including the terminating nul. */
+#define RINGBUF_NAME_MAX 64
+
+/**
+ * ringbuf_info_t:
+ * @id: Unique identifier, see ringbuf_id().
+ * @name: Name given at creation, also the name of the backing memfd.
+ * @address: Start of the double mapping, as found in /proc/<pid>/maps.
+ * @fd: Backing memfd, as found in /proc/<pid>/fd, or -1 for compact rings.
+ * @stats: Counters snapshot, see ringbuf_get_stats().
+ *
+ * Introspection record of a live ring buffer.
+ */
+typedef struct {
+    guint id;
+    gchar name[RINGBUF_NAME_MAX];
+    gconstpointer address;
+    gint fd;
+    ringbuf_stats_t stats;
+} ringbuf_info_t;
+
+/**
+ * ringbuf_foreach_func:
+ * @rb: A live ring buffer.
+ * @user_data: Data passed to ringbuf_foreach().
+ *
+ * Callback used to enumerate live ring buffers.
+ */
+typedef void (*ringbuf_foreach_func) (ringbuf_t *rb, gpointer user_data);
+
 /**
  * ringbuf_new:
  * @size: Desired size in bytes (may be rounded to page size at runtime).
  * @block: Whether to block when the ring buffer is full.
  *
  * Creates and initializes a new ring buffer. Returns NULL on error.
+ *
+ * Rings smaller than a page are compact: a plain array of @size rounded up to
+ * #RINGBUF_COMPACT_ALIGN, with no memfd nor double mapping. The API is the
+ * same, pointers into the ring still cover whole records, at the cost of a
+ * copy for the records that straddle the end of the array.
  */
 ringbuf_t *ringbuf_new (gsize size, gboolean block);
 
+/**
+ * ringbuf_new_named:
+ * @name: Name of the ring, or NULL for the default "queue_region".
+ * @size: Desired size in bytes (may be rounded to page size at runtime).
+ * @block: Whether to block when the ring buffer is full.
+ *
+ * Same as ringbuf_new() but gives the ring a name. The name is used for the
+ * backing memfd, so it shows up in /proc/<pid>/fd and /proc/<pid>/maps, and
+ * identifies the ring in the registry and the stats exporter.
+ */
+ringbuf_t *ringbuf_new_named (const gchar *name, gsize size, gboolean block);
+
 /**
  * ringbuf_buffer_size:
  * @rb: A valid ring buffer object.
@@ -59,6 +147,24 @@ void ringbuf_reset(ringbuf_t *rb);
  */
 gsize ringbuf_bytes_free(ringbuf_t *rb);
 
+/**
+ * ringbuf_bytes_used:
+ * @rb: A valid ring buffer object.
+ *
+ * Returns how many bytes are stored and waiting to be read.
+ */
+gsize ringbuf_bytes_used(ringbuf_t *rb);
+
+/**
+ * ringbuf_bytes_used_relaxed:
+ * @rb: A valid ring buffer object.
+ *
+ * Same as ringbuf_bytes_used() but reads the count the last push or pop left,
+ * without taking the ring lock. Meant for polling loops, which then take the
+ * lock once, in the ringbuf_pop() or ringbuf_push() that follows.
+ */
+gsize ringbuf_bytes_used_relaxed(ringbuf_t *rb);
+
 /**
  * ringbuf_is_full:
  * @rb: A valid ring buffer object.
@@ -79,7 +185,8 @@ int ringbuf_is_empty(ringbuf_t *rb);
  * ringbuf_tail:
  * @rb: A valid ring buffer object.
  *
- * Gets the current tail pointer for reading.
+ * Gets the current tail pointer for reading. The bytes available when it is
+ * called follow it contiguously.
  */
 gconstpointer ringbuf_tail(ringbuf_t *rb);
 
@@ -176,4 +283,98 @@ void ringbuf_commit (ringbuf_t *rb, gsize size);
  */
 gsize ringbuf_wait_for_data (ringbuf_t *rb, gsize size);
 
+/**
+ * ringbuf_wait_for_data_timed:
+ * @rb: A valid ring buffer object.
+ * @size: Number of bytes to wait for.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Same as ringbuf_wait_for_data() but gives up after @timeout. Returns 0 on timeout.
+ */
+gsize ringbuf_wait_for_data_timed (ringbuf_t *rb, gsize size, guint64 timeout);
+
+/**
+ * ringbuf_wait_for_space_timed:
+ * @rb: A valid ring buffer object.
+ * @size: Number of bytes to wait for.
+ * @timeout: Maximum time to wait in microseconds.
+ *
+ * Blocks until a write of @size bytes would not block, for a single producer
+ * that then pushes or reserves. Returns FALSE on timeout. Non-blocking rings
+ * and writes larger than the ring never wait, the write itself fails.
+ */
+gboolean ringbuf_wait_for_space_timed (ringbuf_t *rb, gsize size, guint64 timeout);
+
+/**
+ * ringbuf_id:
+ * @rb: A valid ring buffer object.
+ *
+ * Returns a process-wide unique, non-zero identifier for @rb.
+ */
+guint ringbuf_id (const ringbuf_t *rb);
+
+/**
+ * ringbuf_name:
+ * @rb: A valid ring buffer object.
+ *
+ * Returns the name given at creation. Owned by @rb.
+ */
+const gchar *ringbuf_name (const ringbuf_t *rb);
+
+/**
+ * ringbuf_get_info:
+ * @rb: A valid ring buffer object.
+ * @info: Record to fill.
+ *
+ * Fills @info with the identity and a stats snapshot of @rb.
+ */
+void ringbuf_get_info (ringbuf_t *rb, ringbuf_info_t *info);
+
+/**
+ * ringbuf_get_stats:
+ * @rb: A valid ring buffer object.
+ * @stats: Snapshot to fill.
+ *
+ * Copies the per-ring counters into @stats. Does not take the ring lock, so
+ * the snapshot is not atomic as a whole but never stalls producers or consumers.
+ */
+void ringbuf_get_stats (ringbuf_t *rb, ringbuf_stats_t *stats);
+
+/**
+ * ringbuf_latency_percentile:
+ * @histogram: One of the latency histograms of a #ringbuf_stats_t.
+ * @quantile: Quantile between 0 and 1.
+ *
+ * Returns the upper bound, in microseconds, of the bucket holding @quantile.
+ */
+guint64 ringbuf_latency_percentile (const guint64 *histogram, gdouble quantile);
+
+/**
+ * ringbuf_foreach:
+ * @func: Function to call for each ring.
+ * @user_data: Data passed to @func.
+ *
+ * Calls @func for every ring buffer currently alive in the process. Rings cannot
+ * be created or freed from within @func.
+ */
+void ringbuf_foreach (ringbuf_foreach_func func, gpointer user_data);
+
+/**
+ * ringbuf_list:
+ *
+ * Takes a snapshot of every live ring buffer. Returns a #GArray of
+ * #ringbuf_info_t ordered by creation, free with g_array_unref().
+ */
+GArray *ringbuf_list (void);
+
+/**
+ * ringbuf_lookup:
+ * @name: Name of the ring.
+ * @info: Record to fill.
+ *
+ * Looks up the first live ring called @name. Returns TRUE and fills @info if
+ * one was found.
+ */
+gboolean ringbuf_lookup (const gchar *name, ringbuf_info_t *info);
+
 #endif /* INCLUDED_RINGBUF_H */
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "../ringbuf.h"
+#include "../ringbuf-accumulate.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-framegen.h"
+#include "test.h"
+#include <glib.h>
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+// Every depth and accumulator type against a 64-bit reference sum
+static void test_accumulate_add(void) {
+    const guint depths[] = {1, 2, 4};
+    const guint nb_frames = 5;
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        for (guint type = RINGBUF_ACCUMULATE_U32; type <= RINGBUF_ACCUMULATE_F32; type++) {
+            ringbuf_frame_geometry_t geometry = {37, 11, depths[d]};
+            gsize nb_pixels = 37 * 11;
+            ringbuf_accumulator_t *acc = ringbuf_accumulator_new(&geometry, type, nb_frames, 1, 2);
+            ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 37, 11, depths[d], type);
+            gpointer frame = g_malloc(ringbuf_framegen_frame_size(gen));
+            guint64 *expected = g_new0(guint64, nb_pixels);
+            ringbuf_frame_meta_t meta;
+
+            for (guint batch = 0; batch < 3; batch++) {
+                memset(expected, 0, nb_pixels * sizeof(guint64));
+                for (guint f = 0; f < nb_frames; f++) {
+                    ringbuf_framegen_fill(gen, frame);
+                    // Keep 32-bit inputs small enough not to wrap the integer sums
+                    if (depths[d] == 4) {
+                        for (gsize i = 0; i < nb_pixels; i++) {
+                            ((guint32 *) frame)[i] >>= 8;
+                        }
+                    }
+                    for (gsize i = 0; i < nb_pixels; i++) {
+                        expected[i] += pixel_at(frame, depths[d], i);
+                    }
+                    g_assert_cmpint(ringbuf_accumulator_add(acc, frame), ==, f == nb_frames - 1);
+                }
+
+                gconstpointer sum = ringbuf_frame_ring_acquire(ringbuf_accumulator_output(acc), &meta);
+                g_assert_cmpuint(meta.sequence, ==, batch);
+                for (gsize i = 0; i < nb_pixels; i++) {
+                    if (type == RINGBUF_ACCUMULATE_U32) {
+                        g_assert_cmpuint(((const guint32 *) sum)[i], ==, expected[i]);
+                    }
+                    else {
+                        gdouble error = ((const gfloat *) sum)[i] - (gdouble) expected[i];
+                        g_assert_cmpfloat(ABS(error), <=, expected[i] * 1e-6);
+                    }
+                }
+                ringbuf_frame_ring_release(ringbuf_accumulator_output(acc));
+            }
+
+            g_free(expected);
+            g_free(frame);
+            ringbuf_framegen_free(gen);
+            ringbuf_accumulator_free(acc);
+        }
+    }
+}
+
+// A background thread consumes the input ring, large frames are tiled
+static void test_accumulate_thread(void) {
+    ringbuf_frame_geometry_t geometry = {1024, 301, 2};
+    ringbuf_frame_ring_t *input = ringbuf_frame_ring_new("raw", &geometry, 3, TRUE);
+    ringbuf_accumulator_t *acc = ringbuf_accumulator_new(&geometry, RINGBUF_ACCUMULATE_U32, 4, 3, 2);
+    ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 1024, 301, 2, 0);
+    ringbuf_frame_meta_t meta;
+
+    ringbuf_accumulator_start(acc, input);
+    for (guint f = 0; f < 8; f++) {
+        ringbuf_framegen_fill(gen, ringbuf_frame_ring_reserve(input));
+        ringbuf_frame_ring_commit(input);
+    }
+
+    for (guint batch = 0; batch < 2; batch++) {
+        const guint32 *sum = ringbuf_frame_ring_acquire(ringbuf_accumulator_output(acc), &meta);
+        g_assert_cmpuint(meta.sequence, ==, batch);
+        for (guint y = 0; y < geometry.height; y += 50) {
+            for (guint x = 0; x < geometry.width; x += 7) {
+                guint32 expected = 0;
+                for (guint f = 4 * batch; f < 4 * batch + 4; f++) {
+                    expected += (guint16) (x + y + f);
+                }
+                g_assert_cmpuint(sum[y * geometry.width + x], ==, expected);
+            }
+        }
+        ringbuf_frame_ring_release(ringbuf_accumulator_output(acc));
+    }
+
+    ringbuf_accumulator_stop(acc);
+    ringbuf_framegen_free(gen);
+    ringbuf_accumulator_free(acc);
+    ringbuf_frame_ring_free(input);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/accumulate/add", test_accumulate_add);
+    g_test_add_func("/ringbuf/accumulate/thread", test_accumulate_thread);
+
+    return g_test_run();
+}
@@ -0,0 +1,133 @@
+#include "../ringbuf.h"
+#include "../ringbuf-arena.h"
+#include "test.h"
+#include <dirent.h>
+#include <glib.h>
+
+// Entries of a /proc/self directory or lines of a /proc/self file
+static guint count_entries(const gchar *path, gboolean directory) {
+    guint n = 0;
+    if (directory) {
+        DIR *dir = opendir(path);
+        g_assert_nonnull(dir);
+        while (readdir(dir) != NULL) {
+            n++;
+        }
+        closedir(dir);
+    }
+    else {
+        gchar *contents = NULL;
+        g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+        for (const gchar *c = contents; *c != '\0'; c++) {
+            n += *c == '\n';
+        }
+        g_free(contents);
+    }
+    return n;
+}
+
+// Rings of an arena wrap around like any other and do not share memory
+static void test_arena_rings(void) {
+    ringbuf_arena_t *arena = ringbuf_arena_new("arena", 5000, 3, FALSE);
+    gsize size = ringbuf_arena_ring_size(arena);
+    ringbuf_t *rings[3];
+    ringbuf_info_t first, info;
+    guint8 *src = g_malloc(size), *dst = g_malloc(size);
+
+    g_assert_cmpuint(size, ==, (5000 + getpagesize() - 1) / getpagesize() * getpagesize());
+    g_assert_cmpuint(ringbuf_arena_nb_free(arena), ==, 3);
+    for (guint r = 0; r < 3; r++) {
+        rings[r] = ringbuf_arena_ring_new(arena, "arena-ring", TRUE);
+        g_assert_nonnull(rings[r]);
+        g_assert_cmpuint(ringbuf_buffer_size(rings[r]), ==, size);
+    }
+    g_assert_null(ringbuf_arena_ring_new(arena, NULL, TRUE));
+    g_assert_cmpuint(ringbuf_arena_nb_free(arena), ==, 0);
+    ringbuf_get_info(rings[0], &first);
+    ringbuf_get_info(rings[2], &info);
+    g_assert_cmpint(info.fd, ==, first.fd);
+
+    // Half a ring in and out, then a whole ring across the wrap, read in place through the mirror
+    for (guint r = 0; r < 3; r++) {
+        memset(src, r + 1, size);
+        ringbuf_push(rings[r], src, size / 2);
+        ringbuf_pop(dst, rings[r], size / 2);
+        for (gsize i = 0; i < size; i++) {
+            src[i] = (guint8) (i * 7 + r);
+        }
+        ringbuf_push(rings[r], src, size);
+    }
+    for (guint r = 0; r < 3; r++) {
+        for (gsize i = 0; i < size; i++) {
+            src[i] = (guint8) (i * 7 + r);
+        }
+        g_assert_cmpint(memcmp(ringbuf_tail(rings[r]), src, size), ==, 0);
+    }
+
+    // A freed slot goes to the next ring, trimming leaves live rings alone
+    ringbuf_free(rings[1]);
+    g_assert_cmpuint(ringbuf_arena_nb_free(arena), ==, 1);
+    ringbuf_arena_trim(arena);
+    rings[1] = ringbuf_arena_ring_new(arena, NULL, FALSE);
+    g_assert_nonnull(rings[1]);
+    g_assert_true(ringbuf_is_empty(rings[1]));
+    g_assert_nonnull(ringbuf_push(rings[1], src, 100));
+    g_assert_cmpint(memcmp(ringbuf_tail(rings[1]), src, 100), ==, 0);
+    for (gsize i = 0; i < size; i++) {
+        src[i] = (guint8) (i * 7 + 2);
+    }
+    g_assert_cmpint(memcmp(ringbuf_tail(rings[2]), src, size), ==, 0);
+
+    // Rings outlive the arena
+    ringbuf_arena_free(arena);
+    ringbuf_pop(dst, rings[2], size);
+    g_assert_cmpint(memcmp(dst, src, size), ==, 0);
+    for (guint r = 0; r < 3; r++) {
+        ringbuf_free(rings[r]);
+    }
+    g_free(src);
+    g_free(dst);
+}
+
+// Rings of an arena take no file descriptor and no mapping of their own
+static void test_arena_resources(void) {
+    const guint nb_rings = 200;
+    guint fds = count_entries("/proc/self/fd", TRUE);
+    guint maps = count_entries("/proc/self/maps", FALSE);
+    ringbuf_arena_t *arena = ringbuf_arena_new("many", 4096, nb_rings, FALSE);
+    ringbuf_t **rings = g_new(ringbuf_t *, nb_rings);
+
+    g_assert_nonnull(arena);
+    guint arena_maps = count_entries("/proc/self/maps", FALSE);
+    g_assert_cmpuint(count_entries("/proc/self/fd", TRUE), ==, fds + 1);
+    g_assert_cmpuint(arena_maps, <=, maps + nb_rings + 2);
+
+    for (guint r = 0; r < nb_rings; r++) {
+        rings[r] = ringbuf_arena_ring_new(arena, NULL, FALSE);
+        g_assert_nonnull(ringbuf_push(rings[r], &r, sizeof(r)));
+    }
+    g_assert_cmpuint(count_entries("/proc/self/fd", TRUE), ==, fds + 1);
+    g_assert_cmpuint(count_entries("/proc/self/maps", FALSE), ==, arena_maps);
+    for (guint r = 0; r < nb_rings; r++) {
+        guint value;
+        ringbuf_pop(&value, rings[r], sizeof(value));
+        g_assert_cmpuint(value, ==, r);
+        ringbuf_free(rings[r]);
+    }
+    ringbuf_arena_free(arena);
+    g_assert_cmpuint(count_entries("/proc/self/fd", TRUE), ==, fds);
+    g_free(rings);
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*Invalid arena*");
+    g_assert_null(ringbuf_arena_new(NULL, 4096, 0, FALSE));
+    g_test_assert_expected_messages();
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/arena/rings", test_arena_rings);
+    g_test_add_func("/ringbuf/arena/resources", test_arena_resources);
+
+    return g_test_run();
+}
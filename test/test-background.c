@@ -0,0 +1,105 @@
+#include "../ringbuf.h"
+#include "../ringbuf-background.h"
+#include "../ringbuf-frame.h"
+#include "test.h"
+#include <glib.h>
+
+static void assert_close(gdouble value, gdouble expected, gdouble tolerance) {
+    gdouble error = value - expected;
+    g_assert_cmpfloat(ABS(error), <=, tolerance);
+}
+
+// Cumulative mean and variance against a double precision two-pass reference
+static void test_background_cumulative(void) {
+    ringbuf_frame_geometry_t geometry = {37, 11, 2};
+    const gsize nb_pixels = 37 * 11;
+    const guint nb_frames = 20;
+    ringbuf_background_t *bg = ringbuf_background_new(&geometry, RINGBUF_BACKGROUND_CUMULATIVE, 0,
+                                                      RINGBUF_BACKGROUND_SUBTRACTED, 1, 2);
+    ringbuf_frame_ring_t *output = ringbuf_background_output(bg);
+    GRand *rand = g_rand_new_with_seed(92);
+    guint16 *frames = g_new(guint16, nb_frames * nb_pixels);
+    gdouble *sum = g_new0(gdouble, nb_pixels);
+
+    for (guint f = 0; f < nb_frames; f++) {
+        guint16 *frame = frames + f * nb_pixels;
+        for (gsize i = 0; i < nb_pixels; i++) {
+            frame[i] = 1000 + i + g_rand_int_range(rand, 0, 200);
+        }
+        ringbuf_background_process(bg, frame);
+
+        // Output against the mean of the frames before, to float precision of the pixels
+        const gfloat *out = ringbuf_frame_ring_acquire(output, NULL);
+        for (gsize i = 0; i < nb_pixels; i++) {
+            assert_close(out[i], f == 0 ? 0.0 : frame[i] - sum[i] / f, frame[i] * 1e-5);
+            sum[i] += frame[i];
+        }
+        ringbuf_frame_ring_release(output);
+    }
+
+    const gfloat *mean = ringbuf_background_mean(bg), *variance = ringbuf_background_variance(bg);
+    for (gsize i = 0; i < nb_pixels; i++) {
+        gdouble m = sum[i] / nb_frames, v = 0;
+        for (guint f = 0; f < nb_frames; f++) {
+            v += (frames[f * nb_pixels + i] - m) * (frames[f * nb_pixels + i] - m);
+        }
+        assert_close(mean[i], m, m * 1e-5);
+        assert_close(variance[i], v / nb_frames, v / nb_frames * 1e-3);
+    }
+
+    g_free(sum);
+    g_free(frames);
+    g_rand_free(rand);
+    ringbuf_background_free(bg);
+}
+
+// A transient stands out in the z-score map of a tiled exponential model
+static void test_background_zscore(void) {
+    ringbuf_frame_geometry_t geometry = {1021, 301, 1};
+    const gsize nb_pixels = 1021 * 301, transient = 150 * 1021 + 333;
+    ringbuf_frame_ring_t *input = ringbuf_frame_ring_new("raw", &geometry, 2, TRUE);
+    ringbuf_background_t *bg = ringbuf_background_new(&geometry, RINGBUF_BACKGROUND_EXPONENTIAL, 0.1f,
+                                                      RINGBUF_BACKGROUND_ZSCORE, 3, 2);
+    ringbuf_frame_meta_t meta;
+
+    ringbuf_background_start(bg, input);
+    for (guint f = 0; f < 6; f++) {
+        guint8 *pixels = ringbuf_frame_ring_reserve(input);
+        for (gsize i = 0; i < nb_pixels; i++) {
+            pixels[i] = i % 7 * 10;
+        }
+        if (f == 5) {
+            pixels[transient] += 100;
+        }
+        ringbuf_frame_ring_commit(input);
+
+        const gfloat *z = ringbuf_frame_ring_acquire(ringbuf_background_output(bg), &meta);
+        g_assert_cmpuint(meta.sequence, ==, f);
+        for (gsize i = 0; i < nb_pixels; i++) {
+            if (f == 5 && i == transient) {
+                // 100 above a constant background, over the floor of 1/12
+                assert_close(z[i] * z[i] / 12, 100 * 100, 100 * 100 * 1e-4);
+            }
+            else {
+                g_assert_cmpfloat(z[i], ==, 0);
+            }
+        }
+        ringbuf_frame_ring_release(ringbuf_background_output(bg));
+    }
+    ringbuf_background_stop(bg);
+
+    // The sixth frame still weighs 1/6, more than alpha
+    assert_close(ringbuf_background_mean(bg)[transient], transient % 7 * 10 + 100.0 / 6, 1e-4);
+
+    ringbuf_background_free(bg);
+    ringbuf_frame_ring_free(input);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/background/cumulative", test_background_cumulative);
+    g_test_add_func("/ringbuf/background/zscore", test_background_zscore);
+
+    return g_test_run();
+}
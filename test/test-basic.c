@@ -20,8 +20,13 @@ static void test_ringbuf_create(void) {
 
 // Test buffer size rounding
 static void test_buffer_size_rounding(void) {
-    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES/2, TRUE);
-    g_assert_cmpuint(ringbuf_buffer_size(rb), >=, PLATFORM_MIN_BYTES);
+    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES + 1, TRUE);
+    g_assert_cmpuint(ringbuf_buffer_size(rb), ==, 2 * PLATFORM_MIN_BYTES);
+    ringbuf_free(rb);
+
+    // Below a page, rings are compact and only rounded to a cache line
+    rb = ringbuf_new(PLATFORM_MIN_BYTES/2 - 1, TRUE);
+    g_assert_cmpuint(ringbuf_buffer_size(rb), ==, PLATFORM_MIN_BYTES/2);
     ringbuf_free(rb);
 }
 
@@ -0,0 +1,121 @@
+#include "../ringbuf.h"
+#include "test.h"
+#include <glib.h>
+
+#define RING_SIZE 200
+#define RECORD_SIZE 24
+
+// Small rings are a cache-line rounded array with no memfd
+static void test_compact_size(void) {
+    ringbuf_t *rb = ringbuf_new_named("compact", RING_SIZE, TRUE);
+    ringbuf_info_t info;
+
+    g_assert_cmpuint(ringbuf_buffer_size(rb), ==, 256);
+    ringbuf_get_info(rb, &info);
+    g_assert_cmpint(info.fd, ==, -1);
+    g_assert_cmpstr(info.name, ==, "compact");
+    g_assert_cmpuint(info.stats.capacity, ==, 256);
+    ringbuf_free(rb);
+
+    rb = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_get_info(rb, &info);
+    g_assert_cmpint(info.fd, >=, 0);
+    ringbuf_free(rb);
+}
+
+// Copies split at the end of the array, in-place spans straddle it in one piece
+static void test_compact_wrap(void) {
+    ringbuf_t *rb = ringbuf_new(RING_SIZE, FALSE);
+    gsize size = ringbuf_buffer_size(rb);
+    guint8 src[256], dst[256];
+    guint8 next_in = 0, next_out = 0;
+
+    // Sizes prime with the ring's, so every offset of the wrap gets crossed
+    for (guint round = 0; round < 200; round++) {
+        gsize n = 1 + round % 37;
+        for (gsize i = 0; i < n; i++) {
+            src[i] = next_in++;
+        }
+        if (round % 2 == 0) {
+            g_assert_nonnull(ringbuf_push(rb, src, n));
+        }
+        else {
+            guint8 *span = ringbuf_reserve(rb, n);
+            g_assert_nonnull(span);
+            memcpy(span, src, n);
+            ringbuf_commit(rb, n);
+        }
+
+        g_assert_cmpuint(ringbuf_bytes_used(rb), ==, n);
+        if (round % 3 == 0) {
+            ringbuf_pop(dst, rb, n);
+        }
+        else {
+            memcpy(dst, ringbuf_tail(rb), n);
+            ringbuf_move_tail(rb, n);
+        }
+        for (gsize i = 0; i < n; i++) {
+            g_assert_cmpuint(dst[i], ==, next_out++);
+        }
+    }
+
+    // A full ring across the wrap, read in place
+    for (gsize i = 0; i < size; i++) {
+        src[i] = (guint8) (i * 7);
+    }
+    g_assert_nonnull(ringbuf_push(rb, src, size));
+    g_assert_true(ringbuf_is_full(rb));
+    g_assert_null(ringbuf_push(rb, src, 1));
+    g_assert_true(memcmp(ringbuf_tail(rb), src, size) == 0);
+    ringbuf_move_tail(rb, size);
+    g_assert_true(ringbuf_is_empty(rb));
+
+    ringbuf_free(rb);
+}
+
+typedef struct {
+    ringbuf_t *rb;
+    guint nb_records;
+} transfer_t;
+
+static gpointer producer(gpointer data) {
+    transfer_t *t = data;
+    for (guint r = 0; r < t->nb_records; r++) {
+        guint32 *record = ringbuf_reserve(t->rb, RECORD_SIZE);
+        for (guint i = 0; i < RECORD_SIZE / sizeof(guint32); i++) {
+            guint32 value = r * 16 + i;
+            memcpy(record + i, &value, sizeof(value));
+        }
+        ringbuf_commit(t->rb, RECORD_SIZE);
+    }
+    return NULL;
+}
+
+// Records written and read in place by two threads stay whole across the wrap
+static void test_compact_threads(void) {
+    transfer_t t = {ringbuf_new(RING_SIZE, TRUE), 100000};
+    GThread *thread = g_thread_new("producer", producer, &t);
+
+    for (guint r = 0; r < t.nb_records; r++) {
+        ringbuf_wait_for_data(t.rb, RECORD_SIZE);
+        const guint8 *record = ringbuf_tail(t.rb);
+        for (guint i = 0; i < RECORD_SIZE / sizeof(guint32); i++) {
+            guint32 value;
+            memcpy(&value, record + i * sizeof(value), sizeof(value));
+            g_assert_cmpuint(value, ==, r * 16 + i);
+        }
+        ringbuf_move_tail(t.rb, RECORD_SIZE);
+    }
+    g_thread_join(thread);
+    ringbuf_free(t.rb);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/compact/size", test_compact_size);
+    g_test_add_func("/ringbuf/compact/wrap", test_compact_wrap);
+    g_test_add_func("/ringbuf/compact/threads", test_compact_threads);
+
+    return g_test_run();
+}
@@ -0,0 +1,144 @@
+#include "../ringbuf.h"
+#include "../ringbuf-correct.h"
+#include "../ringbuf-frame.h"
+#include "test.h"
+#include <glib.h>
+
+// Reference: dark and flat on every pixel, then the mean of good neighbours
+static void reference(const ringbuf_frame_geometry_t *geometry, guint16 *pixels, const guint8 *bad,
+                      const guint16 *dark, const gfloat *gain) {
+    guint w = geometry->width, h = geometry->height;
+
+    for (gsize i = 0; dark != NULL && i < (gsize) w * h; i++) {
+        gfloat v = ((gfloat) pixels[i] - (gfloat) dark[i]) * gain[i] + 0.5f;
+        pixels[i] = v < 0.0f ? 0 : v > 65535.0f ? 65535 : (guint16) v;
+    }
+    for (guint y = 0; y < h; y++) {
+        for (guint x = 0; x < w; x++) {
+            gsize i = (gsize) y * w + x;
+            guint sum = 0, count = 0;
+            if (!bad[i]) {
+                continue;
+            }
+            if (x > 0 && !bad[i - 1]) {
+                sum += pixels[i - 1];
+                count++;
+            }
+            if (x + 1 < w && !bad[i + 1]) {
+                sum += pixels[i + 1];
+                count++;
+            }
+            if (y > 0 && !bad[i - w]) {
+                sum += pixels[i - w];
+                count++;
+            }
+            if (y + 1 < h && !bad[i + w]) {
+                sum += pixels[i + w];
+                count++;
+            }
+            pixels[i] = count == 0 ? 0 : (sum + count / 2) / count;
+        }
+    }
+}
+
+static void check_correction(guint width, guint height, guint nb_threads, gboolean dark_flat) {
+    ringbuf_frame_geometry_t geometry = {width, height, 2};
+    gsize nb_pixels = (gsize) width * height;
+    GRand *rand = g_rand_new_with_seed(91);
+    guint16 *frame = g_new(guint16, nb_pixels), *expected = g_new(guint16, nb_pixels);
+    guint16 *dark = g_new(guint16, nb_pixels);
+    gfloat *gain = g_new(gfloat, nb_pixels);
+    guint8 *bad = g_malloc0(nb_pixels);
+    GArray *list = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    // Corners, a cluster, a fully surrounded pixel, rows around tile edges
+    const guint32 fixed[] = {0, width - 1, (guint32) nb_pixels - 1, 5 * width + 5, 5 * width + 6,
+                             6 * width + 5, 7 * width + 20, 6 * width + 20, 8 * width + 20, 7 * width + 19,
+                             7 * width + 21, (height / 3 - 1) * width + 9, (height / 3) * width + 9,
+                             (height / 3 + 1) * width + 9, (2 * height / 3) * width + 100};
+    for (guint i = 0; i < G_N_ELEMENTS(fixed); i++) {
+        g_array_append_val(list, fixed[i]);
+    }
+    for (guint i = 0; i < nb_pixels / 500; i++) {
+        guint32 index = g_rand_int_range(rand, 0, nb_pixels);
+        g_array_append_val(list, index);
+    }
+    g_array_append_val(list, fixed[3]);
+    for (guint i = 0; i < list->len; i++) {
+        bad[g_array_index(list, guint32, i)] = TRUE;
+    }
+
+    for (gsize i = 0; i < nb_pixels; i++) {
+        frame[i] = g_rand_int_range(rand, 0, 65536);
+        dark[i] = g_rand_int_range(rand, 0, 2000);
+        gain[i] = g_rand_double_range(rand, 0.5, 1.5);
+    }
+    memcpy(expected, frame, nb_pixels * sizeof(guint16));
+    reference(&geometry, expected, bad, dark_flat ? dark : NULL, gain);
+
+    ringbuf_correction_t *corr = ringbuf_correction_new(&geometry, (guint32 *) list->data, list->len, nb_threads);
+    if (dark_flat) {
+        ringbuf_correction_set_dark_flat(corr, dark, gain);
+    }
+    ringbuf_correction_apply(corr, frame);
+    for (gsize i = 0; i < nb_pixels; i++) {
+        g_assert_cmpuint(frame[i], ==, expected[i]);
+    }
+
+    ringbuf_correction_free(corr);
+    g_array_unref(list);
+    g_free(bad);
+    g_free(gain);
+    g_free(dark);
+    g_free(expected);
+    g_free(frame);
+    g_rand_free(rand);
+}
+
+// Bad pixels only, from an unsorted list with duplicates
+static void test_correct_patch(void) {
+    check_correction(64, 40, 1, FALSE);
+}
+
+// Fused with dark and flat, tiled over several threads
+static void test_correct_dark_flat(void) {
+    check_correction(64, 40, 1, TRUE);
+    check_correction(1024, 301, 3, TRUE);
+}
+
+// The stage on frames acquired from a ring
+static void test_correct_acquired(void) {
+    ringbuf_frame_geometry_t geometry = {16, 8, 1};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 2, TRUE);
+    const guint32 bad[] = {3 * 16 + 4, 200};
+    ringbuf_correction_t *corr;
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*outside*");
+    corr = ringbuf_correction_new(&geometry, bad, G_N_ELEMENTS(bad), 1);
+    g_test_assert_expected_messages();
+    g_assert_cmpuint(ringbuf_correction_nb_bad_pixels(corr), ==, 1);
+
+    guint8 *pixels = ringbuf_frame_ring_reserve(fr);
+    for (guint i = 0; i < 16 * 8; i++) {
+        pixels[i] = i == bad[0] ? 255 : 10 + i % 16;
+    }
+    ringbuf_frame_ring_commit(fr);
+
+    guint8 *acquired = (guint8 *) ringbuf_frame_ring_acquire(fr, NULL);
+    ringbuf_correction_apply(corr, acquired);
+    g_assert_cmpuint(acquired[bad[0]], ==, 14);
+    ringbuf_frame_ring_release(fr);
+
+    ringbuf_correction_free(corr);
+    ringbuf_frame_ring_free(fr);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/correct/patch", test_correct_patch);
+    g_test_add_func("/ringbuf/correct/dark_flat", test_correct_dark_flat);
+    g_test_add_func("/ringbuf/correct/acquired", test_correct_acquired);
+
+    return g_test_run();
+}
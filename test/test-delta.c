@@ -0,0 +1,143 @@
+#include "../ringbuf.h"
+#include "../ringbuf-delta.h"
+#include "../ringbuf-frame.h"
+#include "test.h"
+#include <glib.h>
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+static void fill_random(guint8 *bytes, gsize size, GRand *rand) {
+    for (gsize i = 0; i < size; i++) {
+        bytes[i] = g_rand_int(rand);
+    }
+}
+
+// Every depth and mode against scalar residuals, then back, in place
+static void test_delta_roundtrip(void) {
+    const guint depths[] = {1, 2, 4};
+    GRand *rand = g_rand_new_with_seed(93);
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        for (guint xor = 0; xor < 2; xor++) {
+            ringbuf_frame_geometry_t geometry = {301, 7, depths[d]};
+            ringbuf_delta_mode_t mode = xor ? RINGBUF_DELTA_XOR : RINGBUF_DELTA_SUBTRACT;
+            gsize nb_pixels = 301 * 7, size = nb_pixels * depths[d];
+            guint32 mask = depths[d] == 4 ? G_MAXUINT32 : (1u << (8 * depths[d])) - 1;
+            guint8 *previous = g_malloc(size), *pixels = g_malloc(size), *residuals = g_malloc(size);
+            guint8 *enc_reference = g_malloc(size), *dec_reference = g_malloc(size);
+
+            fill_random(previous, size, rand);
+            fill_random(pixels, size, rand);
+            memcpy(enc_reference, previous, size);
+            memcpy(dec_reference, previous, size);
+
+            ringbuf_delta_encode(&geometry, mode, pixels, enc_reference, residuals);
+            g_assert_cmpint(memcmp(enc_reference, pixels, size), ==, 0);
+            for (gsize i = 0; i < nb_pixels; i++) {
+                guint32 x = pixel_at(pixels, depths[d], i), r = pixel_at(previous, depths[d], i);
+                g_assert_cmpuint(pixel_at(residuals, depths[d], i), ==, xor ? x ^ r : (x - r) & mask);
+            }
+
+            ringbuf_delta_decode(&geometry, mode, residuals, dec_reference, residuals);
+            g_assert_cmpint(memcmp(residuals, pixels, size), ==, 0);
+            g_assert_cmpint(memcmp(dec_reference, pixels, size), ==, 0);
+
+            // An unchanged frame is all zeros
+            ringbuf_delta_encode(&geometry, mode, pixels, enc_reference, residuals);
+            for (gsize i = 0; i < size; i++) {
+                g_assert_cmpuint(residuals[i], ==, 0);
+            }
+
+            g_free(dec_reference);
+            g_free(enc_reference);
+            g_free(residuals);
+            g_free(pixels);
+            g_free(previous);
+        }
+    }
+    g_rand_free(rand);
+}
+
+// Frames from a ring through the stage thread, keyframes, and a lost record
+static void test_delta_stage(void) {
+    ringbuf_frame_geometry_t geometry = {64, 33, 2};
+    const gsize size = 64 * 33 * 2;
+    const guint nb_frames = 7;
+    ringbuf_frame_ring_t *input = ringbuf_frame_ring_new("raw", &geometry, 2, TRUE);
+    ringbuf_delta_encoder_t *enc = ringbuf_delta_encoder_new(&geometry, RINGBUF_DELTA_SUBTRACT, 3, nb_frames);
+    ringbuf_delta_decoder_t *dec = ringbuf_delta_decoder_new(&geometry, RINGBUF_DELTA_SUBTRACT);
+    ringbuf_delta_decoder_t *lossy = ringbuf_delta_decoder_new(&geometry, RINGBUF_DELTA_SUBTRACT);
+    ringbuf_t *output = ringbuf_delta_encoder_output(enc);
+    ringbuf_delta_header_t header;
+    GRand *rand = g_rand_new_with_seed(930);
+    guint8 *frames = g_malloc(nb_frames * size), *decoded = g_malloc(size), *payload = g_malloc(size);
+
+    // Slowly drifting frames
+    fill_random(frames, size, rand);
+    for (gsize i = size; i < nb_frames * size; i += 2) {
+        guint16 *pixel = (guint16 *) (frames + i);
+        *pixel = *(guint16 *) (frames + i - size) + g_rand_int_range(rand, -3, 4);
+    }
+
+    ringbuf_delta_encoder_start(enc, input);
+    for (guint f = 0; f < nb_frames; f++) {
+        memcpy(ringbuf_frame_ring_reserve(input), frames + f * size, size);
+        ringbuf_frame_ring_commit(input);
+    }
+
+    for (guint f = 0; f < nb_frames; f++) {
+        g_assert_true(ringbuf_delta_decoder_pop(dec, output, &header, decoded, G_USEC_PER_SEC));
+        g_assert_cmpuint(header.sequence, ==, f);
+        g_assert_cmpuint(header.size, ==, size);
+        g_assert_cmpuint(header.flags, ==, f % 3 == 0 ? RINGBUF_DELTA_KEYFRAME : 0);
+        g_assert_cmpuint(header.reference, ==, f % 3 == 0 ? f : f - 1);
+        g_assert_cmpint(memcmp(decoded, frames + f * size, size), ==, 0);
+    }
+    g_assert_false(ringbuf_delta_decoder_pop(dec, output, &header, decoded, 1000));
+
+    // A keyframe on request, then record 3 lost: 4 does not decode, 5 is a keyframe again
+    ringbuf_delta_encoder_request_keyframe(enc);
+    for (guint f = 0; f < 6; f++) {
+        memcpy(ringbuf_frame_ring_reserve(input), frames + f * size, size);
+        ringbuf_frame_ring_commit(input);
+    }
+    for (guint f = 0; f < 6; f++) {
+        ringbuf_pop(&header, output, sizeof(header));
+        ringbuf_pop(payload, output, header.size);
+        g_assert_cmpuint(header.flags, ==, f == 0 || f == 2 || f == 5 ? RINGBUF_DELTA_KEYFRAME : 0);
+        if (f == 3) {
+            continue;
+        }
+        g_assert_cmpint(ringbuf_delta_decoder_decode(lossy, &header, payload, decoded), ==, f != 4);
+        if (f != 4) {
+            g_assert_cmpint(memcmp(decoded, frames + f * size, size), ==, 0);
+        }
+    }
+    ringbuf_delta_encoder_stop(enc);
+
+    g_free(payload);
+    g_free(decoded);
+    g_free(frames);
+    g_rand_free(rand);
+    ringbuf_delta_decoder_free(lossy);
+    ringbuf_delta_decoder_free(dec);
+    ringbuf_delta_encoder_free(enc);
+    ringbuf_frame_ring_free(input);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/delta/roundtrip", test_delta_roundtrip);
+    g_test_add_func("/ringbuf/delta/stage", test_delta_stage);
+
+    return g_test_run();
+}
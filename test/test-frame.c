@@ -0,0 +1,232 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-framegen.h"
+#include "test.h"
+#include <glib.h>
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+static void reference_stats(const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                            guint32 saturation, ringbuf_frame_stats_t *stats) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->min = G_MAXUINT32;
+    for (gsize i = 0; i < nb_pixels; i++) {
+        guint32 v = pixel_at(pixels, geometry->bytes_per_pixel, i);
+        stats->min = MIN(stats->min, v);
+        stats->max = MAX(stats->max, v);
+        stats->sum += v;
+        stats->saturated += v >= saturation;
+    }
+    stats->mean = (gdouble) stats->sum / nb_pixels;
+}
+
+static void assert_stats_equal(const ringbuf_frame_stats_t *a, const ringbuf_frame_stats_t *b) {
+    g_assert_cmpuint(a->min, ==, b->min);
+    g_assert_cmpuint(a->max, ==, b->max);
+    g_assert_cmpuint(a->sum, ==, b->sum);
+    g_assert_cmpuint(a->saturated, ==, b->saturated);
+    g_assert_cmpfloat(a->mean, ==, b->mean);
+}
+
+// The vector kernel matches a scalar reference, odd sizes included
+static void test_frame_stats(void) {
+    const guint depths[] = {1, 2, 4};
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        ringbuf_frame_geometry_t geometry = {61, 7, depths[d]};
+        ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, geometry.width, geometry.height,
+                                                       geometry.bytes_per_pixel, d);
+        gpointer frame = g_malloc(ringbuf_framegen_frame_size(gen));
+        guint32 saturation = 3u << (8 * depths[d] - 2);
+        ringbuf_frame_stats_t stats, expected;
+
+        for (guint f = 0; f < 10; f++) {
+            ringbuf_framegen_fill(gen, frame);
+            ringbuf_frame_compute_stats(&geometry, frame, saturation, &stats);
+            reference_stats(&geometry, frame, saturation, &expected);
+            assert_stats_equal(&stats, &expected);
+        }
+
+        g_free(frame);
+        ringbuf_framegen_free(gen);
+    }
+
+    // Sums of large frames of bright pixels do not overflow the vector lanes
+    ringbuf_frame_geometry_t geometry = {1024, 1024, 4};
+    guint32 *bright = g_new(guint32, 1024 * 1024);
+    ringbuf_frame_stats_t stats;
+    memset(bright, 0xff, 1024 * 1024 * sizeof(guint32));
+    bright[12345] = 7;
+    ringbuf_frame_compute_stats(&geometry, bright, G_MAXUINT32, &stats);
+    g_assert_cmpuint(stats.sum, ==, (guint64) G_MAXUINT32 * (1024 * 1024 - 1) + 7);
+    g_assert_cmpuint(stats.min, ==, 7);
+    g_assert_cmpuint(stats.max, ==, G_MAXUINT32);
+    g_assert_cmpuint(stats.saturated, ==, 1024 * 1024 - 1);
+    g_free(bright);
+}
+
+// Frames come out in order with their metadata, in place or copied
+static void test_frame_ring(void) {
+    ringbuf_frame_geometry_t geometry = {100, 30, 2};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 4, TRUE);
+    ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 100, 30, 2, 0);
+    ringbuf_framegen_t *ref = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 100, 30, 2, 0);
+    gsize size = ringbuf_frame_ring_frame_size(fr);
+    guint8 *expected = g_malloc(size), *frame = g_malloc(size);
+    ringbuf_frame_meta_t meta;
+
+    g_assert_cmpuint(size, ==, 100 * 30 * 2);
+    g_assert_cmpstr(ringbuf_name(ringbuf_frame_ring_pixels(fr)), ==, "frames");
+
+    for (guint f = 0; f < 25; f++) {
+        ringbuf_framegen_fill(gen, ringbuf_frame_ring_reserve(fr));
+        ringbuf_frame_ring_commit(fr);
+        ringbuf_framegen_fill(ref, expected);
+
+        if (f % 2 == 0) {
+            gconstpointer pixels = ringbuf_frame_ring_acquire(fr, &meta);
+            g_assert_true(memcmp(pixels, expected, size) == 0);
+            ringbuf_frame_ring_release(fr);
+        }
+        else {
+            ringbuf_frame_ring_pop(fr, frame, &meta);
+            g_assert_true(memcmp(frame, expected, size) == 0);
+        }
+        g_assert_cmpuint(meta.sequence, ==, f);
+        g_assert_cmpuint(meta.flags, ==, 0);
+        g_assert_cmpint(meta.timestamp, >, 0);
+    }
+    g_assert_null(ringbuf_frame_ring_acquire_timed(fr, &meta, 1000));
+
+    g_free(expected);
+    g_free(frame);
+    ringbuf_framegen_free(gen);
+    ringbuf_framegen_free(ref);
+    ringbuf_frame_ring_free(fr);
+}
+
+// With the stage enabled, commit and fused push both publish the stats
+static void test_frame_ring_stats(void) {
+    // Large enough for several fused blocks and a partial one
+    ringbuf_frame_geometry_t geometry = {1000, 33, 2};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new(NULL, &geometry, 2, TRUE);
+    ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 1000, 33, 2, 3);
+    gsize size = ringbuf_frame_ring_frame_size(fr);
+    guint8 *src = g_malloc(size);
+    ringbuf_frame_stats_t expected;
+    ringbuf_frame_meta_t meta;
+
+    ringbuf_frame_ring_set_stats(fr, TRUE, 60000);
+
+    ringbuf_framegen_fill(gen, src);
+    reference_stats(&geometry, src, 60000, &expected);
+    g_assert_true(ringbuf_frame_ring_push(fr, src));
+    ringbuf_frame_ring_acquire(fr, &meta);
+    ringbuf_frame_ring_release(fr);
+    g_assert_cmpuint(meta.flags & RINGBUF_FRAME_META_STATS, !=, 0);
+    assert_stats_equal(&meta.stats, &expected);
+
+    ringbuf_framegen_fill(gen, ringbuf_frame_ring_reserve(fr));
+    ringbuf_frame_ring_commit(fr);
+    gconstpointer pixels = ringbuf_frame_ring_acquire(fr, &meta);
+    reference_stats(&geometry, pixels, 60000, &expected);
+    ringbuf_frame_ring_release(fr);
+    assert_stats_equal(&meta.stats, &expected);
+    g_assert_cmpuint(meta.sequence, ==, 1);
+
+    g_free(src);
+    ringbuf_framegen_free(gen);
+    ringbuf_frame_ring_free(fr);
+}
+
+// A non-blocking ring drops frames once full, the sidecar never fills first
+static void test_frame_ring_drops(void) {
+    ringbuf_frame_geometry_t geometry = {1000, 1, 1};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("drops", &geometry, 1, FALSE);
+    guint8 src[1000] = {0};
+    guint capacity = ringbuf_buffer_size(ringbuf_frame_ring_pixels(fr)) / sizeof(src);
+    ringbuf_frame_meta_t meta;
+
+    for (guint f = 0; f < capacity; f++) {
+        g_assert_true(ringbuf_frame_ring_push(fr, src));
+    }
+    g_assert_false(ringbuf_frame_ring_push(fr, src));
+    g_assert_null(ringbuf_frame_ring_reserve(fr));
+
+    for (guint f = 0; f < capacity; f++) {
+        ringbuf_frame_ring_acquire(fr, &meta);
+        ringbuf_frame_ring_release(fr);
+        g_assert_cmpuint(meta.sequence, ==, f);
+    }
+
+    ringbuf_frame_ring_free(fr);
+}
+
+// Only the regions are copied, narrow and wide rows alike
+static void test_frame_ring_rois(void) {
+    ringbuf_frame_geometry_t geometry = {100, 30, 2};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 2, TRUE);
+    ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 100, 30, 2, 0);
+    const ringbuf_frame_roi_t rois[] = {{3, 2, 5, 4}, {10, 0, 40, 30}, {0, 29, 100, 1}, {99, 0, 1, 30}};
+    const ringbuf_frame_roi_t outside = {90, 0, 11, 1};
+    gsize size = ringbuf_frame_rois_size(&geometry, rois, G_N_ELEMENTS(rois));
+    guint16 *dst = g_malloc(size);
+    ringbuf_frame_meta_t meta;
+
+    g_assert_cmpuint(size, ==, (5 * 4 + 40 * 30 + 100 + 30) * 2);
+
+    for (guint f = 0; f < 2; f++) {
+        ringbuf_framegen_fill(gen, ringbuf_frame_ring_reserve(fr));
+        ringbuf_frame_ring_commit(fr);
+    }
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*does not fit*");
+    g_assert_false(ringbuf_frame_ring_pop_rois(fr, &outside, 1, dst, &meta));
+    g_test_assert_expected_messages();
+
+    for (guint f = 0; f < 2; f++) {
+        g_assert_true(ringbuf_frame_ring_pop_rois(fr, rois, G_N_ELEMENTS(rois), dst, &meta));
+        g_assert_cmpuint(meta.sequence, ==, f);
+
+        const guint16 *p = dst;
+        for (guint r = 0; r < G_N_ELEMENTS(rois); r++) {
+            for (guint y = rois[r].y; y < rois[r].y + rois[r].height; y++) {
+                for (guint x = rois[r].x; x < rois[r].x + rois[r].width; x++) {
+                    g_assert_cmpuint(*p++, ==, x + y + f);
+                }
+            }
+        }
+    }
+
+    gsize stride;
+    guint16 frame[100 * 30];
+    const guint16 *origin = ringbuf_frame_roi_view(&geometry, frame, &rois[0], &stride);
+    g_assert_true(origin == &frame[2 * 100 + 3]);
+    g_assert_cmpuint(stride, ==, 200);
+
+    g_free(dst);
+    ringbuf_framegen_free(gen);
+    ringbuf_frame_ring_free(fr);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/frame/stats", test_frame_stats);
+    g_test_add_func("/ringbuf/frame/ring", test_frame_ring);
+    g_test_add_func("/ringbuf/frame/ring_stats", test_frame_ring_stats);
+    g_test_add_func("/ringbuf/frame/drops", test_frame_ring_drops);
+    g_test_add_func("/ringbuf/frame/rois", test_frame_ring_rois);
+
+    return g_test_run();
+}
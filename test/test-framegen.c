@@ -0,0 +1,145 @@
+#include "../ringbuf.h"
+#include "../ringbuf-framegen.h"
+#include "test.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+
+// Odd widths exercise the scalar tail after the vector stores
+static void test_framegen_ramp(void) {
+    const guint width = 37, height = 5;
+    const guint depths[] = {1, 2, 4};
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, width, height, depths[d], 0);
+        guint8 *frame = g_malloc(ringbuf_framegen_frame_size(gen));
+        g_assert_cmpuint(ringbuf_framegen_frame_size(gen), ==, width * height * depths[d]);
+
+        for (guint f = 0; f < 300; f++) {
+            ringbuf_framegen_fill(gen, frame);
+            for (guint y = 0; y < height; y++) {
+                for (guint x = 0; x < width; x++) {
+                    guint64 expected = x + y + f;
+                    gsize i = y * width + x;
+                    if (depths[d] == 1) {
+                        g_assert_cmpuint(frame[i], ==, (guint8) expected);
+                    }
+                    else if (depths[d] == 2) {
+                        g_assert_cmpuint(((guint16 *) frame)[i], ==, (guint16) expected);
+                    }
+                    else {
+                        g_assert_cmpuint(((guint32 *) frame)[i], ==, (guint32) expected);
+                    }
+                }
+            }
+        }
+
+        g_free(frame);
+        ringbuf_framegen_free(gen);
+    }
+}
+
+// Same seed, same frames; successive frames and other seeds differ
+static void test_framegen_noise(void) {
+    ringbuf_framegen_t *a = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 101, 3, 2, 42);
+    ringbuf_framegen_t *b = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 101, 3, 2, 42);
+    ringbuf_framegen_t *c = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 101, 3, 2, 7);
+    gsize size = ringbuf_framegen_frame_size(a);
+    guint8 *fa = g_malloc(size + 1), *fb = g_malloc(size), *fc = g_malloc(size);
+
+    // The tail of the last block must not spill past the frame
+    fa[size] = 0xee;
+    ringbuf_framegen_fill(a, fa);
+    ringbuf_framegen_fill(b, fb);
+    ringbuf_framegen_fill(c, fc);
+    g_assert_cmpuint(fa[size], ==, 0xee);
+    g_assert_true(memcmp(fa, fb, size) == 0);
+    g_assert_true(memcmp(fa, fc, size) != 0);
+
+    ringbuf_framegen_fill(b, fb);
+    g_assert_true(memcmp(fa, fb, size) != 0);
+
+    // Rough uniformity, every byte value should show up
+    guint counts[256] = {0};
+    for (guint f = 0; f < 64; f++) {
+        ringbuf_framegen_fill(a, fa);
+        for (gsize i = 0; i < size; i++) {
+            counts[fa[i]]++;
+        }
+    }
+    for (guint v = 0; v < 256; v++) {
+        g_assert_cmpuint(counts[v], >, 0);
+    }
+
+    g_free(fa);
+    g_free(fb);
+    g_free(fc);
+    ringbuf_framegen_free(a);
+    ringbuf_framegen_free(b);
+    ringbuf_framegen_free(c);
+}
+
+static void test_framegen_replay(void) {
+    guint16 frames[3][8];
+    gchar *path = NULL;
+    gint fd = g_file_open_tmp("framegen-XXXXXX", &path, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    close(fd);
+
+    for (guint f = 0; f < 3; f++) {
+        for (guint i = 0; i < 8; i++) {
+            frames[f][i] = f * 1000 + i;
+        }
+    }
+    // A trailing partial frame is ignored
+    g_assert_true(g_file_set_contents(path, (const gchar *) frames, sizeof(frames) + 3, NULL));
+
+    ringbuf_framegen_t *gen = ringbuf_framegen_new_replay(path, 4, 2, 2);
+    g_assert_nonnull(gen);
+    guint16 frame[8];
+    for (guint f = 0; f < 7; f++) {
+        ringbuf_framegen_fill(gen, frame);
+        g_assert_true(memcmp(frame, frames[f % 3], sizeof(frame)) == 0);
+    }
+    ringbuf_framegen_free(gen);
+
+    // Too short for one frame
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*less than one*");
+    g_assert_null(ringbuf_framegen_new_replay(path, 64, 64, 2));
+    g_test_assert_expected_messages();
+
+    g_unlink(path);
+    g_free(path);
+}
+
+// Frames are generated in place, across the wrap of the ring
+static void test_framegen_push(void) {
+    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 100, 10, 2, 0);
+    ringbuf_framegen_t *ref = ringbuf_framegen_new(RINGBUF_PATTERN_RAMP, 100, 10, 2, 0);
+    gsize size = ringbuf_framegen_frame_size(gen);
+    guint8 *expected = g_malloc(size), *frame = g_malloc(size);
+
+    for (guint f = 0; f < 20; f++) {
+        g_assert_nonnull(ringbuf_framegen_push(gen, rb));
+        ringbuf_framegen_fill(ref, expected);
+        ringbuf_pop(frame, rb, size);
+        g_assert_true(memcmp(frame, expected, size) == 0);
+    }
+
+    g_free(expected);
+    g_free(frame);
+    ringbuf_framegen_free(gen);
+    ringbuf_framegen_free(ref);
+    ringbuf_free(rb);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/framegen/ramp", test_framegen_ramp);
+    g_test_add_func("/ringbuf/framegen/noise", test_framegen_noise);
+    g_test_add_func("/ringbuf/framegen/replay", test_framegen_replay);
+    g_test_add_func("/ringbuf/framegen/push", test_framegen_push);
+
+    return g_test_run();
+}
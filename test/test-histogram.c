@@ -0,0 +1,131 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-framegen.h"
+#include "../ringbuf-histogram.h"
+#include "test.h"
+#include <glib.h>
+
+static void reference_histogram(const ringbuf_frame_geometry_t *geometry, gconstpointer pixels,
+                                guint bits, guint32 *bins) {
+    gsize nb_pixels = (gsize) geometry->width * geometry->height;
+    guint shift = 8 * geometry->bytes_per_pixel - bits;
+
+    memset(bins, 0, ((gsize) 1 << bits) * sizeof(guint32));
+    for (gsize i = 0; i < nb_pixels; i++) {
+        guint32 v = geometry->bytes_per_pixel == 1 ? ((const guint8 *) pixels)[i] :
+                    geometry->bytes_per_pixel == 2 ? ((const guint16 *) pixels)[i] :
+                    ((const guint32 *) pixels)[i];
+        bins[v >> shift]++;
+    }
+}
+
+static void test_histogram_compute(void) {
+    const struct { guint bpp, bits; } cases[] = { {1, 8}, {1, 4}, {2, 16}, {2, 12}, {4, 16} };
+
+    for (guint c = 0; c < G_N_ELEMENTS(cases); c++) {
+        ringbuf_frame_geometry_t geometry = {123, 45, cases[c].bpp};
+        ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 123, 45, cases[c].bpp, c);
+        gpointer frame = g_malloc(ringbuf_framegen_frame_size(gen));
+        gsize nb_bins = (gsize) 1 << cases[c].bits;
+        guint32 *bins = g_new(guint32, nb_bins), *expected = g_new(guint32, nb_bins);
+
+        ringbuf_framegen_fill(gen, frame);
+        ringbuf_histogram_compute(&geometry, frame, cases[c].bits, bins);
+        reference_histogram(&geometry, frame, cases[c].bits, expected);
+        g_assert_true(memcmp(bins, expected, nb_bins * sizeof(guint32)) == 0);
+
+        g_free(bins);
+        g_free(expected);
+        g_free(frame);
+        ringbuf_framegen_free(gen);
+    }
+}
+
+// Attached to a frame ring, on one thread or split across tiles
+static void test_histogram_stage(void) {
+    const guint threads[] = {1, 3};
+
+    for (guint t = 0; t < G_N_ELEMENTS(threads); t++) {
+        // Above the threading threshold, with rows that do not split evenly
+        ringbuf_frame_geometry_t geometry = {1024, 517, 2};
+        ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("histogram", &geometry, 2, TRUE);
+        ringbuf_histogram_stage_t *stage = ringbuf_histogram_stage_new(&geometry, 16, threads[t], 4);
+        ringbuf_framegen_t *gen = ringbuf_framegen_new(RINGBUF_PATTERN_NOISE, 1024, 517, 2, t);
+        guint32 *bins = g_new(guint32, 1 << 16), *expected = g_new(guint32, 1 << 16);
+        ringbuf_frame_meta_t meta;
+        guint64 sequence;
+
+        g_assert_cmpuint(ringbuf_histogram_stage_nb_bins(stage), ==, 1 << 16);
+        ringbuf_histogram_stage_attach(stage, fr);
+
+        for (guint f = 0; f < 3; f++) {
+            ringbuf_framegen_fill(gen, ringbuf_frame_ring_reserve(fr));
+            ringbuf_frame_ring_commit(fr);
+
+            gconstpointer pixels = ringbuf_frame_ring_acquire(fr, &meta);
+            g_assert_cmpuint(meta.flags & RINGBUF_FRAME_META_HISTOGRAM, !=, 0);
+            g_assert_true(ringbuf_histogram_stage_pop(stage, &sequence, bins, 0));
+            g_assert_cmpuint(sequence, ==, meta.sequence);
+            reference_histogram(&geometry, pixels, 16, expected);
+            g_assert_true(memcmp(bins, expected, (1 << 16) * sizeof(guint32)) == 0);
+            ringbuf_frame_ring_release(fr);
+        }
+        g_assert_false(ringbuf_histogram_stage_pop(stage, &sequence, bins, 1000));
+
+        g_free(bins);
+        g_free(expected);
+        ringbuf_framegen_free(gen);
+        ringbuf_frame_ring_free(fr);
+        ringbuf_histogram_stage_free(stage);
+    }
+}
+
+// A reader that falls behind loses histograms, frames still flow
+static void test_histogram_drops(void) {
+    ringbuf_frame_geometry_t geometry = {64, 64, 1};
+    ringbuf_histogram_stage_t *stage = ringbuf_histogram_stage_new(&geometry, 8, 1, 1);
+    guint8 frame[64 * 64];
+    guint32 bins[256];
+    ringbuf_frame_meta_t meta = {0};
+    guint64 sequence;
+    guint published = 0;
+
+    memset(frame, 7, sizeof(frame));
+    for (guint f = 0; f < 100; f++) {
+        meta.sequence = f;
+        meta.flags = 0;
+        if (ringbuf_histogram_stage_process(stage, frame, &meta)) {
+            g_assert_cmpuint(meta.flags, ==, RINGBUF_FRAME_META_HISTOGRAM);
+            published++;
+        }
+        else {
+            g_assert_cmpuint(meta.flags, ==, 0);
+        }
+    }
+    g_assert_cmpuint(published, >, 0);
+    g_assert_cmpuint(published, <, 100);
+
+    for (guint i = 0; i < published; i++) {
+        g_assert_true(ringbuf_histogram_stage_pop(stage, &sequence, bins, 0));
+        g_assert_cmpuint(sequence, ==, i);
+        g_assert_cmpuint(bins[7], ==, 64 * 64);
+    }
+
+    // Dropped frames left no counts behind
+    meta.sequence = 100;
+    g_assert_true(ringbuf_histogram_stage_process(stage, frame, &meta));
+    g_assert_true(ringbuf_histogram_stage_pop(stage, &sequence, bins, 0));
+    g_assert_cmpuint(bins[7], ==, 64 * 64);
+
+    ringbuf_histogram_stage_free(stage);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/histogram/compute", test_histogram_compute);
+    g_test_add_func("/ringbuf/histogram/stage", test_histogram_stage);
+    g_test_add_func("/ringbuf/histogram/drops", test_histogram_drops);
+
+    return g_test_run();
+}
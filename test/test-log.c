@@ -0,0 +1,234 @@
+#include "../ringbuf.h"
+#include "../ringbuf-log.h"
+#include "test.h"
+#include <glib.h>
+
+static gchar *log_path(const gchar *name) {
+    return g_strdup_printf("%s/ringbuf-log-%d-%s.log", g_get_tmp_dir(), (gint) getpid(), name);
+}
+
+// Lines of a log file, each split after its thread into the thread and "LEVEL: message"
+static gchar **read_lines(const gchar *path, guint *nb_lines) {
+    gchar *contents = NULL;
+    g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    *nb_lines = g_strv_length(lines) - 1;
+    g_assert_cmpstr(lines[*nb_lines], ==, "");
+    g_free(contents);
+    return lines;
+}
+
+static const gchar *line_message(const gchar *line) {
+    const gchar *message = strstr(line, "]");
+    g_assert_nonnull(message);
+    message = strstr(message, ": ");
+    g_assert_nonnull(message);
+    return message + 2;
+}
+
+#define CHECK(logger, expected, ...)                                \
+    G_STMT_START {                                                  \
+        ringbuf_log(logger, G_LOG_LEVEL_INFO, __VA_ARGS__);         \
+        g_ptr_array_add(expected, g_strdup_printf(__VA_ARGS__));    \
+    } G_STMT_END
+
+// Messages formatted by the logger's thread read the same as printf()
+static void test_log_format(void) {
+    gchar *path = log_path("format");
+    ringbuf_logger_t *logger = ringbuf_logger_new(16384, path);
+    GPtrArray *expected = g_ptr_array_new_with_free_func(g_free);
+    gchar *heap = g_strdup("temporary");
+    gchar long_string[301];
+
+    CHECK(logger, expected, "plain text, 100%% sure");
+    CHECK(logger, expected, "%d %u %x %c %hhd %hd|%5d|%-5d|%05d", -5, 7u, 255u, 'z', -3, 300, 1, 2, 3);
+    CHECK(logger, expected, "%ld %lu %lld %llu %zu %zd %td %jd", -1L, 2UL, -3LL, 4ULL, (gsize) 5, (gssize) -6,
+          (ptrdiff_t) 7, (intmax_t) -8);
+    CHECK(logger, expected, "%" G_GINT64_FORMAT " %" G_GUINT64_FORMAT, G_MININT64, G_MAXUINT64);
+    CHECK(logger, expected, "%f %.3e %g %10.2f|%-8.1f|%a", 1.5, 12345.678, 1e-10, -3.14159, 2.25, 0.5);
+    CHECK(logger, expected, "%*d|%-*.*f|%.*s|%%|%s", 6, 42, 9, 2, 3.14159, 3, "abcdef", "end");
+    CHECK(logger, expected, "%p and %d%% done", (gpointer) 0x1234, 50);
+    CHECK(logger, expected, "[%s] copied", heap);
+    // Arguments are copied, the caller may reuse them at once
+    memset(heap, 'x', strlen(heap));
+    g_free(heap);
+    // Formats the records cannot carry are formatted by the caller
+    CHECK(logger, expected, "%Lf", (long double) 2.5);
+    CHECK(logger, expected, "%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+          17);
+    // Long strings are cut
+    memset(long_string, 'a', 300);
+    long_string[300] = '\0';
+    ringbuf_log(logger, G_LOG_LEVEL_WARNING, "<%s>", long_string);
+    long_string[256] = '\0';
+    g_ptr_array_add(expected, g_strdup_printf("<%s>", long_string));
+
+    ringbuf_logger_flush(logger);
+    guint nb_lines;
+    gchar **lines = read_lines(path, &nb_lines);
+    g_assert_cmpuint(nb_lines, ==, expected->len);
+    for (guint i = 0; i < nb_lines; i++) {
+        g_assert_cmpstr(line_message(lines[i]), ==, g_ptr_array_index(expected, i));
+        g_assert_nonnull(strstr(lines[i], i + 1 < nb_lines ? "INFO: " : "WARNING: "));
+    }
+    g_assert_cmpuint(ringbuf_logger_nb_dropped(logger), ==, 0);
+
+    g_strfreev(lines);
+    ringbuf_logger_free(logger);
+    g_ptr_array_unref(expected);
+    unlink(path);
+    g_free(path);
+}
+
+#define NB_WRITERS 4
+#define NB_MESSAGES 2000
+
+static gpointer writer_thread(gpointer data) {
+    ringbuf_logger_t *logger = data;
+    for (guint i = 0; i < NB_MESSAGES; i++) {
+        ringbuf_log(logger, G_LOG_LEVEL_DEBUG, "message %u of %d", i, NB_MESSAGES);
+    }
+    return NULL;
+}
+
+static void count_writer_rings(ringbuf_t *rb, gpointer user_data) {
+    if (g_str_has_prefix(ringbuf_name(rb), "log-writer")) {
+        (*(guint *) user_data)++;
+    }
+}
+
+// Threads logging at once, each in order, their rings dropped once they exit
+static void test_log_threads(void) {
+    gchar *path = log_path("threads");
+    ringbuf_logger_t *logger = ringbuf_logger_new(256 * 1024, path);
+    GThread *threads[NB_WRITERS];
+    guint next[NB_WRITERS] = {0};
+    guint nb_rings = 0;
+
+    for (guint t = 0; t < NB_WRITERS; t++) {
+        gchar *name = g_strdup_printf("writer-%u", t);
+        threads[t] = g_thread_new(name, writer_thread, logger);
+        g_free(name);
+    }
+    for (guint t = 0; t < NB_WRITERS; t++) {
+        g_thread_join(threads[t]);
+    }
+    ringbuf_logger_flush(logger);
+    ringbuf_foreach(count_writer_rings, &nb_rings);
+    g_assert_cmpuint(nb_rings, ==, 0);
+    g_assert_cmpuint(ringbuf_logger_nb_dropped(logger), ==, 0);
+    ringbuf_logger_free(logger);
+
+    guint nb_lines;
+    gchar **lines = read_lines(path, &nb_lines);
+    g_assert_cmpuint(nb_lines, ==, NB_WRITERS * NB_MESSAGES);
+    for (guint i = 0; i < nb_lines; i++) {
+        guint t, n;
+        const gchar *thread = strstr(lines[i], "[writer-");
+        g_assert_nonnull(thread);
+        g_assert_cmpint(sscanf(thread, "[writer-%u]", &t), ==, 1);
+        g_assert_cmpint(sscanf(line_message(lines[i]), "message %u of", &n), ==, 1);
+        g_assert_cmpuint(t, <, NB_WRITERS);
+        g_assert_cmpuint(n, ==, next[t]++);
+    }
+
+    g_strfreev(lines);
+    unlink(path);
+    g_free(path);
+}
+
+// A full ring drops messages and says so, instead of blocking
+static void test_log_drops(void) {
+    gchar *path = log_path("drops");
+    ringbuf_logger_t *logger = ringbuf_logger_new(4096, path);
+    guint nb_messages = 0, nb_reports = 0;
+
+    for (guint i = 0; i < 5000; i++) {
+        ringbuf_log(logger, G_LOG_LEVEL_MESSAGE, "burst %u", i);
+    }
+    ringbuf_logger_flush(logger);
+    guint64 dropped = ringbuf_logger_nb_dropped(logger);
+    ringbuf_logger_free(logger);
+
+    guint nb_lines;
+    gchar **lines = read_lines(path, &nb_lines);
+    for (guint i = 0; i < nb_lines; i++) {
+        if (g_str_has_prefix(line_message(lines[i]), "burst ")) {
+            nb_messages++;
+        }
+        else {
+            g_assert_nonnull(strstr(lines[i], "messages dropped"));
+            nb_reports++;
+        }
+    }
+    g_assert_cmpuint(dropped, >, 0);
+    g_assert_cmpuint(nb_reports, >, 0);
+    g_assert_cmpuint(nb_messages + dropped, ==, 5000);
+
+    g_strfreev(lines);
+    unlink(path);
+    g_free(path);
+}
+
+#if GLIB_CHECK_VERSION(2, 50, 0)
+static GMutex captured_lock;
+static GPtrArray *captured;
+
+// Keeps the messages of loggers, hands the others to GLib
+static GLogWriterOutput capture_writer(GLogLevelFlags level, const GLogField *fields, gsize n_fields,
+                                       gpointer user_data) {
+    const gchar *message = NULL, *thread = NULL;
+
+    for (gsize i = 0; i < n_fields; i++) {
+        if (g_strcmp0(fields[i].key, "MESSAGE") == 0) {
+            message = fields[i].value;
+        }
+        else if (g_strcmp0(fields[i].key, "RINGBUF_THREAD") == 0) {
+            thread = fields[i].value;
+        }
+    }
+    if (thread == NULL) {
+        return g_log_writer_default(level, fields, n_fields, user_data);
+    }
+    g_mutex_lock(&captured_lock);
+    g_ptr_array_add(captured, g_strdup_printf("%d %s", level & G_LOG_LEVEL_MASK, message));
+    g_mutex_unlock(&captured_lock);
+    return G_LOG_WRITER_HANDLED;
+}
+
+// Without a file, messages go through the GLib log writer
+static void test_log_glib(void) {
+    ringbuf_logger_t *logger = ringbuf_logger_new(8192, NULL);
+    gchar *info, *error;
+
+    captured = g_ptr_array_new_with_free_func(g_free);
+    ringbuf_log(logger, G_LOG_LEVEL_INFO, "glib %d", 7);
+    // Errors do not abort the logger's thread
+    ringbuf_log(logger, G_LOG_LEVEL_ERROR, "fatal %s", "enough");
+    ringbuf_logger_free(logger);
+
+    info = g_strdup_printf("%d glib 7", G_LOG_LEVEL_INFO);
+    error = g_strdup_printf("%d fatal enough", G_LOG_LEVEL_CRITICAL);
+    g_assert_cmpuint(captured->len, ==, 2);
+    g_assert_cmpstr(g_ptr_array_index(captured, 0), ==, info);
+    g_assert_cmpstr(g_ptr_array_index(captured, 1), ==, error);
+
+    g_free(info);
+    g_free(error);
+    g_ptr_array_unref(captured);
+}
+#endif
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/log/format", test_log_format);
+    g_test_add_func("/ringbuf/log/threads", test_log_threads);
+    g_test_add_func("/ringbuf/log/drops", test_log_drops);
+#if GLIB_CHECK_VERSION(2, 50, 0)
+    g_log_set_writer_func(capture_writer, NULL, NULL);
+    g_test_add_func("/ringbuf/log/glib", test_log_glib);
+#endif
+
+    return g_test_run();
+}
@@ -0,0 +1,129 @@
+#include "../ringbuf.h"
+#include "../ringbuf-mailbox.h"
+#include "test.h"
+#include <glib.h>
+
+static const ringbuf_frame_geometry_t geometry = {64, 48, 4};
+#define NB_PIXELS (64 * 48)
+
+static void fill(gpointer frame, guint32 value) {
+    guint32 *pixels = frame;
+    for (guint i = 0; i < NB_PIXELS; i++) {
+        pixels[i] = value;
+    }
+}
+
+// Whole frame holds @value, read once so a torn frame shows
+static gboolean holds(gconstpointer frame, guint32 value) {
+    const guint32 *pixels = frame;
+    for (guint i = 0; i < NB_PIXELS; i++) {
+        if (pixels[i] != value) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// The consumer gets the newest frame, older unread ones are overwritten
+static void test_mailbox_latest(void) {
+    ringbuf_mailbox_t *mb = ringbuf_mailbox_new("mailbox", &geometry);
+    ringbuf_frame_meta_t meta;
+
+    g_assert_null(ringbuf_mailbox_acquire(mb, &meta));
+    for (guint32 f = 0; f < 3; f++) {
+        fill(ringbuf_mailbox_reserve(mb), 100 + f);
+        ringbuf_mailbox_commit(mb, NULL);
+    }
+    gconstpointer frame = ringbuf_mailbox_acquire(mb, &meta);
+    g_assert_nonnull(frame);
+    g_assert_cmpuint(meta.sequence, ==, 2);
+    g_assert_cmpint(meta.timestamp, >, 0);
+    g_assert_true(holds(frame, 102));
+
+    // Nothing new: the same frame again, while the producer keeps writing elsewhere
+    g_assert_true(ringbuf_mailbox_acquire(mb, &meta) == frame);
+    g_assert_cmpuint(meta.sequence, ==, 2);
+    for (guint32 f = 3; f < 10; f++) {
+        gpointer slot = ringbuf_mailbox_reserve(mb);
+        g_assert_true(slot != frame);
+        fill(slot, 100 + f);
+        ringbuf_mailbox_commit(mb, NULL);
+        g_assert_true(holds(frame, 102));
+    }
+    frame = ringbuf_mailbox_acquire(mb, &meta);
+    g_assert_cmpuint(meta.sequence, ==, 9);
+    g_assert_true(holds(frame, 109));
+
+    ringbuf_mailbox_free(mb);
+}
+
+// One frame ring commit feeds the ring and the mailbox
+static void test_mailbox_attach(void) {
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 4, TRUE);
+    ringbuf_mailbox_t *mb = ringbuf_mailbox_new(NULL, &geometry);
+    ringbuf_frame_meta_t meta;
+
+    ringbuf_frame_ring_set_stats(fr, TRUE, G_MAXUINT32);
+    ringbuf_mailbox_attach(mb, fr);
+    for (guint32 f = 0; f < 3; f++) {
+        fill(ringbuf_frame_ring_reserve(fr), f);
+        ringbuf_frame_ring_commit(fr);
+        g_assert_true(holds(ringbuf_mailbox_acquire(mb, &meta), f));
+        g_assert_cmpuint(meta.sequence, ==, f);
+        g_assert_true(meta.flags & RINGBUF_FRAME_META_STATS);
+        g_assert_cmpuint(meta.stats.max, ==, f);
+    }
+    for (guint32 f = 0; f < 3; f++) {
+        g_assert_true(holds(ringbuf_frame_ring_acquire(fr, &meta), f));
+        g_assert_cmpuint(meta.sequence, ==, f);
+        ringbuf_frame_ring_release(fr);
+    }
+
+    ringbuf_mailbox_free(mb);
+    ringbuf_frame_ring_free(fr);
+}
+
+#define NB_FRAMES 20000
+
+static gpointer producer(gpointer data) {
+    ringbuf_mailbox_t *mb = data;
+    for (guint32 f = 0; f < NB_FRAMES; f++) {
+        fill(ringbuf_mailbox_reserve(mb), f);
+        ringbuf_mailbox_commit(mb, NULL);
+    }
+    return NULL;
+}
+
+// A consumer racing the producer never sees a torn or older frame
+static void test_mailbox_threads(void) {
+    ringbuf_mailbox_t *mb = ringbuf_mailbox_new("mailbox", &geometry);
+    GThread *thread = g_thread_new("producer", producer, mb);
+    ringbuf_frame_meta_t meta;
+    guint64 last = 0;
+    guint nb_seen = 0;
+
+    do {
+        gconstpointer frame = ringbuf_mailbox_acquire(mb, &meta);
+        if (frame == NULL) {
+            continue;
+        }
+        g_assert_cmpuint(meta.sequence, >=, last);
+        g_assert_true(holds(frame, (guint32) meta.sequence));
+        nb_seen += meta.sequence > last;
+        last = meta.sequence;
+    } while (last < NB_FRAMES - 1);
+    g_thread_join(thread);
+    g_assert_cmpuint(nb_seen, >, 0);
+
+    ringbuf_mailbox_free(mb);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/mailbox/latest", test_mailbox_latest);
+    g_test_add_func("/ringbuf/mailbox/attach", test_mailbox_attach);
+    g_test_add_func("/ringbuf/mailbox/threads", test_mailbox_threads);
+
+    return g_test_run();
+}
@@ -0,0 +1,131 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-pyramid.h"
+#include "test.h"
+#include <glib.h>
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+// Every level against the rounded mean of 2x2 blocks of a 64-bit reference of the level above
+static void check_levels(const ringbuf_pyramid_header_t *header, const ringbuf_frame_geometry_t *geometry,
+                         gconstpointer pixels) {
+    guint bpp = geometry->bytes_per_pixel;
+    guint w = geometry->width, h = geometry->height;
+    guint64 *above = g_new(guint64, (gsize) w * h);
+    gsize end = 0;
+
+    for (gsize i = 0; i < (gsize) w * h; i++) {
+        above[i] = pixel_at(pixels, bpp, i);
+    }
+    g_assert_cmpuint(header->bytes_per_pixel, ==, bpp);
+    for (guint l = 1; l <= header->nb_levels; l++) {
+        ringbuf_frame_geometry_t level;
+        gconstpointer binned = ringbuf_pyramid_level(header, l, &level);
+        g_assert_cmpuint(level.width, ==, w / 2);
+        g_assert_cmpuint(level.height, ==, h / 2);
+        g_assert_cmpuint(level.bytes_per_pixel, ==, bpp);
+
+        // Levels follow each other without overlapping
+        g_assert_cmpuint(header->levels[l - 1].offset, >=, MAX(end, sizeof(*header)));
+        end = header->levels[l - 1].offset + (gsize) level.width * level.height * bpp;
+
+        for (guint y = 0; y < level.height; y++) {
+            for (guint x = 0; x < level.width; x++) {
+                gsize i = 2 * (gsize) y * w + 2 * x;
+                guint64 mean = (above[i] + above[i + 1] + above[i + w] + above[i + w + 1] + 2) / 4;
+                g_assert_cmpuint(pixel_at(binned, bpp, (gsize) y * level.width + x), ==, mean);
+                above[(gsize) y * level.width + x] = mean;
+            }
+        }
+        w = level.width;
+        h = level.height;
+    }
+    g_assert_null(ringbuf_pyramid_level(header, 0, NULL));
+    g_assert_null(ringbuf_pyramid_level(header, header->nb_levels + 1, NULL));
+    g_free(above);
+}
+
+// Every depth on odd sizes, with values up to the top of the range
+static void test_pyramid_levels(void) {
+    const guint depths[] = {1, 2, 4};
+    GRand *rand = g_rand_new_with_seed(95);
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        ringbuf_frame_geometry_t geometry = {301, 77, depths[d]};
+        gsize size = (gsize) 301 * 77 * depths[d];
+        ringbuf_pyramid_t *pyr = ringbuf_pyramid_new(&geometry, 4, 1, 2);
+        ringbuf_frame_meta_t meta = {0};
+        guint8 *pixels = g_malloc(size);
+
+        for (gsize i = 0; i < size; i++) {
+            pixels[i] = g_rand_int_range(rand, 0, 2) ? 0xff : g_rand_int(rand);
+        }
+        meta.sequence = 42;
+        ringbuf_pyramid_process(pyr, pixels, &meta);
+
+        const ringbuf_pyramid_header_t *header = ringbuf_pyramid_acquire(pyr, G_USEC_PER_SEC);
+        g_assert_nonnull(header);
+        g_assert_cmpuint((guintptr) header % 64, ==, 0);
+        g_assert_cmpuint(header->sequence, ==, 42);
+        g_assert_cmpuint(header->nb_levels, ==, 4);
+        check_levels(header, &geometry, pixels);
+        ringbuf_pyramid_release(pyr);
+        g_assert_null(ringbuf_pyramid_acquire(pyr, 1000));
+
+        g_free(pixels);
+        ringbuf_pyramid_free(pyr);
+    }
+    g_rand_free(rand);
+
+    // A 5x4 frame has no third level
+    ringbuf_frame_geometry_t tiny = {5, 4, 1};
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*Invalid pyramid*");
+    g_assert_null(ringbuf_pyramid_new(&tiny, 3, 1, 1));
+    g_test_assert_expected_messages();
+}
+
+// Frames acquired from a ring, levels tiled over several threads
+static void test_pyramid_thread(void) {
+    ringbuf_frame_geometry_t geometry = {1030, 600, 2};
+    ringbuf_frame_ring_t *input = ringbuf_frame_ring_new("raw", &geometry, 2, TRUE);
+    ringbuf_pyramid_t *pyr = ringbuf_pyramid_new(&geometry, 5, 3, 2);
+    guint16 *frame = g_new(guint16, 1030 * 600);
+    GRand *rand = g_rand_new_with_seed(950);
+
+    ringbuf_pyramid_start(pyr, input);
+    for (guint f = 0; f < 3; f++) {
+        for (gsize i = 0; i < 1030 * 600; i++) {
+            frame[i] = g_rand_int_range(rand, 0, 65536);
+        }
+        ringbuf_frame_ring_push(input, frame);
+
+        const ringbuf_pyramid_header_t *header = ringbuf_pyramid_acquire(pyr, 10 * G_USEC_PER_SEC);
+        g_assert_nonnull(header);
+        g_assert_cmpuint(header->sequence, ==, f);
+        check_levels(header, &geometry, frame);
+        ringbuf_pyramid_release(pyr);
+    }
+    ringbuf_pyramid_stop(pyr);
+
+    g_rand_free(rand);
+    g_free(frame);
+    ringbuf_pyramid_free(pyr);
+    ringbuf_frame_ring_free(input);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/pyramid/levels", test_pyramid_levels);
+    g_test_add_func("/ringbuf/pyramid/thread", test_pyramid_thread);
+
+    return g_test_run();
+}
@@ -0,0 +1,148 @@
+import signal
+import threading
+import unittest
+
+import ringbuf
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+
+class TestRing(unittest.TestCase):
+    def test_spans(self):
+        ring = ringbuf.Ring(4096, name="python-bytes")
+        self.assertEqual(ring.name, "python-bytes")
+
+        # Written in place, pushed on release
+        with ring.reserve(16) as span:
+            view = memoryview(span)
+            self.assertFalse(view.readonly)
+            view[:] = bytes(range(16))
+            view.release()
+        self.assertEqual(ring.used, 16)
+
+        # Read in place, consumed on release
+        with ring.acquire(16) as span:
+            view = memoryview(span)
+            self.assertTrue(view.readonly)
+            self.assertEqual(view.tobytes(), bytes(range(16)))
+            # Views must not outlive the span
+            with self.assertRaises(BufferError):
+                span.release()
+            view.release()
+        self.assertTrue(span.released)
+        self.assertEqual(ring.used, 0)
+
+        self.assertTrue(ring.push(b"abc"))
+        self.assertEqual(ring.pop(3), b"abc")
+        self.assertIsNone(ring.acquire(1, timeout=0.01))
+        self.assertIsNone(ring.pop(1, timeout=0))
+
+    def test_attach(self):
+        ring = ringbuf.Ring(4096, name="python-attach")
+        other = ringbuf.Ring.attach("python-attach")
+        self.assertTrue(ring.push(b"shared"))
+        self.assertEqual(other.pop(6), b"shared")
+        with self.assertRaises(KeyError):
+            ringbuf.Ring.attach("python-missing")
+
+
+class TestFrameRing(unittest.TestCase):
+    def test_frames(self):
+        ring = ringbuf.FrameRing(5, 3, 2, 2, name="python-frames")
+        self.assertEqual(ring.frame_size, 30)
+
+        with ring.reserve() as frame:
+            view = memoryview(frame)
+            self.assertEqual(view.shape, (3, 5))
+            self.assertEqual(view.format, "H")
+            flat = view.cast("B").cast("H")
+            for i in range(15):
+                flat[i] = 1000 + i
+            flat.release()
+            view.release()
+        self.assertTrue(ring.push(bytes(30)))
+
+        frame = ring.acquire(timeout=1)
+        self.assertEqual(frame.sequence, 0)
+        view = memoryview(frame)
+        self.assertEqual(view[2, 4], 1014)
+        self.assertEqual(view.tolist()[1], [1005, 1006, 1007, 1008, 1009])
+        with self.assertRaises(BufferError):
+            frame.release()
+        # Only one frame is acquired at a time
+        with self.assertRaises(RuntimeError):
+            ring.acquire()
+        view.release()
+        frame.release()
+
+        # Collected spans are released too
+        frame = ring.acquire(timeout=1)
+        self.assertEqual(frame.sequence, 1)
+        del frame
+        self.assertIsNone(ring.acquire(timeout=0.01))
+
+        with self.assertRaises(ValueError):
+            ring.push(bytes(29))
+
+    def test_producer_thread(self):
+        ring = ringbuf.FrameRing(64, 32, 4, 2)
+        same = ringbuf.FrameRing.from_capsule(ring.capsule())
+        self.assertEqual(same.name, ring.name)
+
+        # The main thread waits with the GIL released while this one produces
+        def produce():
+            for f in range(10):
+                same.push(bytes([f]) * ring.frame_size)
+
+        thread = threading.Thread(target=produce)
+        thread.start()
+        for f in range(10):
+            with ring.acquire() as frame:
+                self.assertEqual(frame.sequence, f)
+                view = memoryview(frame)
+                self.assertEqual(view[31, 63], f * 0x01010101)
+                view.release()
+        thread.join()
+
+    def test_interrupt(self):
+        class Interrupted(Exception):
+            pass
+
+        def interrupt(signum, frame):
+            raise Interrupted()
+
+        # Writes blocked on a full ring still run signal handlers
+        ring = ringbuf.Ring(64)
+        frames = ringbuf.FrameRing(8, 4, 2, 1)
+        self.assertTrue(ring.push(bytes(ring.size)))
+        self.assertTrue(frames.push(bytes(frames.frame_size)))
+        previous = signal.signal(signal.SIGALRM, interrupt)
+        try:
+            for write in (lambda: ring.push(b"x"), lambda: ring.reserve(1),
+                          lambda: frames.push(bytes(frames.frame_size)), frames.reserve):
+                signal.setitimer(signal.ITIMER_REAL, 0.2)
+                with self.assertRaises(Interrupted):
+                    write()
+        finally:
+            signal.setitimer(signal.ITIMER_REAL, 0)
+            signal.signal(signal.SIGALRM, previous)
+        self.assertEqual(ring.used, ring.size)
+
+    @unittest.skipIf(numpy is None, "NumPy is not installed")
+    def test_numpy(self):
+        ring = ringbuf.FrameRing(8, 4, 2, 1)
+        ring.push(numpy.arange(32, dtype=numpy.uint16).tobytes())
+        with ring.acquire() as frame:
+            pixels = numpy.asarray(frame)
+            self.assertEqual(pixels.shape, (4, 8))
+            self.assertEqual(pixels.dtype, numpy.uint16)
+            self.assertFalse(pixels.flags.writeable)
+            self.assertEqual(int(pixels.sum()), 31 * 32 // 2)
+            del pixels
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,128 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-sparse.h"
+#include "test.h"
+#include <glib.h>
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+// Sparse frame: a few random hits over a noise floor at or below 3
+static void fill_sparse(guint8 *pixels, guint bytes_per_pixel, gsize nb_pixels, GRand *rand) {
+    for (gsize i = 0; i < nb_pixels; i++) {
+        guint32 value = g_rand_int_range(rand, 0, 4);
+        if (g_rand_int_range(rand, 0, 50) == 0) {
+            value = g_rand_int_range(rand, 4, bytes_per_pixel == 1 ? 256 : 60000);
+        }
+        if (bytes_per_pixel == 1) {
+            ((guint8 *) pixels)[i] = value;
+        }
+        else if (bytes_per_pixel == 2) {
+            ((guint16 *) pixels)[i] = value;
+        }
+        else {
+            ((guint32 *) pixels)[i] = value;
+        }
+    }
+}
+
+// Every depth against a scalar scan, then back to a dense frame
+static void test_sparse_extract(void) {
+    const guint depths[] = {1, 2, 4};
+    GRand *rand = g_rand_new_with_seed(87);
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        ringbuf_frame_geometry_t geometry = {301, 7, depths[d]};
+        gsize nb_pixels = 301 * 7;
+        guint8 *pixels = g_malloc(nb_pixels * depths[d]);
+        guint8 *dense = g_malloc(nb_pixels * depths[d]);
+        ringbuf_sparse_event_t *events = g_new(ringbuf_sparse_event_t, nb_pixels);
+        gboolean truncated;
+
+        fill_sparse(pixels, depths[d], nb_pixels, rand);
+        gsize count = ringbuf_sparse_extract(&geometry, pixels, 3, events, nb_pixels, &truncated);
+        g_assert_false(truncated);
+
+        gsize expected = 0;
+        for (gsize i = 0; i < nb_pixels; i++) {
+            guint32 value = pixel_at(pixels, depths[d], i);
+            if (value > 3) {
+                g_assert_cmpuint(events[expected].index, ==, i);
+                g_assert_cmpuint(events[expected].value, ==, value);
+                expected++;
+            }
+        }
+        g_assert_cmpuint(count, ==, expected);
+        g_assert_cmpuint(count, >, 0);
+
+        // Noise floor dropped, hits restored
+        ringbuf_sparse_reconstruct(&geometry, events, count, dense);
+        for (gsize i = 0; i < nb_pixels; i++) {
+            guint32 value = pixel_at(pixels, depths[d], i);
+            g_assert_cmpuint(pixel_at(dense, depths[d], i), ==, value > 3 ? value : 0);
+        }
+
+        // Cut in the middle of a vector block and in the scalar tail
+        gsize cut = ringbuf_sparse_extract(&geometry, pixels, 3, events, count / 2, &truncated);
+        g_assert_cmpuint(cut, ==, count / 2);
+        g_assert_true(truncated);
+
+        g_free(events);
+        g_free(dense);
+        g_free(pixels);
+    }
+    g_rand_free(rand);
+}
+
+// A background thread turns frames into event lists
+static void test_sparse_thread(void) {
+    ringbuf_frame_geometry_t geometry = {256, 64, 2};
+    gsize nb_pixels = 256 * 64;
+    ringbuf_frame_ring_t *input = ringbuf_frame_ring_new("raw", &geometry, 2, TRUE);
+    ringbuf_sparse_stage_t *stage = ringbuf_sparse_stage_new(&geometry, 0, 100, 2);
+    ringbuf_sparse_event_t *events = g_new(ringbuf_sparse_event_t, 100);
+    ringbuf_sparse_header_t header;
+
+    ringbuf_sparse_stage_start(stage, input);
+    for (guint f = 0; f < 4; f++) {
+        guint16 *pixels = ringbuf_frame_ring_reserve(input);
+        memset(pixels, 0, nb_pixels * sizeof(guint16));
+        // Frame f has 40 * f hits, the last one overflows
+        for (guint e = 0; e < 40 * f; e++) {
+            pixels[e * 97 % nb_pixels] = e + 1;
+        }
+        ringbuf_frame_ring_commit(input);
+    }
+
+    for (guint f = 0; f < 4; f++) {
+        g_assert_true(ringbuf_sparse_stage_pop(stage, &header, events, G_USEC_PER_SEC * 5));
+        g_assert_cmpuint(header.sequence, ==, f);
+        g_assert_cmpuint(header.nb_events, ==, MIN(40 * f, 100));
+        g_assert_cmpuint(header.flags, ==, f == 3 ? RINGBUF_SPARSE_TRUNCATED : 0);
+        for (guint e = 1; e < header.nb_events; e++) {
+            g_assert_cmpuint(events[e].index, >, events[e - 1].index);
+        }
+    }
+    g_assert_false(ringbuf_sparse_stage_pop(stage, &header, events, 1000));
+
+    ringbuf_sparse_stage_stop(stage);
+    g_free(events);
+    ringbuf_sparse_stage_free(stage);
+    ringbuf_frame_ring_free(input);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/sparse/extract", test_sparse_extract);
+    g_test_add_func("/ringbuf/sparse/thread", test_sparse_thread);
+
+    return g_test_run();
+}
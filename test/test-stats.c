@@ -0,0 +1,203 @@
+#include "../ringbuf.h"
+#include "../ringbuf-exporter.h"
+#include "test.h"
+#include <glib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Counters follow the data path
+static void test_stats_counters(void) {
+    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    guint8 data[64] = {0};
+    ringbuf_stats_t stats;
+
+    ringbuf_push(rb, data, sizeof(data));
+    ringbuf_push(rb, data, sizeof(data));
+    ringbuf_pop(data, rb, sizeof(data));
+
+    ringbuf_get_stats(rb, &stats);
+    g_assert_cmpuint(stats.capacity, ==, ringbuf_buffer_size(rb));
+    g_assert_cmpuint(stats.push_ops, ==, 2);
+    g_assert_cmpuint(stats.pop_ops, ==, 1);
+    g_assert_cmpuint(stats.bytes_pushed, ==, 2 * sizeof(data));
+    g_assert_cmpuint(stats.bytes_popped, ==, sizeof(data));
+    g_assert_cmpuint(stats.used, ==, sizeof(data));
+    g_assert_cmpuint(stats.high_watermark, ==, 2 * sizeof(data));
+    g_assert_cmpuint(stats.pop_latency[0], ==, 1);
+
+    // Timed out reads are counted as waits and timeouts
+    g_assert_null(ringbuf_timed_pop(data, rb, PLATFORM_MIN_BYTES, 1000));
+    ringbuf_get_stats(rb, &stats);
+    g_assert_cmpuint(stats.timeouts, ==, 1);
+    g_assert_cmpuint(stats.consumer_waits, ==, 1);
+
+    // So are timed waits for space
+    g_assert_true(ringbuf_wait_for_space_timed(rb, PLATFORM_MIN_BYTES - sizeof(data), 1000));
+    g_assert_false(ringbuf_wait_for_space_timed(rb, PLATFORM_MIN_BYTES, 1000));
+    ringbuf_get_stats(rb, &stats);
+    g_assert_cmpuint(stats.timeouts, ==, 2);
+    g_assert_cmpuint(stats.producer_waits, ==, 1);
+
+    ringbuf_free(rb);
+}
+
+// Non-blocking rings refuse writes instead of overwriting data
+static void test_stats_drops(void) {
+    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES, FALSE);
+    guint8 *data = g_malloc0(PLATFORM_MIN_BYTES);
+    ringbuf_stats_t stats;
+
+    g_assert_nonnull(ringbuf_push(rb, data, PLATFORM_MIN_BYTES));
+    g_assert_true(ringbuf_is_full(rb));
+    g_assert_null(ringbuf_push(rb, data, 1));
+    g_assert_null(ringbuf_reserve(rb, 1));
+    // Waiting for space does not block, the write decides
+    g_assert_true(ringbuf_wait_for_space_timed(rb, 1, G_USEC_PER_SEC * 10));
+
+    ringbuf_get_stats(rb, &stats);
+    g_assert_cmpuint(stats.drops, ==, 2);
+    g_assert_cmpuint(stats.used, ==, PLATFORM_MIN_BYTES);
+
+    g_free(data);
+    ringbuf_free(rb);
+}
+
+static void test_latency_percentile(void) {
+    guint64 histogram[RINGBUF_LATENCY_BUCKETS] = {0};
+
+    g_assert_cmpuint(ringbuf_latency_percentile(histogram, 0.5), ==, 0);
+
+    histogram[0] = 90;  // no wait
+    histogram[4] = 9;   // 8-16 us
+    histogram[10] = 1;  // 512-1024 us
+    g_assert_cmpuint(ringbuf_latency_percentile(histogram, 0.5), ==, 0);
+    g_assert_cmpuint(ringbuf_latency_percentile(histogram, 0.95), ==, 16);
+    g_assert_cmpuint(ringbuf_latency_percentile(histogram, 1.0), ==, 1024);
+}
+
+typedef struct {
+    guint count;
+    guint found;
+    guint id;
+} ForeachData;
+
+static void count_rings(ringbuf_t *rb, gpointer user_data) {
+    ForeachData *fd = user_data;
+    fd->count++;
+    if (ringbuf_id(rb) == fd->id) {
+        fd->found++;
+    }
+}
+
+static void test_foreach(void) {
+    ringbuf_t *a = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_t *b = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ForeachData fd = {0, 0, ringbuf_id(b)};
+
+    g_assert_cmpuint(ringbuf_id(a), !=, ringbuf_id(b));
+    ringbuf_foreach(count_rings, &fd);
+    g_assert_cmpuint(fd.count, ==, 2);
+    g_assert_cmpuint(fd.found, ==, 1);
+
+    ringbuf_free(b);
+    fd.count = fd.found = 0;
+    ringbuf_foreach(count_rings, &fd);
+    g_assert_cmpuint(fd.count, ==, 1);
+    g_assert_cmpuint(fd.found, ==, 0);
+
+    ringbuf_free(a);
+}
+
+// Names reach the memfd and the registry
+static void test_named_registry(void) {
+    ringbuf_t *anonymous = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_t *rb = ringbuf_new_named("frames", PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_info_t info;
+
+    g_assert_cmpstr(ringbuf_name(anonymous), ==, "queue_region");
+    g_assert_cmpstr(ringbuf_name(rb), ==, "frames");
+
+    g_assert_true(ringbuf_lookup("frames", &info));
+    g_assert_cmpuint(info.id, ==, ringbuf_id(rb));
+    g_assert_cmpuint(info.stats.capacity, ==, ringbuf_buffer_size(rb));
+    g_assert_false(ringbuf_lookup("missing", &info));
+
+    gchar *fd_path = g_strdup_printf("/proc/self/fd/%d", info.fd);
+    gchar *target = g_file_read_link(fd_path, NULL);
+    g_assert_cmpstr(target, ==, "/memfd:frames (deleted)");
+    g_free(target);
+    g_free(fd_path);
+
+    GArray *rings = ringbuf_list();
+    g_assert_cmpuint(rings->len, ==, 2);
+    g_assert_cmpuint(g_array_index(rings, ringbuf_info_t, 0).id, ==, ringbuf_id(anonymous));
+    g_assert_cmpstr(g_array_index(rings, ringbuf_info_t, 1).name, ==, "frames");
+    g_array_unref(rings);
+
+    ringbuf_free(rb);
+    ringbuf_free(anonymous);
+}
+
+static void test_exporter_render(void) {
+    ringbuf_t *rb = ringbuf_new_named("detector \"A\"", PLATFORM_MIN_BYTES, TRUE);
+    guint8 data[16] = {0};
+    ringbuf_push(rb, data, sizeof(data));
+
+    gchar *text = ringbuf_exporter_render();
+    gchar *line = g_strdup_printf("ringbuf_used_bytes{ring=\"%u\",name=\"detector \\\"A\\\"\"} 16\n", ringbuf_id(rb));
+    g_assert_nonnull(strstr(text, "# TYPE ringbuf_push_ops_total counter\n"));
+    g_assert_nonnull(strstr(text, line));
+    g_assert_nonnull(strstr(text, "ringbuf_wait_seconds{"));
+
+    g_free(line);
+    g_free(text);
+    ringbuf_free(rb);
+}
+
+static void test_exporter_unix_socket(void) {
+    gchar *path = g_strdup_printf("/tmp/ringbuf-exporter-%d.sock", getpid());
+    gchar *address = g_strdup_printf("unix:%s", path);
+    ringbuf_t *rb = ringbuf_new(PLATFORM_MIN_BYTES, TRUE);
+    ringbuf_exporter_t *exporter = ringbuf_exporter_new(address);
+    g_assert_nonnull(exporter);
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+    gint fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    g_assert_cmpint(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), ==, 0);
+
+    const gchar *request = "GET /metrics HTTP/1.0\r\n\r\n";
+    g_assert_cmpint(write(fd, request, strlen(request)), ==, strlen(request));
+
+    GString *response = g_string_new(NULL);
+    gchar chunk[1024];
+    gssize n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        g_string_append_len(response, chunk, n);
+    }
+    close(fd);
+
+    g_assert_true(g_str_has_prefix(response->str, "HTTP/1.0 200 OK\r\n"));
+    g_assert_nonnull(strstr(response->str, "ringbuf_capacity_bytes{ring="));
+
+    g_string_free(response, TRUE);
+    ringbuf_exporter_free(exporter);
+    g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+    ringbuf_free(rb);
+    g_free(address);
+    g_free(path);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/stats/counters", test_stats_counters);
+    g_test_add_func("/ringbuf/stats/drops", test_stats_drops);
+    g_test_add_func("/ringbuf/stats/percentile", test_latency_percentile);
+    g_test_add_func("/ringbuf/stats/foreach", test_foreach);
+    g_test_add_func("/ringbuf/registry/named", test_named_registry);
+    g_test_add_func("/ringbuf/exporter/render", test_exporter_render);
+    g_test_add_func("/ringbuf/exporter/unix_socket", test_exporter_unix_socket);
+
+    return g_test_run();
+}
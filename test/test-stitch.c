@@ -0,0 +1,235 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-stitch.h"
+#include "test.h"
+#include <glib.h>
+
+#define MODULE_W 40
+#define MODULE_H 12
+
+// Two rows of two modules with a 3 pixel gap, one quarter turned
+static const ringbuf_stitch_module_t modules[] = {
+    {0, 0, RINGBUF_STITCH_IDENTITY},
+    {43, 0, RINGBUF_STITCH_FLIP_X},
+    {0, 15, RINGBUF_STITCH_ROTATE_180},
+    {43, 15, RINGBUF_STITCH_ROTATE_90},
+};
+#define FULL_W (43 + MODULE_W)
+#define FULL_H (15 + MODULE_W)
+
+static guint32 module_value(guint module, guint64 frame, guint x, guint y, guint bytes_per_pixel) {
+    guint32 value = 1 + module * 50 + frame * 7 + y * MODULE_W + x;
+    return bytes_per_pixel == 1 ? value & 0xff : value;
+}
+
+static void fill_module(gpointer pixels, guint module, guint64 frame, guint bytes_per_pixel) {
+    for (guint y = 0; y < MODULE_H; y++) {
+        for (guint x = 0; x < MODULE_W; x++) {
+            guint32 value = module_value(module, frame, x, y, bytes_per_pixel);
+            gsize i = y * MODULE_W + x;
+            if (bytes_per_pixel == 1) {
+                ((guint8 *) pixels)[i] = value;
+            }
+            else if (bytes_per_pixel == 2) {
+                ((guint16 *) pixels)[i] = value;
+            }
+            else {
+                ((guint32 *) pixels)[i] = value;
+            }
+        }
+    }
+}
+
+static guint32 pixel_at(gconstpointer pixels, guint bytes_per_pixel, gsize i) {
+    if (bytes_per_pixel == 1) {
+        return ((const guint8 *) pixels)[i];
+    }
+    if (bytes_per_pixel == 2) {
+        return ((const guint16 *) pixels)[i];
+    }
+    return ((const guint32 *) pixels)[i];
+}
+
+// Expected full frame pixel, worked out from the placements directly
+static guint32 expected_at(guint64 frame, guint fx, guint fy, guint bytes_per_pixel) {
+    if (fx < MODULE_W && fy < MODULE_H) {
+        return module_value(0, frame, fx, fy, bytes_per_pixel);
+    }
+    if (fx >= 43 && fy < MODULE_H) {
+        return module_value(1, frame, MODULE_W - 1 - (fx - 43), fy, bytes_per_pixel);
+    }
+    if (fx < MODULE_W && fy >= 15 && fy < 15 + MODULE_H) {
+        return module_value(2, frame, MODULE_W - 1 - fx, MODULE_H - 1 - (fy - 15), bytes_per_pixel);
+    }
+    if (fx >= 43 && fx < 43 + MODULE_H && fy >= 15) {
+        // Clockwise: the first row ends up as the last column
+        return module_value(3, frame, fy - 15, MODULE_H - 1 - (fx - 43), bytes_per_pixel);
+    }
+    return 0;
+}
+
+static void check_frame(gconstpointer pixels, guint64 frame, guint bytes_per_pixel) {
+    for (guint y = 0; y < FULL_H; y++) {
+        for (guint x = 0; x < FULL_W; x++) {
+            g_assert_cmpuint(pixel_at(pixels, bytes_per_pixel, (gsize) y * FULL_W + x), ==,
+                             expected_at(frame, x, y, bytes_per_pixel));
+        }
+    }
+}
+
+// Every orientation at every depth, gaps cleared in reused slots
+static void test_stitch_place(void) {
+    const guint depths[] = {1, 2, 4};
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        ringbuf_frame_geometry_t module = {MODULE_W, MODULE_H, depths[d]};
+        ringbuf_stitcher_t *st = ringbuf_stitcher_new(&module, modules, G_N_ELEMENTS(modules), FULL_W, FULL_H, 2);
+        ringbuf_frame_ring_t *output = ringbuf_stitcher_output(st);
+        gpointer pixels = g_malloc(MODULE_W * MODULE_H * depths[d]);
+        ringbuf_frame_meta_t meta;
+
+        // Dirty the whole output ring first
+        for (guint f = 0; f < 4; f++) {
+            memset(ringbuf_frame_ring_reserve(output), 0xab, ringbuf_frame_ring_frame_size(output));
+            ringbuf_frame_ring_commit(output);
+            ringbuf_frame_ring_acquire(output, NULL);
+            ringbuf_frame_ring_release(output);
+        }
+
+        for (guint64 frame = 0; frame < 3; frame++) {
+            // Modules in any order
+            for (guint m = 0; m < G_N_ELEMENTS(modules); m++) {
+                guint module_index = (m + frame) % G_N_ELEMENTS(modules);
+                fill_module(pixels, module_index, frame, depths[d]);
+                g_assert_cmpint(ringbuf_stitcher_place(st, module_index, frame, pixels), ==,
+                                m == G_N_ELEMENTS(modules) - 1);
+            }
+            check_frame(ringbuf_frame_ring_acquire(output, &meta), frame, depths[d]);
+            g_assert_cmpuint(meta.sequence, ==, frame + 4);
+            ringbuf_frame_ring_release(output);
+        }
+        g_assert_cmpuint(ringbuf_stitcher_nb_incomplete(st), ==, 0);
+
+        g_free(pixels);
+        ringbuf_stitcher_free(st);
+    }
+}
+
+// Frames missing a module are abandoned, late sub-frames ignored
+static void test_stitch_incomplete(void) {
+    ringbuf_frame_geometry_t module = {MODULE_W, MODULE_H, 2};
+    ringbuf_stitcher_t *st = ringbuf_stitcher_new(&module, modules, G_N_ELEMENTS(modules), FULL_W, FULL_H, 2);
+    guint16 pixels[MODULE_W * MODULE_H];
+    const ringbuf_stitch_module_t overlapping[] = {{0, 0, RINGBUF_STITCH_IDENTITY}, {39, 0, RINGBUF_STITCH_IDENTITY}};
+
+    for (guint m = 0; m < 3; m++) {
+        fill_module(pixels, m, 1, 2);
+        g_assert_false(ringbuf_stitcher_place(st, m, 1, pixels));
+    }
+    for (guint m = 0; m < 4; m++) {
+        fill_module(pixels, m, 2, 2);
+        g_assert_cmpint(ringbuf_stitcher_place(st, m, 2, pixels), ==, m == 3);
+    }
+    g_assert_false(ringbuf_stitcher_place(st, 3, 1, pixels));
+    g_assert_cmpuint(ringbuf_stitcher_nb_incomplete(st), ==, 1);
+
+    ringbuf_frame_meta_t meta;
+    check_frame(ringbuf_frame_ring_acquire(ringbuf_stitcher_output(st), &meta), 2, 2);
+    g_assert_cmpuint(meta.sequence, ==, 0);
+    ringbuf_frame_ring_release(ringbuf_stitcher_output(st));
+    g_assert_null(ringbuf_frame_ring_acquire_timed(ringbuf_stitcher_output(st), NULL, 1000));
+    ringbuf_stitcher_free(st);
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*overlaps*");
+    g_assert_null(ringbuf_stitcher_new(&module, overlapping, 2, 100, 20, 2));
+    g_test_assert_expected_messages();
+}
+
+// A thread gathers modules from two input rings, two modules each
+static void test_stitch_thread(void) {
+    ringbuf_frame_geometry_t module = {MODULE_W, MODULE_H, 2};
+    ringbuf_stitcher_t *st = ringbuf_stitcher_new(&module, modules, G_N_ELEMENTS(modules), FULL_W, FULL_H, 2);
+    ringbuf_frame_ring_t *inputs[2];
+    ringbuf_frame_meta_t meta;
+
+    inputs[0] = ringbuf_frame_ring_new("module-0", &module, 4, TRUE);
+    inputs[1] = ringbuf_frame_ring_new("module-1", &module, 4, TRUE);
+    ringbuf_stitcher_start(st, inputs, 2);
+
+    for (guint64 frame = 0; frame < 5; frame++) {
+        for (guint m = 0; m < G_N_ELEMENTS(modules); m++) {
+            fill_module(ringbuf_frame_ring_reserve(inputs[m % 2]), m, frame, 2);
+            ringbuf_frame_ring_commit(inputs[m % 2]);
+        }
+        check_frame(ringbuf_frame_ring_acquire(ringbuf_stitcher_output(st), &meta), frame, 2);
+        g_assert_cmpuint(meta.sequence, ==, frame);
+        ringbuf_frame_ring_release(ringbuf_stitcher_output(st));
+    }
+
+    ringbuf_stitcher_stop(st);
+    ringbuf_stitcher_free(st);
+    ringbuf_frame_ring_free(inputs[0]);
+    ringbuf_frame_ring_free(inputs[1]);
+}
+
+// A sub-frame dropped by a full non-blocking input abandons its frame, later ones stay aligned
+static void test_stitch_drop(void) {
+    ringbuf_frame_geometry_t module = {MODULE_W, MODULE_H, 2};
+    ringbuf_stitcher_t *st = ringbuf_stitcher_new(&module, modules, G_N_ELEMENTS(modules), FULL_W, FULL_H, 2);
+    ringbuf_frame_ring_t *inputs[2];
+    ringbuf_frame_meta_t meta;
+    guint64 dropped = 0;
+
+    inputs[0] = ringbuf_frame_ring_new("module-0", &module, 16, TRUE);
+    inputs[1] = ringbuf_frame_ring_new("module-1", &module, 4, FALSE);
+
+    // Input 1 fills up before the stitcher runs, the frame it drops a module of is the last one
+    for (guint64 frame = 0; dropped == 0; frame++) {
+        for (guint m = 0; m < G_N_ELEMENTS(modules); m++) {
+            gpointer pixels = ringbuf_frame_ring_reserve(inputs[m % 2]);
+            if (pixels == NULL) {
+                dropped = frame;
+                continue;
+            }
+            fill_module(pixels, m, frame, 2);
+            ringbuf_frame_ring_commit(inputs[m % 2]);
+        }
+    }
+    g_assert_cmpuint(dropped, >, 0);
+
+    ringbuf_stitcher_start(st, inputs, 2);
+    for (guint64 frame = 0; frame < dropped; frame++) {
+        check_frame(ringbuf_frame_ring_acquire(ringbuf_stitcher_output(st), &meta), frame, 2);
+        ringbuf_frame_ring_release(ringbuf_stitcher_output(st));
+    }
+    while (!ringbuf_is_empty(ringbuf_frame_ring_pixels(inputs[1]))) {
+        g_usleep(1000);
+    }
+
+    for (guint64 frame = dropped + 1; frame < dropped + 3; frame++) {
+        for (guint m = 0; m < G_N_ELEMENTS(modules); m++) {
+            fill_module(ringbuf_frame_ring_reserve(inputs[m % 2]), m, frame, 2);
+            ringbuf_frame_ring_commit(inputs[m % 2]);
+        }
+        check_frame(ringbuf_frame_ring_acquire(ringbuf_stitcher_output(st), &meta), frame, 2);
+        g_assert_cmpuint(meta.sequence, ==, frame - 1);
+        ringbuf_frame_ring_release(ringbuf_stitcher_output(st));
+    }
+
+    ringbuf_stitcher_stop(st);
+    g_assert_cmpuint(ringbuf_stitcher_nb_incomplete(st), ==, 1);
+    ringbuf_stitcher_free(st);
+    ringbuf_frame_ring_free(inputs[0]);
+    ringbuf_frame_ring_free(inputs[1]);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/stitch/place", test_stitch_place);
+    g_test_add_func("/ringbuf/stitch/incomplete", test_stitch_incomplete);
+    g_test_add_func("/ringbuf/stitch/thread", test_stitch_thread);
+    g_test_add_func("/ringbuf/stitch/drop", test_stitch_drop);
+
+    return g_test_run();
+}
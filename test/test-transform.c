@@ -0,0 +1,174 @@
+#include "../ringbuf.h"
+#include "../ringbuf-frame.h"
+#include "../ringbuf-transform.h"
+#include "test.h"
+#include <glib.h>
+
+// Where pixel (x, y) of a w x h frame lands
+static void reference(ringbuf_transform_t transform, guint w, guint h, guint x, guint y, guint *tx, guint *ty) {
+    switch (transform) {
+    case RINGBUF_TRANSFORM_FLIP_X:
+        *tx = w - 1 - x, *ty = y;
+        break;
+    case RINGBUF_TRANSFORM_FLIP_Y:
+        *tx = x, *ty = h - 1 - y;
+        break;
+    case RINGBUF_TRANSFORM_TRANSPOSE:
+        *tx = y, *ty = x;
+        break;
+    case RINGBUF_TRANSFORM_ROTATE_90:
+        *tx = h - 1 - y, *ty = x;
+        break;
+    case RINGBUF_TRANSFORM_ROTATE_180:
+        *tx = w - 1 - x, *ty = h - 1 - y;
+        break;
+    case RINGBUF_TRANSFORM_ROTATE_270:
+        *tx = y, *ty = w - 1 - x;
+        break;
+    default:
+        *tx = x, *ty = y;
+        break;
+    }
+}
+
+// Every transform and depth, on sizes with partial tiles and several cache blocks
+static void test_transform_copy(void) {
+    const guint depths[] = {1, 2, 4};
+    const guint sizes[][2] = {{37, 70}, {130, 67}, {16, 16}, {5, 3}};
+    GRand *rand = g_rand_new_with_seed(94);
+
+    for (guint d = 0; d < G_N_ELEMENTS(depths); d++) {
+        for (guint s = 0; s < G_N_ELEMENTS(sizes); s++) {
+            guint w = sizes[s][0], h = sizes[s][1], bpp = depths[d];
+            ringbuf_frame_geometry_t geometry = {w, h, bpp};
+            guint8 *src = g_malloc((gsize) w * h * bpp);
+
+            for (gsize i = 0; i < (gsize) w * h * bpp; i++) {
+                src[i] = g_rand_int(rand);
+            }
+            for (ringbuf_transform_t t = RINGBUF_TRANSFORM_IDENTITY; t <= RINGBUF_TRANSFORM_ROTATE_270; t++) {
+                ringbuf_frame_geometry_t result;
+                ringbuf_transform_geometry(&geometry, t, &result);
+                g_assert_cmpuint((gsize) result.width * result.height, ==, (gsize) w * h);
+
+                // Written into a wider frame, the margin stays untouched
+                gsize stride = result.width + 3;
+                guint8 *dst = g_malloc((gsize) stride * result.height * bpp);
+                memset(dst, 0xa5, (gsize) stride * result.height * bpp);
+                ringbuf_transform_copy(&geometry, t, src, dst, stride);
+
+                for (guint y = 0; y < h; y++) {
+                    for (guint x = 0; x < w; x++) {
+                        guint tx, ty;
+                        reference(t, w, h, x, y, &tx, &ty);
+                        g_assert_cmpint(memcmp(dst + ((gsize) ty * stride + tx) * bpp,
+                                               src + ((gsize) y * w + x) * bpp, bpp), ==, 0);
+                    }
+                }
+                for (guint y = 0; y < result.height; y++) {
+                    for (gsize i = result.width * bpp; i < stride * bpp; i++) {
+                        g_assert_cmpuint(dst[(gsize) y * stride * bpp + i], ==, 0xa5);
+                    }
+                }
+                g_free(dst);
+            }
+            g_free(src);
+        }
+    }
+    g_rand_free(rand);
+}
+
+// Popped into a buffer, then into a slot of another ring
+static void test_transform_pop(void) {
+    ringbuf_frame_geometry_t geometry = {48, 20, 2}, turned = {20, 48, 2};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 2, TRUE);
+    ringbuf_frame_ring_t *out = ringbuf_frame_ring_new("turned", &turned, 2, TRUE);
+    guint16 *dst = g_new(guint16, 48 * 20);
+    ringbuf_frame_meta_t meta;
+
+    for (guint f = 0; f < 2; f++) {
+        guint16 *pixels = ringbuf_frame_ring_reserve(fr);
+        for (guint i = 0; i < 48 * 20; i++) {
+            pixels[i] = i + f;
+        }
+        ringbuf_frame_ring_commit(fr);
+    }
+
+    ringbuf_transform_pop(fr, RINGBUF_TRANSFORM_ROTATE_180, dst, &meta);
+    g_assert_cmpuint(meta.sequence, ==, 0);
+    g_assert_cmpuint(dst[0], ==, 48 * 20 - 1);
+    g_assert_cmpuint(dst[48 * 20 - 1], ==, 0);
+
+    // Wrong geometry: nothing consumed
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*geometry*");
+    g_assert_false(ringbuf_transform_pop_to_ring(fr, RINGBUF_TRANSFORM_FLIP_X, out, NULL));
+    g_test_assert_expected_messages();
+
+    g_assert_true(ringbuf_transform_pop_to_ring(fr, RINGBUF_TRANSFORM_ROTATE_90, out, &meta));
+    g_assert_cmpuint(meta.sequence, ==, 1);
+    const guint16 *pixels = ringbuf_frame_ring_acquire(out, NULL);
+    // Bottom left corner to top left, top left to top right
+    g_assert_cmpuint(pixels[0], ==, 19 * 48 + 1);
+    g_assert_cmpuint(pixels[19], ==, 0 + 1);
+    g_assert_cmpuint(pixels[47 * 20 + 19], ==, 47 + 1);
+    ringbuf_frame_ring_release(out);
+
+    g_free(dst);
+    ringbuf_frame_ring_free(out);
+    ringbuf_frame_ring_free(fr);
+}
+
+// A full non-blocking destination drops the frame instead of writing through a NULL slot
+static void test_transform_pop_full(void) {
+    ringbuf_frame_geometry_t geometry = {48, 20, 2}, turned = {20, 48, 2};
+    ringbuf_frame_ring_t *fr = ringbuf_frame_ring_new("frames", &geometry, 4, TRUE);
+    ringbuf_frame_ring_t *out = ringbuf_frame_ring_new("turned", &turned, 1, FALSE);
+    guint16 *pixels;
+    ringbuf_frame_meta_t meta;
+    ringbuf_stats_t stats;
+
+    for (guint f = 0; f < 4; f++) {
+        pixels = ringbuf_frame_ring_reserve(fr);
+        for (guint i = 0; i < 48 * 20; i++) {
+            pixels[i] = i + f;
+        }
+        ringbuf_frame_ring_commit(fr);
+    }
+
+    // Fill the destination, whatever slot count its pages round up to
+    guint filled = 0;
+    while (ringbuf_transform_pop_to_ring(fr, RINGBUF_TRANSFORM_TRANSPOSE, out, &meta)) {
+        g_assert_cmpuint(meta.sequence, ==, filled);
+        filled++;
+        g_assert_cmpuint(filled, <, 3);
+    }
+    g_assert_cmpuint(meta.sequence, ==, filled);
+    ringbuf_get_stats(ringbuf_frame_ring_pixels(out), &stats);
+    g_assert_cmpuint(stats.drops, ==, 1);
+
+    // The dropped frame is gone from the source, the next one goes through once there is room
+    for (guint f = 0; f < filled; f++) {
+        g_assert_nonnull(ringbuf_frame_ring_acquire(out, NULL));
+        ringbuf_frame_ring_release(out);
+    }
+    g_assert_true(ringbuf_transform_pop_to_ring(fr, RINGBUF_TRANSFORM_TRANSPOSE, out, &meta));
+    g_assert_cmpuint(meta.sequence, ==, filled + 1);
+    pixels = (guint16 *) ringbuf_frame_ring_acquire(out, &meta);
+    g_assert_cmpuint(meta.sequence, ==, filled);
+    g_assert_cmpuint(meta.frame_id, ==, filled + 1);
+    g_assert_cmpuint(pixels[1], ==, 48 + filled + 1);
+    ringbuf_frame_ring_release(out);
+
+    ringbuf_frame_ring_free(out);
+    ringbuf_frame_ring_free(fr);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/transform/copy", test_transform_copy);
+    g_test_add_func("/ringbuf/transform/pop", test_transform_pop);
+    g_test_add_func("/ringbuf/transform/pop-full", test_transform_pop_full);
+
+    return g_test_run();
+}
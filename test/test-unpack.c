@@ -0,0 +1,108 @@
+#include "../ringbuf.h"
+#include "../ringbuf-unpack.h"
+#include "test.h"
+#include <glib.h>
+
+// Reference packer, one bit at a time, least significant bits first
+static guint8 *pack(const guint16 *pixels, gsize nb_pixels, guint bits, gsize *size) {
+    *size = (nb_pixels * bits + 7) / 8;
+    guint8 *packed = g_malloc0(*size);
+    for (gsize i = 0; i < nb_pixels; i++) {
+        for (guint b = 0; b < bits; b++) {
+            gsize bit = i * bits + b;
+            packed[bit / 8] |= ((pixels[i] >> b) & 1) << (bit % 8);
+        }
+    }
+    return packed;
+}
+
+// Reference decoder, bit by bit as well
+static guint16 unpack_one(const guint8 *packed, guint bits, gsize i) {
+    guint16 value = 0;
+    for (guint b = 0; b < bits; b++) {
+        gsize bit = i * bits + b;
+        value |= ((packed[bit / 8] >> (bit % 8)) & 1) << b;
+    }
+    return value;
+}
+
+// Both packings, sizes around the vector block, against the references
+static void test_unpack_spans(void) {
+    const gsize sizes[] = {1, 2, 3, 15, 16, 17, 31, 33, 1021};
+    const ringbuf_packing_t packings[] = {RINGBUF_PACKING_MONO10P, RINGBUF_PACKING_MONO12P};
+    GRand *rand = g_rand_new_with_seed(89);
+
+    for (guint p = 0; p < G_N_ELEMENTS(packings); p++) {
+        guint bits = packings[p] == RINGBUF_PACKING_MONO10P ? 10 : 12;
+        for (guint s = 0; s < G_N_ELEMENTS(sizes); s++) {
+            gsize n = sizes[s], size;
+            guint16 *pixels = g_new(guint16, n);
+            guint16 *u16 = g_new(guint16, n);
+            gfloat *f32 = g_new(gfloat, n);
+
+            for (gsize i = 0; i < n; i++) {
+                pixels[i] = g_rand_int_range(rand, 0, 1 << bits);
+            }
+            guint8 *packed = pack(pixels, n, bits, &size);
+            g_assert_cmpuint(ringbuf_unpack_packed_size(packings[p], n), ==, size);
+
+            ringbuf_unpack_u16(packings[p], packed, n, u16);
+            ringbuf_unpack_f32(packings[p], packed, n, f32);
+            for (gsize i = 0; i < n; i++) {
+                g_assert_cmpuint(unpack_one(packed, bits, i), ==, pixels[i]);
+                g_assert_cmpuint(u16[i], ==, pixels[i]);
+                g_assert_cmpfloat(f32[i], ==, pixels[i]);
+            }
+
+            g_free(packed);
+            g_free(f32);
+            g_free(u16);
+            g_free(pixels);
+        }
+    }
+    g_rand_free(rand);
+}
+
+// Frames unpacked straight out of the ring, across the wrap
+static void test_unpack_pop(void) {
+    const gsize n = 1000;
+    ringbuf_t *rb = ringbuf_new(4096, TRUE);
+    guint16 *pixels = g_new(guint16, n);
+    guint16 *u16 = g_new(guint16, n);
+    gfloat *f32 = g_new(gfloat, n);
+    gsize size;
+
+    for (guint f = 0; f < 10; f++) {
+        for (gsize i = 0; i < n; i++) {
+            pixels[i] = (i * 7 + f) & 0xfff;
+        }
+        guint8 *packed = pack(pixels, n, 12, &size);
+        ringbuf_push(rb, packed, size);
+        if (f % 2 == 0) {
+            ringbuf_unpack_pop_u16(rb, RINGBUF_PACKING_MONO12P, n, u16);
+            g_assert_true(memcmp(u16, pixels, n * sizeof(guint16)) == 0);
+        }
+        else {
+            ringbuf_unpack_pop_f32(rb, RINGBUF_PACKING_MONO12P, n, f32);
+            for (gsize i = 0; i < n; i++) {
+                g_assert_cmpfloat(f32[i], ==, pixels[i]);
+            }
+        }
+        g_free(packed);
+    }
+    g_assert_true(ringbuf_is_empty(rb));
+
+    g_free(f32);
+    g_free(u16);
+    g_free(pixels);
+    ringbuf_free(rb);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ringbuf/unpack/spans", test_unpack_spans);
+    g_test_add_func("/ringbuf/unpack/pop", test_unpack_pop);
+
+    return g_test_run();
+}